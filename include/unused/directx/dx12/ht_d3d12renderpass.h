@@ -37,7 +37,7 @@ namespace Hatchit
                 // Inherited via RenderPassBase
                 virtual void VUpdate() override;
 
-                virtual bool VBuildCommandList(const ICommandPool* commandPool) override;
+                virtual bool VBuildCommandList(const CommandRecordContext& context) override;
 
             private:
 
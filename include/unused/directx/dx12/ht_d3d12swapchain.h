@@ -32,13 +32,15 @@ namespace Hatchit
 
                 ~D3D12SwapChain();
                 
+                void VBeginFrame() override;
+
                 void VClear(float* color) override;
 
                 bool VInitialize(uint32_t width, uint32_t height)  override;
 
                 void VResize(uint32_t width, uint32_t height) override;
 
-                void VExecute(std::vector<RenderPassHandle> renderPasses) override;
+                void VExecute(const std::vector<RenderPassHandle>& renderPasses) override;
 
                 void VSetInput(RenderPassHandle handle) override;
 
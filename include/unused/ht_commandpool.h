@@ -18,22 +18,49 @@
 *
 * \brief An interface to an object that allocates command buffers / command lists
 * that will need to be implemented with a graphics language
+*
+* Pools are transient: every command list handed out is only valid until the
+* next VReset, after which the pool recycles it rather than allocating again.
 */
 
 #pragma once
 
 #include <ht_platform.h>    //HT_API
+#include <cstdint>          //uint64_t
 
 namespace Hatchit
 {
     namespace Graphics
     {
+        struct CommandPoolStats
+        {
+            uint64_t allocations;           //Command lists allocated from the graphics API
+            uint64_t allocationsAvoided;    //Requests served by recycling a command list after a reset
+            uint64_t resets;                //Times the whole pool has been reset
+            uint64_t recordNanoseconds;     //Time spent beginning and ending command lists
+        };
+
+        struct RecordStats
+        {
+            uint32_t draws;         //Draw calls recorded
+            uint32_t bindsIssued;   //Binds, pushes and dynamic state recorded
+            uint32_t bindsElided;   //Ones skipped because they were already bound
+        };
+
         class HT_API ICommandPool 
         {
         public:
             virtual ~ICommandPool() {}
 
             virtual bool VInitialize() = 0;
+
+            //Return every command list from this pool to it in one go
+            virtual bool VReset() = 0;
+
+            const CommandPoolStats& GetStats() const { return m_stats; }
+
+        protected:
+            CommandPoolStats m_stats = {};
         };
     }
 }
\ No newline at end of file
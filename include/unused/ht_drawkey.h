@@ -0,0 +1,68 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+/**
+* \class DrawKeySorter
+* \ingroup HatchitGraphics
+*
+* \brief Packs render requests into 64-bit keys and radix sorts them
+*
+* A key holds, from the most significant bits down, the pipeline's,
+* material's and mesh's sort ids and the request's depth. Sorting the
+* keys groups requests by pipeline, then material, then mesh, with
+* nearer requests first inside each group, so instanced draws fall out
+* of the runs of equal keys.
+*
+* Keys are sorted with an LSD radix sort, eight bits per pass. Bytes
+* every key shares are skipped, so a frame with few distinct resources
+* only pays for the bytes that differ. Large sorts are split into blocks
+* that are counted and scattered in parallel on a JobScheduler. The sort
+* is stable, so equal keys stay in submission order.
+*/
+
+#pragma once
+
+#include <ht_platform.h>        //HT_API
+#include <ht_jobscheduler.h>    //JobScheduler
+#include <cstddef>              //size_t
+#include <cstdint>              //uint64_t
+
+namespace Hatchit
+{
+    namespace Graphics
+    {
+        struct DrawKey
+        {
+            uint64_t    key;
+            uint32_t    index;  //Index of the request the key was made from
+        };
+
+        class HT_API DrawKeySorter
+        {
+        public:
+            static const uint32_t PipelineBits = 12;
+            static const uint32_t MaterialBits = 16;
+            static const uint32_t MeshBits = 16;
+            static const uint32_t DepthBits = 20;
+
+            //Below this many keys the sort stays on the calling thread
+            static const size_t ParallelThreshold = 16 * 1024;
+            static const uint32_t MaxBlocks = 16;
+
+            static uint64_t MakeKey(uint32_t pipeline, uint32_t material, uint32_t mesh, float depth);
+
+            static void Sort(DrawKey* keys, DrawKey* scratch, size_t count, JobScheduler* scheduler = nullptr);
+        };
+    }
+}
@@ -0,0 +1,135 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+/**
+* \class FrameArena
+* \ingroup HatchitGraphics
+*
+* \brief A linear allocator for data that only lives until the end of a frame
+*
+* Allocations bump a pointer through a block of memory and are never freed
+* one by one; Reset rewinds the whole arena at once. When a frame needs more
+* than the arena holds, another block is added. The next Reset folds every
+* block into one big enough for that frame, so a steady-state frame never
+* touches the heap.
+*
+* An arena is not thread safe. Each thread building frame data needs its own.
+* Anything with a destructor placed in the arena has to be destroyed before
+* Reset; FrameAllocator lets standard containers live in an arena.
+*/
+
+#pragma once
+
+#include <ht_platform.h>    //HT_API
+#include <cstddef>          //size_t
+#include <cstdint>          //uint8_t
+#include <limits>           //std::numeric_limits
+#include <new>              //std::bad_alloc
+#include <vector>           //std::vector
+
+namespace Hatchit
+{
+    namespace Graphics
+    {
+        struct FrameArenaStats
+        {
+            size_t      bytesUsed;          //Bytes handed out since the last Reset
+            size_t      bytesReserved;      //Bytes held across every block
+            uint32_t    blockCount;         //Blocks currently held
+            uint32_t    heapAllocations;    //Blocks ever allocated; steady when no frame grows the arena
+        };
+
+        class HT_API FrameArena
+        {
+        public:
+            static const size_t DefaultBlockSize = 64 * 1024;
+
+            FrameArena(size_t blockSize = DefaultBlockSize);
+            ~FrameArena();
+
+            FrameArena(const FrameArena&) = delete;
+            FrameArena& operator=(const FrameArena&) = delete;
+
+            void* Allocate(size_t size, size_t alignment);
+            void Reset();
+
+            FrameArenaStats GetStats() const;
+
+        private:
+            struct Block
+            {
+                uint8_t*    data;
+                size_t      size;
+            };
+
+            std::vector<Block>  m_blocks;
+            size_t              m_blockSize;
+            size_t              m_current;  //Block being bumped through
+            size_t              m_offset;   //Next free byte in the current block
+            size_t              m_used;
+            uint32_t            m_heapAllocations;
+
+            bool addBlock(size_t minimumSize);
+            void releaseBlocks();
+        };
+
+        /**
+        * Lets standard containers allocate from a FrameArena.
+        * Deallocation does nothing; the memory comes back when the arena resets.
+        * Like any standard allocator, failing to allocate throws std::bad_alloc.
+        */
+        template<typename T>
+        class FrameAllocator
+        {
+        public:
+            typedef T value_type;
+
+            explicit FrameAllocator(FrameArena* arena) : m_arena(arena) {}
+
+            template<typename U>
+            FrameAllocator(const FrameAllocator<U>& other) : m_arena(other.GetArena()) {}
+
+            T* allocate(size_t count)
+            {
+                if (count > std::numeric_limits<size_t>::max() / sizeof(T))
+                    throw std::bad_alloc();
+
+                void* memory = m_arena->Allocate(count * sizeof(T), alignof(T));
+                if (memory == nullptr)
+                    throw std::bad_alloc();
+
+                return static_cast<T*>(memory);
+            }
+
+            void deallocate(T*, size_t) {}
+
+            FrameArena* GetArena() const { return m_arena; }
+
+            template<typename U>
+            struct rebind { typedef FrameAllocator<U> other; };
+
+        private:
+            FrameArena* m_arena;
+        };
+
+        template<typename T, typename U>
+        bool operator==(const FrameAllocator<T>& a, const FrameAllocator<U>& b) { return a.GetArena() == b.GetArena(); }
+
+        template<typename T, typename U>
+        bool operator!=(const FrameAllocator<T>& a, const FrameAllocator<U>& b) { return a.GetArena() != b.GetArena(); }
+
+        template<typename T>
+        using FrameVector = std::vector<T, FrameAllocator<T>>;
+    }
+}
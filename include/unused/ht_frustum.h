@@ -0,0 +1,78 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+/**
+* \class Frustum
+* \ingroup HatchitGraphics
+*
+* \brief The six planes bounding what a camera can see
+*
+* Planes are pulled straight out of the combined view and projection
+* matrix and normalized, so the signed distance of a point from each is
+* in world units. Each plane faces into the frustum; a sphere whose
+* centre is further than its radius behind any plane can't be seen.
+*
+* The near plane is taken as if clip depth ran from -w to w. With a
+* 0 to w projection that plane sits a little behind the real one, which
+* only ever keeps objects that could have been culled.
+*/
+
+#pragma once
+
+#include <ht_platform.h>    //HT_API
+#include <ht_math.h>        //Math::Matrix4
+
+namespace Hatchit
+{
+    namespace Graphics
+    {
+        //A world space sphere around an object; a radius of 0 or less is never culled
+        struct BoundingSphere
+        {
+            float   x;
+            float   y;
+            float   z;
+            float   radius;
+        };
+
+        class HT_API Frustum
+        {
+        public:
+            enum Plane
+            {
+                Left,
+                Right,
+                Bottom,
+                Top,
+                Near,
+                Far,
+
+                PlaneCount
+            };
+
+            Frustum();
+            Frustum(const Math::Matrix4& view, const Math::Matrix4& proj);
+
+            void Set(const Math::Matrix4& view, const Math::Matrix4& proj);
+
+            bool Intersects(const BoundingSphere& sphere) const;
+
+            //Every plane as a, b, c, d with a*x + b*y + c*z + d >= 0 inside
+            const float* GetPlanes() const;
+
+        private:
+            float m_planes[PlaneCount][4];
+        };
+    }
+}
@@ -0,0 +1,66 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+/**
+* \class FrustumCuller
+* \ingroup HatchitGraphics
+*
+* \brief Tests many bounding spheres against a frustum at once
+*
+* Spheres are read from separate arrays of x, y, z and radius so eight
+* of them fit in a handful of vector registers. With AVX the eight are
+* tested in one go; with SSE as two halves of four. Anything left over,
+* and builds with neither, fall back to Frustum::Intersects, which the
+* vector paths agree with exactly.
+*
+* Large batches are split into blocks that are culled in parallel on a
+* JobScheduler.
+*/
+
+#pragma once
+
+#include <ht_platform.h>        //HT_API
+#include <ht_frustum.h>         //Frustum
+#include <ht_jobscheduler.h>    //JobScheduler
+#include <cstddef>              //size_t
+#include <cstdint>              //uint8_t
+
+namespace Hatchit
+{
+    namespace Graphics
+    {
+        //Bounding spheres laid out one component per array
+        struct BoundingSphereSoA
+        {
+            const float*    x;
+            const float*    y;
+            const float*    z;
+            const float*    radius;
+        };
+
+        class HT_API FrustumCuller
+        {
+        public:
+            //Spheres tested per iteration; blocks are split on multiples of this
+            static const size_t Width = 8;
+
+            //Below this many spheres culling stays on the calling thread
+            static const size_t ParallelThreshold = 8 * 1024;
+            static const uint32_t MaxBlocks = 16;
+
+            static size_t Cull(const Frustum& frustum, const BoundingSphereSoA& spheres, size_t count,
+                uint8_t* visible, JobScheduler* scheduler = nullptr);
+        };
+    }
+}
@@ -24,6 +24,9 @@
 #include <ht_rendertarget.h>
 #include <ht_renderpass.h>
 #include <ht_mesh.h>
+#include <ht_gpuresourcerequest.h>
+#include <functional>
+#include <mutex>
 
 namespace Hatchit
 {
@@ -44,6 +47,13 @@ namespace Hatchit
         class HT_API GPUResourcePool : public Core::Singleton<GPUResourcePool>
         {
         public:
+            /**
+            * Called when the memory budget evicts a resource or brings it back.
+            * base is the object the loader wrote into the request's data, so it
+            * matches a handle's GetBase().
+            */
+            typedef std::function<void(GPUResourceRequest::Type type, void* base, bool resident)> ResidencyCallback;
+
             static bool             Initialize(IDevice* device, SwapChain* swapchain);
             static void             DeInitialize();
             static bool             IsLocked();
@@ -57,14 +67,16 @@ namespace Hatchit
             static void             RequestRenderTarget(std::string file, void** data);
             static void             RequestMesh(std::string file, void** data);
 
-            static void             RequestTextureAsync(std::string file, void** data);
-            static void             RequestMaterialAsync(std::string file, void** data);
-            static void             RequestRootLayoutAsync(std::string file, void** data);
-            static void             RequestPipelineAsync(std::string file, void** data);
-            static void             RequestShaderAsync(std::string file, void** data);
-            static void             RequestRenderPassAsync(std::string file, void** data);
-            static void             RequestRenderTargetAsync(std::string file, void** data);
-            static void             RequestMeshAsync(std::string file, void** data);
+            static uint64_t         RequestTextureAsync(std::string file, void** data, GPUResourceRequest::Priority priority = GPUResourceRequest::Priority::Prefetch);
+            static uint64_t         RequestMaterialAsync(std::string file, void** data, GPUResourceRequest::Priority priority = GPUResourceRequest::Priority::Prefetch);
+            static uint64_t         RequestRootLayoutAsync(std::string file, void** data, GPUResourceRequest::Priority priority = GPUResourceRequest::Priority::Prefetch);
+            static uint64_t         RequestPipelineAsync(std::string file, void** data, GPUResourceRequest::Priority priority = GPUResourceRequest::Priority::Prefetch);
+            static uint64_t         RequestShaderAsync(std::string file, void** data, GPUResourceRequest::Priority priority = GPUResourceRequest::Priority::Prefetch);
+            static uint64_t         RequestRenderPassAsync(std::string file, void** data, GPUResourceRequest::Priority priority = GPUResourceRequest::Priority::Prefetch);
+            static uint64_t         RequestRenderTargetAsync(std::string file, void** data, GPUResourceRequest::Priority priority = GPUResourceRequest::Priority::Prefetch);
+            static uint64_t         RequestMeshAsync(std::string file, void** data, GPUResourceRequest::Priority priority = GPUResourceRequest::Priority::Prefetch);
+
+            static bool             CancelRequest(uint64_t id);
 
             static void             CreateTexture(std::string file, void** data);
             static void             CreateMaterial(std::string file, void** data);
@@ -75,9 +87,14 @@ namespace Hatchit
             static void             CreateRenderTarget(std::string file, void** data);
             static void             CreateMesh(std::string file, void** data);
 
+            static void             SetResidencyCallback(ResidencyCallback callback);
+            static void             NotifyResidency(GPUResourceRequest::Type type, void* base, bool resident);
+
         private:
             GPUResourceThread*  m_thread;
             IDevice*            m_device;
+            ResidencyCallback   m_residencyCallback;
+            std::mutex          m_residencyMutex;
             
         };
     }
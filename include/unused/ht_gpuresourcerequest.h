@@ -34,6 +34,10 @@ namespace Hatchit
         class GPUResourceRequest
         {
         public:
+            GPUResourceRequest()
+                : data(nullptr), priority(Priority::Frame), id(0),
+                  blocking(false), cancelled(false), finished(false) { };
+
             virtual ~GPUResourceRequest() { };
 
             enum class Type
@@ -48,15 +52,31 @@ namespace Hatchit
                 Mesh
             };
 
-            Type type;
+            /**
+            * Loads needed by the frame being built are always picked up
+            * before prefetches, no matter how long the prefetches have waited.
+            */
+            enum class Priority
+            {
+                Prefetch,
+                Frame
+            };
+
+            Type                type;
+            std::string         file;
+            void**              data;
+            Priority            priority;
+
+            //Owned by the GPUResourceThread and guarded by its mutex
+            uint64_t            id;
+            bool                blocking;
+            bool                cancelled;
+            bool                finished;
         };
 
         template <typename T>
         class HT_API GPURequest : public GPUResourceRequest
         {
-        public:
-            std::string         file;
-            void**              data;
         };
 
         using TextureRequest = GPURequest<Texture>;
@@ -16,13 +16,13 @@
 
 #include <ht_platform.h>
 #include <ht_string.h>
-#include <ht_threadvector.h>
-#include <ht_threadstack.h>
-#include <ht_threadqueue.h>
 #include <atomic>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <deque>
+#include <map>
+#include <vector>
 #include <ht_gpuresourcerequest.h>
 
 #include <ht_texture_resource.h>
@@ -47,23 +47,29 @@ namespace Hatchit
         *
         *   \brief Abstract class that defines and implements functions for creation of GPU resource objects.
         *
-        *   This class defines the logic for the GPU resource thread owned by GPUResourcePool, for the
-        *   loading and creation of GPU resource objects.
+        *   This class defines the logic for the pool of GPU resource loader threads owned by
+        *   GPUResourcePool, for the loading and creation of GPU resource objects. Workers sleep
+        *   until a request arrives and always pick up frame-critical loads before prefetches.
+        *   Requests for a file that is already queued or loading are attached to that load
+        *   instead of loading the file a second time.
         */
         class HT_API GPUResourceThread
         {
-            using GPURequestQueue = Core::ThreadsafeStack<GPUResourceRequest*>;
-
         public:
+            GPUResourceThread();
+
             virtual ~GPUResourceThread() { };
 
             virtual void VStart() = 0;
 
             bool Locked() const;
             void Load(GPUResourceRequest* request);
-            void LoadAsync(GPUResourceRequest* request);
+            uint64_t LoadAsync(GPUResourceRequest* request);
+            bool Cancel(uint64_t id);
             void Kill();
 
+            uint32_t GetWorkerCount() const;
+
             void CreateTexture(std::string file, void** data);
             void CreateMaterial(std::string file, void** data);
             void CreateRootLayout(std::string file, void** data);
@@ -74,14 +80,36 @@ namespace Hatchit
             void CreateMesh(std::string file, void** data);
 
         protected:
-            std::thread             m_thread;
-            std::atomic_bool        m_alive;
-            std::atomic_bool        m_tfinished;
-            std::atomic_bool        m_locked;
-            mutable std::mutex      m_mutex;
-            std::condition_variable m_cv;
-            std::atomic_bool        m_processed;
-            GPURequestQueue         m_requests;
+            using LoadKey = std::pair<GPUResourceRequest::Type, std::string>;
+
+            //Every request for the same file, loaded once by a single worker
+            struct PendingLoad
+            {
+                LoadKey                             key;
+                GPUResourceRequest::Priority        priority;
+                bool                                started;
+                size_t                              next;       //First request the worker hasn't picked up yet
+                std::vector<GPUResourceRequest*>    requests;
+            };
+
+            std::vector<std::thread>    m_threads;
+            uint32_t                    m_workerCount;
+            std::atomic_bool            m_alive;
+
+            //Guards the queues, the load table and the state of every queued request
+            mutable std::mutex          m_mutex;
+            std::condition_variable     m_cv;       //Workers sleep on this until a load is queued
+            std::condition_variable     m_finished; //Blocking loaders sleep on this until their request is done
+            std::deque<PendingLoad*>    m_queues[2];//Indexed by GPUResourceRequest::Priority
+            std::map<LoadKey, PendingLoad*>     m_loads;    //Queued or in flight
+            std::map<uint64_t, PendingLoad*>    m_tickets;  //Async request id to its load
+            uint64_t                    m_nextID;
+
+            //Backends share upload command buffers and descriptor pools between
+            //workers so object creation is serialized. Nested loads re-enter it.
+            std::recursive_mutex        m_createMutex;
+
+            void runLoads();
 
             void ProcessTextureRequest(TextureRequest* request);
             void ProcessMaterialRequest(MaterialRequest* request);
@@ -92,6 +120,8 @@ namespace Hatchit
             void ProcessRenderTargetRequest(RenderTargetRequest* request);
             void ProcessMeshRequest(MeshRequest* request);
 
+            void ProcessRequest(GPUResourceRequest* request);
+
             virtual void VCreateTextureBase(Resource::TextureHandle handle, void** base) = 0;
             virtual void VCreateMaterialBase(Resource::MaterialHandle handle, void** base) = 0;
             virtual void VCreateRootLayoutBase(Resource::RootLayoutHandle handle, void** base) = 0;
@@ -100,6 +130,15 @@ namespace Hatchit
             virtual void VCreateRenderPassBase(Resource::RenderPassHandle handle, void** base) = 0;
             virtual void VCreateRenderTargetBase(Resource::RenderTargetHandle handle, void** base) = 0;
             virtual void VCreateMeshBase(Resource::ModelHandle handle, void** base) = 0;
+
+        private:
+            std::mutex                  m_startMutex;
+
+            bool start();
+            uint64_t enqueue(GPUResourceRequest* request);
+            PendingLoad* nextLoad();
+            void finishLoad(PendingLoad* load);
+            void finishRequest(GPUResourceRequest* request);
         };
     }
 }
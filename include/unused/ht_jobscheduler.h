@@ -0,0 +1,107 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+/**
+* \class JobScheduler
+* \ingroup HatchitGraphics
+*
+* \brief A work-stealing scheduler used to spread render work across threads
+*
+* Every worker owns a deque of jobs. A worker pops from the back of its own
+* deque and steals from the front of the others when it runs dry. Completion
+* is tracked with a JobCounter; a thread waiting on a counter executes pending
+* jobs itself and only goes to sleep when there is nothing left to steal.
+*/
+
+#pragma once
+
+#include <ht_platform.h>        //HT_API
+#include <atomic>               //std::atomic
+#include <condition_variable>   //std::condition_variable
+#include <deque>                //std::deque
+#include <functional>           //std::function
+#include <mutex>                //std::mutex
+#include <thread>               //std::thread
+#include <vector>               //std::vector
+
+namespace Hatchit
+{
+    namespace Graphics
+    {
+        /**
+        * A job receives the context index of the thread running it.
+        * Indices [0, workerCount) belong to the workers, workerCount belongs
+        * to the thread that called JobScheduler::Wait.
+        */
+        typedef std::function<void(uint32_t)> Job;
+
+        class HT_API JobCounter
+        {
+        public:
+            JobCounter();
+
+            void Add(uint32_t count);
+            bool Decrement();
+
+            bool IsDone() const;
+
+        private:
+            std::atomic<uint32_t> m_count;
+        };
+
+        class HT_API JobScheduler
+        {
+        public:
+            JobScheduler();
+            ~JobScheduler();
+
+            bool Start(uint32_t workerCount);
+            void Shutdown();
+
+            void Schedule(Job job, JobCounter* counter);
+            void Wait(JobCounter* counter);
+
+            uint32_t GetWorkerCount() const;
+            uint32_t GetContextCount() const;
+
+        private:
+            struct Entry
+            {
+                Job         job;
+                JobCounter* counter;
+            };
+
+            struct Worker
+            {
+                std::mutex          mutex;
+                std::deque<Entry>   jobs;
+                std::thread         thread;
+            };
+
+            std::vector<Worker*>    m_workers;
+            std::atomic_bool        m_alive;
+            std::atomic<uint32_t>   m_pending;  //Jobs sitting in any deque
+            std::atomic<uint32_t>   m_next;     //Round robin target for jobs scheduled from outside
+
+            std::mutex              m_sleepMutex;
+            std::condition_variable m_wake;     //Workers sleep on this when there's nothing to steal
+            std::condition_variable m_done;     //Waiters sleep on this until a counter drains
+
+            void worker_main(uint32_t index);
+
+            bool popOrSteal(uint32_t index, Entry& entry);
+            void execute(Entry& entry, uint32_t index);
+        };
+    }
+}
@@ -83,8 +83,11 @@ namespace Hatchit {
             PipelineHandle const GetPipeline() const;
             MaterialBase* const GetBase() const;
 
+            uint32_t GetSortID() const;
+
         protected:
             MaterialBase* m_base;
+            uint32_t m_sortID;  //Packed into draw keys
 
         };
 
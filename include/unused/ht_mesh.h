@@ -52,8 +52,11 @@ namespace Hatchit {
 
             MeshBase* const GetBase() const;
 
+            uint32_t GetSortID() const;
+
         protected:
             MeshBase* m_base;
+            uint32_t m_sortID;  //Packed into draw keys
         };
 
         using MeshHandle = Core::Handle<Mesh>;
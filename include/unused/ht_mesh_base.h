@@ -32,6 +32,14 @@ namespace Hatchit {
 
     namespace Graphics {
 
+        //Where a mesh lives in the buffers it's drawn from
+        struct MeshRange
+        {
+            int32_t  vertexOffset;  //Added to every index
+            uint32_t firstIndex;
+            uint32_t indexCount;
+        };
+
         class HT_API MeshBase
         {
         public:
@@ -39,8 +47,12 @@ namespace Hatchit {
 
             virtual uint32_t VGetIndexCount() = 0;
 
+            //Meshes that share buffers are drawn with these instead of rebinding
+            const MeshRange& GetRange() const { return m_range; }
+
         protected:
             uint32_t m_indexCount;
+            MeshRange m_range = {};
         };
     }
 }
\ No newline at end of file
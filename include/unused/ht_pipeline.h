@@ -68,8 +68,11 @@ namespace Hatchit {
 
             PipelineBase* const GetBase() const;
 
+            uint32_t GetSortID() const;
+
         protected:
             PipelineBase* m_base;
+            uint32_t m_sortID;  //Packed into draw keys
         };
        
         using PipelineHandle = Core::Handle<Pipeline>;
@@ -37,9 +37,12 @@
 #include <ht_camera.h>
 #include <Hatchit/HatchitGraphics/include/ht_device.h>
 #include <ht_gpuqueue.h>
-#include <ht_threadqueue.h>
 #include <ht_shadervariable.h>
-#include <ht_renderthread.h>
+#include <ht_jobscheduler.h>
+#include <ht_rendergraph.h>
+#include <ht_commandpool.h>
+#include <atomic>
+#include <mutex>
 
 namespace Hatchit {
 
@@ -76,6 +79,7 @@ namespace Hatchit {
             void*           display;
             Color           clearColor;
             std::string     applicationName;
+            uint32_t        framesInFlight = 2; //How many frames the CPU may record ahead of the GPU; 1 to 3
         };
 
         class HT_API Renderer
@@ -102,7 +106,14 @@ namespace Hatchit {
             ///Present a frame to the screen via a backbuffer
             void Present();
 
-            void RegisterRenderRequest(RenderPassHandle pass, MaterialHandle material, MeshHandle mesh, ShaderVariableChunk* instanceVariables);
+            void RegisterRenderRequest(RenderPassHandle pass, MaterialHandle material, MeshHandle mesh, ShaderVariableChunk* instanceVariables,
+                const BoundingSphere& bounds = BoundingSphere());
+            RenderRequestID AddRenderRequest(RenderPassHandle pass, MaterialHandle material, MeshHandle mesh, ShaderVariableChunk* instanceVariables, float depth = 0.0f,
+                const BoundingSphere& bounds = BoundingSphere());
+
+            void RemoveRenderPass(RenderPassHandle pass);
+
+            void SetPresentPass(RenderPassHandle pass);
 
             void RegisterCamera(Camera camera);
 
@@ -112,25 +123,31 @@ namespace Hatchit {
 
             static RendererType GetType();
 
+            ///Sum of the statistics of every command pool owned by this renderer
+            CommandPoolStats GetCommandPoolStats() const;
+
         protected:
             static IDevice*     _Device;
             static GPUQueue*    _Queue;
+            static GPUQueue*    _CopyQueue;
             static RendererType _Type;
             static SwapChain*   _SwapChain;
 
-            //A collection of renderpass layers. Each layer may contain multiple render passes.
-            std::vector<std::vector<RenderPassHandle>> m_renderPassLayers = std::vector<std::vector<RenderPassHandle>>(64);
-            //A collection of cameras sorted by renderpass layer. Repopulated each frame.
-            std::vector<std::vector<Graphics::Camera>> m_renderPassCameras = std::vector<std::vector<Graphics::Camera>>(64);
+            //Every registered render pass, ordered by the render targets they share
+            RenderGraph m_renderGraph;
+            std::mutex  m_graphMutex;
+            //Passes stamped with this generation are already in the graph. Unique across
+            //renderers and bumped whenever a pass is removed.
+            std::atomic<uint64_t> m_generation;
+            static std::atomic<uint64_t> _Generation;
+            //Cameras matched to passes by layer. Repopulated each frame.
+            std::vector<Graphics::Camera> m_cameras;
             
-            std::vector<RenderThread*> m_threads;
-            std::mutex m_mutex;
-            std::unique_lock<std::mutex> m_lock;
-            std::condition_variable m_cv;
-            bool m_locked;
-            bool m_processed;
-
-            Core::ThreadsafeQueue<RenderPassHandle> m_threadQueue;
+            //Records render pass command lists across worker threads
+            JobScheduler m_scheduler;
+            //Command pools indexed by [frame slot][scheduler context]. A pool is only ever
+            //touched by the thread with its context index and is reset once its frame slot is free
+            std::vector<std::vector<ICommandPool*>> m_commandPools;
 
             RendererParams  m_params;
             
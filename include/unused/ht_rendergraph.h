@@ -0,0 +1,72 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+/**
+* \class RenderGraph
+* \ingroup HatchitGraphics
+*
+* \brief Orders render passes by the render targets they read and write
+*
+* A pass depends on the nearest pass registered before it that writes one
+* of its input targets, and the next pass to write that target waits for
+* it to finish reading. A target read before anything writes it in the
+* frame holds whatever was written last frame, such as history or
+* ping-pong targets. The graph is sorted into levels such that no pass depends on another pass in
+* its own level, so a whole level may be recorded and submitted together.
+* Passes that don't feed the presented pass are culled. The compiled result
+* is cached until a pass is added or removed.
+*/
+
+#pragma once
+
+#include <ht_platform.h>    //HT_API
+#include <ht_renderpass.h>  //RenderPassHandle
+#include <vector>           //std::vector
+
+namespace Hatchit
+{
+    namespace Graphics
+    {
+        class HT_API RenderGraph
+        {
+        public:
+            RenderGraph();
+
+            bool AddPass(RenderPassHandle pass);
+            bool RemovePass(RenderPassHandle pass);
+
+            void SetPresentPass(RenderPassHandle pass);
+
+            const std::vector<std::vector<RenderPassHandle>>& Compile();
+
+            RenderPassHandle GetPresentPass() const;
+            const std::vector<RenderPassHandle>& GetPasses() const;
+
+            bool IsDirty() const;
+
+        private:
+            //Every registered pass in registration order
+            std::vector<RenderPassHandle> m_passes;
+
+            //The pass the user asked to present; may be unset
+            RenderPassHandle m_presentPass;
+
+            //Compiled output
+            std::vector<std::vector<RenderPassHandle>> m_levels;
+            RenderPassHandle m_compiledPresentPass;
+
+            bool m_dirty;
+        };
+    }
+}
@@ -31,12 +31,14 @@
 #include <Hatchit/HatchitGraphics/include/ht_color.h>
 #include <ht_shadervariablechunk.h>
 #include <ht_commandpool.h>     //ICommandPool
+#include <ht_renderpass_base.h> //RenderRequestID & BoundingSphere
 
 namespace Hatchit {
 
     namespace Graphics {
 
         class RenderPassBase;
+        struct CommandRecordContext;
 
         class HT_API RenderPass : public Core::RefCounted<Graphics::RenderPass>
         {
@@ -46,15 +48,31 @@ namespace Hatchit {
 
             bool Initialize(const std::string& file);
 
-            bool BuildCommandList(const ICommandPool* commandPool);
+            bool BuildCommandList(const CommandRecordContext& context);
+
+            void SetChunkSize(uint32_t chunkSize);
+            void SetGPUDriven(bool gpuDriven);
 
             void SetView(Math::Matrix4 view);
             void SetProj(Math::Matrix4 proj);
 
-            void ScheduleRenderRequest(MaterialHandle material, MeshHandle mesh, ShaderVariableChunk* instanceVariables);
+            void ScheduleRenderRequest(MaterialHandle material, MeshHandle mesh, ShaderVariableChunk* instanceVariables, float depth = 0.0f,
+                const BoundingSphere& bounds = BoundingSphere());
+
+            RenderRequestID AddRenderRequest(MaterialHandle material, MeshHandle mesh, ShaderVariableChunk* instanceVariables, float depth = 0.0f,
+                const BoundingSphere& bounds = BoundingSphere());
+            void RemoveRenderRequest(RenderRequestID id);
+            void UpdateRenderRequest(RenderRequestID id, float depth = 0.0f, const BoundingSphere& bounds = BoundingSphere());
+
+            bool MarkRegistered(uint64_t generation);
 
             uint64_t GetLayerFlags();
 
+            const RecordStats& GetRecordStats() const;
+
+            const std::vector<std::string>& GetInputPaths() const;
+            const std::vector<std::string>& GetOutputPaths() const;
+
             RenderPassBase* const GetBase() const;
 
         private:
@@ -18,6 +18,21 @@
 *
 * \brief An abstraction of a class that will render the whole scene from a perspective with a graphics language
 *
+* Requests come in two kinds. Scheduled requests last for one frame and
+* have to be scheduled again every frame. Retained requests are added once
+* and stay until they're removed; they're kept sorted as they come and go,
+* so a frame never sorts them again. A pass whose draws are all retained
+* and whose draw list and camera haven't changed may reuse what it
+* recorded the last time the frame slot came around.
+*
+* Requests are culled on the CPU while the hierarchy is built. Their
+* bounds are tested against the frustum of the camera the pass was given,
+* eight at a time, spread over the job scheduler.
+*
+* A pass set to be GPU driven leaves culling to the GPU. Every instance
+* is tested against the camera's frustum by a compute dispatch, which
+* writes the draws' instance counts; the pass only records one indirect
+* draw per material and mesh.
 */
 
 #pragma once
@@ -31,17 +46,31 @@
 #include <ht_mesh.h>                //MeshHandle
 #include <ht_rendertarget.h>        //RenderTargetHandle
 #include <ht_commandpool.h>         //ICommandPool
+#include <ht_jobscheduler.h>        //JobScheduler
+#include <ht_framearena.h>          //FrameArena & FrameVector
+#include <ht_drawkey.h>             //DrawKey
+#include <ht_frustum.h>             //BoundingSphere
+#include <ht_submissionqueue.h>     //SubmissionQueue
+#include <atomic>                   //std::atomic
+#include <mutex>                    //std::mutex
+#include <vector>                   //std::vector
 
 namespace Hatchit
 {
     namespace Graphics
     {
+        //Names a retained render request for as long as it's in its pass
+        using RenderRequestID = uint32_t;
+        const RenderRequestID InvalidRenderRequestID = 0xFFFFFFFF;
+
         struct RenderRequest
         {
             PipelineHandle          pipeline;
             MaterialHandle          material;
             MeshHandle              mesh;
             ShaderVariableChunk*    instanceData;
+            BoundingSphere          bounds;
+            uint64_t                sortKey;    //See DrawKeySorter
         };
 
         struct Renderable
@@ -54,32 +83,81 @@ namespace Hatchit
         {
             Renderable  renderable;
             uint32_t    count;
+            uint32_t    instanceIndex;  //Index of this draw's entry in the pass's instance data
+        };
+
+        struct PipelineRenderables
+        {
+            PipelineHandle                      pipeline;
+            FrameVector<RenderableInstances>    renderables;
+        };
+
+        struct MeshInstanceData
+        {
+            MeshHandle                          mesh;
+            FrameVector<ShaderVariableChunk*>   chunks;
+            FrameVector<uint64_t>               versions;   //Version of each retained chunk; 0 for scheduled ones
+            FrameVector<BoundingSphere>         bounds;     //Bounds of each instance, parallel to chunks
+        };
+
+        struct CommandRecordContext
+        {
+            JobScheduler*                       scheduler;  //Scheduler a pass may spread its own recording across
+            const std::vector<ICommandPool*>*   pools;      //This frame's command pools indexed by scheduler context
+            uint32_t                            index;      //Scheduler context of the thread recording the pass
         };
 
         class HT_API RenderPassBase
         {
         public:
-            virtual ~RenderPassBase() { };
+            RenderPassBase();
+            virtual ~RenderPassBase();
 
             virtual void VUpdate() = 0;
 
             void SetView(Math::Matrix4 view);
             void SetProj(Math::Matrix4 proj);
 
-            virtual bool VBuildCommandList(const ICommandPool* commandPool) = 0;
+            virtual bool VBuildCommandList(const CommandRecordContext& context) = 0;
+
+            void SetChunkSize(uint32_t chunkSize);
+            void SetGPUDriven(bool gpuDriven);
+
+            virtual void ScheduleRenderRequest(MaterialHandle material, MeshHandle mesh, ShaderVariableChunk* instanceVariables, float depth = 0.0f,
+                const BoundingSphere& bounds = BoundingSphere());
 
-            virtual void ScheduleRenderRequest(MaterialHandle material, MeshHandle mesh, ShaderVariableChunk* instanceVariables);
+            RenderRequestID AddRenderRequest(MaterialHandle material, MeshHandle mesh, ShaderVariableChunk* instanceVariables, float depth = 0.0f,
+                const BoundingSphere& bounds = BoundingSphere());
+            void RemoveRenderRequest(RenderRequestID id);
+            void UpdateRenderRequest(RenderRequestID id, float depth = 0.0f, const BoundingSphere& bounds = BoundingSphere());
+
+            bool MarkRegistered(uint64_t generation);
 
             virtual uint64_t GetLayerFlags();
 
+            const RecordStats& GetRecordStats() const;
+
+            const std::vector<std::string>& GetInputPaths() const;
+            const std::vector<std::string>& GetOutputPaths() const;
+
         protected:
-            void BuildRenderRequestHeirarchy();
+            void BuildRenderRequestHeirarchy(JobScheduler* scheduler = nullptr, bool cull = true);
 
-            //Input
+            //Input; every thread's submissions merged once per frame
             std::vector<RenderRequest> m_renderRequests;
 
-            std::map<PipelineHandle, std::vector<RenderableInstances>> m_pipelineList;
-            std::map<MeshHandle, std::vector<ShaderVariableChunk*>> m_instanceData;
+            //Everything built while recording a frame lives here and is dropped at once next frame.
+            //Only the thread recording the pass may allocate from it.
+            FrameArena m_frameArena;
+
+            //Sorted by pipeline, then material and mesh
+            FrameVector<PipelineRenderables> m_pipelineList;
+            //One entry per instanced draw, in draw order
+            FrameVector<MeshInstanceData> m_instanceData;
+
+            //Paths of the render targets read and written; these link passes in the render graph
+            std::vector<std::string> m_inputPaths;
+            std::vector<std::string> m_outputPaths;
 
             //Output
             std::vector<RenderTargetHandle> m_outputRenderTargets;
@@ -87,11 +165,57 @@ namespace Hatchit
             //Internals
             uint64_t m_layerflags = 1;
 
+            //How many renderables are recorded per job when a pass is split across threads; 0 never splits
+            uint32_t m_chunkSize = 256;
+
+            //True to cull and fill in draws on the GPU where the device allows it
+            bool m_gpuDriven = false;
+
             uint32_t m_width;
             uint32_t m_height;
 
             Math::Matrix4 m_view;
             Math::Matrix4 m_proj;
+
+            //Bumped whenever the view or projection actually changes
+            uint64_t m_cameraVersion = 1;
+            //Bumped whenever a retained request is added, removed or moved in the draw order
+            uint64_t m_retainedListVersion = 1;
+            //True if the last hierarchy was built only from retained requests
+            bool m_retainedOnly = false;
+
+            //Draws and binds of the command list submitted for the last frame
+            RecordStats m_recordStats = {};
+
+        private:
+            struct RetainedRequest
+            {
+                RenderRequest   request;
+                uint64_t        version;    //Bumped by every update
+                bool            alive;
+            };
+
+            //Scheduled requests, one buffer per submitting thread
+            SubmissionQueue<RenderRequest> m_submissions;
+
+            //Generation of the renderer that last registered this pass
+            std::atomic<uint64_t> m_registeredGeneration;
+
+            //Retained requests indexed by id, and their keys kept in draw order
+            std::mutex                      m_retainedMutex;
+            std::vector<RetainedRequest>    m_retainedRequests;
+            std::vector<RenderRequestID>    m_freeRequestIDs;
+            std::vector<DrawKey>            m_retainedKeys;
+            //Which retained requests were in view last frame, in key order
+            std::vector<uint8_t>            m_retainedVisible;
+
+            RenderRequest makeRenderRequest(MaterialHandle material, MeshHandle mesh, ShaderVariableChunk* instanceVariables,
+                float depth, const BoundingSphere& bounds) const;
+            void insertRetainedKey(uint64_t key, RenderRequestID id);
+            void eraseRetainedKey(uint64_t key, RenderRequestID id);
+
+            void gatherRenderRequests();
+            void resetFrameData();
         };
     }
 }
\ No newline at end of file
@@ -18,6 +18,10 @@
 *
 * \brief An object used to store and manage shader variables
 * this class will be used by mesh renderers, materials, and render passes
+*
+* Every Set widens the chunk's dirty range, so whoever copies the chunk
+* to the GPU can copy just the bytes that changed and then ClearDirty.
+* A new chunk is entirely dirty.
 */
 
 #pragma once
@@ -52,9 +56,17 @@ namespace Hatchit {
             const BYTE* GetByteData();
             size_t GetSize();
 
+            bool IsDirty() const;
+            void GetDirtyRange(size_t& begin, size_t& end) const;
+            void ClearDirty();
+
         private:
             BYTE*           m_byteData;
             std::size_t     m_byteDataSize;
+            std::size_t     m_dirtyBegin;   //Changed bytes since the last ClearDirty; empty when begin == end
+            std::size_t     m_dirtyEnd;
+
+            void markDirty(size_t offset, size_t size);
 
         };
     }
@@ -0,0 +1,52 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+/**
+* \class SortIDPool
+* \ingroup HatchitGraphics
+*
+* \brief Hands out small, dense ids for packing resources into sort keys
+*
+* Pipelines, materials and meshes each take an id from their own pool
+* when they're created and give it back when they're destroyed. Freed
+* ids are reused first so ids stay as small as the number of live
+* resources, which keeps them inside the bits a draw key has for them.
+*/
+
+#pragma once
+
+#include <ht_platform.h>    //HT_API
+#include <cstdint>          //uint32_t
+#include <mutex>            //std::mutex
+#include <vector>           //std::vector
+
+namespace Hatchit
+{
+    namespace Graphics
+    {
+        class HT_API SortIDPool
+        {
+        public:
+            SortIDPool();
+
+            uint32_t Acquire();
+            void Release(uint32_t id);
+
+        private:
+            std::mutex              m_mutex;
+            std::vector<uint32_t>   m_free;
+            uint32_t                m_next;
+        };
+    }
+}
@@ -0,0 +1,118 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+/**
+* \class SubmissionQueue
+* \ingroup HatchitGraphics
+*
+* \brief Collects items pushed from any number of threads without locking
+*
+* Every thread pushes into its own buffer, found through a slot the thread
+* takes the first time it pushes into any queue and hands back when it
+* exits. Only threads alive at the same time compete for slots, so a pool
+* of workers that comes and goes never runs out. Past SubmitSlots::MaxSlots
+* threads at once, the rest share one locked buffer.
+*
+* Gather must not run while anything is pushing.
+*/
+
+#pragma once
+
+#include <ht_platform.h>    //HT_API
+#include <atomic>           //std::atomic
+#include <cstdint>          //uint32_t
+#include <mutex>            //std::mutex
+#include <vector>           //std::vector
+
+namespace Hatchit
+{
+    namespace Graphics
+    {
+        class HT_API SubmitSlots
+        {
+        public:
+            static const uint32_t MaxSlots = 64;
+
+            ///The calling thread's slot, or MaxSlots if every slot is held by a live thread
+            static uint32_t ThisThread();
+        };
+
+        template<typename T>
+        class SubmissionQueue
+        {
+        public:
+            SubmissionQueue()
+            {
+                for (uint32_t i = 0; i < SubmitSlots::MaxSlots; i++)
+                    m_buffers[i] = nullptr;
+            }
+
+            ~SubmissionQueue()
+            {
+                for (uint32_t i = 0; i < SubmitSlots::MaxSlots; i++)
+                    delete m_buffers[i].load();
+            }
+
+            SubmissionQueue(const SubmissionQueue&) = delete;
+            SubmissionQueue& operator=(const SubmissionQueue&) = delete;
+
+            void Push(const T& item)
+            {
+                const uint32_t slot = SubmitSlots::ThisThread();
+                if (slot >= SubmitSlots::MaxSlots)
+                {
+                    std::lock_guard<std::mutex> lock(m_overflowMutex);
+                    m_overflow.push_back(item);
+                    return;
+                }
+
+                //Only the thread holding the slot ever stores into it so there's nothing to race
+                std::vector<T>* buffer = m_buffers[slot].load(std::memory_order_acquire);
+                if (!buffer)
+                {
+                    buffer = new std::vector<T>;
+                    m_buffers[slot].store(buffer, std::memory_order_release);
+                }
+
+                buffer->push_back(item);
+            }
+
+            ///Appends everything pushed since the last Gather to out
+            void Gather(std::vector<T>& out)
+            {
+                //Buffers are cleared rather than freed so they keep their capacity next frame
+                for (uint32_t i = 0; i < SubmitSlots::MaxSlots; i++)
+                {
+                    std::vector<T>* buffer = m_buffers[i].load(std::memory_order_acquire);
+                    if (!buffer || buffer->empty())
+                        continue;
+
+                    out.insert(out.end(), buffer->begin(), buffer->end());
+                    buffer->clear();
+                }
+
+                std::lock_guard<std::mutex> lock(m_overflowMutex);
+                out.insert(out.end(), m_overflow.begin(), m_overflow.end());
+                m_overflow.clear();
+            }
+
+        private:
+            //One buffer per slot, only ever written by the thread holding it
+            std::atomic<std::vector<T>*>    m_buffers[SubmitSlots::MaxSlots];
+
+            std::mutex                      m_overflowMutex;
+            std::vector<T>                  m_overflow;
+        };
+    }
+}
@@ -43,10 +43,16 @@ namespace Hatchit {
             uint32_t GetWidth()  const;
             uint32_t GetHeight() const;
 
+            uint32_t GetFrameCount()   const;
+            uint32_t GetCurrentFrame() const;
+
+            virtual void VBeginFrame() = 0;
             virtual void VClear(float* color) = 0;
             virtual bool VInitialize(uint32_t width, uint32_t height) = 0;
             virtual void VResize(uint32_t width, uint32_t height) = 0;
-            virtual void VExecute(std::vector<RenderPassHandle> renderPasses) = 0;
+            virtual void VExecute(const std::vector<RenderPassHandle>& renderPasses) = 0;
+            //Given the compiled render graph before any pass records; implementations may lay out pass attachments here
+            virtual void VPrepareRenderPasses(const std::vector<std::vector<RenderPassHandle>>& levels) {}
             virtual void VSetInput(RenderPassHandle handle) = 0;
             virtual void VPresent() = 0;
 
@@ -56,6 +62,10 @@ namespace Hatchit {
             uint32_t m_currentBuffer;
             uint32_t m_width;
             uint32_t m_height;
+
+            //Frames that may be in flight on the GPU at once and the slot being recorded
+            uint32_t m_frameCount;
+            uint32_t m_currentFrame;
         };
     }
 }
@@ -0,0 +1,96 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+/**
+* \class VKAttachmentAliaser
+* \ingroup HatchitGraphics
+*
+* \brief Binds render pass attachments to memory shared by passes that never overlap
+*
+* Each attachment is requested with its lifetime as a range of positions
+* in the frame's pass order. Attachments are placed largest first into
+* heaps; an attachment joins a heap when its lifetime overlaps no other
+* attachment already there. Each heap is a single allocation big enough
+* for its largest attachment.
+*
+* Transient attachments that are never read after their pass go to
+* lazily allocated memory instead when the device has it. Tiled GPUs
+* may never give that memory physical backing.
+*
+* A pass whose attachments share a heap with an earlier pass must wait
+* for that pass's attachment writes before it starts writing its own.
+*/
+
+#pragma once
+
+#include <ht_platform.h>    //HT_API
+#include <ht_vulkan.h>      //General Vulkan headers
+#include <vector>           //std::vector
+
+namespace Hatchit {
+
+    namespace Graphics {
+
+        namespace Vulkan {
+
+            struct VKAttachmentRequest
+            {
+                VkImage     image;      //Created without memory
+                bool        transient;  //Made with VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT
+                uint32_t    firstPass;  //Lifetime as positions in the pass order
+                uint32_t    lastPass;
+                bool        aliased;    //Set by Build if the memory is shared with another attachment
+            };
+
+            struct VKAttachmentStats
+            {
+                uint32_t        attachments;        //Attachments bound by the last Build
+                uint32_t        heaps;              //Allocations the aliased attachments share
+                uint32_t        lazyAttachments;    //Attachments in lazily allocated memory
+                VkDeviceSize    bytesRequested;     //Memory needed without aliasing
+                VkDeviceSize    bytesAllocated;     //Memory actually allocated for the heaps
+                VkDeviceSize    bytesLazy;          //Memory allocated lazily
+                VkDeviceSize    bytesSaved;         //Peak attachment memory that aliasing and lazy allocation avoided
+            };
+
+            class HT_API VKAttachmentAliaser
+            {
+            public:
+                VKAttachmentAliaser();
+                ~VKAttachmentAliaser();
+
+                bool Initialize(VkDevice device);
+                void DeInitialize();
+
+                bool Build(std::vector<VKAttachmentRequest>& requests);
+
+                VKAttachmentStats GetStats() const;
+
+            private:
+                struct Heap
+                {
+                    VkMemoryRequirements                requirements;
+                    std::vector<VKAttachmentRequest*>   users;
+                };
+
+                VkDevice                    m_device;
+                std::vector<VKAllocation>   m_allocations;
+                VKAttachmentStats           m_stats;
+
+                void release();
+                bool bind(VkImage image, const VKAllocation& allocation);
+            };
+        }
+    }
+}
@@ -0,0 +1,106 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+/**
+* \class VKBufferPool
+* \ingroup HatchitGraphics
+*
+* \brief Packs many small buffers into a few large ones
+*
+* Every range handed out shares its VkBuffer with other ranges. The
+* range's offset in that buffer is stored in the block's descriptor, so
+* callers bind with descriptor.offset as the base offset. Freed ranges are
+* merged with their free neighbours. A new buffer is created whenever the
+* existing ones are too full.
+*
+* Pools are device-local unless created with other memory properties.
+* Ranges of a host visible pool have allocation.mapped pointing at the
+* range; GetMemory gives the memory behind it.
+*/
+
+#pragma once
+
+#include <ht_platform.h>    //HT_API
+#include <ht_vulkan.h>      //General Vulkan headers
+#include <map>              //std::map
+#include <mutex>            //std::mutex
+#include <vector>           //std::vector
+
+namespace Hatchit {
+
+    namespace Graphics {
+
+        namespace Vulkan {
+
+            struct VKBufferPoolStats
+            {
+                uint32_t        bufferCount;    //Large buffers created
+                uint32_t        rangeCount;     //Ranges handed out
+                VkDeviceSize    bytesUsed;      //Bytes in handed out ranges, including alignment padding
+                VkDeviceSize    bytesFree;      //Bytes left across all buffers
+            };
+
+            class HT_API VKBufferPool
+            {
+            public:
+                static const VkDeviceSize DefaultBufferSize = 16 * 1024 * 1024;
+
+                VKBufferPool();
+                ~VKBufferPool();
+
+                bool Initialize(VkDevice device, VkBufferUsageFlags usage, const std::vector<uint32_t>& queueFamilies,
+                    VKMemoryCategory category = VKMemoryCategory::Other,
+                    VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                    VkDeviceSize bufferSize = DefaultBufferSize);
+                void DeInitialize();
+
+                bool Allocate(VkDeviceSize size, VkDeviceSize alignment, UniformBlock_vk& block);
+                void Free(const UniformBlock_vk& block);
+
+                bool Owns(const UniformBlock_vk& block) const;
+                bool GetMemory(const UniformBlock_vk& block, VKAllocation& allocation) const;
+                VkDeviceSize GetBufferSize() const;
+
+                VKBufferPoolStats GetStats() const;
+
+            private:
+                struct Range
+                {
+                    VkDeviceSize start;     //Where the range begins, including padding
+                    VkDeviceSize end;
+                };
+
+                struct PoolBuffer
+                {
+                    UniformBlock_vk                     block;
+                    std::map<VkDeviceSize, VkDeviceSize> free;      //Free ranges, start to end
+                    std::map<VkDeviceSize, Range>        allocated; //Handed out ranges by aligned offset
+                };
+
+                VkDevice                m_device;
+                VkBufferUsageFlags      m_usage;
+                std::vector<uint32_t>   m_queueFamilies;
+                VkDeviceSize            m_bufferSize;
+                VKMemoryCategory        m_category;
+                VkMemoryPropertyFlags   m_properties;
+
+                mutable std::mutex          m_mutex;
+                std::vector<PoolBuffer*>    m_buffers;
+
+                bool allocateFrom(PoolBuffer* buffer, VkDeviceSize size, VkDeviceSize alignment, UniformBlock_vk& block);
+                PoolBuffer* createBuffer();
+            };
+        }
+    }
+}
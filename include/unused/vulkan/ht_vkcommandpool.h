@@ -18,6 +18,10 @@
 *
 * \brief A wrapper around a VkCommandPool object that other 
 * Hatchit objects can understand abstracted from graphics languages
+*
+* The pool is created TRANSIENT and is only ever reset as a whole. Command
+* buffers acquired from it are kept after a reset and handed out again,
+* so steady state frames allocate nothing.
 */
 
 #pragma once
@@ -25,6 +29,7 @@
 #include <ht_commandpool.h>
 #include <ht_vulkan.h>      //VkCommandPool (the original object from the VK API)
 #include <ht_vkdevice.h>    //Need a VKDevice to create a pool
+#include <vector>           //std::vector
 
 namespace Hatchit
 {
@@ -39,12 +44,24 @@ namespace Hatchit
                 ~VKCommandPool();
 
                 bool VInitialize() override;
+                bool VReset() override;
 
                 VkCommandPool GetVKCommandPool() const;
 
+                VkCommandBuffer AcquireCommandBuffer(VkCommandBufferLevel level);
+
+                VkResult BeginCommandBuffer(VkCommandBuffer commandBuffer, const VkCommandBufferBeginInfo& beginInfo);
+                VkResult EndCommandBuffer(VkCommandBuffer commandBuffer);
+
             private:
                 VkDevice m_device;
                 VkCommandPool m_commandPool;
+
+                //Every buffer ever allocated from this pool and how many have been handed out since the last reset
+                std::vector<VkCommandBuffer> m_primaryBuffers;
+                std::vector<VkCommandBuffer> m_secondaryBuffers;
+                size_t m_primaryUsed;
+                size_t m_secondaryUsed;
             };
         }
     }
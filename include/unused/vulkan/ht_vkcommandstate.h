@@ -0,0 +1,95 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+/**
+* \class VKCommandState
+* \ingroup HatchitGraphics
+*
+* \brief Records into a command buffer while skipping binds that change nothing
+*
+* Remembers the pipeline, descriptor sets, vertex and index buffers, push
+* constants and dynamic state bound so far. A bind that matches what is
+* already bound isn't recorded. Descriptor set binds only record the sets
+* that differ.
+*
+* Secondary command buffers inherit no bindings, so every command buffer
+* needs a fresh state. Changing the pipeline layout forgets the sets and
+* push constants bound under the old one.
+*/
+
+#pragma once
+
+#include <ht_platform.h>    //HT_API
+#include <ht_vulkan.h>      //General Vulkan headers
+#include <ht_commandpool.h> //RecordStats
+
+namespace Hatchit {
+
+    namespace Graphics {
+
+        namespace Vulkan {
+
+            class HT_API VKCommandState
+            {
+            public:
+                static const uint32_t MaxDescriptorSets = 8;        //Sets past this are always bound
+                static const uint32_t MaxVertexBindings = 4;        //Bindings past this are always bound
+                static const uint32_t MaxPushConstantBytes = 128;   //The least every device supports
+
+                VKCommandState(VkCommandBuffer commandBuffer);
+
+                void BindPipeline(VkPipeline pipeline);
+                void BindDescriptorSets(VkPipelineLayout layout, uint32_t firstSet, uint32_t setCount, const VkDescriptorSet* sets);
+                void BindVertexBuffer(uint32_t binding, VkBuffer buffer, VkDeviceSize offset);
+                void BindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType);
+                void PushConstants(VkPipelineLayout layout, VkShaderStageFlags stages, uint32_t offset, uint32_t size, const void* data);
+
+                void SetViewport(const VkViewport& viewport);
+                void SetScissor(const VkRect2D& scissor);
+
+                void DrawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance);
+                void DrawIndexedIndirect(VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount, uint32_t stride);
+
+                VkCommandBuffer GetVkCommandBuffer() const;
+                const RecordStats& GetStats() const;
+
+            private:
+                VkCommandBuffer     m_commandBuffer;
+                RecordStats         m_stats;
+
+                VkPipeline          m_pipeline;
+                VkPipelineLayout    m_layout;   //Layout the sets and push constants were bound with
+                VkDescriptorSet     m_sets[MaxDescriptorSets];
+
+                VkBuffer            m_vertexBuffers[MaxVertexBindings];
+                VkDeviceSize        m_vertexOffsets[MaxVertexBindings];
+
+                VkBuffer            m_indexBuffer;
+                VkDeviceSize        m_indexOffset;
+                VkIndexType         m_indexType;
+
+                VkShaderStageFlags  m_pushStages;
+                uint8_t             m_pushData[MaxPushConstantBytes];
+                bool                m_pushValid[MaxPushConstantBytes];
+
+                VkViewport          m_viewport;
+                VkRect2D            m_scissor;
+                bool                m_viewportSet;
+                bool                m_scissorSet;
+
+                void setLayout(VkPipelineLayout layout);
+            };
+        }
+    }
+}
@@ -0,0 +1,108 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+/**
+* \class VKDeletionQueue
+* \ingroup HatchitGraphics
+*
+* \brief Defers destruction of Vulkan objects until the GPU is done with them
+*
+* Objects are retired with the value of the graphics queue timeline
+* that last used them, which by default is the newest submission. Collect
+* then destroys everything whose value has completed in one go. Nothing is
+* destroyed while a frame in flight may still read it, and nobody has to
+* call vkDeviceWaitIdle.
+*/
+
+#pragma once
+
+#include <ht_platform.h>    //HT_API
+#include <ht_vulkan.h>      //General Vulkan headers
+#include <ht_vkqueue.h>     //VKQueue
+#include <deque>            //std::deque
+#include <functional>       //std::function
+#include <mutex>            //std::mutex
+#include <vector>           //std::vector
+
+namespace Hatchit {
+
+    namespace Graphics {
+
+        namespace Vulkan {
+
+            struct DeletionQueueStats
+            {
+                uint64_t objectsPending;    //Retired objects not yet destroyed
+                uint64_t bytesPending;      //Device memory held by those objects
+                uint64_t bytesReleased;     //Device memory freed since Initialize
+            };
+
+            class HT_API VKDeletionQueue
+            {
+            public:
+                //Retire with the newest value submitted to the queue
+                static const uint64_t LastSubmission = UINT64_MAX;
+
+                static bool Initialize(const VkDevice& device, VKQueue* queue);
+                static void DeInitialize();
+
+                static void RetireBuffer(const UniformBlock_vk& uniformBlock, uint64_t value = LastSubmission);
+                static void RetireTexelBuffer(const TexelBlock_vk& texelBlock, uint64_t value = LastSubmission);
+                static void RetireImage(const Image_vk& image, uint64_t value = LastSubmission);
+                static void RetireImage(VkImage image, VkImageView view, const VKAllocation& allocation, uint64_t value = LastSubmission);
+                static void RetireSampler(VkSampler sampler, uint64_t value = LastSubmission);
+                static void RetireDescriptorSets(VkDescriptorPool pool, const std::vector<VkDescriptorSet>& sets, uint64_t value = LastSubmission);
+                static void RetirePipeline(VkPipeline pipeline, VkPipelineCache cache, uint64_t value = LastSubmission);
+                static void RetireFramebuffer(VkFramebuffer framebuffer, uint64_t value = LastSubmission);
+                static void RetireRenderPass(VkRenderPass renderPass, uint64_t value = LastSubmission);
+                static void RetireCallback(const std::function<void()>& release, uint64_t value = LastSubmission);
+
+                static void Collect();
+
+                static DeletionQueueStats GetStats();
+
+            private:
+                struct Retired
+                {
+                    uint64_t        value;
+                    VkDeviceSize    bytes;
+
+                    VkBuffer                        buffer;
+                    VkBufferView                    bufferView;
+                    VkImage                         image;
+                    VkImageView                     imageView;
+                    VKAllocation                    allocation;
+                    VkSampler                       sampler;
+                    VkDescriptorPool                descriptorPool;
+                    std::vector<VkDescriptorSet>    descriptorSets;
+                    VkPipeline                      pipeline;
+                    VkPipelineCache                 pipelineCache;
+                    VkFramebuffer                   framebuffer;
+                    VkRenderPass                    renderPass;
+                    std::function<void()>           release;
+                };
+
+                static VkDevice             m_device;
+                static VKTimeline*          m_timeline;
+                static std::mutex           m_mutex;
+                static std::deque<Retired>  m_retired;
+                static DeletionQueueStats   m_stats;
+
+                static Retired makeRetired(uint64_t value);
+                static void retire(Retired& retired);
+                static void destroy(Retired& retired);
+            };
+        }
+    }
+}
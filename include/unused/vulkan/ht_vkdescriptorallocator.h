@@ -0,0 +1,132 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+/**
+* \class VKDescriptorAllocator
+* \ingroup HatchitGraphics
+*
+* \brief Allocates descriptor sets from pools that grow as they're needed
+*
+* Every descriptor set layout registers its bindings, which gives it a
+* mix of descriptor types. Each thread gets its own chain of pools for
+* each mix, so threads never contend over a pool. A full pool doesn't
+* fail anything; the next one in the chain is tried and, if none have
+* room, a new, larger pool is added.
+*
+* Long-lived sets are freed through Retire once no frame uses them.
+* Transient sets come from pools belonging to the current frame slot
+* and are never freed one by one; BeginFrame resets all of the slot's
+* pools at once when the slot comes back around.
+*
+* Sets acquired through AcquireCached are shared. Acquiring a set with
+* the same layout and the same writes as one that's already alive hands
+* back that set instead of allocating and writing a new one.
+*/
+
+#pragma once
+
+#include <ht_platform.h>    //HT_API
+#include <ht_vulkan.h>      //General Vulkan headers
+#include <memory>           //std::unique_ptr
+#include <mutex>            //std::mutex
+#include <unordered_map>    //std::unordered_map
+#include <vector>           //std::vector
+
+namespace Hatchit {
+
+    namespace Graphics {
+
+        namespace Vulkan {
+
+            struct VKDescriptorThreadPools;
+
+            struct VKDescriptorAllocation
+            {
+                VkDescriptorSet             set;
+                VkDescriptorPool            pool;   //Pool the set came from
+                VKDescriptorThreadPools*    owner;  //Pools of the thread that allocated it
+            };
+
+            struct VKDescriptorAllocatorStats
+            {
+                uint32_t    pools;          //Pools created across every thread
+                uint32_t    sets;           //Long-lived sets alive, cached ones included
+                uint32_t    transientSets;  //Transient sets taken since the last BeginFrame
+                uint32_t    cachedSets;     //Distinct sets in the cache
+                uint64_t    cacheHits;      //AcquireCached calls answered by an existing set
+                uint64_t    cacheMisses;    //AcquireCached calls that had to write a new set
+            };
+
+            class HT_API VKDescriptorAllocator
+            {
+            public:
+                static const uint32_t FirstPoolSets = 32;   //Sets in the first pool of a chain
+                static const uint32_t MaxPoolSets = 1024;   //Later pools double up to this
+
+                static bool Initialize(const VkDevice& device);
+                static void DeInitialize();
+
+                static void RegisterLayout(VkDescriptorSetLayout layout, const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+
+                static bool Allocate(VkDescriptorSetLayout layout, VKDescriptorAllocation& allocation);
+                static void Free(VKDescriptorAllocation& allocation);
+                static void Retire(const VKDescriptorAllocation& allocation);
+
+                static bool AllocateTransient(VkDescriptorSetLayout layout, VkDescriptorSet& set);
+                static void BeginFrame(uint32_t frame);
+
+                static bool AcquireCached(VkDescriptorSetLayout layout, std::vector<VkWriteDescriptorSet>& writes, VkDescriptorSet& set);
+                static void ReleaseCached(VkDescriptorSet set);
+
+                static VKDescriptorAllocatorStats GetStats();
+
+            private:
+                struct Mix
+                {
+                    std::vector<VkDescriptorPoolSize> sizes;    //Descriptors of each type one set needs
+                };
+
+                struct CachedSet
+                {
+                    std::vector<uint64_t>   key;
+                    VKDescriptorAllocation  allocation;
+                    uint32_t                references;
+                };
+
+                static VkDevice                     m_device;
+                static uint32_t                     m_frame;
+
+                static std::mutex                                                   m_mutex;        //Guards the thread pools' lifetime
+                static std::vector<std::unique_ptr<VKDescriptorThreadPools>>        m_threads;
+                static uint64_t                                                     m_generation;
+
+                static std::mutex                                                   m_mixMutex;
+                static std::vector<Mix>                                             m_mixes;
+                static std::unordered_map<VkDescriptorSetLayout, uint32_t>          m_layoutMixes;
+
+                static std::mutex                                                   m_cacheMutex;
+                static std::unordered_multimap<uint64_t, CachedSet>                 m_cache;
+                static std::unordered_map<VkDescriptorSet, uint64_t>                m_cachedHashes;
+                static VKDescriptorAllocatorStats                                   m_stats;
+
+                static VKDescriptorThreadPools* getThreadPools();
+                static uint32_t getMix(VkDescriptorSetLayout layout);
+                static bool allocateFrom(VKDescriptorThreadPools* pools, bool transient, uint32_t mix,
+                    VkDescriptorSetLayout layout, VKDescriptorAllocation& allocation);
+                static bool createPool(uint32_t mix, uint32_t maxSets, bool freeable, VkDescriptorPool& pool);
+                static void buildKey(VkDescriptorSetLayout layout, const std::vector<VkWriteDescriptorSet>& writes, std::vector<uint64_t>& key);
+            };
+        }
+    }
+}
@@ -41,15 +41,33 @@ namespace Hatchit
                 const std::vector<VkDevice>&                            GetVKDevices() const;
                 const std::vector<VkPhysicalDevice>&                    GetVKPhysicalDevices() const;
                 const std::vector<VkPhysicalDeviceFeatures>&            GetVKPhysicalDeviceFeatures() const;
+                const std::vector<VkPhysicalDeviceProperties>&          GetVKPhysicalDeviceProperties() const;
                 const std::vector<VkPhysicalDeviceMemoryProperties>&    GetVKPhysicalDeviceMemoryProperties() const;
                 const VkInstance&                                       GetVKInstance() const;
 
+                bool SupportsTimelineSemaphores() const;
+                bool SupportsMemoryBudget() const;
+                bool SupportsMultiDrawIndirect() const;
+                bool SupportsIndirectFirstInstance() const;
+                uint32_t GetGraphicsQueueFamily() const;
+                int32_t GetComputeQueueFamily() const;
+                int32_t GetTransferQueueFamily() const;
+
             private:
                 std::vector<VkDevice>                           m_devices;
                 std::vector<VkPhysicalDevice>                   m_gpus;
                 std::vector<VkPhysicalDeviceFeatures>           m_gpuFeatures;
+                std::vector<VkPhysicalDeviceProperties>         m_gpuProps;
                 std::vector<VkPhysicalDeviceMemoryProperties>   m_gpuMemoryProps;
                 VkInstance                                      m_instance;
+                std::vector<bool>                               m_timelineSemaphores;
+                std::vector<bool>                               m_memoryBudgets;
+                std::vector<bool>                               m_multiDrawIndirect;
+                std::vector<bool>                               m_indirectFirstInstance;
+                bool                                            m_physicalDeviceProperties2;
+                std::vector<uint32_t>                           m_graphicsQueueFamilies;
+                std::vector<int32_t>                            m_computeQueueFamilies;     //-1 without a compute family of its own
+                std::vector<int32_t>                            m_transferQueueFamilies;    //-1 without a transfer-only family
 
                 bool    m_initialized;
                 bool    m_validate;
@@ -74,13 +92,14 @@ namespace Hatchit
                 bool enumeratePhysicalDevices();
                 bool queryDeviceCapabilities();
                 bool setupDevices();
+                bool selectQueueFamilies(size_t gpu);
                 bool setupProcAddresses();
                 bool setupDebugCallback();
 
                 bool checkInstanceLayers();
                 bool checkInstanceExtensions();
                 bool checkDeviceLayers(const VkPhysicalDevice& gpu);
-                bool checkDeviceExtensions(const VkPhysicalDevice& gpu);
+                bool checkDeviceExtensions(const VkPhysicalDevice& gpu, bool& timelineSemaphores, bool& memoryBudget);
 
                 bool checkLayers(std::vector<const char*> layerNames, std::vector <VkLayerProperties> layers);
 
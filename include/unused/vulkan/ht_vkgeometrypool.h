@@ -0,0 +1,90 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+/**
+* \class VKGeometryPool
+* \ingroup HatchitGraphics
+*
+* \brief Keeps the vertices and indices of every mesh in a few large buffers
+*
+* Each mesh takes a range of a shared vertex buffer and a range of a
+* shared index buffer. Vertex ranges are aligned to the vertex stride and
+* index ranges to the index size, so a mesh is drawn from the start of the
+* buffers with its MeshRange's vertexOffset and firstIndex. Meshes in the
+* same buffers never need their buffers bound again between draws.
+*
+* Meshes larger than MaxSharedSize get buffers of their own instead, so
+* the memory budget can still give them back when it evicts them. Their
+* range starts at zero.
+*/
+
+#pragma once
+
+#include <ht_platform.h>        //HT_API
+#include <ht_vulkan.h>          //General Vulkan headers
+#include <ht_vkbufferpool.h>    //VKBufferPool
+#include <ht_mesh_base.h>       //MeshRange
+#include <mutex>                //std::mutex
+#include <vector>               //std::vector
+
+namespace Hatchit {
+
+    namespace Graphics {
+
+        namespace Vulkan {
+
+            struct VKGeometryRange
+            {
+                UniformBlock_vk vertexBlock;    //Bind vertexBlock.buffer at offset 0
+                UniformBlock_vk indexBlock;     //Bind indexBlock.buffer at offset 0
+                MeshRange       range;
+                bool            shared;         //False if the blocks are buffers of their own
+            };
+
+            struct VKGeometryPoolStats
+            {
+                uint32_t        sharedMeshes;   //Meshes in the shared buffers
+                uint32_t        ownMeshes;      //Meshes too large to share
+                uint32_t        vertexBuffers;  //Shared vertex buffers created
+                uint32_t        indexBuffers;   //Shared index buffers created
+                VkDeviceSize    bytesUsed;      //Bytes in shared ranges, including alignment padding
+            };
+
+            class HT_API VKGeometryPool
+            {
+            public:
+                static const VkDeviceSize VertexBufferSize = 64 * 1024 * 1024;
+                static const VkDeviceSize IndexBufferSize = 32 * 1024 * 1024;
+                static const VkDeviceSize MaxSharedSize = 4 * 1024 * 1024;     //Larger meshes get their own buffers
+
+                static bool Initialize(const VkDevice& device, const std::vector<uint32_t>& queueFamilies);
+                static void DeInitialize();
+
+                static bool Allocate(const void* vertices, uint32_t vertexCount, uint32_t vertexStride,
+                    const uint32_t* indices, uint32_t indexCount, VKGeometryRange& range);
+                static void Free(VKGeometryRange& range);
+
+                static VKGeometryPoolStats GetStats();
+
+            private:
+                static VkDevice             m_device;
+                static VKBufferPool         m_vertexPool;
+                static VKBufferPool         m_indexPool;
+
+                static std::mutex           m_mutex;
+                static VKGeometryPoolStats  m_stats;
+            };
+        }
+    }
+}
@@ -49,8 +49,6 @@ namespace Hatchit
                 VKDevice*   m_device;
                 VKSwapChain* m_swapchain;
 
-                VkDescriptorPool    m_descriptorPool;
-
                 void VCreateTextureBase(Resource::TextureHandle handle, void** base)            override;
                 void VCreateMaterialBase(Resource::MaterialHandle handle, void** base)          override;
                 void VCreateRootLayoutBase(Resource::RootLayoutHandle handle, void** base)      override;
@@ -61,8 +59,6 @@ namespace Hatchit
                 void VCreateMeshBase(Resource::ModelHandle handle, void** base)                 override;
 
                 void thread_main();
-
-                bool createDescriptorPool(const VkDevice& device);
             };
         }
     }
@@ -0,0 +1,124 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+/**
+* \class VKIndirectCuller
+* \ingroup HatchitGraphics
+*
+* \brief Culls instances against a frustum on the GPU and fills in indirect draws
+*
+* Records a compute dispatch with a thread per instance. Each thread tests
+* its instance's bounding sphere against the frustum and, if any of it can
+* be seen, claims the next instance of its draw by adding one to the
+* draw's instanceCount. The instance's data is copied into that slot of
+* the draw's output range, so what's visible ends up packed at the start
+* of the range and the draw covers only that. Draws are written with an
+* instanceCount of 0, so a draw with nothing visible costs nothing.
+*
+* Objects find their draw through a table rather than holding it
+* themselves. Objects written once and kept on the GPU can then be culled
+* into whatever draws this frame has; only the table is written again.
+* Several dispatches may share one table, commands and output.
+*
+* The dispatch runs IndirectCull.spv, built from shaders/IndirectCull.comp,
+* a compute shader with a local size of GroupSize that reads:
+*  - set 0, binding 0: the VKCullObjects
+*  - set 0, binding 1: the instance data being culled, as uints
+*  - set 0, binding 2: the VkDrawIndexedIndirectCommands
+*  - set 0, binding 3: where visible instance data is copied, as uints
+*  - set 0, binding 4: the VKCullDraws
+*  - push constants: the six planes of Frustum as vec4s, then the object count
+*
+* Without the shader, or on devices that can't start an indirect draw at
+* an instance other than 0, IsAvailable is false and passes cull nothing.
+*/
+
+#pragma once
+
+#include <ht_platform.h>    //HT_API
+#include <ht_vulkan.h>      //General Vulkan headers
+#include <ht_vkuploadring.h>    //VKUploadRange
+#include <ht_frustum.h>     //Frustum
+#include <string>           //std::string
+
+namespace Hatchit {
+
+    namespace Graphics {
+
+        namespace Vulkan {
+
+            //One instance to cull, as the shader reads it
+            struct VKCullObject
+            {
+                float       sphere[4];      //Centre and radius; a radius of 0 or less is always visible
+                uint32_t    draw;           //Index of the instance's VKCullDraw
+                uint32_t    sourceWord;     //Where its instance data starts in the input, in 4 byte words
+                uint32_t    strideWords;    //Size of its instance data, in words
+                uint32_t    padding;
+            };
+
+            //Where the visible instances of a draw go, as the shader reads it
+            struct VKCullDraw
+            {
+                uint32_t    command;        //Index of the draw's VkDrawIndexedIndirectCommand
+                uint32_t    destWord;       //Where the draw's instances start in the output, in words
+            };
+
+            //Everything one dispatch reads and writes
+            struct VKCullDispatch
+            {
+                VKUploadRange   objects;        //VKCullObjects
+                uint32_t        objectCount;
+                VKUploadRange   instances;      //Instance data of every object
+                VKUploadRange   draws;          //VKCullDraws the objects index
+                VKUploadRange   commands;       //VkDrawIndexedIndirectCommands, each with an instanceCount of 0
+                VkBuffer        output;         //Receives the visible instance data
+                VkDeviceSize    outputSize;
+            };
+
+            class HT_API VKIndirectCuller
+            {
+            public:
+                static const uint32_t GroupSize = 64;
+                static const VkDeviceSize Alignment = 256;  //Enough for any device's storage buffer offsets
+
+                static bool Initialize(const VkDevice& device, bool multiDrawIndirect, bool indirectFirstInstance);
+                static void DeInitialize();
+
+                static bool CreatePipeline(const std::string& shaderPath = "IndirectCull.spv");
+
+                static bool IsAvailable();
+                static bool SupportsMultiDraw();
+
+                static bool RecordCull(VkCommandBuffer commandBuffer, const Frustum& frustum, const VKCullDispatch& dispatch);
+
+            private:
+                struct PushConstants
+                {
+                    float       planes[Frustum::PlaneCount * 4];
+                    uint32_t    objectCount;
+                    uint32_t    padding[3];
+                };
+
+                static VkDevice                 m_device;
+                static bool                     m_multiDrawIndirect;
+                static bool                     m_indirectFirstInstance;
+
+                static VkDescriptorSetLayout    m_setLayout;
+                static VkPipelineLayout         m_pipelineLayout;
+                static VkPipeline               m_pipeline;
+            };
+        }
+    }
+}
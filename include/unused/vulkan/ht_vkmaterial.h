@@ -21,6 +21,11 @@
 * After creating a material and setting its shader variables
 * this class will build a VkDescriptorSet to describe what
 * will be sent to the GPU.
+*
+* All of the material's shader variable chunks live in one range of
+* the uniform arena, which keeps a copy per frame slot. VUpdate only
+* copies the bytes of chunks that changed since the current slot's copy
+* was last written, and every slot binds descriptor sets of its own.
 */
 
 #pragma once
@@ -30,9 +35,13 @@
 #include <ht_vkrenderpass.h>
 #include <ht_vkpipeline.h>
 #include <ht_vktexture.h>
+#include <ht_vkuniformarena.h>
+#include <ht_vkcommandstate.h>
 #include <ht_material_resource.h>
 #include <ht_refcounted.h>
 
+#include <mutex>
+
 namespace Hatchit {
 
     namespace Graphics {
@@ -46,39 +55,52 @@ namespace Hatchit {
                 ~VKMaterial();
 
                 //Required function for RefCounted class
-                bool Initialize(Resource::MaterialHandle handle, const VkDevice& device, const VkDescriptorPool& descriptorPool);
+                bool Initialize(Resource::MaterialHandle handle, const VkDevice& device);
 
                 bool VBindTexture(std::string name, TextureHandle texture)      override;
                 bool VUnbindTexture(std::string name, TextureHandle texture)    override;
 
                 bool VUpdate()                                              override;
 
-                const void BindMaterial(const VkCommandBuffer& commandBuffer, const VkPipelineLayout& pipelineLayout) const;
+                const void BindMaterial(VKCommandState& state, const VkPipelineLayout& pipelineLayout) const;
+                void VKMarkUsed() const;
                 
                 PipelineHandle const VGetPipeline() const override;
                 const VKPipeline* GetVKPipeline() const;
 
             private:
                 const VkDevice* m_device;
-                const VkDescriptorPool* m_descriptorPool;
 
                 bool setupDescriptorSet();
+                void rebuildDescriptorSet();
+                size_t getSetSlot(uint32_t set);
 
                 PipelineHandle m_pipelineHandle;
                 VKPipeline* m_pipeline;
 
                 std::vector<VkDescriptorSetLayout> m_descriptorSetLayouts;
-                std::vector<VkDescriptorSetLayout> m_materialLayouts;
-                std::vector<VkDescriptorSet> m_materialSets;
+                std::vector<uint32_t> m_setIndices;                 //Set index of each material set, ascending
+                std::vector<VkDescriptorSetLayout> m_materialLayouts; //Parallel to m_setIndices
+                std::vector<std::vector<VkDescriptorSet>> m_materialSets;   //Per frame slot, each parallel to m_setIndices
 
                 std::map<std::string, Graphics::TextureHandle> m_textureHandles;
 
-                UniformBlock_vk m_uniformVSBuffer;
-                //UniformBlock m_uniformFSBuffer;
-                std::vector<UniformBlock_vk> m_fragmentTextures;
+                VKUniformRange m_uniformRange;      //Every shader variable chunk, one after another
+                std::vector<size_t> m_chunkOffsets; //Where each chunk starts in m_uniformRange
+
+                struct DirtyRange
+                {
+                    size_t begin;
+                    size_t end;     //Equal to begin when nothing is waiting
+                };
+
+                //Bytes of each chunk not yet written to each frame slot's copy
+                std::vector<std::vector<DirtyRange>> m_pendingRanges;
+                std::mutex m_updateMutex;
                 
                 std::vector<LayoutLocation> m_textureLocations;
                 std::vector<VKTexture*> m_textures;
+                std::vector<uint32_t> m_textureListeners;   //Residency listener ids, parallel to m_textures
             };
         }
     }
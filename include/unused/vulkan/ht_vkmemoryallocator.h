@@ -0,0 +1,169 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+/**
+* \class VKMemoryAllocator
+* \ingroup HatchitGraphics
+*
+* \brief Sub-allocates device memory out of large blocks
+*
+* Drivers cap the number of live vkAllocateMemory calls, often at 4096,
+* and every call is slow. This allocator asks for one large block per
+* memory type at a time and splits it with a buddy allocator. Buddy ranges
+* are naturally aligned to their size, so resource alignment is handled by
+* rounding up. Linear and optimally tiled resources are kept in separate
+* blocks when bufferImageGranularity would otherwise force padding between
+* them. Requests too large for a block get a dedicated allocation.
+*
+* Host visible blocks are mapped once when they are created and stay mapped.
+*
+* The vkAllocateMemory family is called through a table of function
+* pointers so the allocator can be driven by a mock memory-type table.
+*/
+
+#pragma once
+
+#include <ht_platform.h>    //HT_API
+#include <ht_vulkan.h>      //General Vulkan headers
+#include <functional>       //std::function
+#include <mutex>            //std::recursive_mutex
+#include <set>              //std::set
+#include <unordered_map>    //std::unordered_map
+#include <vector>           //std::vector
+
+namespace Hatchit {
+
+    namespace Graphics {
+
+        namespace Vulkan {
+
+            struct VKMemoryFunctions
+            {
+                PFN_vkAllocateMemory    allocate;
+                PFN_vkFreeMemory        free;
+                PFN_vkMapMemory         map;
+                PFN_vkUnmapMemory       unmap;
+            };
+
+            struct VKMemoryStats
+            {
+                uint32_t        blockCount;         //Shared blocks
+                uint32_t        dedicatedCount;     //Allocations too large for a block
+                uint32_t        allocationCount;    //Live allocations, dedicated included
+                VkDeviceSize    bytesReserved;      //Memory taken from the driver
+                VkDeviceSize    bytesUsed;          //Memory handed out, including rounding
+                VkDeviceSize    bytesFree;          //Memory left in shared blocks
+                VkDeviceSize    largestFreeRange;   //Biggest single range left in a shared block
+                float           fragmentation;      //0 when all free memory is in one range; approaches 1 as it splinters
+            };
+
+            struct VKHeapUsage
+            {
+                VkDeviceSize    reserved;   //Memory taken from the driver out of this heap
+                VkDeviceSize    categories[static_cast<uint32_t>(VKMemoryCategory::Count)]; //Memory handed out, by category
+            };
+
+            class HT_API VKMemoryAllocator
+            {
+            public:
+                /** Called by Defragment to move an allocation
+                *
+                * The callback copies the contents from the old range into the new
+                * one and rebinds whatever used it. Returning false leaves the
+                * allocation where it was.
+                */
+                typedef std::function<bool(const VKAllocation& from, const VKAllocation& to)> MoveCallback;
+
+                static const VkDeviceSize DefaultBlockSize = 64 * 1024 * 1024;
+
+                VKMemoryAllocator();
+                ~VKMemoryAllocator();
+
+                bool Initialize(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties,
+                    VkDeviceSize bufferImageGranularity, const VKMemoryFunctions* functions = nullptr,
+                    VkDeviceSize blockSize = DefaultBlockSize);
+                void DeInitialize();
+
+                bool Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+                    bool linear, VKAllocation& allocation, VKMemoryCategory category = VKMemoryCategory::Other,
+                    void* userData = nullptr);
+                bool AllocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties,
+                    VKAllocation& allocation, VKMemoryCategory category = VKMemoryCategory::Other,
+                    void* userData = nullptr);
+                bool AllocateForImage(VkImage image, bool linearTiling, VkMemoryPropertyFlags properties,
+                    VKAllocation& allocation, VKMemoryCategory category = VKMemoryCategory::Other,
+                    void* userData = nullptr);
+                void Free(VKAllocation& allocation);
+
+                void SetMoveCallback(MoveCallback callback);
+                uint32_t Defragment(uint32_t maxMoves);
+
+                VKMemoryStats GetStats() const;
+                VKHeapUsage GetHeapUsage(uint32_t heap) const;
+                VkMemoryPropertyFlags GetMemoryTypeProperties(uint32_t memoryType) const;
+
+            private:
+                struct Range
+                {
+                    uint32_t            order;
+                    VKMemoryCategory    category;
+                    void*               userData;
+                };
+
+                struct Block
+                {
+                    VkDeviceMemory  memory;
+                    VkDeviceSize    size;
+                    VkDeviceSize    used;
+                    void*           mapped;
+                    uint32_t        memoryType;
+                    bool            linear;
+                    bool            dedicated;
+
+                    //Free ranges by order, order 0 being MinOrder
+                    std::vector<std::set<VkDeviceSize>> freeLists;
+
+                    //Live ranges by offset
+                    std::unordered_map<VkDeviceSize, Range> allocated;
+                };
+
+                static const uint32_t MinOrder = 8;
+
+                VkDevice                            m_device;
+                VkPhysicalDeviceMemoryProperties    m_memoryProperties;
+                VkDeviceSize                        m_bufferImageGranularity;
+                VKMemoryFunctions                   m_functions;
+                VkDeviceSize                        m_blockSize;
+                MoveCallback                        m_moveCallback;
+
+                mutable std::recursive_mutex        m_mutex;
+                std::vector<Block*>                 m_blocks;
+                std::unordered_map<VkDeviceMemory, Block*> m_blockLookup;
+                VKHeapUsage                         m_heapUsage[VK_MAX_MEMORY_HEAPS];
+
+                bool allocateFromType(uint32_t memoryType, VkDeviceSize size, bool linear, const Block* exclude,
+                    bool allowNewBlock, VKAllocation& allocation, VKMemoryCategory category, void* userData);
+                bool allocateFromBlock(Block* block, uint32_t order, VKAllocation& allocation,
+                    VKMemoryCategory category, void* userData);
+                Block* createBlock(uint32_t memoryType, VkDeviceSize size, bool linear, bool dedicated);
+                void destroyBlock(Block* block);
+                void releaseRange(Block* block, VkDeviceSize offset, uint32_t order);
+
+                VkDeviceSize blockSizeFor(uint32_t memoryType) const;
+                bool segregates() const;
+                static uint32_t orderOf(VkDeviceSize size);
+            };
+        }
+    }
+}
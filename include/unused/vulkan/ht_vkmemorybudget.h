@@ -0,0 +1,132 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+/**
+* \class VKMemoryBudget
+* \ingroup HatchitGraphics
+*
+* \brief Keeps device memory use under the budget by evicting idle textures and meshes
+*
+* Every frame the budget of each memory heap is refreshed. With
+* VK_EXT_memory_budget the driver reports the budget and the process's
+* usage. Without it the budget is a fraction of the heap's size and the
+* usage is what VKMemoryAllocator has handed out of that heap.
+*
+* When a device-local heap is over budget, registered resources that no
+* frame in flight can still be using are evicted, least recently used
+* first, until the overage is covered. Textures drop to a lower mip and
+* meshes drop to their CPU copy. Evicted resources that were used again
+* are restored once there is room. After evicting, the budget waits for
+* the retired memory to actually be freed before evicting again.
+*/
+
+#pragma once
+
+#include <ht_platform.h>    //HT_API
+#include <ht_vulkan.h>      //General Vulkan headers
+#include <ht_gpuresourcerequest.h>  //GPUResourceRequest::Type
+#include <atomic>           //std::atomic
+#include <mutex>            //std::mutex
+#include <vector>           //std::vector
+
+namespace Hatchit {
+
+    namespace Graphics {
+
+        namespace Vulkan {
+
+            struct VKHeapBudget
+            {
+                VkDeviceSize    size;       //Size of the heap
+                VkDeviceSize    budget;     //How much of it the process should use
+                VkDeviceSize    usage;      //How much of it the process is using
+                VkDeviceSize    reserved;   //Memory VKMemoryAllocator took from the heap
+                VkDeviceSize    categories[static_cast<uint32_t>(VKMemoryCategory::Count)]; //Memory handed out, by category
+                bool            deviceLocal;
+            };
+
+            /**
+            * A resource the budget may evict. Evicting and restoring only happen
+            * while a frame begins, so the resource isn't being recorded at the time.
+            */
+            class HT_API VKEvictable
+            {
+            public:
+                VKEvictable();
+                virtual ~VKEvictable() = default;
+
+                //Called whenever the resource is drawn with
+                void VKMarkUsed();
+                uint64_t VKGetLastUsed() const;
+
+                //Frees some or all of the resource's device memory; returns how much
+                virtual VkDeviceSize VKEvict() = 0;
+                //Brings the resource back to full quality
+                virtual bool VKRestore() = 0;
+                //How much more device memory VKRestore needs
+                virtual VkDeviceSize VKGetRestoreSize() const = 0;
+                virtual bool VKIsEvicted() const = 0;
+
+                virtual VKMemoryCategory VKGetCategory() const = 0;
+                virtual GPUResourceRequest::Type VKGetResourceType() const = 0;
+                //The base implementation handles point at
+                virtual void* VKGetResourceBase() = 0;
+
+            private:
+                std::atomic<uint64_t>   m_lastUsed;
+            };
+
+            class HT_API VKMemoryBudget
+            {
+            public:
+                static const float DefaultBudgetFraction;
+
+                static bool Initialize(VkPhysicalDevice gpu, const VkPhysicalDeviceMemoryProperties& memoryProperties,
+                    bool budgetExtension, uint32_t framesInFlight);
+                static void DeInitialize();
+
+                static void Register(VKEvictable* resource);
+                static void Unregister(VKEvictable* resource);
+
+                static void BeginFrame();
+
+                static uint64_t GetFrame();
+                static uint64_t GetResidencyVersion();
+                static uint32_t GetHeapCount();
+                static VKHeapBudget GetHeapBudget(uint32_t heap);
+
+                static void SetBudgetFraction(float fraction);
+
+            private:
+                static VkPhysicalDevice                 m_gpu;
+                static VkPhysicalDeviceMemoryProperties m_memoryProperties;
+                static bool                             m_budgetExtension;
+                static uint32_t                         m_framesInFlight;
+                static float                            m_budgetFraction;
+
+                static std::atomic<uint64_t>    m_frame;
+                static std::atomic<uint64_t>    m_residencyVersion;
+                static uint64_t                 m_cooldownUntil;
+
+                static std::mutex                   m_mutex;
+                static std::vector<VKEvictable*>    m_resources;
+                static VKHeapBudget                 m_heaps[VK_MAX_MEMORY_HEAPS];
+
+                static void updateHeaps();
+                static VkDeviceSize evict(VkDeviceSize overage);
+                static void restore(VkDeviceSize headroom);
+            };
+        }
+    }
+}
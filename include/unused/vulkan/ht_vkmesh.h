@@ -17,13 +17,23 @@
 * \ingroup HatchitGraphics
 *
 * \brief A Mesh existing on the GPU via Vulkan
+*
+* The mesh's vertices and indices live in VKGeometryPool. Bind the
+* buffers of GetVertexBlock and GetIndexBlock at offset 0 and draw with
+* the mesh's range.
 */
 
 #pragma once
 
 #include <ht_mesh_resource.h>
 #include <ht_mesh_base.h>
+#include <ht_mesh.h>            //Vertex
 #include <ht_vulkan.h>
+#include <ht_vkmemorybudget.h>  //VKEvictable
+#include <ht_vkgeometrypool.h>  //VKGeometryRange
+#include <atomic>               //std::atomic
+#include <mutex>                //std::mutex
+#include <vector>               //std::vector
 
 namespace Hatchit {
 
@@ -32,7 +42,7 @@ namespace Hatchit {
         namespace Vulkan {
 
             class VKRenderer;
-            class HT_API VKMesh : public MeshBase
+            class HT_API VKMesh : public MeshBase, public VKEvictable
             {
             public:
                 VKMesh();
@@ -45,10 +55,29 @@ namespace Hatchit {
                 UniformBlock_vk GetVertexBlock();
                 UniformBlock_vk GetIndexBlock();
 
+                //Uploads the buffers again if they were evicted; must be called before drawing
+                bool VKMakeResident();
+
+                VkDeviceSize VKEvict() override;
+                bool VKRestore() override;
+                VkDeviceSize VKGetRestoreSize() const override;
+                bool VKIsEvicted() const override;
+                VKMemoryCategory VKGetCategory() const override;
+                GPUResourceRequest::Type VKGetResourceType() const override;
+                void* VKGetResourceBase() override;
+
             private:
+                bool upload();
+
                 VkDevice m_device;
-                UniformBlock_vk m_vertexBlock;
-                UniformBlock_vk m_indexBlock;
+                VKGeometryRange m_geometry;
+
+                //CPU copies the buffers are uploaded from again after eviction
+                std::vector<Vertex> m_vertices;
+                std::vector<uint32_t> m_indices;
+
+                std::atomic<bool> m_resident;
+                std::mutex m_mutex;
             };
 
         }
@@ -30,6 +30,7 @@
 #include <ht_vkshader.h>
 
 #include <ht_vulkan.h>
+#include <ht_vkcommandstate.h>   //VKCommandState
 
 #include <cassert>
 
@@ -45,9 +46,9 @@ namespace Hatchit {
                 VKPipeline();
                 virtual ~VKPipeline();
 
-                bool Initialize(const Resource::PipelineHandle& handle, const VkDevice& device, const VkDescriptorPool& descriptorPool);
+                bool Initialize(const Resource::PipelineHandle& handle, const VkDevice& device);
 
-                ///Have Vulkan update the descriptor sets in this pipeline
+                ///Nothing to do; render passes read the shader variables as they record
                 bool VUpdate()                                                  override;
 
                 /* Add a map of existing shader variables into this pipeline
@@ -64,13 +65,14 @@ namespace Hatchit {
                 bool VSetMatrix4(size_t offset, Math::Matrix4 data)  override;
 
                 VkPipeline                          GetVKPipeline();
+                ///Variables past the first 128 bytes are uniforms each render pass keeps its own copy of
+                const ShaderVariableChunk*          GetShaderVariables() const;
                 
-                void BindPipeline(const VkCommandBuffer& commandBuffer);
+                void BindPipeline(VKCommandState& state, const BYTE* pushData, uint32_t pushSize) const;
 
             protected:
                 //Input
                 VkDevice m_device;
-                VkDescriptorPool m_descriptorPool;
                 VKRenderPass* m_renderPass;
 
                 std::vector<VkVertexInputAttributeDescription> m_vertexLayout;
@@ -89,13 +91,6 @@ namespace Hatchit {
                 VkPipelineLayout    m_pipelineLayout; //Given by the root layout
                 VkPipeline          m_pipeline;
 
-                std::vector<BYTE> m_pushData;
-                std::vector<BYTE> m_descriptorData;
-
-                UniformBlock_vk m_uniformVSBuffer;
-                uint8_t* m_uniformBindPoint;
-                VkDescriptorSet m_descriptorSet; //Descriptor set for data that can't fit into push constants
-
             private:
                 bool m_hasVertexAttribs;
                 bool m_hasIndexAttribs;
@@ -132,8 +127,6 @@ namespace Hatchit {
 
                 bool preparePipeline();
 
-                bool prepareDescriptorSet();
-
                 VkFormat formatFromType(const Resource::ShaderVariable::Type& type) const;
 
                 void addAttributesToLayout(const std::vector<Resource::Pipeline::Attribute>& attributes, std::vector<VkVertexInputAttributeDescription>& vkAttributes, uint32_t& outStride);
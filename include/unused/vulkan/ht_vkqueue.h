@@ -29,6 +29,7 @@
 #include <ht_vulkan.h>      //General Vulkan
 #include <ht_gpuqueue.h>    //Extending this class
 #include <ht_vkdevice.h>    //VKDevice that is required for init
+#include <ht_vktimeline.h>  //VKTimeline
 
 namespace Hatchit
 {
@@ -45,9 +46,15 @@ namespace Hatchit
                 bool Initialize(const VKDevice* device);
 
                 const VkQueue& GetVKQueue() const;
+                uint32_t GetVKQueueFamily() const;
+
+                ///Every submission to this queue should go through its timeline
+                VKTimeline& GetTimeline();
 
             private:
-                VkQueue m_queue;
+                VkQueue     m_queue;
+                uint32_t    m_queueFamily;
+                VKTimeline  m_timeline;
             };
         }
     }
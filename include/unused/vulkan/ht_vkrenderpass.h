@@ -20,6 +20,24 @@
 *
 * This render pass uses Vulkan to create a command buffer fit for submission to the renderer.
 * It can be a part of a RenderLayer and takes in Render Submissions made up of Materials and Meshes.
+*
+* A frame that only draws retained requests is recorded into a command
+* buffer the pass keeps for that frame slot, with instance data in a buffer
+* the slot keeps too. When the slot comes back around and neither the draw
+* list, the camera, the attachments nor anything's residency has changed,
+* only changed instance data is copied and the recording is submitted again.
+*
+* A GPU driven pass records a culling dispatch ahead of its draws and one
+* indirect draw per material and mesh, or one per run of them that share
+* every binding where the device can multi-draw. The CPU only copies
+* instance data and draw parameters, however many instances are culled.
+*
+* Meshes are drawn by their range of the shared geometry buffers, so
+* draws of different meshes under one material don't bind anything new.
+*
+* Pipelines are shared between passes, so a pass never writes its camera
+* into one. It keeps its own copy of each pipeline's uniforms, one per
+* frame slot, and binds that copy alongside the pipeline.
 */
 
 #pragma once
@@ -31,6 +49,13 @@
 #include <ht_vkrootlayout.h>
 #include <ht_rootlayout.h>      //RootLayoutHandle
 #include <ht_vkcommandpool.h>   //VKCommandPool
+#include <ht_vkuploadring.h>    //VKUploadRange
+#include <ht_vkattachmentaliaser.h> //VKAttachmentRequest
+#include <ht_vkdescriptorallocator.h>   //VKDescriptorAllocation
+#include <ht_vkcommandstate.h>  //VKCommandState
+#include <ht_vkindirectculler.h>    //VKCullDispatch
+#include <ht_vkuniformarena.h>  //VKUniformRange
+#include <unordered_map>        //std::unordered_map
 
 namespace Hatchit {
 
@@ -38,6 +63,8 @@ namespace Hatchit {
 
         namespace Vulkan {
 
+            class VKPipeline;
+
             class HT_API VKRenderPass : public RenderPassBase
             {
             public:
@@ -45,14 +72,13 @@ namespace Hatchit {
                 ~VKRenderPass();
 
                 //Required function for RefCounted classes
-                bool Initialize(const Resource::RenderPassHandle& handle, const VkDevice& device,
-                    const VkDescriptorPool& descriptorPool, const VKSwapChain* swapchain);
+                bool Initialize(const Resource::RenderPassHandle& handle, const VkDevice& device, const VKSwapChain* swapchain);
 
                 //Will this be sent the Objects that it needs to render?
                 ///Render the scene
                 void VUpdate() override;
 
-                bool VBuildCommandList(const ICommandPool* commandPool) override;
+                bool VBuildCommandList(const CommandRecordContext& context) override;
 
                 const VkRenderPass& GetVkRenderPass() const;
                 const VkCommandBuffer& GetVkCommandBuffer() const;
@@ -60,10 +86,92 @@ namespace Hatchit {
 
                 const std::vector<RenderTargetHandle>& GetOutputRenderTargets() const;
 
+                ///Called by the swapchain whenever the pass order changes
+                bool VKPrepareAttachments(uint32_t position, std::vector<VKAttachmentRequest>& requests);
+                bool VKBindAttachments(bool aliased);
+                bool VKAttachmentsReady() const;
+
             private:
+                //How this frame binds one pipeline from m_pipelineList
+                struct PipelineBinding
+                {
+                    VKPipeline*         pipeline;
+                    const BYTE*         pushData;       //The pipeline's push constants with this pass's camera, in the frame arena
+                    uint32_t            pushSize;
+                    VkDescriptorSet     uniformSet;     //This pass's copy of the pipeline's uniforms for the frame slot
+                };
+
+                //A pipeline's uniforms as this pass sees them, with the pass's camera written in
+                struct PipelineUniforms
+                {
+                    VKUniformRange                      range;      //One copy per frame slot
+                    std::vector<VKDescriptorAllocation> sets;       //One per frame slot, each pointing at that slot's copy
+                    uint64_t                            lastBuild;  //m_buildCount when the pass last drew with it
+                };
+
+                //A run of renderables under one pipeline that is recorded as a unit
+                struct DrawChunk
+                {
+                    const PipelineBinding*                      binding;
+                    const FrameVector<RenderableInstances>*     renderables;
+                    size_t                                      first;
+                    size_t                                      last;
+                };
+
+                //What a frame slot recorded for retained requests and what the recording depended on
+                struct RetainedSlot
+                {
+                    VKCommandPool*          commandPool;        //Only reset when the slot records again
+                    VkCommandBuffer         commandBuffer;
+                    UniformBlock_vk         instanceBlock;      //Persistently mapped instance data, draw after draw
+                    VkDeviceSize            instanceCapacity;
+                    std::vector<uint64_t>   writtenVersions;    //Version of every chunk in instanceBlock, in draw order
+                    uint64_t                listVersion;
+                    uint64_t                cameraVersion;
+                    uint64_t                attachmentVersion;
+                    uint64_t                residencyVersion;
+                    VkClearValue            clearColor;
+                    RecordStats             recordStats;
+                    bool                    recorded;
+                };
+
+                //What a GPU driven frame hands the culling dispatches and reads back when drawing
+                struct IndirectDraws
+                {
+                    VKCullDispatch              cull;               //Scheduled instances, written this frame
+                    VKCullDispatch              resident;           //Retained instances kept in m_resident; shares cull's draws, commands and output
+                    FrameVector<VkDeviceSize>   pipelineOffsets;    //Where each pipeline's visible instances start in cull.output
+                    Frustum                     frustum;
+                    const PipelineBinding*      bindings;           //Parallel to m_pipelineList
+                    VkBuffer                    objectSource;       //Staged VKCullObjects of changed retained instances
+                    FrameVector<VkBufferCopy>   objectCopies;       //From objectSource into m_resident.objectBlock
+                    VkBuffer                    instanceSource;     //Staged instance data of changed retained instances
+                    FrameVector<VkBufferCopy>   instanceCopies;     //From instanceSource into m_resident.instanceBlock
+                };
+
+                //Retained instances kept on the GPU between frames, in m_retainedKeys order
+                struct ResidentCullSet
+                {
+                    UniformBlock_vk         objectBlock;        //VKCullObjects
+                    VkDeviceSize            objectCapacity;
+                    UniformBlock_vk         instanceBlock;      //Instance data, one instance after another
+                    VkDeviceSize            instanceCapacity;
+                    std::vector<uint64_t>   writtenVersions;    //Version of every instance in the blocks
+                    std::vector<uint32_t>   drawSizes;          //Instances in each resident draw
+                    uint64_t                listVersion;        //0 when the blocks must be written again from scratch
+                };
+
+                //Where a frame slot's culling dispatch copies visible instance data
+                struct IndirectSlot
+                {
+                    UniformBlock_vk         outputBlock;
+                    VkDeviceSize            outputCapacity;
+                };
+
                 //Input
                 uint32_t m_firstInputTargetSetIndex;
                 std::vector<VkDescriptorSet> m_inputTargetDescriptorSets;
+                std::vector<VKDescriptorAllocation> m_inputTargetAllocations; //Parallel to m_inputTargetDescriptorSets
 
                 std::vector<RenderTargetHandle> m_renderTargets;
 
@@ -71,28 +179,69 @@ namespace Hatchit {
 
                 bool setupRenderPass();
                 bool setupAttachmentImages();
+                bool setupAttachmentViews();
                 bool setupFramebuffer();
+                void retireAttachments();
+
+                bool recordPrimary(VKCommandPool* commandPool, VkCommandBuffer commandBuffer, VkCommandBufferUsageFlags usage,
+                    const FrameVector<DrawChunk>& chunks, const FrameVector<VKUploadRange>& instanceRanges,
+                    const FrameVector<VkCommandBuffer>& secondaryBuffers, const IndirectDraws* indirect = nullptr);
+                bool recordSecondary(VKCommandPool* commandPool, const DrawChunk& chunk,
+                    const FrameVector<VKUploadRange>& instanceRanges, VkCommandBuffer& commandBuffer, RecordStats& stats) const;
+                void recordChunk(VKCommandState& state, const DrawChunk& chunk,
+                    const FrameVector<VKUploadRange>& instanceRanges) const;
+                void bindPassState(VKCommandState& state, const PipelineBinding& binding) const;
+
+                bool buildPushConstants(const VKPipeline* pipeline, const Math::Matrix4& proj, const Math::Matrix4& view, PipelineBinding& binding);
+                bool writePipelineUniforms(VKPipeline* pipeline, const Math::Matrix4& invView, VkDescriptorSet& uniformSet);
+                bool allocatePipelineUniforms(size_t size, PipelineUniforms& uniforms);
+                void retirePipelineUniforms(PipelineUniforms& uniforms);
+                void prunePipelineUniforms();
+
+                bool canDrawIndirect() const;
+                bool buildIndirect(VKCommandPool* commandPool, uint32_t frame, const FrameVector<PipelineBinding>& bindings);
+                bool stageResident(IndirectDraws& draws, uint32_t residentCount, VkDeviceSize residentBytes);
+                void recordResidentCopies(VkCommandBuffer commandBuffer, const IndirectDraws& draws) const;
+                void recordIndirect(VKCommandState& state, const IndirectDraws& draws) const;
+
+                bool buildRetained(uint32_t frame, const FrameVector<DrawChunk>& chunks);
+                bool writeRetainedInstances(RetainedSlot& slot, bool rewrite, FrameVector<VKUploadRange>& instanceRanges, bool& moved);
+                bool createInstanceBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, UniformBlock_vk& block);
 
-                bool allocateCommandBuffer(const VKCommandPool* commandPool);
                 //Mapping set index to maps of binding indicies and render targets
                 bool setupDescriptorSets(std::map < uint32_t, std::map < uint32_t, VKRenderTarget* >> inputTargets);
 
                 VkDevice m_device;
-                VkDescriptorPool m_descriptorPool;
 
                 VkRenderPass m_renderPass;
-                VkCommandBuffer m_commandBuffer;
+                //One command buffer per frame slot so a slot can be recorded while the others are in flight
+                std::vector<VkCommandBuffer> m_commandBuffers;
+                //One per frame slot, used when a frame only draws retained requests
+                std::vector<RetainedSlot> m_retainedSlots;
+                //One per frame slot, used when the pass is GPU driven
+                std::vector<IndirectSlot> m_indirectSlots;
+                //Shared by every frame slot; copies into it wait for earlier frames' culling
+                ResidentCullSet m_resident;
+                //Every pipeline drawn with lately; entries not drawn with for a few frames are retired
+                std::unordered_map<const VKPipeline*, PipelineUniforms> m_pipelineUniforms;
+                uint64_t m_buildCount;
                 
                 Graphics::RootLayoutHandle m_rootLayoutHandle; //To keep this referenced
                 VKRootLayout* m_rootLayout;
-                
-                //For instance data
-                std::map<MeshHandle, UniformBlock_vk> m_instanceBlocks;
 
                 std::vector<Image_vk> m_colorImages;
                 Image_vk m_depthImage;
 
                 VkFramebuffer m_framebuffer;
+
+                bool m_attachmentsReady;
+                //Set when an earlier pass in the frame shares our attachment memory
+                bool m_aliased;
+                //Bumped every time the attachments and framebuffer are recreated
+                uint64_t m_attachmentVersion;
+                //Set once the pass has said it can't cull on the GPU, so it isn't said every frame
+                bool m_reportedCPUCulling;
+
             };
         }
     }
@@ -16,6 +16,7 @@
 
 #include <ht_platform.h>
 #include <ht_vulkan.h>
+#include <ht_vkdescriptorallocator.h>
 #include <ht_rootlayout_base.h>
 #include <ht_rootlayout_resource.h>
 
@@ -34,7 +35,7 @@ namespace Hatchit
 
                 ~VKRootLayout();
 
-                bool Initialize(const Resource::RootLayoutHandle& handle, const VkDevice& device, const VkDescriptorPool& descriptorPool);
+                bool Initialize(const Resource::RootLayoutHandle& handle, const VkDevice& device);
 
                 const VkPipelineLayout& VKGetPipelineLayout() const;
                 const VkDescriptorSet& VKGetSamplerSet() const;
@@ -45,12 +46,12 @@ namespace Hatchit
                 VkDevice m_device;
 
                 std::vector<VKSampler*> m_samplers; //So we can delete them later
-                VkDescriptorSet         m_samplerSet; //Bind this so we can avoid the pipeline complaining about it
+                VKDescriptorAllocation  m_samplerSet; //Bind this so we can avoid the pipeline complaining about it
                 VkPipelineLayout m_pipelineLayout;
                 std::vector<VkDescriptorSetLayout> m_descriptorSetLayouts;
                 std::vector<VkPushConstantRange> m_pushConstantRanges;
 
-                bool setupSamplerSet(const VkDevice& device, const VkDescriptorPool& descriptorPool);
+                bool setupSamplerSet(const VkDevice& device);
             };
         }
     }
@@ -0,0 +1,152 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+/**
+* \class VKStagingUploader
+* \ingroup HatchitGraphics
+*
+* \brief Copies data into device-local buffers and images through a staging ring
+*
+* Uploads are written into one persistently mapped staging buffer and the
+* copies are queued instead of being submitted one by one. Flush records
+* every queued copy into one command buffer and submits it to the copy
+* queue, which is the dedicated transfer queue when the device has one.
+* Staging space is reused once the copy timeline passes the batch that
+* used it; if the ring fills up, Upload flushes and waits for the oldest
+* batch.
+*
+* Images are copied the same way, level by level. Missing mip levels
+* are then generated with blits and every level is moved to shader read
+* layout. Blits need a graphics queue, so with a dedicated copy queue that
+* last step is submitted to the graphics queue after the copies finish.
+*
+* When the copy queue is not the graphics queue, the graphics submission
+* has to wait on GetTimeline() at the value Flush returned.
+*/
+
+#pragma once
+
+#include <ht_platform.h>    //HT_API
+#include <ht_vulkan.h>      //General Vulkan headers
+#include <ht_vkqueue.h>     //VKQueue
+#include <deque>            //std::deque
+#include <mutex>            //std::mutex
+#include <vector>           //std::vector
+
+namespace Hatchit {
+
+    namespace Graphics {
+
+        namespace Vulkan {
+
+            struct VKStagingStats
+            {
+                VkDeviceSize    bytesUploaded;      //Bytes copied since the last BeginFrame
+                uint32_t        copies;             //Copies recorded since the last BeginFrame
+                uint32_t        batches;            //Batches submitted since the last BeginFrame
+                VkDeviceSize    bytesOutstanding;   //Staging bytes the GPU has not finished copying
+                VkDeviceSize    stagingSize;        //Size of the staging ring
+                uint32_t        images;             //Images finished since the last BeginFrame
+            };
+
+            struct VKImageUpload
+            {
+                VkImage         image;      //Created with transfer source and destination usage
+                uint32_t        width;
+                uint32_t        height;
+                uint32_t        texelSize;  //Bytes per texel
+                uint32_t        mipLevels;  //Levels in the image
+                uint32_t        dataLevels; //Levels in data, largest first and tightly packed; the rest are blitted
+                const void*     data;
+            };
+
+            class HT_API VKStagingUploader
+            {
+            public:
+                static const VkDeviceSize DefaultStagingSize = 32 * 1024 * 1024;
+
+                static bool Initialize(const VkDevice& device, VKQueue* copyQueue, VKQueue* graphicsQueue,
+                    VkDeviceSize stagingSize = DefaultStagingSize);
+                static void DeInitialize();
+
+                static bool Upload(const void* data, VkDeviceSize size, VkBuffer buffer, VkDeviceSize offset);
+                static bool UploadImage(const VKImageUpload& upload);
+                static uint64_t Flush();
+
+                static void BeginFrame();
+
+                static bool IsDedicated();
+                static VKTimeline* GetTimeline();
+
+                static VKStagingStats GetStats();
+
+            private:
+                struct Copy
+                {
+                    VkBuffer        buffer;
+                    VkBufferCopy    region;
+                };
+
+                struct ImageCopy
+                {
+                    VkImage             image;
+                    VkBufferImageCopy   region;
+                };
+
+                struct PendingImage
+                {
+                    VKImageUpload   upload;
+                    bool            transitioned;   //Moved to transfer destination layout
+                    bool            complete;       //Every copy has been queued
+                };
+
+                struct Batch
+                {
+                    uint64_t        value;              //Copy timeline value of the batch
+                    uint64_t        end;                //Staging head when the batch was submitted
+                    VkCommandBuffer commandBuffer;
+                    uint64_t        finishValue;        //Graphics timeline value of the image finish, if any
+                    VkCommandBuffer finishCommandBuffer;
+                };
+
+                static VkDevice             m_device;
+                static VKTimeline*          m_timeline;
+                static VKTimeline*          m_graphicsTimeline;
+                static bool                 m_dedicated;
+                static VkCommandPool        m_commandPool;
+                static VkCommandPool        m_graphicsCommandPool;
+                static UniformBlock_vk      m_staging;
+                static VkDeviceSize         m_stagingSize;
+
+                //Monotonic byte counters; position in the ring is the counter modulo its size
+                static uint64_t             m_head;
+                static uint64_t             m_tail;
+
+                static std::mutex           m_mutex;
+                static std::vector<Copy>    m_copies;
+                static std::vector<ImageCopy>       m_imageCopies;
+                static std::vector<PendingImage>    m_images;
+                static std::deque<Batch>    m_batches;
+                static uint64_t             m_lastValue;
+                static VKStagingStats       m_stats;
+
+                static bool reserve(VkDeviceSize size, VkDeviceSize& offset);
+                static uint64_t flush();
+                static void retireBatches();
+                static VkCommandBuffer beginCommands(VkCommandPool pool);
+                static void finishImages(VkCommandBuffer commandBuffer, const std::vector<VKImageUpload>& images);
+            };
+        }
+    }
+}
@@ -29,6 +29,9 @@
 #include <ht_vkpipeline.h>  
 #include <ht_vkrendertarget.h>
 #include <ht_vkqueue.h>
+#include <ht_vkuploadring.h>
+#include <ht_vkattachmentaliaser.h>
+#include <ht_framearena.h>
 
 namespace Hatchit {
 
@@ -50,6 +53,12 @@ namespace Hatchit {
                 VkImageView view;
             };
 
+            struct FrameSync {
+                uint64_t value;             //Queue timeline value reached once the GPU has finished with this frame slot
+                VkSemaphore acquireSemaphore; //Signaled once the acquired image may be rendered to
+                VkSemaphore renderSemaphore;  //Signaled once the image may be presented
+            };
+
             class VKRenderer;
 
             class HT_API VKSwapChain : public SwapChain
@@ -58,10 +67,12 @@ namespace Hatchit {
                 VKSwapChain(const RendererParams& rendererParams, VKDevice* device, VKQueue* queue);
                 ~VKSwapChain();
                 
+                void VBeginFrame()                                          override;
                 void VClear(float* color)                                   override;
                 bool VInitialize(uint32_t width, uint32_t height)           override;
                 void VResize(uint32_t width, uint32_t height)               override;
-                void VExecute(std::vector<RenderPassHandle> renderPasses)   override;
+                void VExecute(const std::vector<RenderPassHandle>& renderPasses) override;
+                void VPrepareRenderPasses(const std::vector<std::vector<RenderPassHandle>>& levels) override;
                 void VSetInput(RenderPassHandle handle)                     override;
                 void VPresent()                                             override;
 
@@ -71,6 +82,10 @@ namespace Hatchit {
 
                 const VkClearValue&     GetVKClearColor() const;
 
+                VKUploadRing*           GetUploadRing() const;
+
+                VKAttachmentStats       GetAttachmentStats() const;
+
                 bool BuildSwapchainCommands(VkClearValue clearColor);
 
                 VkResult VKGetNextImage(VkSemaphore presentSemaphore);
@@ -85,13 +100,21 @@ namespace Hatchit {
                 VkPhysicalDevice    m_gpu;
                 VkDevice            m_device;
                 VkQueue             m_queue;
+                VKTimeline*         m_timeline;
                 VkCommandPool       m_commandPool;
                 VkDescriptorPool    m_descriptorPool;
 
-                VkPipelineStageFlags m_submitStages;
-                VkSemaphore          m_presentSemaphore;
-                VkSemaphore          m_renderSemaphore;
-                VkSubmitInfo         m_submitInfo;
+                VkPipelineStageFlags   m_submitStages;
+                std::vector<FrameSync> m_frames;
+                VKUploadRing*          m_uploadRing;
+
+                //Submission lists built while executing a frame; rewound in VBeginFrame
+                FrameArena                  m_frameArena;
+                std::vector<VKTimelineWait> m_executeWaits;
+
+                //Attachment memory for every render pass, aliased between levels of the graph
+                VKAttachmentAliaser                 m_attachments;
+                std::vector<std::vector<VKRenderPass*>> m_attachmentLevels;
 
                 bool m_dirty;
 
@@ -124,12 +147,19 @@ namespace Hatchit {
 
                 UniformBlock_vk         m_vertexBuffer;
                 std::vector<Texture_vk> m_inputTextures;
+                VKRenderPass*           m_inputPass;
 
                 bool vkPrepare();
                 bool vkPrepareResources();
 
                 bool createAllocatorPools();
 
+                //Create the semaphores and upload ring for every frame slot
+                bool prepareFrames();
+
+                //Block until the GPU has finished every frame slot
+                void waitForFrames();
+
                 bool prepareSurface();
 
                 bool getQueueProperties();
@@ -164,6 +194,7 @@ namespace Hatchit {
                 void destroySwapchainBuffers();
                 void destroyRenderPass();
                 void destroySwapchain();
+                void destroyFrames();
                 
             };
         }
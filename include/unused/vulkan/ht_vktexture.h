@@ -19,6 +19,11 @@
 #include <ht_texture_resource.h>
 #include <ht_vksampler.h>
 #include <ht_vulkan.h>
+#include <ht_vkmemorybudget.h>  //VKEvictable
+#include <functional>           //std::function
+#include <map>                  //std::map
+#include <mutex>                //std::mutex
+#include <vector>               //std::vector
 
 namespace Hatchit {
 
@@ -26,7 +31,7 @@ namespace Hatchit {
     
         namespace Vulkan {
 
-            class HT_API VKTexture : public TextureBase
+            class HT_API VKTexture : public TextureBase, public VKEvictable
             {
             public:
                 VKTexture();
@@ -35,21 +40,50 @@ namespace Hatchit {
                 //Required function for RefCounted classes
                 bool Initialize(Resource::TextureHandle handle, const VkDevice& device);
 
-                //For building a texture *not* from a file
+                //For building a texture *not* from a file; data holds mipLevels levels, largest first,
+                //and any levels below those are generated
                 bool Initialize(const VkDevice& device, const BYTE* data, uint32_t width, uint32_t height, uint32_t channelCount, uint32_t mipLevels);
 
                 VkImageView GetView();
 
+                //Called after eviction or restoring replaces the view; anything holding it must rewrite it
+                uint32_t AddResidencyListener(const std::function<void()>& listener);
+                void RemoveResidencyListener(uint32_t id);
+
+                VkDeviceSize VKEvict() override;
+                bool VKRestore() override;
+                VkDeviceSize VKGetRestoreSize() const override;
+                bool VKIsEvicted() const override;
+                VKMemoryCategory VKGetCategory() const override;
+                GPUResourceRequest::Type VKGetResourceType() const override;
+                void* VKGetResourceBase() override;
+
             private:
                 bool VKBufferImage();
+                bool createImage(uint32_t baseLevel);
+                bool replaceImage(uint32_t baseLevel);
+                void notifyListeners();
 
                 VkDevice m_device;
 
                 VkImageView m_view;
                 VkImage m_image;
                 VkImageLayout m_imageLayout;
+                uint32_t m_dataLevels;
+
+                VKAllocation m_allocation;
+
+                //Keeps the CPU copy alive so evicted levels can be uploaded again
+                Resource::TextureHandle m_resource;
+                VkFormat m_format;
+                uint32_t m_texelSize;
+                uint32_t m_fullChain;
+                uint32_t m_baseLevel;       //Level of the full chain the image starts at; 0 when resident
+                VkDeviceSize m_residentSize;
 
-                VkDeviceMemory m_deviceMemory;
+                std::mutex m_listenerMutex;
+                std::map<uint32_t, std::function<void()>> m_listeners;
+                uint32_t m_nextListener;
             };
 
         }
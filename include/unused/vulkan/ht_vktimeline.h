@@ -0,0 +1,104 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+/**
+* \class VKTimeline
+* \ingroup HatchitGraphics
+*
+* \brief Tracks how far a Vulkan queue has progressed through its submissions
+*
+* Every submission made through a timeline is given the next value of a
+* monotonically increasing counter. Any thread may then poll or wait for
+* "the GPU reached value X" without idling the whole queue, and other
+* timelines may make their submissions wait on it.
+*
+* When the device supports VK_KHR_timeline_semaphore the counter is a
+* timeline semaphore. Otherwise every submission signals a fence from a
+* small recycled pool and the completed value is the newest fence that
+* has signaled; waits from other queues are then done on the CPU.
+*/
+
+#pragma once
+
+#include <ht_platform.h>    //HT_API
+#include <ht_vulkan.h>      //General Vulkan headers
+#include <deque>            //std::deque
+#include <mutex>            //std::mutex
+#include <vector>           //std::vector
+
+namespace Hatchit
+{
+    namespace Graphics
+    {
+        namespace Vulkan
+        {
+            class VKTimeline;
+
+            struct VKTimelineWait
+            {
+                VKTimeline*             timeline;   //Timeline of the queue being waited on
+                uint64_t                value;      //Value that queue must reach
+                VkPipelineStageFlags    stage;      //Stages of this submission that have to wait
+            };
+
+            class HT_API VKTimeline
+            {
+            public:
+                VKTimeline();
+                ~VKTimeline();
+
+                bool Initialize(VkDevice device, VkQueue queue, bool useTimelineSemaphore);
+                void DeInitialize();
+
+                bool Submit(const VkSubmitInfo& submitInfo, uint64_t* value = nullptr);
+                bool Submit(const VkSubmitInfo& submitInfo, const std::vector<VKTimelineWait>& waits, uint64_t* value = nullptr);
+                VkResult Present(const VkPresentInfoKHR& presentInfo);
+
+                uint64_t GetSubmittedValue() const;
+                uint64_t GetCompletedValue();
+
+                bool IsComplete(uint64_t value);
+                bool Wait(uint64_t value, uint64_t timeout = UINT64_MAX);
+                bool WaitIdle();
+
+                bool UsesTimelineSemaphore() const;
+                const VkSemaphore& GetVKSemaphore() const;
+
+            private:
+                struct PendingFence
+                {
+                    uint64_t    value;
+                    VkFence     fence;
+                };
+
+                VkDevice    m_device;
+                VkQueue     m_queue;
+                VkSemaphore m_semaphore;
+                bool        m_useTimelineSemaphore;
+
+                //Guards the queue itself since VkQueue needs external synchronization
+                mutable std::mutex  m_mutex;
+                uint64_t            m_submitted;
+                uint64_t            m_completed;
+
+                //Fallback only; submissions in flight oldest first, and fences ready for reuse
+                std::deque<PendingFence>    m_pending;
+                std::vector<VkFence>        m_freeFences;
+
+                bool acquireFence(VkFence& fence);
+                void retireFences();
+            };
+        }
+    }
+}
@@ -29,6 +29,7 @@
 #include <ht_vulkan.h>      //General Vulkan headers
 #include <ht_vkdevice.h>    //Vulkan Device
 #include <ht_vkqueue.h>     //Vulkan Queue
+#include <ht_vkmemoryallocator.h>   //VKMemoryAllocator
 
 namespace Hatchit {
 
@@ -39,7 +40,7 @@ namespace Hatchit {
             class HT_API VKTools 
             {
             public:
-                static bool Initialize(const VKDevice* device, const VKQueue* queue);
+                static bool Initialize(const VKDevice* device, VKQueue* queue);
                 static void DeInitialize();
                 
                 static bool CreateUniformBuffer(size_t dataSize, void* data, UniformBlock_vk* uniformBlock);
@@ -48,6 +49,9 @@ namespace Hatchit {
                 static void DeleteUniformBuffer(UniformBlock_vk& uniformBlock);
                 static void DeleteTexelBuffer(TexelBlock_vk& texelBlock);
 
+                static bool CreateDeviceBuffer(size_t dataSize, const void* data, VkBufferUsageFlags usage, UniformBlock_vk* block);
+                static void DeleteDeviceBuffer(UniformBlock_vk& block);
+
                 static VkFormat GetPreferredColorFormat();
                 static VkFormat GetPreferredDepthFormat();
 
@@ -55,6 +59,10 @@ namespace Hatchit {
                 static void FlushSetupCommandBuffer();
                 static VkCommandBuffer GetSetupCommandBuffer();
 
+                static VKMemoryAllocator& GetAllocator();
+                static const std::vector<uint32_t>& GetQueueFamilies();
+                static bool SupportsBlit(VkFormat format);
+
                 //Reused helpers
                 static bool SetImageLayout(VkCommandBuffer commandBuffer, VkImage image, VkImageAspectFlags aspectMask,
                     VkImageLayout oldImageLayout, VkImageLayout newImageLayout);
@@ -66,8 +74,14 @@ namespace Hatchit {
                 static VkCommandPool                    m_setupCommandPool;
                 static VkCommandBuffer                  m_setupCommandBuffer;
                 static VkDevice                         m_device;
+                static VkPhysicalDevice                 m_gpu;
                 static VkQueue                          m_queue;
+                static VKTimeline*                      m_timeline;
                 static VkPhysicalDeviceMemoryProperties m_gpuMemoryProps;
+                static VKMemoryAllocator                m_allocator;
+
+                //Families that touch device-local buffers; more than one means concurrent sharing
+                static std::vector<uint32_t>            m_queueFamilies;
 
             };
 
@@ -0,0 +1,112 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+/**
+* \class VKUniformArena
+* \ingroup HatchitGraphics
+*
+* \brief Persistently mapped uniform buffer ranges for materials and pipelines
+*
+* Every material and pipeline takes a range of a few large host visible
+* uniform buffers that stay mapped for their whole life. Write copies
+* straight into the range, so updating a uniform never maps or unmaps
+* anything. Callers only write the bytes that changed.
+*
+* When the memory isn't host coherent, every write is remembered and Flush
+* hands the merged ranges to vkFlushMappedMemoryRanges in a single call.
+* Ranges are aligned to nonCoherentAtomSize so a flush never reaches past
+* its own range. Flush must run before the submission that reads them.
+*
+* Every range holds one copy per frame slot, one after another. Write
+* only ever touches the copy of the slot given to BeginFrame, so a frame
+* still in flight keeps reading what it was recorded with. Bind a slot's
+* copy with GetDescriptor.
+*/
+
+#pragma once
+
+#include <ht_platform.h>    //HT_API
+#include <ht_vulkan.h>      //General Vulkan headers
+#include <ht_vkbufferpool.h>    //VKBufferPool
+#include <atomic>           //std::atomic
+#include <mutex>            //std::mutex
+#include <vector>           //std::vector
+
+namespace Hatchit {
+
+    namespace Graphics {
+
+        namespace Vulkan {
+
+            struct VKUniformRange
+            {
+                UniformBlock_vk block;          //The first copy; the buffer is shared
+                VkDeviceMemory  memory;         //Memory behind the range
+                VkDeviceSize    memoryOffset;   //Offset of the first copy in memory
+                VkDeviceSize    size;           //Size of one copy, rounded up to the flush granularity
+                VkDeviceSize    stride;         //Distance from one slot's copy to the next
+                uint32_t        copies;         //One per frame slot
+                uint8_t*        mapped;         //Host pointer to the first copy
+                bool            coherent;       //False if writes have to be flushed
+            };
+
+            struct VKUniformArenaStats
+            {
+                uint32_t        ranges;         //Ranges handed out
+                VkDeviceSize    bytesWritten;   //Bytes written before the last Flush
+                uint32_t        writes;         //Writes before the last Flush
+                uint32_t        flushedRanges;  //Merged ranges the last Flush passed to the driver
+            };
+
+            class HT_API VKUniformArena
+            {
+            public:
+                static const VkDeviceSize DefaultBufferSize = 1024 * 1024;
+
+                static bool Initialize(const VkDevice& device, const VkPhysicalDeviceLimits& limits,
+                    uint32_t frameCount, VkDeviceSize bufferSize = DefaultBufferSize);
+                static void DeInitialize();
+
+                static bool Allocate(VkDeviceSize size, VKUniformRange& range);
+                static void Free(VKUniformRange& range);
+
+                static void BeginFrame(uint32_t frame);
+
+                static bool Write(const VKUniformRange& range, VkDeviceSize offset, const void* data, VkDeviceSize size);
+                static bool Flush();
+
+                static VkDescriptorBufferInfo GetDescriptor(const VKUniformRange& range, uint32_t frame);
+                static VkDeviceSize GetAlignment();
+                static uint32_t GetFrameCount();
+                static uint32_t GetFrame();
+
+                static VKUniformArenaStats GetStats();
+
+            private:
+                static VkDevice                         m_device;
+                static VkDeviceSize                     m_alignment;
+                static VkDeviceSize                     m_atomSize;
+                static uint32_t                         m_frameCount;
+                static std::atomic<uint32_t>            m_frame;    //Only changes between frames
+                static VKBufferPool                     m_pool;
+
+                static std::mutex                       m_mutex;
+                static std::vector<VkMappedMemoryRange> m_dirty;
+                static VKUniformArenaStats              m_stats;
+                static VkDeviceSize                     m_pendingBytes;
+                static uint32_t                         m_pendingWrites;
+            };
+        }
+    }
+}
@@ -0,0 +1,99 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+/**
+* \class VKUploadRing
+* \ingroup HatchitGraphics
+*
+* \brief Hands out per-frame ranges of one persistently mapped buffer
+*
+* The buffer is split into one region per frame slot. Each region is a
+* linear allocator that is rewound when its slot comes back around, so
+* data written this frame never touches ranges the GPU may still be
+* reading. Callers write straight into the mapped range and bind the
+* buffer at the range's offset.
+*
+* Allocate is lock free and may be called from any recording thread. If a
+* frame runs out of room the range comes from a one-off buffer instead,
+* and the ring grows when that slot is next begun.
+*/
+
+#pragma once
+
+#include <ht_platform.h>    //HT_API
+#include <ht_vulkan.h>      //General Vulkan headers
+#include <atomic>           //std::atomic
+#include <mutex>            //std::mutex
+#include <vector>           //std::vector
+
+namespace Hatchit {
+
+    namespace Graphics {
+
+        namespace Vulkan {
+
+            struct VKUploadRange
+            {
+                VkBuffer        buffer;     //Buffer to bind
+                VkDeviceSize    offset;     //Offset of the range in buffer
+                VkDeviceSize    size;       //Size of the range
+                void*           mapped;     //Where to write the range's contents
+            };
+
+            struct VKUploadRingStats
+            {
+                uint32_t        allocations;        //Ranges handed out this frame
+                uint32_t        overflowBuffers;    //Ranges that didn't fit and got their own buffer
+                VkDeviceSize    bytesUsed;          //Bytes handed out this frame, including padding
+                VkDeviceSize    bytesPerFrame;      //Size of each frame's region
+            };
+
+            class HT_API VKUploadRing
+            {
+            public:
+                static const VkDeviceSize DefaultBytesPerFrame = 4 * 1024 * 1024;
+
+                VKUploadRing();
+                ~VKUploadRing();
+
+                bool Initialize(VkDevice device, uint32_t frameCount, VkDeviceSize bytesPerFrame = DefaultBytesPerFrame);
+                void DeInitialize();
+
+                void BeginFrame(uint32_t frame);
+
+                bool Allocate(VkDeviceSize size, VkDeviceSize alignment, VKUploadRange& range);
+
+                VKUploadRingStats GetStats() const;
+
+            private:
+                VkDevice        m_device;
+                UniformBlock_vk m_block;
+                uint32_t        m_frameCount;
+                uint32_t        m_frame;
+                VkDeviceSize    m_bytesPerFrame;
+
+                //Head of the current frame's region
+                std::atomic<VkDeviceSize>   m_head;
+                std::atomic<uint32_t>       m_allocations;
+
+                //One-off buffers per frame slot, freed when the slot comes back
+                std::mutex                                  m_overflowMutex;
+                std::vector<std::vector<UniformBlock_vk>>   m_overflow;
+                VkDeviceSize                                m_overflowBytes;
+
+                bool createBuffer(VkDeviceSize size, UniformBlock_vk& block);
+            };
+        }
+    }
+}
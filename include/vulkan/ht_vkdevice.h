@@ -19,6 +19,7 @@
 #include <ht_string.h>
 #include <ht_vulkan.h>
 #include <set>
+#include <vector>
 
 namespace Hatchit
 {
@@ -35,6 +36,11 @@ namespace Hatchit
              * This class wraps the functionality associated with interfacing with a GPU device
              * using Vulkan. Since there can be multiple active devices, this class represents a single
              * device instance.
+             *
+             * Besides the graphics queue, the device asks for a dedicated transfer queue and an
+             * async compute queue when the hardware exposes separate families for them, so uploads
+             * and compute work can overlap graphics. Resources shared between families change
+             * ownership with the Release and Acquire helpers.
              */
             class HT_API VKDevice
             {
@@ -48,6 +54,29 @@ namespace Hatchit
 
                 const VkPhysicalDeviceProperties& Properties() const;
 
+                uint32_t GraphicsQueueFamily() const;
+                uint32_t ComputeQueueFamily() const;
+                uint32_t TransferQueueFamily() const;
+
+                VkQueue GraphicsQueue() const;
+                VkQueue ComputeQueue() const;
+                VkQueue TransferQueue() const;
+
+                bool HasAsyncComputeQueue() const;
+                bool HasDedicatedTransferQueue() const;
+
+                static void ReleaseBuffer(VkCommandBuffer cmd, VkBuffer buffer, uint32_t srcFamily, uint32_t dstFamily,
+                    VkAccessFlags srcAccess, VkPipelineStageFlags srcStage);
+                static void AcquireBuffer(VkCommandBuffer cmd, VkBuffer buffer, uint32_t srcFamily, uint32_t dstFamily,
+                    VkAccessFlags dstAccess, VkPipelineStageFlags dstStage);
+
+                static void ReleaseImage(VkCommandBuffer cmd, VkImage image, const VkImageSubresourceRange& range,
+                    VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t srcFamily, uint32_t dstFamily,
+                    VkAccessFlags srcAccess, VkPipelineStageFlags srcStage);
+                static void AcquireImage(VkCommandBuffer cmd, VkImage image, const VkImageSubresourceRange& range,
+                    VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t srcFamily, uint32_t dstFamily,
+                    VkAccessFlags dstAccess, VkPipelineStageFlags dstStage);
+
                 operator VkDevice();
                 operator VkPhysicalDevice();
 
@@ -57,10 +86,21 @@ namespace Hatchit
                 VkPhysicalDeviceFeatures            m_vkPhysicalDeviceFeatures;
                 VkPhysicalDeviceProperties          m_vkPhysicalDeviceProperties;
                 VkPhysicalDeviceMemoryProperties    m_vkPhysicalDeviceMemoryProperties;
+                std::vector<VkQueueFamilyProperties> m_vkQueueFamilyProperties;
+
+                //Compute and transfer fall back to the graphics family when the
+                //hardware has no separate family for them
+                uint32_t                            m_graphicsQueueFamily;
+                uint32_t                            m_computeQueueFamily;
+                uint32_t                            m_transferQueueFamily;
 
+                VkQueue                             m_graphicsQueue;
+                VkQueue                             m_computeQueue;
+                VkQueue                             m_transferQueue;
 
                 bool EnumeratePhysicalDevices(VKApplication& instance, uint32_t index);
                 bool QueryPhysicalDeviceInfo();
+                bool SelectQueueFamilies();
             };
         }
     }
@@ -33,18 +33,43 @@ namespace Hatchit
     {
         namespace Vulkan
         {
+            //What device memory is used for; VKMemoryAllocator accounts every allocation under one
+            enum class VKMemoryCategory : uint32_t
+            {
+                Other,
+                Texture,
+                Mesh,
+                Attachment,
+                Uniform,
+                Staging,
+
+                Count
+            };
+
+            //A range of device memory handed out by VKMemoryAllocator
+            struct VKAllocation
+            {
+                VkDeviceMemory      memory;     //Memory the range lives in; shared with other allocations
+                VkDeviceSize        offset;     //Offset of the range inside memory
+                VkDeviceSize        size;       //Size of the range
+                void*               mapped;     //Host pointer to the range; null unless host visible
+                uint32_t            memoryType; //Memory type index
+                void*               userData;   //Handed back to defragmentation callbacks
+                VKMemoryCategory    category;   //What the range was allocated for
+            };
+
             /*
             struct UniformBlock_vk
             {
                 VkBuffer                buffer;
-                VkDeviceMemory          memory;
+                VKAllocation            allocation;
                 VkDescriptorBufferInfo  descriptor;
             };
 
             struct TexelBlock_vk
             {
                 VkBuffer                buffer;
-                VkDeviceMemory          memory;
+                VKAllocation            allocation;
                 VkBufferView            view;
             };
 
@@ -52,7 +77,7 @@ namespace Hatchit
             {
                 VkImage         image;
                 VkImageView     view;
-                VkDeviceMemory  memory;
+                VKAllocation    allocation;
             };
 
             struct Texture_vk
@@ -93,6 +118,20 @@ namespace Hatchit
                 fpAcquireNextImageKHR;
             extern PFN_vkQueuePresentKHR
                 fpQueuePresentKHR;
+
+#ifdef VK_KHR_timeline_semaphore
+            //Null unless the device enabled VK_KHR_timeline_semaphore
+            extern PFN_vkWaitSemaphoresKHR
+                fpWaitSemaphoresKHR;
+            extern PFN_vkGetSemaphoreCounterValueKHR
+                fpGetSemaphoreCounterValueKHR;
+#endif
+
+#ifdef VK_EXT_memory_budget
+            //Null unless the device enabled VK_EXT_memory_budget
+            extern PFN_vkGetPhysicalDeviceMemoryProperties2KHR
+                fpGetPhysicalDeviceMemoryProperties2KHR;
+#endif
         }
     }
 }
@@ -35,10 +35,7 @@ namespace Hatchit
         {
             D3D12GPUResourceThread::D3D12GPUResourceThread(D3D12Device* device)
             {
-                m_alive = false;
-                m_tfinished = false;
                 m_device = device;
-                m_locked = false;
             }
 
             D3D12GPUResourceThread::~D3D12GPUResourceThread()
@@ -50,7 +47,8 @@ namespace Hatchit
             {
                 m_alive = true;
 
-                m_thread = std::thread(&D3D12GPUResourceThread::thread_main, this);
+                for (uint32_t i = 0; i < m_workerCount; i++)
+                    m_threads.push_back(std::thread(&D3D12GPUResourceThread::thread_main, this));
             }
 
             void D3D12GPUResourceThread::thread_main()
@@ -58,90 +56,18 @@ namespace Hatchit
                 HRESULT hr = S_OK;
 
                 auto device = m_device->GetDevice();
-                auto queue = m_device->GetQueue();
 
                 /*Create thread specific resources*/
                 ID3D12CommandAllocator* _allocator = nullptr;
-                ID3D12GraphicsCommandList* cmdList = nullptr;
                 
                 hr = device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&_allocator));
                 if (FAILED(hr))
                 {
                     HT_ERROR_PRINTF("Failed to create command allocator in thread.\n");
-                    Kill();
+                    return;
                 }
 
-                while (m_alive)
-                {
-                    /*Load any resource requests asynchrounsly*/
-                    if (m_requests.empty())
-                        continue;
-                   
-                    auto request = m_requests.pop();
-                    switch ((*request)->type)
-                    {
-                        case GPUResourceRequest::Type::Texture:
-                        {
-                            auto tRequest = static_cast<TextureRequest*>(*request);
-
-                            ProcessTextureRequest(tRequest);
-                        } break;
-                        
-                        case GPUResourceRequest::Type::Material:
-                        {
-                            auto mRequest = static_cast<MaterialRequest*>(*request);
-
-                            ProcessMaterialRequest(mRequest);
-                        } break;
-
-                        case GPUResourceRequest::Type::RootLayout:
-                        {
-                            auto rRequest = static_cast<RootLayoutRequest*>(*request);
-
-                            ProcessRootLayoutRequest(rRequest);
-                        } break;
-
-                        case GPUResourceRequest::Type::Pipeline:
-                        {
-                            auto pRequest = static_cast<PipelineRequest*>(*request);
-
-                            ProcessPipelineRequest(pRequest);
-                        } break;
-
-                        case GPUResourceRequest::Type::Shader:
-                        {
-                            auto sRequest = static_cast<ShaderRequest*>(*request);
-
-                            ProcessShaderRequest(sRequest);
-                        } break;
-
-                        case GPUResourceRequest::Type::RenderPass:
-                        {
-                            auto sRequest = static_cast<RenderPassRequest*>(*request);
-
-                            ProcessRenderPassRequest(sRequest);
-                        } break;
-
-                        case GPUResourceRequest::Type::RenderTarget:
-                        {
-                            auto sRequest = static_cast<RenderTargetRequest*>(*request);
-
-                            ProcessRenderTargetRequest(sRequest);
-                        } break;
-
-                        case GPUResourceRequest::Type::Mesh:
-                        {
-                            auto sRequest = static_cast<MeshRequest*>(*request);
-
-                            ProcessMeshRequest(sRequest);
-                        } break;
-
-                    }
-
-                    m_processed = true;
-                    m_cv.notify_one();
-                    
-                }
+                runLoads();
 
                 ReleaseCOM(_allocator);
             }
@@ -40,10 +40,11 @@ namespace Hatchit
                 auto inputPaths = handle->GetInputTargets();
                 auto outputPaths = handle->GetOutputPaths();
 
-                for (auto path : inputPaths)
-                {
+                for (auto target : inputPaths)
+                    m_inputPaths.push_back(target.path);
 
-                }
+                for (auto path : outputPaths)
+                    m_outputPaths.push_back(path);
 
                 return false;
             }
@@ -53,7 +54,7 @@ namespace Hatchit
 
             }
 
-            bool D3D12RenderPass::VBuildCommandList(const ICommandPool* commandPool)
+            bool D3D12RenderPass::VBuildCommandList(const CommandRecordContext& context)
             {
                 return false;
             }
@@ -36,6 +36,9 @@ namespace Hatchit
                 m_renderTargetHeap = nullptr;
                 m_commandList = nullptr;
                 m_fence = nullptr;
+
+                m_frameCount = NUM_BUFFER_FRAMES;
+                m_currentFrame = 0;
             }
 
             D3D12SwapChain::~D3D12SwapChain()
@@ -147,10 +150,15 @@ namespace Hatchit
             {
             }
 
-            void D3D12SwapChain::VExecute(std::vector<RenderPassHandle> renderPasses)
+            void D3D12SwapChain::VExecute(const std::vector<RenderPassHandle>& renderPasses)
             {
             }
 
+            void D3D12SwapChain::VBeginFrame()
+            {
+                //MoveToNextFrame already waits on the next frame's fence at present
+            }
+
             void D3D12SwapChain::VSetInput(RenderPassHandle handle)
             {
             
@@ -265,6 +273,9 @@ namespace Hatchit
                 }
 
                 m_fenceValues[m_currentBuffer] = currentFenceValue + 1;
+
+                //Frame slots follow the back buffers one to one
+                m_currentFrame = m_currentBuffer;
             }
 
             void D3D12SwapChain::WaitForGpu()
@@ -0,0 +1,155 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+#include <ht_drawkey.h>     //DrawKeySorter & DrawKey
+#include <algorithm>        //std::min & std::swap
+#include <cstring>          //memcpy & memset
+
+namespace Hatchit
+{
+    namespace Graphics
+    {
+        typedef uint32_t DigitCounts[256];
+
+        //Runs job(block) for every block, spreading them across the scheduler when there's more than one
+        template<typename BlockJob>
+        static void runBlocks(uint32_t blocks, JobScheduler* scheduler, const BlockJob& job)
+        {
+            if (blocks == 1)
+            {
+                job(0);
+                return;
+            }
+
+            JobCounter counter;
+            for (uint32_t b = 0; b < blocks; b++)
+                scheduler->Schedule([&job, b](uint32_t) { job(b); }, &counter);
+
+            scheduler->Wait(&counter);
+        }
+
+        /** Packs a request's resources and depth into a sort key
+        *
+        * Ids too large for their field wrap around; requests that end up
+        * with equal keys still draw correctly, they just might not batch.
+        *
+        * \param pipeline The pipeline's sort id
+        * \param material The material's sort id
+        * \param mesh The mesh's sort id
+        * \param depth The request's view depth; negative depths sort as 0
+        * \return The packed key
+        */
+        uint64_t DrawKeySorter::MakeKey(uint32_t pipeline, uint32_t material, uint32_t mesh, float depth)
+        {
+            //Non-negative floats order the same as their bits, so the top bits make a coarse depth
+            uint32_t depthBits = 0;
+            if (depth > 0.0f)
+            {
+                memcpy(&depthBits, &depth, sizeof(depthBits));
+                depthBits >>= 31 - DepthBits;
+            }
+
+            uint64_t key = pipeline & ((1u << PipelineBits) - 1);
+            key = (key << MaterialBits) | (material & ((1u << MaterialBits) - 1));
+            key = (key << MeshBits) | (mesh & ((1u << MeshBits) - 1));
+            key = (key << DepthBits) | (depthBits & ((1u << DepthBits) - 1));
+
+            return key;
+        }
+
+        /** Sorts keys in ascending order, keeping equal keys in their original order
+        * \param keys The keys to sort; sorted in place
+        * \param scratch Room for count more keys; its contents are overwritten
+        * \param count The number of keys
+        * \param scheduler Scheduler to spread large sorts across, or nullptr to stay on this thread
+        */
+        void DrawKeySorter::Sort(DrawKey* keys, DrawKey* scratch, size_t count, JobScheduler* scheduler)
+        {
+            if (count < 2)
+                return;
+
+            //Only bytes that differ somewhere need a pass
+            uint64_t varying = 0;
+            for (size_t i = 1; i < count; i++)
+                varying |= keys[i].key ^ keys[0].key;
+
+            if (varying == 0)
+                return;
+
+            uint32_t blocks = 1;
+            if (scheduler != nullptr && count >= ParallelThreshold)
+            {
+                blocks = scheduler->GetContextCount();
+                if (blocks > MaxBlocks)
+                    blocks = MaxBlocks;
+                else if (blocks < 1)
+                    blocks = 1;
+            }
+
+            const size_t blockSize = (count + blocks - 1) / blocks;
+
+            DigitCounts counts[MaxBlocks];
+
+            DrawKey* source = keys;
+            DrawKey* destination = scratch;
+
+            for (uint32_t shift = 0; shift < 64; shift += 8)
+            {
+                if (((varying >> shift) & 0xFF) == 0)
+                    continue;
+
+                //Count each block's digits
+                runBlocks(blocks, scheduler, [&](uint32_t b)
+                {
+                    uint32_t* digits = counts[b];
+                    memset(digits, 0, sizeof(DigitCounts));
+
+                    const size_t first = b * blockSize;
+                    const size_t last = std::min(first + blockSize, count);
+                    for (size_t i = first; i < last; i++)
+                        digits[(source[i].key >> shift) & 0xFF]++;
+                });
+
+                //Turn the counts into where each block writes each digit; blocks
+                //keep their order within a digit, which keeps the sort stable
+                uint32_t offset = 0;
+                for (uint32_t d = 0; d < 256; d++)
+                {
+                    for (uint32_t b = 0; b < blocks; b++)
+                    {
+                        uint32_t digitCount = counts[b][d];
+                        counts[b][d] = offset;
+                        offset += digitCount;
+                    }
+                }
+
+                //Scatter
+                runBlocks(blocks, scheduler, [&](uint32_t b)
+                {
+                    uint32_t* digits = counts[b];
+
+                    const size_t first = b * blockSize;
+                    const size_t last = std::min(first + blockSize, count);
+                    for (size_t i = first; i < last; i++)
+                        destination[digits[(source[i].key >> shift) & 0xFF]++] = source[i];
+                });
+
+                std::swap(source, destination);
+            }
+
+            if (source != keys)
+                memcpy(keys, source, count * sizeof(DrawKey));
+        }
+    }
+}
@@ -0,0 +1,140 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+#include <ht_framearena.h>  //FrameArena
+#include <ht_debug.h>       //HT_ERROR_PRINTF
+#include <cstdlib>          //std::malloc & std::free
+
+namespace Hatchit
+{
+    namespace Graphics
+    {
+        FrameArena::FrameArena(size_t blockSize)
+        {
+            m_blockSize = blockSize;
+            m_current = 0;
+            m_offset = 0;
+            m_used = 0;
+            m_heapAllocations = 0;
+        }
+
+        FrameArena::~FrameArena()
+        {
+            releaseBlocks();
+        }
+
+        /** Takes memory out of the arena
+        * \param size The number of bytes needed
+        * \param alignment The alignment of the returned pointer; must be a power of two
+        * \return The memory, or nullptr if a new block couldn't be allocated
+        */
+        void* FrameArena::Allocate(size_t size, size_t alignment)
+        {
+            if (alignment == 0)
+                alignment = 1;
+
+            while (m_current < m_blocks.size())
+            {
+                Block& block = m_blocks[m_current];
+
+                uintptr_t address = reinterpret_cast<uintptr_t>(block.data) + m_offset;
+                uintptr_t aligned = (address + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+                size_t start = m_offset + static_cast<size_t>(aligned - address);
+
+                if (start + size <= block.size)
+                {
+                    m_offset = start + size;
+                    m_used += size;
+                    return block.data + start;
+                }
+
+                //Doesn't fit; move on to the next block rather than searching back
+                m_current++;
+                m_offset = 0;
+            }
+
+            if (!addBlock(size + alignment))
+                return nullptr;
+
+            return Allocate(size, alignment);
+        }
+
+        /** Rewinds the arena so every allocation can be reused
+        *
+        * If the last frame spilled over into more than one block they are
+        * replaced with a single block that holds all of it.
+        */
+        void FrameArena::Reset()
+        {
+            if (m_blocks.size() > 1)
+            {
+                size_t total = 0;
+                for (size_t i = 0; i < m_blocks.size(); i++)
+                    total += m_blocks[i].size;
+
+                releaseBlocks();
+                addBlock(total);
+            }
+
+            m_current = 0;
+            m_offset = 0;
+            m_used = 0;
+        }
+
+        /** Gets how much of the arena is in use
+        * \return A snapshot of the arena's stats
+        */
+        FrameArenaStats FrameArena::GetStats() const
+        {
+            FrameArenaStats stats = {};
+            stats.bytesUsed = m_used;
+            stats.blockCount = static_cast<uint32_t>(m_blocks.size());
+            stats.heapAllocations = m_heapAllocations;
+
+            for (size_t i = 0; i < m_blocks.size(); i++)
+                stats.bytesReserved += m_blocks[i].size;
+
+            return stats;
+        }
+
+        bool FrameArena::addBlock(size_t minimumSize)
+        {
+            Block block;
+            block.size = minimumSize > m_blockSize ? minimumSize : m_blockSize;
+            block.data = static_cast<uint8_t*>(std::malloc(block.size));
+            if (block.data == nullptr)
+            {
+                HT_ERROR_PRINTF("FrameArena::addBlock(): Failed to allocate %llu bytes\n", static_cast<unsigned long long>(block.size));
+                return false;
+            }
+
+            m_blocks.push_back(block);
+            m_current = m_blocks.size() - 1;
+            m_offset = 0;
+            m_heapAllocations++;
+
+            return true;
+        }
+
+        void FrameArena::releaseBlocks()
+        {
+            for (size_t i = 0; i < m_blocks.size(); i++)
+                std::free(m_blocks[i].data);
+            m_blocks.clear();
+
+            m_current = 0;
+            m_offset = 0;
+        }
+    }
+}
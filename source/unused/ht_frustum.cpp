@@ -0,0 +1,120 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+#include <ht_frustum.h>     //Frustum & BoundingSphere
+#include <cmath>            //std::sqrt
+#include <cstdint>          //uint32_t
+#include <cstring>          //memcpy
+
+namespace Hatchit
+{
+    namespace Graphics
+    {
+        static_assert(sizeof(Math::Matrix4) == 16 * sizeof(float), "Frustum expects Math::Matrix4 to be 16 packed floats");
+
+        /** Makes a frustum that contains everything
+        */
+        Frustum::Frustum()
+        {
+            for (uint32_t i = 0; i < PlaneCount; i++)
+            {
+                m_planes[i][0] = 0.0f;
+                m_planes[i][1] = 0.0f;
+                m_planes[i][2] = 0.0f;
+                m_planes[i][3] = 1.0f;
+            }
+        }
+
+        /** Makes the frustum of a camera
+        * \param view The camera's view matrix
+        * \param proj The camera's projection matrix
+        */
+        Frustum::Frustum(const Math::Matrix4& view, const Math::Matrix4& proj)
+        {
+            Set(view, proj);
+        }
+
+        /** Pulls the planes out of a camera's matrices
+        *
+        * Matrices are stored a row at a time and transform column vectors,
+        * the same way render passes are handed them.
+        *
+        * \param view The camera's view matrix
+        * \param proj The camera's projection matrix
+        */
+        void Frustum::Set(const Math::Matrix4& view, const Math::Matrix4& proj)
+        {
+            Math::Matrix4 viewProj = proj * view;
+
+            float m[16];
+            memcpy(m, &viewProj, sizeof(m));
+
+            const float* row0 = m;
+            const float* row1 = m + 4;
+            const float* row2 = m + 8;
+            const float* row3 = m + 12;
+
+            for (uint32_t i = 0; i < 4; i++)
+            {
+                m_planes[Left][i] = row3[i] + row0[i];
+                m_planes[Right][i] = row3[i] - row0[i];
+                m_planes[Bottom][i] = row3[i] + row1[i];
+                m_planes[Top][i] = row3[i] - row1[i];
+                m_planes[Near][i] = row3[i] + row2[i];
+                m_planes[Far][i] = row3[i] - row2[i];
+            }
+
+            for (uint32_t i = 0; i < PlaneCount; i++)
+            {
+                float* plane = m_planes[i];
+                float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+                if (length <= 0.0f)
+                    continue;
+
+                plane[0] /= length;
+                plane[1] /= length;
+                plane[2] /= length;
+                plane[3] /= length;
+            }
+        }
+
+        /** Tests whether any of a sphere could be seen
+        * \param sphere The sphere to test
+        * \return False only if the sphere is entirely outside one of the planes
+        */
+        bool Frustum::Intersects(const BoundingSphere& sphere) const
+        {
+            if (sphere.radius <= 0.0f)
+                return true;
+
+            for (uint32_t i = 0; i < PlaneCount; i++)
+            {
+                const float* plane = m_planes[i];
+                float distance = plane[0] * sphere.x + plane[1] * sphere.y + plane[2] * sphere.z + plane[3];
+                if (distance < -sphere.radius)
+                    return false;
+            }
+
+            return true;
+        }
+
+        /** Gets the planes, four floats each, in the order of Frustum::Plane
+        * \return A pointer to 24 floats
+        */
+        const float* Frustum::GetPlanes() const
+        {
+            return &m_planes[0][0];
+        }
+    }
+}
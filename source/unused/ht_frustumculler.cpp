@@ -0,0 +1,203 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+#include <ht_frustumculler.h>   //FrustumCuller
+
+#if defined(__AVX__)
+#include <immintrin.h>          //AVX intrinsics
+#define HT_CULL_AVX
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>          //SSE intrinsics
+#define HT_CULL_SSE
+#endif
+
+namespace Hatchit
+{
+    namespace Graphics
+    {
+#if defined(HT_CULL_AVX)
+        /** Tests eight spheres against every plane
+        *
+        * A sphere is culled when its distance to a plane is less than minus
+        * its radius. Testing for "not less than" keeps NaNs visible, the
+        * same as Frustum::Intersects.
+        *
+        * \return One bit per sphere, set if it may be visible
+        */
+        static int cullEight(const __m256 (&planes)[Frustum::PlaneCount][4], const BoundingSphereSoA& spheres, size_t i)
+        {
+            __m256 x = _mm256_loadu_ps(spheres.x + i);
+            __m256 y = _mm256_loadu_ps(spheres.y + i);
+            __m256 z = _mm256_loadu_ps(spheres.z + i);
+            __m256 radius = _mm256_loadu_ps(spheres.radius + i);
+
+            __m256 zero = _mm256_setzero_ps();
+            __m256 negRadius = _mm256_sub_ps(zero, radius);
+
+            //Spheres without a radius are never culled
+            __m256 keep = _mm256_cmp_ps(radius, zero, _CMP_LE_OQ);
+            __m256 inside = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+
+            for (uint32_t p = 0; p < Frustum::PlaneCount; p++)
+            {
+                __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planes[p][0], x), _mm256_mul_ps(planes[p][1], y)),
+                    _mm256_add_ps(_mm256_mul_ps(planes[p][2], z), planes[p][3]));
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negRadius, _CMP_NLT_UQ));
+            }
+
+            return _mm256_movemask_ps(_mm256_or_ps(keep, inside));
+        }
+#elif defined(HT_CULL_SSE)
+        /** Tests four spheres against every plane
+        *
+        * A sphere is culled when its distance to a plane is less than minus
+        * its radius. Testing for "not less than" keeps NaNs visible, the
+        * same as Frustum::Intersects.
+        *
+        * \return One bit per sphere, set if it may be visible
+        */
+        static int cullFour(const __m128 (&planes)[Frustum::PlaneCount][4], const BoundingSphereSoA& spheres, size_t i)
+        {
+            __m128 x = _mm_loadu_ps(spheres.x + i);
+            __m128 y = _mm_loadu_ps(spheres.y + i);
+            __m128 z = _mm_loadu_ps(spheres.z + i);
+            __m128 radius = _mm_loadu_ps(spheres.radius + i);
+
+            __m128 zero = _mm_setzero_ps();
+            __m128 negRadius = _mm_sub_ps(zero, radius);
+
+            //Spheres without a radius are never culled
+            __m128 keep = _mm_cmple_ps(radius, zero);
+            __m128 inside = _mm_cmpeq_ps(zero, zero);
+
+            for (uint32_t p = 0; p < Frustum::PlaneCount; p++)
+            {
+                __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes[p][0], x), _mm_mul_ps(planes[p][1], y)),
+                    _mm_add_ps(_mm_mul_ps(planes[p][2], z), planes[p][3]));
+                inside = _mm_and_ps(inside, _mm_cmpnlt_ps(distance, negRadius));
+            }
+
+            return _mm_movemask_ps(_mm_or_ps(keep, inside));
+        }
+#endif
+
+        /** Culls the spheres in [begin, end)
+        * \return How many of them may be visible
+        */
+        static size_t cullRange(const Frustum& frustum, const BoundingSphereSoA& spheres, size_t begin, size_t end, uint8_t* visible)
+        {
+            size_t visibleCount = 0;
+            size_t i = begin;
+
+#if defined(HT_CULL_AVX) || defined(HT_CULL_SSE)
+            const float* planeData = frustum.GetPlanes();
+
+#if defined(HT_CULL_AVX)
+            __m256 planes[Frustum::PlaneCount][4];
+            for (uint32_t p = 0; p < Frustum::PlaneCount; p++)
+                for (uint32_t c = 0; c < 4; c++)
+                    planes[p][c] = _mm256_set1_ps(planeData[p * 4 + c]);
+#else
+            __m128 planes[Frustum::PlaneCount][4];
+            for (uint32_t p = 0; p < Frustum::PlaneCount; p++)
+                for (uint32_t c = 0; c < 4; c++)
+                    planes[p][c] = _mm_set1_ps(planeData[p * 4 + c]);
+#endif
+
+            for (; i + FrustumCuller::Width <= end; i += FrustumCuller::Width)
+            {
+#if defined(HT_CULL_AVX)
+                int mask = cullEight(planes, spheres, i);
+#else
+                int mask = cullFour(planes, spheres, i) | (cullFour(planes, spheres, i + 4) << 4);
+#endif
+
+                for (uint32_t k = 0; k < FrustumCuller::Width; k++)
+                {
+                    uint8_t bit = static_cast<uint8_t>((mask >> k) & 1);
+                    visible[i + k] = bit;
+                    visibleCount += bit;
+                }
+            }
+#endif
+
+            //Whatever doesn't fill a whole iteration
+            for (; i < end; i++)
+            {
+                BoundingSphere sphere = { spheres.x[i], spheres.y[i], spheres.z[i], spheres.radius[i] };
+                visible[i] = frustum.Intersects(sphere) ? 1 : 0;
+                visibleCount += visible[i];
+            }
+
+            return visibleCount;
+        }
+
+        /** Tests every sphere against a frustum
+        * \param frustum The frustum to test against
+        * \param spheres The spheres, one array per component
+        * \param count How many spheres there are
+        * \param visible Room for count flags; each is set to 1 if its sphere may be visible and 0 if not
+        * \param scheduler Scheduler to spread large batches across, or nullptr to stay on this thread
+        * \return How many spheres may be visible
+        */
+        size_t FrustumCuller::Cull(const Frustum& frustum, const BoundingSphereSoA& spheres, size_t count,
+            uint8_t* visible, JobScheduler* scheduler)
+        {
+            if (count == 0)
+                return 0;
+
+            uint32_t blocks = 1;
+            if (scheduler != nullptr && count >= ParallelThreshold)
+            {
+                blocks = scheduler->GetContextCount();
+                if (blocks > MaxBlocks)
+                    blocks = MaxBlocks;
+                if (blocks == 0)
+                    blocks = 1;
+            }
+
+            if (blocks == 1)
+                return cullRange(frustum, spheres, 0, count, visible);
+
+            //Blocks start on whole iterations so only the last one has a scalar tail
+            const size_t width = Width;
+            size_t blockSize = (count + blocks - 1) / blocks;
+            blockSize = ((blockSize + width - 1) / width) * width;
+
+            size_t visibleCounts[MaxBlocks] = {};
+
+            JobCounter counter;
+            for (uint32_t b = 0; b < blocks; b++)
+            {
+                size_t begin = b * blockSize;
+                if (begin >= count)
+                    break;
+
+                size_t end = begin + blockSize < count ? begin + blockSize : count;
+                scheduler->Schedule([&frustum, &spheres, &visibleCounts, visible, begin, end, b](uint32_t)
+                {
+                    visibleCounts[b] = cullRange(frustum, spheres, begin, end, visible);
+                }, &counter);
+            }
+
+            scheduler->Wait(&counter);
+
+            size_t visibleCount = 0;
+            for (uint32_t b = 0; b < blocks; b++)
+                visibleCount += visibleCounts[b];
+
+            return visibleCount;
+        }
+    }
+}
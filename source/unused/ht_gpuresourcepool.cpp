@@ -309,20 +309,23 @@ namespace Hatchit
         *   \brief Function requests the GPUResourcePool to process an async texture load request.
         *   \param file Path of texture file to load.
         *   \param data Pointer to the base texture implementation to fill.
+        *   \param priority Whether the frame needs it or it is only a prefetch.
+        *   \return An id that may be passed to CancelRequest.
         *
         *   This function requests the GPUResourcePool to process an asynchronous texture
         *   load request. Calling this function will NOT block the main thread.
         */
-        void GPUResourcePool::RequestTextureAsync(std::string file, void** data)
+        uint64_t GPUResourcePool::RequestTextureAsync(std::string file, void** data, GPUResourceRequest::Priority priority)
         {
             GPUResourcePool& instance = GPUResourcePool::instance();
 
             TextureRequest* request = new TextureRequest;
             request->file = file;
             request->data = data;
+            request->priority = priority;
             request->type = GPUResourceRequest::Type::Texture;
 
-            instance.m_thread->LoadAsync(request);
+            return instance.m_thread->LoadAsync(request);
         }
 
         /**
@@ -330,20 +333,23 @@ namespace Hatchit
         *   \brief Function requests the GPUResourcePool to process an async material load request.
         *   \param file Path to material file to load.
         *   \param data Pointer to the base material implementation to fill.
+        *   \param priority Whether the frame needs it or it is only a prefetch.
+        *   \return An id that may be passed to CancelRequest.
         *
         *   This function requests the GPUResourcePool to process an asynchronous material
         *   load request. Calling this function will NOT block the main thread. 
         */
-        void GPUResourcePool::RequestMaterialAsync(std::string file, void** data)
+        uint64_t GPUResourcePool::RequestMaterialAsync(std::string file, void** data, GPUResourceRequest::Priority priority)
         {
             GPUResourcePool& instance = GPUResourcePool::instance();
 
             MaterialRequest* request = new MaterialRequest;
             request->file = file;
             request->data = data;
+            request->priority = priority;
             request->type = GPUResourceRequest::Type::Material;
 
-            instance.m_thread->LoadAsync(request);
+            return instance.m_thread->LoadAsync(request);
         }
 
         /**
@@ -351,20 +357,23 @@ namespace Hatchit
         *   \brief Function requests the GPUResourcePool to process an async rootlayout load request.
         *   \param file Path to the rootlayout file to load.
         *   \param data Pointer to the base rootlayout implementation to fill.
+        *   \param priority Whether the frame needs it or it is only a prefetch.
+        *   \return An id that may be passed to CancelRequest.
         *
         *   This function requests the GPUResourcePool to process an asynchronous rootlayout
         *   load request. Calling this function will NOT block the main thread.
         */
-        void GPUResourcePool::RequestRootLayoutAsync(std::string file, void** data)
+        uint64_t GPUResourcePool::RequestRootLayoutAsync(std::string file, void** data, GPUResourceRequest::Priority priority)
         {
             GPUResourcePool& instance = GPUResourcePool::instance();
 
             RootLayoutRequest* request = new RootLayoutRequest;
             request->file = file;
             request->data = data;
+            request->priority = priority;
             request->type = GPUResourceRequest::Type::RootLayout;
 
-            instance.m_thread->LoadAsync(request);
+            return instance.m_thread->LoadAsync(request);
         }
 
         /**
@@ -372,11 +381,13 @@ namespace Hatchit
         *   \brief Function requests the GPUResourcePool to process an async pipeline load request.
         *   \param file Path to the pipeline file to load.
         *   \param data Pointer to the base pipeline implementation to fill.
+        *   \param priority Whether the frame needs it or it is only a prefetch.
+        *   \return An id that may be passed to CancelRequest.
         *
         *   This function requests the GPUResourcePool to process an asynchronous pipeline
         *   load request. Calling this function will NOT block the main thread.
         */
-        void GPUResourcePool::RequestPipelineAsync(std::string file, void** data)
+        uint64_t GPUResourcePool::RequestPipelineAsync(std::string file, void** data, GPUResourceRequest::Priority priority)
         {
             GPUResourcePool& instance = GPUResourcePool::instance();
 
@@ -384,8 +395,9 @@ namespace Hatchit
             request->file = file;
             request->type = GPUResourceRequest::Type::Pipeline;
             request->data = data;
+            request->priority = priority;
 
-            instance.m_thread->LoadAsync(request);
+            return instance.m_thread->LoadAsync(request);
         }
 
         /**
@@ -393,11 +405,13 @@ namespace Hatchit
         *   \brief Function requests the GPUResourcePool to process an async shader load request.
         *   \param file Path to the shader file to load.
         *   \param data Pointer to the base shader implementation to fill.
+        *   \param priority Whether the frame needs it or it is only a prefetch.
+        *   \return An id that may be passed to CancelRequest.
         *
         *   This function requests the GPUResourcePool to process an asynchronous shader
         *   load request. Calling this function will NOT block the main thread.
         */
-        void GPUResourcePool::RequestShaderAsync(std::string file, void** data)
+        uint64_t GPUResourcePool::RequestShaderAsync(std::string file, void** data, GPUResourceRequest::Priority priority)
         {
             GPUResourcePool& instance = GPUResourcePool::instance();
 
@@ -405,8 +419,9 @@ namespace Hatchit
             request->file = file;
             request->type = GPUResourceRequest::Type::Shader;
             request->data = data;
+            request->priority = priority;
 
-            instance.m_thread->LoadAsync(request);
+            return instance.m_thread->LoadAsync(request);
         }
 
         /**
@@ -414,11 +429,13 @@ namespace Hatchit
         *   \brief Function requests the GPUResourcePool to process an async renderpass load request.
         *   \param file Path to renderpass file to load.
         *   \param data Pointer to the base renderpass implementation to fill.
+        *   \param priority Whether the frame needs it or it is only a prefetch.
+        *   \return An id that may be passed to CancelRequest.
         *
         *   This function requests the GPUResourcePool to process an asynchronous shader
         *   load request. Calling this function will NOT block the main thread.
         */
-        void GPUResourcePool::RequestRenderPassAsync(std::string file, void** data)
+        uint64_t GPUResourcePool::RequestRenderPassAsync(std::string file, void** data, GPUResourceRequest::Priority priority)
         {
             GPUResourcePool& instance = GPUResourcePool::instance();
 
@@ -426,8 +443,9 @@ namespace Hatchit
             request->file = file;
             request->type = GPUResourceRequest::Type::RenderPass;
             request->data = data;
+            request->priority = priority;
 
-            instance.m_thread->LoadAsync(request);
+            return instance.m_thread->LoadAsync(request);
         }
 
         /**
@@ -435,11 +453,13 @@ namespace Hatchit
         *   \brief Function requests the GPUResourcePool to process an async rendertarget load request.
         *   \param file Path to the renderpass file to load.
         *   \param data Pointer to the base rendertarget implementation to fill.
+        *   \param priority Whether the frame needs it or it is only a prefetch.
+        *   \return An id that may be passed to CancelRequest.
         *
         *   This function requests the GPUResourcePool to process an asynchronous rendertarget
         *   load request. Calling this function will NOT block the main thread.
         */
-        void GPUResourcePool::RequestRenderTargetAsync(std::string file, void** data)
+        uint64_t GPUResourcePool::RequestRenderTargetAsync(std::string file, void** data, GPUResourceRequest::Priority priority)
         {
             GPUResourcePool& instance = GPUResourcePool::instance();
 
@@ -447,8 +467,9 @@ namespace Hatchit
             request->file = file;
             request->type = GPUResourceRequest::Type::RenderTarget;
             request->data = data;
+            request->priority = priority;
 
-            instance.m_thread->LoadAsync(request);
+            return instance.m_thread->LoadAsync(request);
         }
 
         /**
@@ -456,11 +477,13 @@ namespace Hatchit
         *   \brief Function requests the GPUResourcePool to process an async mesh load request.
         *   \param file Path to the mesh file to load
         *   \param data Pointer to the base mesh implementation to fill.
+        *   \param priority Whether the frame needs it or it is only a prefetch.
+        *   \return An id that may be passed to CancelRequest.
         *
         *   This function requests the GPUResourcePool to process an asynchronous mesh
         *   load request. Calling this function will NOT block the main thread.
         */
-        void GPUResourcePool::RequestMeshAsync(std::string file, void** data)
+        uint64_t GPUResourcePool::RequestMeshAsync(std::string file, void** data, GPUResourceRequest::Priority priority)
         {
             GPUResourcePool& instance = GPUResourcePool::instance();
 
@@ -468,8 +491,25 @@ namespace Hatchit
             request->file = file;
             request->type = GPUResourceRequest::Type::Mesh;
             request->data = data;
+            request->priority = priority;
 
-            instance.m_thread->LoadAsync(request);
+            return instance.m_thread->LoadAsync(request);
+        }
+
+        /**
+        *   \fn GPUResourcePool::CancelRequest()
+        *   \brief Function cancels an async load request.
+        *   \param id The id returned by one of the async request functions.
+        *   \return True if the request will not be processed.
+        *
+        *   Requests still waiting in the queue are dropped. A request that is
+        *   already being created can't be stopped.
+        */
+        bool GPUResourcePool::CancelRequest(uint64_t id)
+        {
+            GPUResourcePool& instance = GPUResourcePool::instance();
+
+            return instance.m_thread->Cancel(id);
         }
 
         /**
@@ -647,6 +687,43 @@ namespace Hatchit
 
             instance.m_thread->CreateMesh(file, data);
         }
+
+        /**
+        *   \fn GPUResourcePool::SetResidencyCallback()
+        *   \brief Sets the function told when a resource is evicted or made resident again.
+        *   \param callback The function to call; an empty function stops the calls.
+        *
+        *   The callback may be called from the render thread while a frame begins,
+        *   or from whichever thread draws an evicted mesh. It must not block.
+        */
+        void GPUResourcePool::SetResidencyCallback(ResidencyCallback callback)
+        {
+            GPUResourcePool& instance = GPUResourcePool::instance();
+
+            std::lock_guard<std::mutex> lock(instance.m_residencyMutex);
+            instance.m_residencyCallback = callback;
+        }
+
+        /**
+        *   \fn GPUResourcePool::NotifyResidency()
+        *   \brief Tells the residency callback that a resource moved in or out of GPU memory.
+        *   \param type The kind of resource.
+        *   \param base The base implementation the resource was loaded into.
+        *   \param resident False if the resource was evicted; true if it is fully back.
+        */
+        void GPUResourcePool::NotifyResidency(GPUResourceRequest::Type type, void* base, bool resident)
+        {
+            GPUResourcePool& instance = GPUResourcePool::instance();
+
+            ResidencyCallback callback;
+            {
+                std::lock_guard<std::mutex> lock(instance.m_residencyMutex);
+                callback = instance.m_residencyCallback;
+            }
+
+            if (callback)
+                callback(type, base, resident);
+        }
         
      
     }
@@ -14,6 +14,7 @@
 **/
 
 #include <ht_gpuresourcethread.h>
+#include <ht_debug.h>
 
 #include <ht_texture_resource.h>
 #include <ht_material_resource.h>
@@ -26,76 +27,212 @@ namespace Hatchit
     namespace Graphics
     {
 
+        //The loader pool the current thread works for, if any
+        static thread_local const GPUResourceThread* t_loader = nullptr;
+
+        GPUResourceThread::GPUResourceThread()
+        {
+            m_alive = false;
+            m_nextID = 1;
+
+            //Loaders spend most of their time waiting on the disk, so a few are
+            //enough and we leave the rest of the cores to the render jobs
+            m_workerCount = std::thread::hardware_concurrency() / 4;
+            if (m_workerCount < 1)
+                m_workerCount = 1;
+            if (m_workerCount > 4)
+                m_workerCount = 4;
+        }
+
         /**
         *   \fn GPUResourceThread::Locked()
-        *   \brief Function returns if thread is locked.
-        *   \return m_locked True if thread is locked, otherwise false.
+        *   \brief Function returns if the calling thread is one of the loader threads.
+        *   \return True if called from a loader thread, otherwise false.
         *
-        *   The function returns true if the thread is currently in a locked state,
-        *   otherwise it returns false.
-        *   
-        *   NOTE: A GPUResourceThread is usually in a locked state due to a non-async
-        *   resource request.
+        *   Resources that load other resources while they are being created
+        *   use this to create the nested resource directly instead of queueing
+        *   a request and blocking a loader on it.
         */
         bool GPUResourceThread::Locked() const
         {
-            return m_locked;
+            return t_loader == this;
         }
 
-
         /**
         *   \fn GPUResourceThread::Load()
         *   \brief Function processes a non-async GPUResourceRequest
         *   \param request Pointer to GPUResourceRequest object
         *
         *   This function will process a GPUResourceRequest non-asynchronously
-        *   by pushing the request onto the request stack and then blocking the main thread
-        *   for processing.
+        *   by queueing the request at frame priority and then blocking the calling
+        *   thread until a loader has processed it. If the same file is already
+        *   queued as a prefetch, that load is promoted instead. The request is
+        *   deleted once it has been processed.
         */
         void GPUResourceThread::Load(GPUResourceRequest* request)
         {
-            if (!m_alive)
-                VStart();
+            if (Locked())
+            {
+                //Blocking one loader on another could starve the pool
+                ProcessRequest(request);
+                delete request;
+                return;
+            }
 
-            m_processed = false;
+            if (!start())
+            {
+                HT_ERROR_PRINTF("GPUResourceThread::Load(): Loader threads failed to start!\n");
+                delete request;
+                return;
+            }
 
-            m_requests.push(request);
+            request->priority = GPUResourceRequest::Priority::Frame;
+            request->blocking = true;
 
             std::unique_lock<std::mutex> lock(m_mutex);
-            while(!m_processed)
-                m_cv.wait(lock, [this]() -> bool { m_locked = true;  return this->m_processed; });
-            
-            m_locked = false;
+            enqueue(request);
+            m_finished.wait(lock, [request]() -> bool { return request->finished; });
+
+            lock.unlock();
+            delete request;
         }
 
         /**
         *   \fn GPUResourceThread::LoadAsync()
         *   \brief Function processes an async GPUResourceRequest
         *   \param request Pointer to GPUResourceRequet object
+        *   \return An id that may be passed to Cancel, or 0 if the request was dropped
         *
         *   This function will process a GPUResourceRequest asynchronously
-        *   by pushing the request onto the request stack. It does NOT
-        *   block the main thread, but loads asynchronously instead.
+        *   by queueing it at its own priority. It does NOT block the calling
+        *   thread. The thread takes ownership of the request.
         */
-        void GPUResourceThread::LoadAsync(GPUResourceRequest* request)
+        uint64_t GPUResourceThread::LoadAsync(GPUResourceRequest* request)
         {
-            if (!m_alive)
-                VStart();
+            if (!start())
+            {
+                HT_ERROR_PRINTF("GPUResourceThread::LoadAsync(): Loader threads failed to start!\n");
+                delete request;
+                return 0;
+            }
+
+            request->blocking = false;
 
-            m_requests.push(request);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return enqueue(request);
+        }
+
+        /**
+        *   \fn GPUResourceThread::Cancel()
+        *   \brief Function cancels an async GPUResourceRequest
+        *   \param id The id returned by LoadAsync
+        *   \return True if the request will not be processed.
+        *
+        *   A request that is still queued is dropped. If a worker has already
+        *   picked up the load, requests sharing it that haven't been processed
+        *   yet are skipped, but the one being created can't be stopped.
+        */
+        bool GPUResourceThread::Cancel(uint64_t id)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            auto ticket = m_tickets.find(id);
+            if (ticket == m_tickets.end())
+                return false;
+
+            PendingLoad* load = ticket->second;
+            m_tickets.erase(ticket);
+
+            for (size_t i = 0; i < load->requests.size(); i++)
+            {
+                GPUResourceRequest* request = load->requests[i];
+                if (request->id != id)
+                    continue;
+
+                if (load->started)
+                {
+                    //The worker walks the request list in order; once it
+                    //has picked a request up there's no stopping it
+                    if (i < load->next)
+                        return false;
+
+                    request->cancelled = true;
+                    return true;
+                }
+
+                load->requests.erase(load->requests.begin() + i);
+                delete request;
+                break;
+            }
+
+            if (load->requests.empty())
+            {
+                std::deque<PendingLoad*>& queue = m_queues[static_cast<size_t>(load->priority)];
+                for (size_t i = 0; i < queue.size(); i++)
+                {
+                    if (queue[i] == load)
+                    {
+                        queue.erase(queue.begin() + i);
+                        break;
+                    }
+                }
+
+                m_loads.erase(load->key);
+                delete load;
+            }
+
+            return true;
         }
 
         /**
         *   \fn GPUResourceThread::Kill()
-        *   \brief Function kills the thread
+        *   \brief Function kills the loader threads
         *
-        *   This function will kill the thread and join until finished.
+        *   This function will wake and join every loader thread. Loads that are
+        *   already running finish first. Anything still queued is dropped and
+        *   threads blocked in Load are released.
         */
         void GPUResourceThread::Kill()
         {
-            m_alive = false;
-            if (m_thread.joinable())
-                m_thread.join();
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_alive = false;
+            }
+            m_cv.notify_all();
+
+            for (size_t i = 0; i < m_threads.size(); i++)
+            {
+                if (m_threads[i].joinable())
+                    m_threads[i].join();
+            }
+            m_threads.clear();
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (size_t i = 0; i < 2; i++)
+            {
+                for (size_t j = 0; j < m_queues[i].size(); j++)
+                {
+                    PendingLoad* load = m_queues[i][j];
+                    for (size_t k = 0; k < load->requests.size(); k++)
+                        finishRequest(load->requests[k]);
+                    delete load;
+                }
+                m_queues[i].clear();
+            }
+            m_loads.clear();
+            m_tickets.clear();
+
+            m_finished.notify_all();
+        }
+
+        /**
+        *   \fn GPUResourceThread::GetWorkerCount()
+        *   \brief Function returns the number of loader threads.
+        *   \return The number of loader threads started by VStart.
+        */
+        uint32_t GPUResourceThread::GetWorkerCount() const
+        {
+            return m_workerCount;
         }
 
         /**
@@ -110,6 +247,7 @@ namespace Hatchit
         {
             Resource::TextureHandle handle = Resource::Texture::GetHandle(file, file);
 
+            std::lock_guard<std::recursive_mutex> lock(m_createMutex);
             VCreateTextureBase(handle, data);
         }
         
@@ -125,6 +263,7 @@ namespace Hatchit
         {
             Resource::MaterialHandle handle = Resource::Material::GetHandle(file, file);
 
+            std::lock_guard<std::recursive_mutex> lock(m_createMutex);
             VCreateMaterialBase(handle, data);
         }
 
@@ -140,6 +279,7 @@ namespace Hatchit
         {
             Resource::RootLayoutHandle handle = Resource::RootLayout::GetHandle(file, file);
 
+            std::lock_guard<std::recursive_mutex> lock(m_createMutex);
             VCreateRootLayoutBase(handle, data);
         }
 
@@ -155,6 +295,7 @@ namespace Hatchit
         {
             Resource::PipelineHandle handle = Resource::Pipeline::GetHandle(file, file);
 
+            std::lock_guard<std::recursive_mutex> lock(m_createMutex);
             VCreatePipelineBase(handle, data);
         }
 
@@ -170,6 +311,7 @@ namespace Hatchit
         {
             Resource::ShaderHandle handle = Resource::Shader::GetHandle(file, file);
 
+            std::lock_guard<std::recursive_mutex> lock(m_createMutex);
             VCreateShaderBase(handle, data);
         }
 
@@ -185,6 +327,7 @@ namespace Hatchit
         {
             Resource::RenderPassHandle handle = Resource::RenderPass::GetHandle(file, file);
 
+            std::lock_guard<std::recursive_mutex> lock(m_createMutex);
             VCreateRenderPassBase(handle, data);
         }
 
@@ -200,6 +343,7 @@ namespace Hatchit
         {
             Resource::RenderTargetHandle handle = Resource::RenderTarget::GetHandle(file, file);
 
+            std::lock_guard<std::recursive_mutex> lock(m_createMutex);
             VCreateRenderTargetBase(handle, data);
         }
 
@@ -215,6 +359,7 @@ namespace Hatchit
         {
             Resource::ModelHandle handle = Resource::Model::GetHandle(file, file);
 
+            std::lock_guard<std::recursive_mutex> lock(m_createMutex);
             VCreateMeshBase(handle, data);
         }
 
@@ -224,23 +369,14 @@ namespace Hatchit
         *   \brief Function processes a texture request
         *   \param request Pointer to TextureRequest.
         *
-        *   This function will process a TextureRequest and create the texture
-        *   either non-async or async depending on the state of the GPU resource thread.
+        *   This function will process a TextureRequest and create the texture.
         */
         void GPUResourceThread::ProcessTextureRequest(TextureRequest * request)
         {
             Resource::TextureHandle handle = Resource::Texture::GetHandle(request->file, request->file);
-            if (!m_locked)
-            {
-                HT_DEBUG_PRINTF("Async texture load.\n");
 
-            }
-            else
-            {
-                HT_DEBUG_PRINTF("Non-Async texture load.\n");
-
-                VCreateTextureBase(handle, request->data);
-            }
+            std::lock_guard<std::recursive_mutex> lock(m_createMutex);
+            VCreateTextureBase(handle, request->data);
         }
 
         /**
@@ -248,23 +384,14 @@ namespace Hatchit
         *   \brief Function processes a material request
         *   \param request Pointer to MaterialRequest.
         *
-        *   This function will process a MaterialRequest and create the material
-        *   either non-async or async depending on the state of the GPU resource thread.
+        *   This function will process a MaterialRequest and create the material.
         */
         void GPUResourceThread::ProcessMaterialRequest(MaterialRequest * request)
         {
             Resource::MaterialHandle handle = Resource::Material::GetHandle(request->file, request->file);
-            if (!m_locked)
-            {
-                HT_DEBUG_PRINTF("Async material load.\n");
-
-            }
-            else
-            {
-                HT_DEBUG_PRINTF("Non-Async material load.\n");
 
-                VCreateMaterialBase(handle, request->data);
-            }
+            std::lock_guard<std::recursive_mutex> lock(m_createMutex);
+            VCreateMaterialBase(handle, request->data);
         }
 
         /**
@@ -272,22 +399,14 @@ namespace Hatchit
         *   \brief Function processes a rootlayout request
         *   \param request Pointer to RootLayoutRequest.
         *
-        *   This function will process a RootLayoutRequest and create the rootlayout
-        *   either non-async or asycn depending on the state of the GPU resource thread.
+        *   This function will process a RootLayoutRequest and create the rootlayout.
         */
         void GPUResourceThread::ProcessRootLayoutRequest(RootLayoutRequest * request)
         {
             Resource::RootLayoutHandle handle = Resource::RootLayout::GetHandle(request->file, request->file);
-            if (!m_locked)
-            {
-                HT_DEBUG_PRINTF("Async rootlayout load.\n");
-            }
-            else
-            {
-                HT_DEBUG_PRINTF("Non-async rootlayout load.\n");
 
-                VCreateRootLayoutBase(handle, request->data);
-            }
+            std::lock_guard<std::recursive_mutex> lock(m_createMutex);
+            VCreateRootLayoutBase(handle, request->data);
         }
 
         /**
@@ -295,22 +414,14 @@ namespace Hatchit
         *   \brief Function processes a pipeline request
         *   \param request Pointer to PipelineRequest
         *
-        *   This function will process a PipelineRequst and create the pipeline
-        *   either non-async or asycn depending on the state of the GPU resource thread.
+        *   This function will process a PipelineRequst and create the pipeline.
         */
         void GPUResourceThread::ProcessPipelineRequest(PipelineRequest * request)
         {
             Resource::PipelineHandle handle = Resource::Pipeline::GetHandle(request->file, request->file);
-            if (!m_locked)
-            {
-                HT_DEBUG_PRINTF("Async pipeline load.\n");
-            }
-            else
-            {
-                HT_DEBUG_PRINTF("Non-async pipeline load.\n");
 
-                VCreatePipelineBase(handle, request->data);
-            }
+            std::lock_guard<std::recursive_mutex> lock(m_createMutex);
+            VCreatePipelineBase(handle, request->data);
         }
 
         /**
@@ -318,22 +429,14 @@ namespace Hatchit
         *   \brief Function processes a shader request
         *   \param request Pointer to ShaderRequest
         *
-        *   This function will process a ShaderRequest and create the shader
-        *   either non-async or async depending on the state of the GPU resource thread.
+        *   This function will process a ShaderRequest and create the shader.
         */
         void GPUResourceThread::ProcessShaderRequest(ShaderRequest * request)
         {
             Resource::ShaderHandle handle = Resource::Shader::GetHandle(request->file, request->file);
-            if (!m_locked)
-            {
-                HT_DEBUG_PRINTF("Async shader load.\n");
-            }
-            else
-            {
-                HT_DEBUG_PRINTF("Non-async shader load.\n");
 
-                VCreateShaderBase(handle, request->data);
-            }
+            std::lock_guard<std::recursive_mutex> lock(m_createMutex);
+            VCreateShaderBase(handle, request->data);
         }
 
         /**
@@ -341,22 +444,14 @@ namespace Hatchit
         *   \brief Function processes a renderpass request
         *   \param request Pointer to RenderPassRequest
         *
-        *   This function will process a RenderPassRequest and create the renderpass
-        *   either non-async or async depending on the state of the GPU resource thread.
+        *   This function will process a RenderPassRequest and create the renderpass.
         */
         void GPUResourceThread::ProcessRenderPassRequest(RenderPassRequest* request)
         {
             Resource::RenderPassHandle handle = Resource::RenderPass::GetHandle(request->file, request->file);
-            if (!m_locked)
-            {
-                HT_DEBUG_PRINTF("Async render pass load.\n");
-            }
-            else
-            {
-                HT_DEBUG_PRINTF("Non-async render pass load.\n");
 
-                VCreateRenderPassBase(handle, request->data);
-            }
+            std::lock_guard<std::recursive_mutex> lock(m_createMutex);
+            VCreateRenderPassBase(handle, request->data);
         }
         
         /**
@@ -364,22 +459,14 @@ namespace Hatchit
         *   \brief Function processes a rendertarget request
         *   \param request Pointer to RenderTargetRequest
         *
-        *   This function will process a RenderTargetRequest and create the rendertarget
-        *   either non-async or async depending on the state of the GPU resource thread.
+        *   This function will process a RenderTargetRequest and create the rendertarget.
         */
         void GPUResourceThread::ProcessRenderTargetRequest(RenderTargetRequest* request)
         {
             Resource::RenderTargetHandle handle = Resource::RenderTarget::GetHandle(request->file, request->file);
-            if (!m_locked)
-            {
-                HT_DEBUG_PRINTF("Async render target load.\n");
-            }
-            else
-            {
-                HT_DEBUG_PRINTF("Non-async render target load.\n");
 
-                VCreateRenderTargetBase(handle, request->data);
-            }
+            std::lock_guard<std::recursive_mutex> lock(m_createMutex);
+            VCreateRenderTargetBase(handle, request->data);
         }
 
         /**
@@ -387,22 +474,208 @@ namespace Hatchit
         *   \brief Function processes a mesh request
         *   \param request Pointer to MeshRequest
         *
-        *   This function will process a MeshRequest and create the mesh
-        *   either non-async or async depending on the state of the GPU resource thread.
+        *   This function will process a MeshRequest and create the mesh.
         */
         void GPUResourceThread::ProcessMeshRequest(MeshRequest* request)
         {
             Resource::ModelHandle handle = Resource::Model::GetHandle(request->file, request->file);
-            if (!m_locked)
+
+            std::lock_guard<std::recursive_mutex> lock(m_createMutex);
+            VCreateMeshBase(handle, request->data);
+        }
+
+        /**
+        *   \fn GPUResourceThread::ProcessRequest()
+        *   \brief Function processes any GPUResourceRequest
+        *   \param request Pointer to GPUResourceRequest
+        *
+        *   This function will hand the request to the Process function
+        *   matching its type.
+        */
+        void GPUResourceThread::ProcessRequest(GPUResourceRequest* request)
+        {
+            switch (request->type)
+            {
+                case GPUResourceRequest::Type::Texture:
+                    ProcessTextureRequest(static_cast<TextureRequest*>(request));
+                    break;
+
+                case GPUResourceRequest::Type::Material:
+                    ProcessMaterialRequest(static_cast<MaterialRequest*>(request));
+                    break;
+
+                case GPUResourceRequest::Type::RootLayout:
+                    ProcessRootLayoutRequest(static_cast<RootLayoutRequest*>(request));
+                    break;
+
+                case GPUResourceRequest::Type::Pipeline:
+                    ProcessPipelineRequest(static_cast<PipelineRequest*>(request));
+                    break;
+
+                case GPUResourceRequest::Type::Shader:
+                    ProcessShaderRequest(static_cast<ShaderRequest*>(request));
+                    break;
+
+                case GPUResourceRequest::Type::RenderPass:
+                    ProcessRenderPassRequest(static_cast<RenderPassRequest*>(request));
+                    break;
+
+                case GPUResourceRequest::Type::RenderTarget:
+                    ProcessRenderTargetRequest(static_cast<RenderTargetRequest*>(request));
+                    break;
+
+                case GPUResourceRequest::Type::Mesh:
+                    ProcessMeshRequest(static_cast<MeshRequest*>(request));
+                    break;
+            }
+        }
+
+        /**
+        *   \fn GPUResourceThread::runLoads()
+        *   \brief Function runs the loader loop of a worker thread
+        *
+        *   Backends call this from their worker threads once any thread specific
+        *   resources exist. It sleeps until a load is queued and returns once the
+        *   thread has been killed.
+        */
+        void GPUResourceThread::runLoads()
+        {
+            t_loader = this;
+
+            while (PendingLoad* load = nextLoad())
+                finishLoad(load);
+
+            t_loader = nullptr;
+        }
+
+        /*
+            Private Methods
+        */
+
+        bool GPUResourceThread::start()
+        {
+            std::lock_guard<std::mutex> lock(m_startMutex);
+            if (!m_alive)
+                VStart();
+
+            return m_alive;
+        }
+
+        uint64_t GPUResourceThread::enqueue(GPUResourceRequest* request)
+        {
+            request->id = m_nextID++;
+
+            LoadKey key(request->type, request->file);
+
+            PendingLoad* load = nullptr;
+            auto it = m_loads.find(key);
+            if (it != m_loads.end())
             {
-                HT_DEBUG_PRINTF("Async mesh load.\n");
+                //Someone already asked for this file; share their load
+                load = it->second;
+                load->requests.push_back(request);
+
+                if (!load->started && request->priority > load->priority)
+                {
+                    std::deque<PendingLoad*>& queue = m_queues[static_cast<size_t>(load->priority)];
+                    for (size_t i = 0; i < queue.size(); i++)
+                    {
+                        if (queue[i] == load)
+                        {
+                            queue.erase(queue.begin() + i);
+                            break;
+                        }
+                    }
+
+                    load->priority = request->priority;
+                    m_queues[static_cast<size_t>(load->priority)].push_back(load);
+                    m_cv.notify_one();
+                }
             }
             else
             {
-                HT_DEBUG_PRINTF("Non-async mesh load.\n");
+                load = new PendingLoad;
+                load->key = key;
+                load->priority = request->priority;
+                load->started = false;
+                load->next = 0;
+                load->requests.push_back(request);
+
+                m_loads[key] = load;
+                m_queues[static_cast<size_t>(load->priority)].push_back(load);
+                m_cv.notify_one();
+            }
+
+            if (!request->blocking)
+                m_tickets[request->id] = load;
+
+            return request->id;
+        }
+
+        GPUResourceThread::PendingLoad* GPUResourceThread::nextLoad()
+        {
+            std::deque<PendingLoad*>& frame = m_queues[static_cast<size_t>(GPUResourceRequest::Priority::Frame)];
+            std::deque<PendingLoad*>& prefetch = m_queues[static_cast<size_t>(GPUResourceRequest::Priority::Prefetch)];
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock, [&]() -> bool { return !m_alive || !frame.empty() || !prefetch.empty(); });
+
+            if (!m_alive)
+                return nullptr;
+
+            std::deque<PendingLoad*>& queue = frame.empty() ? prefetch : frame;
+
+            PendingLoad* load = queue.front();
+            queue.pop_front();
+            load->started = true;
+
+            return load;
+        }
+
+        void GPUResourceThread::finishLoad(PendingLoad* load)
+        {
+            //The first request does the actual loading. Any request that joined it
+            //finds the resource already cached and only creates its own GPU object,
+            //which is skipped entirely when it points at the same base.
+            while (true)
+            {
+                GPUResourceRequest* request = nullptr;
+                bool cancelled = false;
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    if (load->next == load->requests.size())
+                    {
+                        m_loads.erase(load->key);
+                        delete load;
+                        return;
+                    }
+
+                    request = load->requests[load->next++];
+                    cancelled = request->cancelled;
+                }
+
+                if (!cancelled)
+                    ProcessRequest(request);
+
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    finishRequest(request);
+                }
+                m_finished.notify_all();
+            }
+        }
 
-                VCreateMeshBase(handle, request->data);
+        void GPUResourceThread::finishRequest(GPUResourceRequest* request)
+        {
+            if (request->blocking)
+            {
+                //The thread blocked in Load owns the request
+                request->finished = true;
+                return;
             }
+
+            m_tickets.erase(request->id);
+            delete request;
         }
     }
 }
@@ -0,0 +1,288 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+#include <ht_jobscheduler.h>    //JobScheduler & JobCounter
+#include <ht_debug.h>           //HT_ERROR_PRINTF
+
+namespace Hatchit
+{
+    namespace Graphics
+    {
+        //The worker index of the current thread, if it belongs to a scheduler
+        static thread_local const JobScheduler* t_scheduler = nullptr;
+        static thread_local uint32_t t_workerIndex = 0;
+
+        JobCounter::JobCounter()
+        {
+            m_count = 0;
+        }
+
+        /** Adds outstanding jobs to this counter
+        * \param count The number of jobs to add
+        */
+        void JobCounter::Add(uint32_t count)
+        {
+            m_count += count;
+        }
+
+        /** Marks one job as finished
+        * \return True if this was the last outstanding job
+        */
+        bool JobCounter::Decrement()
+        {
+            return --m_count == 0;
+        }
+
+        /** Gets whether or not every job tracked by this counter has finished
+        * \return True if there are no outstanding jobs
+        */
+        bool JobCounter::IsDone() const
+        {
+            return m_count == 0;
+        }
+
+        JobScheduler::JobScheduler()
+        {
+            m_alive = false;
+            m_pending = 0;
+            m_next = 0;
+        }
+
+        JobScheduler::~JobScheduler()
+        {
+            Shutdown();
+        }
+
+        /** Spins up the worker threads
+        * \param workerCount The number of workers to create; at least one is always created
+        * \return True if the scheduler was started
+        */
+        bool JobScheduler::Start(uint32_t workerCount)
+        {
+            if (m_alive)
+            {
+                HT_ERROR_PRINTF("JobScheduler::Start(): Scheduler has already been started!\n");
+                return false;
+            }
+
+            if (workerCount == 0)
+                workerCount = 1;
+
+            m_alive = true;
+
+            for (uint32_t i = 0; i < workerCount; i++)
+                m_workers.push_back(new Worker);
+
+            //Workers may steal from each other as soon as they start so
+            //every deque must exist before the first thread runs
+            for (uint32_t i = 0; i < workerCount; i++)
+                m_workers[i]->thread = std::thread(&JobScheduler::worker_main, this, i);
+
+            return true;
+        }
+
+        /** Stops every worker and joins them
+        *
+        * Jobs still sitting in a deque are dropped. Callers are expected
+        * to Wait on their counters before shutting the scheduler down.
+        */
+        void JobScheduler::Shutdown()
+        {
+            if (!m_alive)
+                return;
+
+            {
+                std::lock_guard<std::mutex> lock(m_sleepMutex);
+                m_alive = false;
+            }
+            m_wake.notify_all();
+            m_done.notify_all();
+
+            for (size_t i = 0; i < m_workers.size(); i++)
+            {
+                if (m_workers[i]->thread.joinable())
+                    m_workers[i]->thread.join();
+                delete m_workers[i];
+            }
+            m_workers.clear();
+
+            m_pending = 0;
+        }
+
+        /** Schedules a job to be run by the next free thread
+        *
+        * Jobs scheduled from a worker go onto that worker's own deque.
+        * Jobs scheduled from any other thread are dealt round robin.
+        *
+        * \param job The job to run
+        * \param counter A counter to decrement once the job has run. May be null.
+        */
+        void JobScheduler::Schedule(Job job, JobCounter* counter)
+        {
+            if (m_workers.empty())
+            {
+                HT_ERROR_PRINTF("JobScheduler::Schedule(): Scheduler has not been started!\n");
+                return;
+            }
+
+            if (counter)
+                counter->Add(1);
+
+            uint32_t target;
+            if (t_scheduler == this)
+                target = t_workerIndex;
+            else
+                target = m_next++ % static_cast<uint32_t>(m_workers.size());
+
+            Worker* worker = m_workers[target];
+            {
+                std::lock_guard<std::mutex> lock(worker->mutex);
+                worker->jobs.push_back({ std::move(job), counter });
+            }
+
+            //Bump the pending count under the sleep lock so a worker that
+            //just found every deque empty can't miss this wake up
+            {
+                std::lock_guard<std::mutex> lock(m_sleepMutex);
+                m_pending++;
+            }
+            m_wake.notify_one();
+            m_done.notify_one();
+        }
+
+        /** Blocks until every job tracked by a counter has finished
+        *
+        * The calling thread executes pending jobs while it waits and only
+        * sleeps once there is nothing left to steal. Jobs may wait on work
+        * they scheduled themselves; a worker keeps its own context index.
+        * Only one thread outside of the workers should wait at a time since
+        * it runs jobs with the context index GetWorkerCount().
+        *
+        * \param counter The counter to wait on
+        */
+        void JobScheduler::Wait(JobCounter* counter)
+        {
+            const uint32_t index = (t_scheduler == this) ? t_workerIndex : GetWorkerCount();
+
+            while (!counter->IsDone())
+            {
+                Entry entry;
+                if (popOrSteal(index, entry))
+                {
+                    execute(entry, index);
+                    continue;
+                }
+
+                std::unique_lock<std::mutex> lock(m_sleepMutex);
+                m_done.wait(lock, [this, counter] { return counter->IsDone() || m_pending > 0 || !m_alive; });
+
+                if (!m_alive)
+                    break;
+            }
+        }
+
+        /** Gets the number of worker threads
+        * \return The number of worker threads owned by this scheduler
+        */
+        uint32_t JobScheduler::GetWorkerCount() const
+        {
+            return static_cast<uint32_t>(m_workers.size());
+        }
+
+        /** Gets the number of distinct context indices a job may be given
+        *
+        * This is the worker count plus one for the waiting thread. Use it
+        * to size any per-thread storage that jobs index into.
+        *
+        * \return The number of context indices
+        */
+        uint32_t JobScheduler::GetContextCount() const
+        {
+            return GetWorkerCount() + 1;
+        }
+
+        /*
+            Private Methods
+        */
+
+        void JobScheduler::worker_main(uint32_t index)
+        {
+            t_scheduler = this;
+            t_workerIndex = index;
+
+            while (m_alive)
+            {
+                Entry entry;
+                if (popOrSteal(index, entry))
+                {
+                    execute(entry, index);
+                    continue;
+                }
+
+                std::unique_lock<std::mutex> lock(m_sleepMutex);
+                m_wake.wait(lock, [this] { return !m_alive || m_pending > 0; });
+            }
+
+            t_scheduler = nullptr;
+        }
+
+        bool JobScheduler::popOrSteal(uint32_t index, Entry& entry)
+        {
+            const uint32_t workerCount = static_cast<uint32_t>(m_workers.size());
+
+            //Newest work first from our own deque; it is the most likely to be warm in cache
+            if (index < workerCount)
+            {
+                Worker* own = m_workers[index];
+                std::lock_guard<std::mutex> lock(own->mutex);
+                if (!own->jobs.empty())
+                {
+                    entry = std::move(own->jobs.back());
+                    own->jobs.pop_back();
+                    m_pending--;
+                    return true;
+                }
+            }
+
+            //Oldest work first from everyone else
+            for (uint32_t i = 1; i <= workerCount; i++)
+            {
+                Worker* victim = m_workers[(index + i) % workerCount];
+                std::lock_guard<std::mutex> lock(victim->mutex);
+                if (!victim->jobs.empty())
+                {
+                    entry = std::move(victim->jobs.front());
+                    victim->jobs.pop_front();
+                    m_pending--;
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        void JobScheduler::execute(Entry& entry, uint32_t index)
+        {
+            entry.job(index);
+
+            if (entry.counter && entry.counter->Decrement())
+            {
+                //Take the lock so a waiter can't check the counter and then
+                //go to sleep between our decrement and the notify
+                std::lock_guard<std::mutex> lock(m_sleepMutex);
+                m_done.notify_all();
+            }
+        }
+    }
+}
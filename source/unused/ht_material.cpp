@@ -16,6 +16,7 @@
 #include <ht_material_base.h>   //MaterialBase
 #include <ht_renderpass.h>      //RenderPass
 #include <ht_gpuresourcepool.h> //GPUResourcePool
+#include <ht_sortidpool.h>      //SortIDPool
 #include <ht_guid.h>            //Core::Guid
 #include <ht_string.h>          //std::string
 
@@ -23,15 +24,32 @@ namespace Hatchit {
 
     namespace Graphics {
 
+        //Never destroyed, so resources released during static destruction can still give their id back
+        static SortIDPool& materialSortIDs()
+        {
+            static SortIDPool* pool = new SortIDPool;
+            return *pool;
+        }
+
         Material::Material(Core::Guid ID)
             : Core::RefCounted<Material>(ID)
         {
             m_base = nullptr;
+            m_sortID = materialSortIDs().Acquire();
         }
 
         Material::~Material()
         {
             delete m_base;
+            materialSortIDs().Release(m_sortID);
+        }
+
+        /** Gets the id this Material is sorted by when drawing
+        * \return An id no other live Material has
+        */
+        uint32_t Material::GetSortID() const
+        {
+            return m_sortID;
         }
 
         /** Get a reference to this Material's collection of RenderPasses
@@ -26,20 +26,30 @@
 #include <ht_mesh_base.h>
 #include <cstdint>
 #include <ht_gpuresourcepool.h>
+#include <ht_sortidpool.h>
 
 namespace Hatchit 
 {
     namespace Graphics 
     {
 
+        //Never destroyed, so resources released during static destruction can still give their id back
+        static SortIDPool& meshSortIDs()
+        {
+            static SortIDPool* pool = new SortIDPool;
+            return *pool;
+        }
+
         Mesh::Mesh(Core::Guid ID) 
         {
             m_base = nullptr;
+            m_sortID = meshSortIDs().Acquire();
         }
 
         Mesh::~Mesh() 
         {
             delete m_base;
+            meshSortIDs().Release(m_sortID);
         }
 
         bool Mesh::Initialize(const std::string& file)
@@ -71,5 +81,13 @@ namespace Hatchit
             return m_base;
         }
 
+        /** Gets the id this Mesh is sorted by when drawing
+        * \return An id no other live Mesh has
+        */
+        uint32_t Mesh::GetSortID() const
+        {
+            return m_sortID;
+        }
+
     }
 }
\ No newline at end of file
@@ -15,20 +15,30 @@
 #include <ht_pipeline.h>
 #include <ht_pipeline_base.h>
 #include <ht_gpuresourcepool.h>
+#include <ht_sortidpool.h>
 
 namespace Hatchit
 {
     namespace Graphics
     {
+        //Never destroyed, so resources released during static destruction can still give their id back
+        static SortIDPool& pipelineSortIDs()
+        {
+            static SortIDPool* pool = new SortIDPool;
+            return *pool;
+        }
+
         Pipeline::Pipeline(Core::Guid ID)
             : Core::RefCounted<Pipeline>(ID)
         {
             m_base = nullptr;
+            m_sortID = pipelineSortIDs().Acquire();
         }
 
         Pipeline::~Pipeline()
         {
             delete m_base;
+            pipelineSortIDs().Release(m_sortID);
         }
 
         bool Pipeline::Initialize(const std::string& file)
@@ -103,5 +113,13 @@ namespace Hatchit
             return m_base;
         }
 
+        /** Gets the id this Pipeline is sorted by when drawing
+        * \return An id no other live Pipeline has
+        */
+        uint32_t Pipeline::GetSortID() const
+        {
+            return m_sortID;
+        }
+
     }
 }
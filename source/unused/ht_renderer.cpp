@@ -19,9 +19,11 @@
 #include <ht_device.h>              //IDevice
 #include <ht_gpuqueue.h>            //GPUQueue
 #include <ht_renderpass.h>          //RenderPass
+#include <ht_renderpass_base.h>     //CommandRecordContext
 #include <ht_material.h>            //Material
 #include <ht_mesh.h>                //Mesh
 #include <ht_camera.h>              //Camera
+#include <ht_debug.h>               //HT_ERROR_PRINTF
 
 #ifdef DX12_SUPPORT
 #include <ht_d3d12device.h>     //D3D12Device
@@ -32,8 +34,15 @@
 #include <ht_vkdevice.h>        //VKDevice
 #include <ht_vkswapchain.h>     //VKSwapChain
 #include <ht_vkqueue.h>         //VKQueue
+#include <ht_vkdeletionqueue.h> //VKDeletionQueue
+#include <ht_vkstaginguploader.h>   //VKStagingUploader
+#include <ht_vkmemorybudget.h>  //VKMemoryBudget
+#include <ht_vkuniformarena.h>  //VKUniformArena
+#include <ht_vkgeometrypool.h>  //VKGeometryPool
+#include <ht_vkdescriptorallocator.h>   //VKDescriptorAllocator
+#include <ht_vkindirectculler.h>    //VKIndirectCuller
 #include <ht_vktools.h>         //VKTools
-#include <ht_vkrenderthread.h>  //VKRenderThread
+#include <ht_vkcommandpool.h>   //VKCommandPool
 #endif
 
 
@@ -43,77 +52,149 @@ namespace Hatchit {
 
         IDevice*        Renderer::_Device = nullptr;
         GPUQueue*       Renderer::_Queue = nullptr;
+        GPUQueue*       Renderer::_CopyQueue = nullptr;
         RendererType    Renderer::_Type = UNKNOWN;
         SwapChain*      Renderer::_SwapChain = nullptr;
 
+        std::atomic<uint64_t> Renderer::_Generation(0);
+
         /** Register a render request with the renderer
         * 
         * Tell a RenderPass that it should render a Mesh with a Material
         * and a ShaderVariableChunk of instance data. Then make sure that the 
-        * pass is stored in a collection based on its layer. This way the 
-        * cameras will be able to be matched with the passes on the same layers. 
+        * pass is part of the render graph so it is ordered against the passes
+        * it reads from and writes to.
+        *
+        * Safe to call from any number of threads at once, but not while the
+        * renderer is rendering. Only the first request for a pass touches the
+        * render graph.
         *
         * \param pass The RenderPass you want to register a request with
         * \param material A handle to the Material that you want to render with
         * \param mesh A handle to the Mesh you want to render
         * \param instanceVaraibles A pointer to a ShaderVariableChunk of instance data necessary for rendering
+        * \param bounds World space bounds of the request, for culling; leave empty to never cull it
         */
-        void Renderer::RegisterRenderRequest(RenderPassHandle pass, MaterialHandle material, MeshHandle mesh, ShaderVariableChunk* instanceVariables)
+        void Renderer::RegisterRenderRequest(RenderPassHandle pass, MaterialHandle material, MeshHandle mesh, ShaderVariableChunk* instanceVariables,
+            const BoundingSphere& bounds)
         {
-            pass->ScheduleRenderRequest(material, mesh, instanceVariables);
+            pass->ScheduleRenderRequest(material, mesh, instanceVariables, 0.0f, bounds);
 
-            //Check if the pass already exists
-            for (size_t i = 0; i < m_renderPassLayers.size(); i++)
+            if (pass->MarkRegistered(m_generation))
             {
-                std::vector<RenderPassHandle> layer = m_renderPassLayers[i];
-                for (size_t j = 0; j < layer.size(); j++)
-                {
-                    if (layer[j] == pass)
-                        return;
-                }
+                std::lock_guard<std::mutex> lock(m_graphMutex);
+                m_renderGraph.AddPass(pass);
             }
+        }
+
+        /** Add a retained render request to a render pass
+        *
+        * Like RegisterRenderRequest, but the request keeps being drawn every
+        * frame until it's removed from the pass with RenderPass::RemoveRenderRequest.
+        *
+        * \param pass The RenderPass you want to add a request to
+        * \param material A handle to the Material that you want to render with
+        * \param mesh A handle to the Mesh you want to render
+        * \param instanceVariables A pointer to a ShaderVariableChunk of instance data; must outlive the request
+        * \param depth Distance from the camera; nearer requests draw first within a batch
+        * \param bounds World space bounds of the request, for culling; leave empty to never cull it
+        * \return The id of the request within the pass
+        */
+        RenderRequestID Renderer::AddRenderRequest(RenderPassHandle pass, MaterialHandle material, MeshHandle mesh, ShaderVariableChunk* instanceVariables, float depth,
+            const BoundingSphere& bounds)
+        {
+            RenderRequestID id = pass->AddRenderRequest(material, mesh, instanceVariables, depth, bounds);
 
-            uint64_t flags = pass->GetLayerFlags();
-            for (int j = 0; flags != 0; j++)
+            if (pass->MarkRegistered(m_generation))
             {
-                if (flags & 1)
-                {
-                    m_renderPassLayers[j].push_back(pass);
-                }
-                flags >>= 1;
+                std::lock_guard<std::mutex> lock(m_graphMutex);
+                m_renderGraph.AddPass(pass);
             }
+
+            return id;
+        }
+
+        /** Remove a render pass from the renderer
+        * 
+        * The pass will no longer be recorded and the render graph
+        * will be rebuilt on the next frame.
+        *
+        * \param pass The RenderPass you want to stop rendering
+        */
+        void Renderer::RemoveRenderPass(RenderPassHandle pass)
+        {
+            std::lock_guard<std::mutex> lock(m_graphMutex);
+            m_renderGraph.RemovePass(pass);
+
+            //The removed pass still carries our stamp, so start a new generation to
+            //let it register again. Passes still in the graph re-stamp harmlessly.
+            m_generation = ++_Generation;
+        }
+
+        /** Choose which render pass ends up on screen
+        * 
+        * Passes that don't contribute to this pass are culled. If this is never
+        * called the last registered pass that no other pass reads from is used.
+        *
+        * \param pass The RenderPass to present
+        */
+        void Renderer::SetPresentPass(RenderPassHandle pass)
+        {
+            m_renderGraph.SetPresentPass(pass);
         }
 
         /** Register a camera with this renderer so it can be given things to render
         * 
-        * The camera will be sorted into a collection based on which layers it wants to render.
-        * It will then be matched and given to render passes on the same layers.
+        * The camera will be matched and given to render passes that share
+        * at least one layer with it. Cameras are cleared after every frame.
         *
         * \param camera The Camera you'd like to register with this Renderer
         */
         void Renderer::RegisterCamera(Camera camera)
         {
-            uint64_t flags = camera.GetLayerFlags();
-            for (int j = 0; flags != 0; j++)
-            {
-                if (flags & 1)
-                {
-                    m_renderPassCameras[j].push_back(camera);
-                }
-                flags >>= 1;
-            }
+            m_cameras.push_back(camera);
         }
 
         Renderer::Renderer()
         {
             _SwapChain = nullptr;
-            m_locked = false;
-            m_processed = false;
+            m_generation = ++_Generation;
         }
 
         Renderer::~Renderer()
         {
+            m_scheduler.Shutdown();
+
+            //The swapchain waits for frames in flight, so it goes before the pools they record from
             delete _SwapChain;
+            _SwapChain = nullptr;
+
+            for (size_t i = 0; i < m_commandPools.size(); i++)
+            {
+                for (size_t j = 0; j < m_commandPools[i].size(); j++)
+                    delete m_commandPools[i][j];
+            }
+            m_commandPools.clear();
+
+#ifdef VK_SUPPORT
+            //Release anything still waiting on the GPU before the queues go away
+            if (_Type == RendererType::VULKAN)
+            {
+                Vulkan::VKStagingUploader::DeInitialize();
+                Vulkan::VKDeletionQueue::DeInitialize();
+                Vulkan::VKIndirectCuller::DeInitialize();
+                Vulkan::VKUniformArena::DeInitialize();
+                Vulkan::VKGeometryPool::DeInitialize();
+                Vulkan::VKDescriptorAllocator::DeInitialize();
+                Vulkan::VKMemoryBudget::DeInitialize();
+            }
+#endif
+
+            //Without a transfer family the copy queue is just the graphics queue
+            if (_CopyQueue != _Queue)
+                delete _CopyQueue;
+            _CopyQueue = nullptr;
+
             delete _Queue;
             delete _Device;
         }
@@ -166,6 +247,37 @@ namespace Hatchit {
 
                         if (!Vulkan::VKTools::Initialize(Device, Queue))
                             return false;
+                        if (!Vulkan::VKDeletionQueue::Initialize(Device->GetVKDevices()[0], Queue))
+                            return false;
+                        if (!Vulkan::VKMemoryBudget::Initialize(Device->GetVKPhysicalDevices()[0],
+                            Device->GetVKPhysicalDeviceMemoryProperties()[0], Device->SupportsMemoryBudget(), params.framesInFlight))
+                            return false;
+                        if (!Vulkan::VKUniformArena::Initialize(Device->GetVKDevices()[0], Device->GetVKPhysicalDeviceProperties()[0].limits,
+                            params.framesInFlight))
+                            return false;
+                        if (!Vulkan::VKGeometryPool::Initialize(Device->GetVKDevices()[0], Vulkan::VKTools::GetQueueFamilies()))
+                            return false;
+                        if (!Vulkan::VKDescriptorAllocator::Initialize(Device->GetVKDevices()[0]))
+                            return false;
+                        if (!Vulkan::VKIndirectCuller::Initialize(Device->GetVKDevices()[0],
+                            Device->SupportsMultiDrawIndirect(), Device->SupportsIndirectFirstInstance()))
+                            return false;
+
+                        //Uploads go through the transfer-only family when the device has one
+                        Vulkan::VKQueue* CopyQueue = Queue;
+                        if (Device->GetTransferQueueFamily() >= 0)
+                        {
+                            CopyQueue = new Vulkan::VKQueue(QueueType::COPY);
+                            if (!CopyQueue->Initialize(Device))
+                            {
+                                delete CopyQueue;
+                                CopyQueue = Queue;
+                            }
+                        }
+                        _CopyQueue = static_cast<GPUQueue*>(CopyQueue);
+
+                        if (!Vulkan::VKStagingUploader::Initialize(Device->GetVKDevices()[0], CopyQueue, Queue))
+                            return false;
                     }
 
                     _SwapChain = new Vulkan::VKSwapChain(params, static_cast<Vulkan::VKDevice*>(_Device), static_cast<Vulkan::VKQueue*>(_Queue));
@@ -173,6 +285,9 @@ namespace Hatchit {
                     /*Initialize GPU Resource Pool*/
                     GPUResourcePool::Initialize(_Device, _SwapChain);
 
+                    //The culling shader loads through the pool; without it GPU driven passes cull on the CPU
+                    Vulkan::VKIndirectCuller::CreatePipeline();
+
                     if (!_SwapChain->VInitialize(params.viewportWidth, params.viewportHeight))
                         return false;
                 } break;
@@ -196,61 +311,76 @@ namespace Hatchit {
 
         void Renderer::Render()
         {
+            //Order the passes by their render target dependencies; this is
+            //cached and only rebuilt when a pass has been added or removed
+            const std::vector<std::vector<RenderPassHandle>>& levels = m_renderGraph.Compile();
+            if (levels.size() <= 0)
+                return;
+
+            //Wait until the GPU has released this frame slot so its
+            //command buffers and per-frame data may be rewritten
+            _SwapChain->VBeginFrame();
+
+            //Every command list recorded for this slot last time around is done; recycle them all at once
+            std::vector<ICommandPool*>& commandPools = m_commandPools[_SwapChain->GetCurrentFrame()];
+            for (size_t i = 0; i < commandPools.size(); i++)
+            {
+                if (commandPools[i])
+                    commandPools[i]->VReset();
+            }
+
+            //Let the swapchain lay out attachment memory for the graph before anything records into it
+            _SwapChain->VPrepareRenderPasses(levels);
+
             //Tell the swapchain which render pass to put on screen
-            std::vector<RenderPassHandle> lastLayer = m_renderPassLayers[0];
-            RenderPassHandle lastRenderPass = lastLayer[lastLayer.size() - 1];
-            _SwapChain->VSetInput(lastRenderPass);
+            _SwapChain->VSetInput(m_renderGraph.GetPresentPass());
 
             //Step 01: Clear the buffer
             //Not exactly sure how this will work, as the clear command
             //need to be recorded as part of a command list
             _SwapChain->VClear(reinterpret_cast<float*>(&m_params.clearColor));
 
-            //Step 02: Record each renderpass's command list in a pass thread
-            //We will need to *SMARTLY* spawn enough threads to handle
-            //the command generation or each render layer.
-            for (size_t i = 0; i < m_renderPassLayers.size(); i++)
+            //Step 02: Record each renderpass's command list as a job
+            //Each job is handed the index of the thread running it so
+            //it can record into that thread's own command pool.
+            //Recording doesn't depend on the graph order; only submission does.
+            JobCounter recorded;
+            for (size_t i = 0; i < levels.size(); i++)
             {
-                std::vector<RenderPassHandle> renderPasses = m_renderPassLayers[i];
-                std::vector<Camera> cameras = m_renderPassCameras[i];
+                const std::vector<RenderPassHandle>& renderPasses = levels[i];
                 for (size_t j = 0; j < renderPasses.size(); j++)
                 {
                     RenderPassHandle passHandle = renderPasses[j];
-                    Camera camera = cameras[0];
 
-                    passHandle->SetView(camera.GetView());
-                    passHandle->SetProj(camera.GetProjection());
-                    
-                    //Add work for the render threads
-                    m_threadQueue.push(passHandle);
-                }
-            }
+                    //Use the first camera that shares a layer with the pass
+                    const uint64_t passLayers = passHandle->GetLayerFlags();
+                    for (size_t k = 0; k < m_cameras.size(); k++)
+                    {
+                        if (m_cameras[k].GetLayerFlags() & passLayers)
+                        {
+                            passHandle->SetView(m_cameras[k].GetView());
+                            passHandle->SetProj(m_cameras[k].GetProjection());
+                            break;
+                        }
+                    }
 
-            //Tell all threads that they can work
-            for (size_t i = 0; i < this->m_threads.size(); i++)
-                m_threads[i]->Notify();
-            
-            //Wait for all threads to finish
-            while (true)
-            {
-                size_t processed = 0;
-                for (size_t i = 0; i < this->m_threads.size(); i++)
-                {
-                    if (m_threads[i]->Processed())
-                        processed++;
+                    m_scheduler.Schedule([this, &commandPools, passHandle](uint32_t context)
+                    {
+                        CommandRecordContext recordContext = { &m_scheduler, &commandPools, context };
+                        passHandle->BuildCommandList(recordContext);
+                    }, &recorded);
                 }
-
-                if (processed == this->m_threads.size())
-                    break;
             }
 
+            //Record alongside the workers rather than spinning until they finish
+            m_scheduler.Wait(&recorded);
+
             //Step 03: Execute the recorded command lists
-            //This is a complicated step as we must execute command lists potentially
-            //while others are still being generated. The pass threads must signal they have completed
-            //to the renderer for it to then collect and execute them
-            for (size_t i = 0; i < m_renderPassLayers.size(); i++)
+            //Levels are in dependency order and passes within a level are
+            //independent, so each level goes to the GPU as one submission.
+            for (size_t i = 0; i < levels.size(); i++)
             {
-                _SwapChain->VExecute(m_renderPassLayers[i]);
+                _SwapChain->VExecute(levels[i]);
             }
 
             //Step 04: Present to the screen
@@ -260,10 +390,7 @@ namespace Hatchit {
             _SwapChain->VPresent();
 
             //Clear out cameras
-            for (size_t i = 0; i < m_renderPassCameras.size(); i++)
-            {
-                m_renderPassCameras[i].clear();
-            }
+            m_cameras.clear();
         }
 
         void Renderer::Present()
@@ -286,27 +413,65 @@ namespace Hatchit {
             return Renderer::_Type;
         }
 
+        /** Gets the combined statistics of every command pool this renderer records with
+        * \return A CommandPoolStats summed across every frame slot and thread
+        */
+        CommandPoolStats Renderer::GetCommandPoolStats() const
+        {
+            CommandPoolStats total = {};
+
+            for (size_t i = 0; i < m_commandPools.size(); i++)
+            {
+                for (size_t j = 0; j < m_commandPools[i].size(); j++)
+                {
+                    if (!m_commandPools[i][j])
+                        continue;
+
+                    const CommandPoolStats& stats = m_commandPools[i][j]->GetStats();
+                    total.allocations += stats.allocations;
+                    total.allocationsAvoided += stats.allocationsAvoided;
+                    total.resets += stats.resets;
+                    total.recordNanoseconds += stats.recordNanoseconds;
+                }
+            }
+
+            return total;
+        }
+
         /*
             Protected Methods
         */
 
         void Renderer::initThreads() 
         {
-            uint32_t threadCount = std::thread::hardware_concurrency();
-            for (uint32_t i = 0; i < threadCount; i++)
+            uint32_t workerCount = std::thread::hardware_concurrency();
+            if (workerCount > 1)
+                workerCount--; //The render thread records jobs itself while it waits
+
+            if (!m_scheduler.Start(workerCount))
+                return;
+
+            //One transient pool per thread per frame slot so a pool is never
+            //reset while the GPU may still be executing out of it
+            m_commandPools.resize(_SwapChain->GetFrameCount());
+            for (uint32_t frame = 0; frame < _SwapChain->GetFrameCount(); frame++)
             {
-                RenderThread* renderThread;
+                for (uint32_t i = 0; i < m_scheduler.GetContextCount(); i++)
+                {
+                    ICommandPool* commandPool = nullptr;
 
 #ifdef DX12_SUPPORT
 #endif
 
 #ifdef VK_SUPPORT
-                renderThread = new Vulkan::VKRenderThread(static_cast<Vulkan::VKDevice*>(_Device));
+                    commandPool = new Vulkan::VKCommandPool(static_cast<Vulkan::VKDevice*>(_Device)->GetVKDevices()[0]);
 #endif
 
-                renderThread->VStart(&m_cv, &m_threadQueue);
+                    if (commandPool && !commandPool->VInitialize())
+                        HT_ERROR_PRINTF("Renderer::initThreads(): Failed to initialize command pool %d for frame %d!\n", i, frame);
 
-                m_threads.push_back(renderThread);
+                    m_commandPools[frame].push_back(commandPool);
+                }
             }
         }
     }
@@ -0,0 +1,307 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+#include <ht_rendergraph.h>     //RenderGraph
+#include <ht_debug.h>           //HT_ERROR_PRINTF
+#include <ht_string.h>          //std::string
+#include <map>                  //std::map
+#include <set>                  //std::set
+#include <queue>                //std::queue
+
+namespace Hatchit
+{
+    namespace Graphics
+    {
+        RenderGraph::RenderGraph()
+        {
+            m_dirty = true;
+        }
+
+        /** Adds a render pass to the graph
+        * \param pass The pass to add
+        * \return True if the pass was not already part of the graph
+        */
+        bool RenderGraph::AddPass(RenderPassHandle pass)
+        {
+            for (size_t i = 0; i < m_passes.size(); i++)
+            {
+                if (m_passes[i] == pass)
+                    return false;
+            }
+
+            m_passes.push_back(pass);
+            m_dirty = true;
+
+            return true;
+        }
+
+        /** Removes a render pass from the graph
+        * \param pass The pass to remove
+        * \return True if the pass was part of the graph
+        */
+        bool RenderGraph::RemovePass(RenderPassHandle pass)
+        {
+            for (size_t i = 0; i < m_passes.size(); i++)
+            {
+                if (m_passes[i] == pass)
+                {
+                    m_passes.erase(m_passes.begin() + i);
+                    m_dirty = true;
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        /** Sets the pass whose output ends up on screen
+        *
+        * Every pass that doesn't contribute to this one is culled. If no
+        * present pass is set, the last registered pass that nobody reads
+        * from is presented.
+        *
+        * \param pass The pass to present
+        */
+        void RenderGraph::SetPresentPass(RenderPassHandle pass)
+        {
+            if (m_presentPass == pass)
+                return;
+
+            m_presentPass = pass;
+            m_dirty = true;
+        }
+
+        /** Compiles the graph into levels of independent passes
+        *
+        * Levels are in dependency order. Every pass in a level only depends
+        * on passes in earlier levels. The result is cached and only rebuilt
+        * after a pass has been added or removed.
+        *
+        * \return The live passes grouped into levels; empty if there is nothing to render
+        */
+        const std::vector<std::vector<RenderPassHandle>>& RenderGraph::Compile()
+        {
+            if (!m_dirty)
+                return m_levels;
+
+            m_levels.clear();
+            m_compiledPresentPass = RenderPassHandle();
+            m_dirty = false;
+
+            const size_t passCount = m_passes.size();
+            if (passCount == 0)
+                return m_levels;
+
+            //Link writers to readers through the paths of the targets they share. Readers and
+            //dependencies decide what is live; overwriters only order passes after a read.
+            std::vector<std::set<size_t>> readers(passCount);
+            std::vector<std::set<size_t>> dependencies(passCount);
+            std::vector<std::set<size_t>> overwriters(passCount);
+            std::vector<std::set<size_t>> waits(passCount);
+
+            std::map<std::string, std::vector<size_t>> writers;
+            for (size_t i = 0; i < passCount; i++)
+            {
+                const std::vector<std::string>& outputs = m_passes[i]->GetOutputPaths();
+                for (size_t j = 0; j < outputs.size(); j++)
+                    writers[outputs[j]].push_back(i);
+            }
+
+            //Passes writing the same target keep their registration order
+            for (auto it = writers.begin(); it != writers.end(); it++)
+            {
+                const std::vector<size_t>& targetWriters = it->second;
+                for (size_t i = 1; i < targetWriters.size(); i++)
+                {
+                    readers[targetWriters[i - 1]].insert(targetWriters[i]);
+                    dependencies[targetWriters[i]].insert(targetWriters[i - 1]);
+                }
+            }
+
+            for (size_t i = 0; i < passCount; i++)
+            {
+                const std::vector<std::string>& inputs = m_passes[i]->GetInputPaths();
+                for (size_t j = 0; j < inputs.size(); j++)
+                {
+                    auto it = writers.find(inputs[j]);
+                    if (it == writers.end())
+                        continue;
+
+                    //Writers are in registration order; read what the nearest earlier one wrote
+                    const std::vector<size_t>& targetWriters = it->second;
+                    size_t next = 0;
+                    while (next < targetWriters.size() && targetWriters[next] < i)
+                        next++;
+
+                    if (next > 0)
+                    {
+                        size_t writer = targetWriters[next - 1];
+                        readers[writer].insert(i);
+                        dependencies[i].insert(writer);
+                    }
+
+                    //The next write has to wait until this pass has read the target
+                    if (next < targetWriters.size() && targetWriters[next] == i)
+                        next++;
+                    if (next < targetWriters.size())
+                    {
+                        size_t writer = targetWriters[next];
+                        overwriters[i].insert(writer);
+                        waits[writer].insert(i);
+                    }
+                }
+            }
+
+            //Find the pass we present
+            size_t present = passCount;
+            for (size_t i = 0; i < passCount; i++)
+            {
+                if (m_passes[i] == m_presentPass)
+                    present = i;
+            }
+            for (size_t i = passCount; present == passCount && i > 0; i--)
+            {
+                if (readers[i - 1].empty())
+                    present = i - 1;
+            }
+            if (present == passCount)
+            {
+                HT_ERROR_PRINTF("RenderGraph::Compile(): Every pass is read by another; there is no pass to present!\n");
+                return m_levels;
+            }
+
+            //Cull anything the presented pass doesn't depend on
+            std::vector<bool> live(passCount, false);
+            std::vector<size_t> open;
+            live[present] = true;
+            open.push_back(present);
+            while (!open.empty())
+            {
+                size_t pass = open.back();
+                open.pop_back();
+
+                for (auto it = dependencies[pass].begin(); it != dependencies[pass].end(); it++)
+                {
+                    if (!live[*it])
+                    {
+                        live[*it] = true;
+                        open.push_back(*it);
+                    }
+                }
+            }
+
+            //Sort the live passes; each pass lands one level after its deepest dependency
+            std::vector<size_t> remaining(passCount, 0);
+            std::vector<size_t> level(passCount, 0);
+            std::queue<size_t> ready;
+            size_t liveCount = 0;
+
+            for (size_t i = 0; i < passCount; i++)
+            {
+                if (!live[i])
+                    continue;
+
+                liveCount++;
+                remaining[i] = dependencies[i].size();
+
+                //A culled reader has nothing to wait for
+                for (auto it = waits[i].begin(); it != waits[i].end(); it++)
+                {
+                    if (live[*it])
+                        remaining[i]++;
+                }
+
+                if (remaining[i] == 0)
+                    ready.push(i);
+            }
+
+            size_t sorted = 0;
+            size_t levelCount = 0;
+            while (!ready.empty())
+            {
+                size_t pass = ready.front();
+                ready.pop();
+                sorted++;
+
+                if (level[pass] + 1 > levelCount)
+                    levelCount = level[pass] + 1;
+
+                for (int edges = 0; edges < 2; edges++)
+                {
+                    const std::set<size_t>& next = edges == 0 ? readers[pass] : overwriters[pass];
+                    for (auto it = next.begin(); it != next.end(); it++)
+                    {
+                        if (!live[*it])
+                            continue;
+
+                        if (level[pass] + 1 > level[*it])
+                            level[*it] = level[pass] + 1;
+
+                        if (--remaining[*it] == 0)
+                            ready.push(*it);
+                    }
+                }
+            }
+
+            if (sorted != liveCount)
+            {
+                //A cycle; fall back to registration order so we still draw something
+                HT_ERROR_PRINTF("RenderGraph::Compile(): Render passes form a cycle; falling back to registration order\n");
+
+                for (size_t i = 0; i < passCount; i++)
+                {
+                    if (live[i])
+                        m_levels.push_back({ m_passes[i] });
+                }
+            }
+            else
+            {
+                m_levels.resize(levelCount);
+                for (size_t i = 0; i < passCount; i++)
+                {
+                    if (live[i])
+                        m_levels[level[i]].push_back(m_passes[i]);
+                }
+            }
+
+            m_compiledPresentPass = m_passes[present];
+
+            return m_levels;
+        }
+
+        /** Gets the pass chosen to be presented by the last Compile
+        * \return A handle to the presented pass; invalid if nothing was compiled
+        */
+        RenderPassHandle RenderGraph::GetPresentPass() const
+        {
+            return m_compiledPresentPass;
+        }
+
+        /** Gets every registered pass, including culled ones
+        * \return The passes in registration order
+        */
+        const std::vector<RenderPassHandle>& RenderGraph::GetPasses() const
+        {
+            return m_passes;
+        }
+
+        /** Gets whether the graph needs to be compiled again
+        * \return True if a pass has been added or removed since the last Compile
+        */
+        bool RenderGraph::IsDirty() const
+        {
+            return m_dirty;
+        }
+    }
+}
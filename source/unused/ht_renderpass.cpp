@@ -60,17 +60,34 @@ namespace Hatchit
             return true;
         }
 
-        /** Build a command list with the given command pool
+        /** Build a command list with the given record context
         * 
-        * Given an interface to a command pool, record all the necesary
-        * commands to render this render pass onto a command list.
+        * Given this frame's command pools and the scheduler recording it, record
+        * all the necesary commands to render this render pass onto a command list.
+        * Large passes may schedule more jobs to record parts of themselves.
         *
-        * \param commandPool A pointer to the command pool to build the command list from
+        * \param context The scheduler, command pools and context index to record with
         * \return A boolean representing whether or not this operation succeeded
         */
-        bool RenderPass::BuildCommandList(const ICommandPool* commandPool) 
+        bool RenderPass::BuildCommandList(const CommandRecordContext& context) 
         {
-            return m_base->VBuildCommandList(commandPool);
+            return m_base->VBuildCommandList(context);
+        }
+
+        /** Set how many renderables are recorded per job when this pass is split across threads
+        * \param chunkSize The number of renderables per chunk; zero never splits the pass
+        */
+        void RenderPass::SetChunkSize(uint32_t chunkSize)
+        {
+            m_base->SetChunkSize(chunkSize);
+        }
+
+        /** Set whether this pass culls and fills in its draws on the GPU
+        * \param gpuDriven True to cull on the GPU where the device allows it
+        */
+        void RenderPass::SetGPUDriven(bool gpuDriven)
+        {
+            m_base->SetGPUDriven(gpuDriven);
         }
 
         /** Set the view matrix to be used in this render pass
@@ -97,10 +114,58 @@ namespace Hatchit
         * \param material A handle to the material you want to render with
         * \param mesh A handle to the mesh you want to render
         * \param instanceVariables Any instance level variables required for rendering
+        * \param depth Distance from the camera; nearer requests draw first within a batch
+        * \param bounds World space bounds of the request, for culling
+        */
+        void RenderPass::ScheduleRenderRequest(MaterialHandle material, MeshHandle mesh, ShaderVariableChunk* instanceVariables, float depth,
+            const BoundingSphere& bounds) 
+        {
+            m_base->ScheduleRenderRequest(material, mesh, instanceVariables, depth, bounds);
+        }
+
+        /** Add a retained render request to this render pass
+        *
+        * The request is drawn every frame until it's removed. The instance variables
+        * must stay alive until then; call UpdateRenderRequest after changing them.
+        *
+        * \param material A handle to the material you want to render with
+        * \param mesh A handle to the mesh you want to render
+        * \param instanceVariables Any instance level variables required for rendering
+        * \param depth Distance from the camera; nearer requests draw first within a batch
+        * \param bounds World space bounds of the request, for culling
+        * \return The id of the request, for removing and updating it later
+        */
+        RenderRequestID RenderPass::AddRenderRequest(MaterialHandle material, MeshHandle mesh, ShaderVariableChunk* instanceVariables, float depth,
+            const BoundingSphere& bounds)
+        {
+            return m_base->AddRenderRequest(material, mesh, instanceVariables, depth, bounds);
+        }
+
+        /** Remove a retained render request from this render pass
+        * \param id The id AddRenderRequest returned
         */
-        void RenderPass::ScheduleRenderRequest(MaterialHandle material, MeshHandle mesh, ShaderVariableChunk* instanceVariables) 
+        void RenderPass::RemoveRenderRequest(RenderRequestID id)
         {
-            m_base->ScheduleRenderRequest(material, mesh, instanceVariables);
+            m_base->RemoveRenderRequest(id);
+        }
+
+        /** Tell this render pass that a retained request's instance variables changed
+        * \param id The id AddRenderRequest returned
+        * \param depth Distance from the camera; nearer requests draw first within a batch
+        * \param bounds World space bounds of the request, for culling
+        */
+        void RenderPass::UpdateRenderRequest(RenderRequestID id, float depth, const BoundingSphere& bounds)
+        {
+            m_base->UpdateRenderRequest(id, depth, bounds);
+        }
+
+        /** Stamps this pass as registered with a renderer generation
+        * \param generation The generation of the renderer's pass list
+        * \return True if the pass wasn't already stamped with this generation
+        */
+        bool RenderPass::MarkRegistered(uint64_t generation)
+        {
+            return m_base->MarkRegistered(generation);
         }
 
         /** Gets the layers that this RenderPassBase is a part of
@@ -111,6 +176,30 @@ namespace Hatchit
             return m_base->GetLayerFlags();
         }
 
+        /** Gets how many draws and binds went into the command list last built for this pass
+        * \return The pass's RecordStats
+        */
+        const RecordStats& RenderPass::GetRecordStats() const
+        {
+            return m_base->GetRecordStats();
+        }
+
+        /** Gets the paths of every render target this pass reads from
+        * \return A vector of render target paths
+        */
+        const std::vector<std::string>& RenderPass::GetInputPaths() const
+        {
+            return m_base->GetInputPaths();
+        }
+
+        /** Gets the paths of every render target this pass writes to
+        * \return A vector of render target paths
+        */
+        const std::vector<std::string>& RenderPass::GetOutputPaths() const
+        {
+            return m_base->GetOutputPaths();
+        }
+
         RenderPassBase* const RenderPass::GetBase() const
         {
             return m_base;
@@ -18,25 +18,110 @@
 #include <ht_pipeline.h>            //Pipeline
 #include <ht_shadervariablechunk.h> //ShaderVariableChunk
 #include <ht_math.h>                //Math::Matrix4
+#include <ht_drawkey.h>             //DrawKeySorter
+#include <ht_frustumculler.h>       //FrustumCuller
+#include <ht_debug.h>               //HT_DEBUG_PRINTF
+#include <algorithm>                //std::upper_bound & std::equal_range & std::equal
+#include <cstring>                  //memcmp
 
 namespace Hatchit 
 {
     namespace Graphics 
     {
+        //Lays the spheres sphereAt(i) returns out one component per array in the arena and culls them
+        template<typename SphereAt>
+        static size_t cullSpheres(FrameArena& arena, const Frustum& frustum, size_t count, const SphereAt& sphereAt,
+            JobScheduler* scheduler, uint8_t* visible)
+        {
+            FrameVector<float> x(count, 0.0f, FrameAllocator<float>(&arena));
+            FrameVector<float> y(count, 0.0f, FrameAllocator<float>(&arena));
+            FrameVector<float> z(count, 0.0f, FrameAllocator<float>(&arena));
+            FrameVector<float> radius(count, 0.0f, FrameAllocator<float>(&arena));
+            for (size_t i = 0; i < count; i++)
+            {
+                const BoundingSphere& sphere = sphereAt(i);
+                x[i] = sphere.x;
+                y[i] = sphere.y;
+                z[i] = sphere.z;
+                radius[i] = sphere.radius;
+            }
+
+            BoundingSphereSoA spheres = { x.data(), y.data(), z.data(), radius.data() };
+            return FrustumCuller::Cull(frustum, spheres, count, visible, scheduler);
+        }
+
+        RenderPassBase::RenderPassBase()
+            : m_pipelineList(FrameAllocator<PipelineRenderables>(&m_frameArena)),
+            m_instanceData(FrameAllocator<MeshInstanceData>(&m_frameArena))
+        {
+            m_registeredGeneration = 0;
+        }
+
+        RenderPassBase::~RenderPassBase()
+        {
+            resetFrameData();
+        }
+
         /** Set the view matrix to be used in this render pass
+        *
+        * Setting the same matrix again doesn't count as a camera change.
+        *
         * \param view The Math::Matrix4 to be used for the view matrix
         */
         void RenderPassBase::SetView(Math::Matrix4 view) 
         {
+            //A camera that didn't move is set with the same bits
+            if (memcmp(&m_view, &view, sizeof(Math::Matrix4)) == 0)
+                return;
+
             m_view = view; 
+            m_cameraVersion++;
         }
 
         /** Set the projection matrix to be used in this render pass
+        *
+        * Setting the same matrix again doesn't count as a camera change.
+        *
         * \param proj The Math::Matrix4 to be used for the projection matrix
         */
         void RenderPassBase::SetProj(Math::Matrix4 proj) 
         { 
+            if (memcmp(&m_proj, &proj, sizeof(Math::Matrix4)) == 0)
+                return;
+
             m_proj = proj; 
+            m_cameraVersion++;
+        }
+
+        /** Set how many renderables are recorded per job when this pass is split across threads
+        *
+        * Passes with more renderables than this are recorded in parallel in chunks
+        * of this size. Smaller chunks spread better across threads but cost more
+        * command buffers. Zero records the whole pass on one thread.
+        *
+        * \param chunkSize The number of renderables per chunk
+        */
+        void RenderPassBase::SetChunkSize(uint32_t chunkSize)
+        {
+            m_chunkSize = chunkSize;
+        }
+
+        /** Set whether this pass culls and fills in its draws on the GPU
+        *
+        * Only takes effect on devices that can draw indirectly with a first
+        * instance and once the culling shader has loaded; otherwise the pass
+        * logs an error the first time it records and culls on the CPU.
+        * Everything else about the pass stays the same, but a GPU driven
+        * pass records every frame rather than reusing a recording. Retained
+        * requests stay on the GPU and are only copied again once
+        * UpdateRenderRequest says they changed; scheduled requests are
+        * uploaded every frame.
+        *
+        * \param gpuDriven True to cull on the GPU
+        */
+        void RenderPassBase::SetGPUDriven(bool gpuDriven)
+        {
+            m_gpuDriven = gpuDriven;
         }
 
         /** Schedule a render request on this render pass
@@ -44,20 +129,147 @@ namespace Hatchit
         * Provide a material, mesh and any instance data you want and that object will be
         * rendered in a command as part of this pass. The data will be sorted and built later.
         *
+        * Any number of threads may schedule requests at once without locking; each
+        * appends to its own buffer. Requests must not be scheduled while the pass is
+        * building its command list.
+        *
         * \param material A handle to the material you want to render with
         * \param mesh A handle to the mesh you want to render
         * \param instanceVariables Any instance level variables required for rendering
+        * \param depth Distance from the camera; nearer requests draw first within a batch
+        * \param bounds World space bounds of the request, for culling
         */
-        void RenderPassBase::ScheduleRenderRequest(MaterialHandle material, MeshHandle mesh, ShaderVariableChunk* instanceVariables)
+        void RenderPassBase::ScheduleRenderRequest(MaterialHandle material, MeshHandle mesh, ShaderVariableChunk* instanceVariables, float depth,
+            const BoundingSphere& bounds)
         {
-            RenderRequest renderRequest = {};
+            //Keyed here so the cost is spread across the submitting threads
+            RenderRequest renderRequest = makeRenderRequest(material, mesh, instanceVariables, depth, bounds);
 
-            renderRequest.pipeline = material->GetPipeline();
-            renderRequest.material = material;
-            renderRequest.mesh = mesh;
-            renderRequest.instanceData = instanceVariables;
+            m_submissions.Push(renderRequest);
+        }
+
+        /** Add a retained render request to this render pass
+        *
+        * The request is drawn every frame until it's removed, without being
+        * scheduled again. The instance variables are read every frame, so they
+        * must stay alive until the request is removed. Call UpdateRenderRequest
+        * after changing them.
+        *
+        * Requests may be added, removed and updated from any thread, but not
+        * while the pass is building its command list.
+        *
+        * \param material A handle to the material you want to render with
+        * \param mesh A handle to the mesh you want to render
+        * \param instanceVariables Any instance level variables required for rendering
+        * \param depth Distance from the camera; nearer requests draw first within a batch
+        * \param bounds World space bounds of the request, for culling
+        * \return The id of the request, for removing and updating it later
+        */
+        RenderRequestID RenderPassBase::AddRenderRequest(MaterialHandle material, MeshHandle mesh, ShaderVariableChunk* instanceVariables, float depth,
+            const BoundingSphere& bounds)
+        {
+            RetainedRequest retained;
+            retained.request = makeRenderRequest(material, mesh, instanceVariables, depth, bounds);
+            retained.version = 1;
+            retained.alive = true;
+
+            std::lock_guard<std::mutex> lock(m_retainedMutex);
+
+            RenderRequestID id;
+            if (!m_freeRequestIDs.empty())
+            {
+                id = m_freeRequestIDs.back();
+                m_freeRequestIDs.pop_back();
+                m_retainedRequests[id] = retained;
+            }
+            else
+            {
+                id = static_cast<RenderRequestID>(m_retainedRequests.size());
+                m_retainedRequests.push_back(retained);
+            }
+
+            insertRetainedKey(retained.request.sortKey, id);
+            m_retainedListVersion++;
+
+            return id;
+        }
+
+        /** Remove a retained render request from this render pass
+        *
+        * The request's handles are released and its id may be handed out again.
+        *
+        * \param id The id AddRenderRequest returned
+        */
+        void RenderPassBase::RemoveRenderRequest(RenderRequestID id)
+        {
+            std::lock_guard<std::mutex> lock(m_retainedMutex);
+
+            if (id >= m_retainedRequests.size() || !m_retainedRequests[id].alive)
+            {
+                HT_DEBUG_PRINTF("RenderPassBase::RemoveRenderRequest(): No retained request with id %u\n", id);
+                return;
+            }
+
+            RetainedRequest& retained = m_retainedRequests[id];
+            eraseRetainedKey(retained.request.sortKey, id);
+
+            retained.request = {};
+            retained.alive = false;
+            m_freeRequestIDs.push_back(id);
+
+            m_retainedListVersion++;
+        }
+
+        /** Tell this render pass that a retained request's instance variables changed
+        *
+        * Only the changed request's instance data is copied again. If the depth
+        * moves the request to another place in the draw order the draw list is
+        * patched, which costs the pass a new recording.
+        *
+        * \param id The id AddRenderRequest returned
+        * \param depth Distance from the camera; nearer requests draw first within a batch
+        * \param bounds World space bounds of the request, for culling
+        */
+        void RenderPassBase::UpdateRenderRequest(RenderRequestID id, float depth, const BoundingSphere& bounds)
+        {
+            std::lock_guard<std::mutex> lock(m_retainedMutex);
+
+            if (id >= m_retainedRequests.size() || !m_retainedRequests[id].alive)
+            {
+                HT_DEBUG_PRINTF("RenderPassBase::UpdateRenderRequest(): No retained request with id %u\n", id);
+                return;
+            }
+
+            RetainedRequest& retained = m_retainedRequests[id];
+            retained.version++;
+
+            RenderRequest& request = retained.request;
+            request.bounds = bounds;
+
+            uint64_t key = DrawKeySorter::MakeKey(request.pipeline->GetSortID(), request.material->GetSortID(), request.mesh->GetSortID(), depth);
+            if (key == request.sortKey)
+                return;
+
+            eraseRetainedKey(request.sortKey, id);
+            request.sortKey = key;
+            insertRetainedKey(key, id);
+
+            m_retainedListVersion++;
+        }
+
+        /** Stamps this pass as registered with a renderer generation
+        *
+        * Lets a renderer skip registering the pass again on every request.
+        *
+        * \param generation The generation of the renderer's pass list
+        * \return True if the pass wasn't already stamped with this generation
+        */
+        bool RenderPassBase::MarkRegistered(uint64_t generation)
+        {
+            if (m_registeredGeneration.load(std::memory_order_relaxed) == generation)
+                return false;
 
-            m_renderRequests.push_back(renderRequest);
+            return m_registeredGeneration.exchange(generation) != generation;
         }
 
         /** Gets the layers that this RenderPassBase is a part of
@@ -68,64 +280,232 @@ namespace Hatchit
             return m_layerflags;
         }
 
+        /** Gets how many draws and binds went into the command list last built for this pass
+        *
+        * Binds that matched what was already bound are skipped and counted
+        * as elided. A pass that reused an earlier recording reports that one.
+        *
+        * \return The pass's RecordStats
+        */
+        const RecordStats& RenderPassBase::GetRecordStats() const
+        {
+            return m_recordStats;
+        }
+
+        /** Gets the paths of every render target this pass reads from
+        * \return A vector of render target paths
+        */
+        const std::vector<std::string>& RenderPassBase::GetInputPaths() const
+        {
+            return m_inputPaths;
+        }
+
+        /** Gets the paths of every render target this pass writes to
+        * \return A vector of render target paths
+        */
+        const std::vector<std::string>& RenderPassBase::GetOutputPaths() const
+        {
+            return m_outputPaths;
+        }
+
         /** Sorts this pass's render requests so that building the pass's commands is easier
         * 
-        * This maps meshes and materials to the pipelines that they will be rendered with
-        * as well as shader instance variables with the meshes that they will be used to render.
+        * Requests whose bounds are outside the frustum of the pass's camera are
+        * dropped first, so they cost nothing further this frame.
+        *
+        * Requests are radix sorted by their draw keys, which groups them by pipeline,
+        * then material and mesh. Every run of requests with the same material and
+        * mesh becomes one instanced draw with its own instance data.
+        *
+        * Retained requests are already in order, so they're merged in with the
+        * sorted scheduled requests rather than sorted again.
+        *
+        * Last frame's hierarchy is dropped first. Everything is built in the pass's
+        * frame arena so a frame that is no bigger than the last one never allocates.
+        *
+        * \param scheduler Scheduler to spread a large cull and sort across, or nullptr to stay on this thread
+        * \param cull False to keep every request, such as when the GPU culls them instead
         */
-        void RenderPassBase::BuildRenderRequestHeirarchy()
+        void RenderPassBase::BuildRenderRequestHeirarchy(JobScheduler* scheduler, bool cull)
         {
-            uint32_t i;
+            gatherRenderRequests();
+
+            resetFrameData();
 
-            //Clear past request data
-            for (i = 0; i < m_renderRequests.size(); i++)
+            const size_t scheduledCount = m_renderRequests.size();
+            const Frustum frustum(m_view, m_proj);
+
+            FrameVector<uint8_t> scheduledVisible(scheduledCount, 1, FrameAllocator<uint8_t>(&m_frameArena));
+            size_t requestCount = scheduledCount;
+            if (cull)
             {
-                RenderRequest renderRequest = m_renderRequests[i];
+                requestCount = cullSpheres(m_frameArena, frustum, scheduledCount, [this](size_t i) -> const BoundingSphere&
+                {
+                    return m_renderRequests[i].bounds;
+                }, scheduler, scheduledVisible.data());
+            }
 
-                MeshHandle mesh = renderRequest.mesh;
-                PipelineHandle pipeline = renderRequest.pipeline;
+            //Sort keys rather than the requests so no handles are copied around
+            FrameVector<DrawKey> keys(requestCount, DrawKey(), FrameAllocator<DrawKey>(&m_frameArena));
+            FrameVector<DrawKey> scratch(requestCount, DrawKey(), FrameAllocator<DrawKey>(&m_frameArena));
+            for (size_t i = 0, k = 0; i < scheduledCount; i++)
+            {
+                if (!scheduledVisible[i])
+                    continue;
 
-                m_pipelineList[pipeline].clear();
-                m_instanceData[mesh].clear();
+                keys[k].key = m_renderRequests[i].sortKey;
+                keys[k].index = static_cast<uint32_t>(i);
+                k++;
             }
 
-            //Build new requests
-            for (i = 0; i < m_renderRequests.size(); i++)
+            DrawKeySorter::Sort(keys.data(), scratch.data(), requestCount, scheduler);
+
+            std::lock_guard<std::mutex> lock(m_retainedMutex);
+
+            const size_t retainedCount = m_retainedKeys.size();
+            m_retainedOnly = scheduledCount == 0;
+
+            FrameVector<uint8_t> retainedVisible(retainedCount, 1, FrameAllocator<uint8_t>(&m_frameArena));
+            if (cull)
             {
-                RenderRequest renderRequest = m_renderRequests[i];
+                cullSpheres(m_frameArena, frustum, retainedCount, [this](size_t i) -> const BoundingSphere&
+                {
+                    return m_retainedRequests[m_retainedKeys[i].index].request.bounds;
+                }, scheduler, retainedVisible.data());
+            }
 
-                PipelineHandle pipeline = renderRequest.pipeline;
-                MaterialHandle material = renderRequest.material;
-                MeshHandle mesh = renderRequest.mesh;
+            //A recording kept for retained requests is stale once any of them comes into or goes out of view
+            if (m_retainedVisible.size() != retainedCount ||
+                !std::equal(retainedVisible.begin(), retainedVisible.end(), m_retainedVisible.begin()))
+            {
+                m_retainedVisible.assign(retainedVisible.begin(), retainedVisible.end());
+                m_retainedListVersion++;
+            }
 
-                std::vector<RenderableInstances> instances = m_pipelineList[pipeline];
+            size_t r = 0;
+            size_t s = 0;
+            while (r < retainedCount || s < requestCount)
+            {
+                const RenderRequest* request;
+                uint64_t version;
 
-                //If the pipeline maps to an existing material and mesh, lets increment the count
-                bool found = false;
-                for (size_t i = 0; i < instances.size(); i++)
+                //Retained requests go first when keys tie
+                if (s == requestCount || (r < retainedCount && m_retainedKeys[r].key <= keys[s].key))
                 {
-                    Renderable renderable = instances[i].renderable;
-                    if (renderable.material == material && renderable.mesh == mesh)
+                    if (!retainedVisible[r])
                     {
-                        instances[i].count++;
-                        found = true;
-                        break;
+                        r++;
+                        continue;
                     }
+
+                    const RetainedRequest& retained = m_retainedRequests[m_retainedKeys[r++].index];
+                    request = &retained.request;
+                    version = retained.version;
+                }
+                else
+                {
+                    request = &m_renderRequests[keys[s++].index];
+                    version = 0;
                 }
 
-                if (!found)
-                    instances.push_back({ material, mesh, 1 });
+                const RenderRequest& renderRequest = *request;
 
-                m_pipelineList[pipeline] = instances;
+                //Handles are compared as well as keys; ids that wrapped in the key only cost batching
+                if (m_pipelineList.empty() || !(m_pipelineList.back().pipeline == renderRequest.pipeline))
+                    m_pipelineList.push_back({ renderRequest.pipeline, FrameVector<RenderableInstances>(FrameAllocator<RenderableInstances>(&m_frameArena)) });
 
-                //Take the instance data for this mesh and add it to the map of instance data
-                //This is to make sure that different meshes will render in chunks with their own separate instance data
-                ShaderVariableChunk* instanceData = renderRequest.instanceData;
-                m_instanceData[mesh].push_back(instanceData);
+                FrameVector<RenderableInstances>& instances = m_pipelineList.back().renderables;
+
+                //If the last draw has this material and mesh, lets add an instance to it
+                if (!instances.empty())
+                {
+                    RenderableInstances& last = instances.back();
+                    if (last.renderable.material == renderRequest.material && last.renderable.mesh == renderRequest.mesh)
+                    {
+                        last.count++;
+                        m_instanceData[last.instanceIndex].chunks.push_back(renderRequest.instanceData);
+                        m_instanceData[last.instanceIndex].versions.push_back(version);
+                        m_instanceData[last.instanceIndex].bounds.push_back(renderRequest.bounds);
+                        continue;
+                    }
+                }
+
+                //Each draw gets its own instance data, even when another draw shares the mesh
+                instances.push_back({ { renderRequest.material, renderRequest.mesh }, 1, static_cast<uint32_t>(m_instanceData.size()) });
+
+                m_instanceData.push_back({ renderRequest.mesh, FrameVector<ShaderVariableChunk*>(FrameAllocator<ShaderVariableChunk*>(&m_frameArena)),
+                    FrameVector<uint64_t>(FrameAllocator<uint64_t>(&m_frameArena)), FrameVector<BoundingSphere>(FrameAllocator<BoundingSphere>(&m_frameArena)) });
+                m_instanceData.back().chunks.push_back(renderRequest.instanceData);
+                m_instanceData.back().versions.push_back(version);
+                m_instanceData.back().bounds.push_back(renderRequest.bounds);
             }
 
             //Done with render requests so we can clear them
             m_renderRequests.clear();
         }
+
+        /*
+            Private Methods
+        */
+
+        RenderRequest RenderPassBase::makeRenderRequest(MaterialHandle material, MeshHandle mesh, ShaderVariableChunk* instanceVariables,
+            float depth, const BoundingSphere& bounds) const
+        {
+            RenderRequest renderRequest = {};
+
+            renderRequest.pipeline = material->GetPipeline();
+            renderRequest.material = material;
+            renderRequest.mesh = mesh;
+            renderRequest.instanceData = instanceVariables;
+            renderRequest.bounds = bounds;
+            renderRequest.sortKey = DrawKeySorter::MakeKey(renderRequest.pipeline->GetSortID(), material->GetSortID(), mesh->GetSortID(), depth);
+
+            return renderRequest;
+        }
+
+        void RenderPassBase::insertRetainedKey(uint64_t key, RenderRequestID id)
+        {
+            //After every equal key, so requests with the same key keep the order they came in
+            DrawKey drawKey = { key, id };
+            auto it = std::upper_bound(m_retainedKeys.begin(), m_retainedKeys.end(), drawKey, [](const DrawKey& a, const DrawKey& b)
+            {
+                return a.key < b.key;
+            });
+
+            m_retainedKeys.insert(it, drawKey);
+        }
+
+        void RenderPassBase::eraseRetainedKey(uint64_t key, RenderRequestID id)
+        {
+            DrawKey drawKey = { key, id };
+            auto range = std::equal_range(m_retainedKeys.begin(), m_retainedKeys.end(), drawKey, [](const DrawKey& a, const DrawKey& b)
+            {
+                return a.key < b.key;
+            });
+
+            for (auto it = range.first; it != range.second; it++)
+            {
+                if (it->index == id)
+                {
+                    m_retainedKeys.erase(it);
+                    return;
+                }
+            }
+        }
+
+        void RenderPassBase::gatherRenderRequests()
+        {
+            m_submissions.Gather(m_renderRequests);
+        }
+
+        void RenderPassBase::resetFrameData()
+        {
+            //Swap in empty containers so nothing points into the arena once it rewinds;
+            //destroying the old ones releases their handles
+            FrameVector<PipelineRenderables>(FrameAllocator<PipelineRenderables>(&m_frameArena)).swap(m_pipelineList);
+            FrameVector<MeshInstanceData>(FrameAllocator<MeshInstanceData>(&m_frameArena)).swap(m_instanceData);
+
+            m_frameArena.Reset();
+        }
     }
 }
\ No newline at end of file
@@ -15,6 +15,7 @@
 #include <ht_shadervariablechunk.h> //ShaderVariableChunk
 #include <ht_shadervariable.h>      //Resource::ShaderVariable
 #include <cassert>                  //assert
+#include <algorithm>                //std::min, std::max
 
 namespace Hatchit
 {
@@ -47,6 +48,9 @@ namespace Hatchit
                 //increment size counter
                 m_byteDataSize += offset;
             }
+
+            m_dirtyBegin = 0;
+            m_dirtyEnd = m_byteDataSize;
         };
 
         ShaderVariableChunk::~ShaderVariableChunk()
@@ -59,6 +63,7 @@ namespace Hatchit
             BYTE* location = m_byteData + offset;
             assert(location + sizeof(uint32_t) <= m_byteData + m_byteDataSize);
             memcpy(location, &data, sizeof(uint32_t));
+            markDirty(offset, sizeof(uint32_t));
             return true;
         }
 
@@ -67,6 +72,7 @@ namespace Hatchit
             BYTE* location = m_byteData + offset;
             assert(location + sizeof(double) <= m_byteData + m_byteDataSize);
             memcpy(location, &data, sizeof(double));
+            markDirty(offset, sizeof(double));
             return true;
         }
 
@@ -75,6 +81,7 @@ namespace Hatchit
             BYTE* location = m_byteData + offset;
             assert(location + sizeof(float) <= m_byteData + m_byteDataSize);
             memcpy(location, &data, sizeof(float));
+            markDirty(offset, sizeof(float));
             return true;
         }
 
@@ -83,6 +90,7 @@ namespace Hatchit
             BYTE* location = m_byteData + offset;
             assert(location + sizeof(float) * 2 <= m_byteData + m_byteDataSize);
             memcpy(location, &data, sizeof(float) * 2);
+            markDirty(offset, sizeof(float) * 2);
             return true;
         }
 
@@ -91,6 +99,7 @@ namespace Hatchit
             BYTE* location = m_byteData + offset;
             assert(location + sizeof(float) * 3 <= m_byteData + m_byteDataSize);
             memcpy(location, &data, sizeof(float) * 3);
+            markDirty(offset, sizeof(float) * 3);
             return true;
         }
 
@@ -99,6 +108,7 @@ namespace Hatchit
             BYTE* location = m_byteData + offset;
             assert(location + sizeof(float) * 4 <= m_byteData + m_byteDataSize);
             memcpy(location, &data, sizeof(float) * 4);
+            markDirty(offset, sizeof(float) * 4);
             return true;
         }
 
@@ -107,6 +117,7 @@ namespace Hatchit
             BYTE* location = m_byteData + offset;
             assert(location + sizeof(float) * 16 <= m_byteData + m_byteDataSize);
             memcpy(location, &data, sizeof(float) * 16);
+            markDirty(offset, sizeof(float) * 16);
             return true;
         }
 
@@ -119,5 +130,44 @@ namespace Hatchit
         {
             return m_byteDataSize;
         }
+
+        /** Gets whether anything was set since the last ClearDirty
+        * \return True if the dirty range isn't empty
+        */
+        bool ShaderVariableChunk::IsDirty() const
+        {
+            return m_dirtyBegin < m_dirtyEnd;
+        }
+
+        /** Gets the bytes set since the last ClearDirty
+        * \param begin Filled with the first changed byte
+        * \param end Filled with one past the last changed byte
+        */
+        void ShaderVariableChunk::GetDirtyRange(size_t& begin, size_t& end) const
+        {
+            begin = m_dirtyBegin;
+            end = m_dirtyEnd;
+        }
+
+        /** Marks the chunk as copied to wherever it's going
+        */
+        void ShaderVariableChunk::ClearDirty()
+        {
+            m_dirtyBegin = 0;
+            m_dirtyEnd = 0;
+        }
+
+        void ShaderVariableChunk::markDirty(size_t offset, size_t size)
+        {
+            if (m_dirtyBegin >= m_dirtyEnd)
+            {
+                m_dirtyBegin = offset;
+                m_dirtyEnd = offset + size;
+                return;
+            }
+
+            m_dirtyBegin = std::min(m_dirtyBegin, offset);
+            m_dirtyEnd = std::max(m_dirtyEnd, offset + size);
+        }
     }
 }
@@ -0,0 +1,50 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+#include <ht_sortidpool.h>  //SortIDPool
+
+namespace Hatchit
+{
+    namespace Graphics
+    {
+        SortIDPool::SortIDPool()
+        {
+            m_next = 0;
+        }
+
+        /** Takes an id, reusing the most recently freed one if there is one
+        * \return An id no other live resource in this pool has
+        */
+        uint32_t SortIDPool::Acquire()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            if (m_free.empty())
+                return m_next++;
+
+            uint32_t id = m_free.back();
+            m_free.pop_back();
+            return id;
+        }
+
+        /** Gives an id back to the pool
+        * \param id An id from Acquire that nothing uses anymore
+        */
+        void SortIDPool::Release(uint32_t id)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_free.push_back(id);
+        }
+    }
+}
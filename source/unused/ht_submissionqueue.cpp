@@ -0,0 +1,71 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+#include <ht_submissionqueue.h>
+
+namespace Hatchit
+{
+    namespace Graphics
+    {
+        //Slots handed back by threads that have exited, reused before any new one
+        static std::mutex               _SlotMutex;
+        static std::vector<uint32_t>    _FreeSlots;
+        static uint32_t                 _NextSlot = 0;
+
+        //Takes a slot when a thread first pushes and gives it back when the thread exits
+        struct ThreadSlot
+        {
+            uint32_t index;
+
+            ThreadSlot()
+            {
+                std::lock_guard<std::mutex> lock(_SlotMutex);
+                if (!_FreeSlots.empty())
+                {
+                    index = _FreeSlots.back();
+                    _FreeSlots.pop_back();
+                }
+                else if (_NextSlot < SubmitSlots::MaxSlots)
+                    index = _NextSlot++;
+                else
+                    index = SubmitSlots::MaxSlots;
+            }
+
+            ~ThreadSlot()
+            {
+                if (index >= SubmitSlots::MaxSlots)
+                    return;
+
+                //What this thread pushed stays in its buffers for the next thread given the slot;
+                //handing the slot over under the lock orders those writes before the new thread's
+                std::lock_guard<std::mutex> lock(_SlotMutex);
+                _FreeSlots.push_back(index);
+            }
+        };
+
+        static thread_local ThreadSlot t_slot;
+
+        /** Gets the slot of the calling thread
+        *
+        * The slot is taken on the first call from a thread and held until
+        * the thread exits.
+        *
+        * \return The slot, or MaxSlots if every slot is held by a live thread
+        */
+        uint32_t SubmitSlots::ThisThread()
+        {
+            return t_slot.index;
+        }
+    }
+}
@@ -36,5 +36,25 @@ namespace Hatchit
             return m_height;
         }
 
+        /** Get the number of frames that may be in flight at once
+        *
+        * Anything the CPU writes per frame should be kept in this many copies
+        * and indexed with GetCurrentFrame().
+        *
+        * \return The number of frame slots as a uint32_t
+        */
+        uint32_t SwapChain::GetFrameCount() const
+        {
+            return m_frameCount;
+        }
+
+        /** Get the index of the frame slot currently being recorded
+        * \return The current frame slot in the range [0, GetFrameCount())
+        */
+        uint32_t SwapChain::GetCurrentFrame() const
+        {
+            return m_currentFrame;
+        }
+
     }
 }
@@ -0,0 +1,217 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+#include <ht_vkattachmentaliaser.h>
+#include <ht_vktools.h>
+#include <ht_vkdeletionqueue.h>
+#include <ht_debug.h>
+#include <algorithm>    //std::sort, std::max
+#include <cassert>
+
+namespace Hatchit {
+
+    namespace Graphics {
+
+        namespace Vulkan {
+
+            VKAttachmentAliaser::VKAttachmentAliaser()
+            {
+                m_device = VK_NULL_HANDLE;
+                m_stats = {};
+            }
+
+            VKAttachmentAliaser::~VKAttachmentAliaser()
+            {
+                DeInitialize();
+            }
+
+            /** Prepares the aliaser for a device
+            * \param device The device attachments are created on
+            * \return True
+            */
+            bool VKAttachmentAliaser::Initialize(VkDevice device)
+            {
+                m_device = device;
+                m_stats = {};
+
+                return true;
+            }
+
+            /** Retires all memory handed out by the last Build
+            */
+            void VKAttachmentAliaser::DeInitialize()
+            {
+                release();
+            }
+
+            /** Binds memory to every requested attachment
+            *
+            * Memory from the previous Build is retired, so every attachment
+            * bound by it must have been retired or rebuilt first.
+            *
+            * \param requests The attachments and their lifetimes; aliased is filled in
+            * \return True if every attachment was bound
+            */
+            bool VKAttachmentAliaser::Build(std::vector<VKAttachmentRequest>& requests)
+            {
+                release();
+
+                m_stats = {};
+                m_stats.attachments = static_cast<uint32_t>(requests.size());
+
+                std::vector<VkMemoryRequirements> requirements(requests.size());
+                std::vector<VKAttachmentRequest*> placed;
+
+                for (size_t i = 0; i < requests.size(); i++)
+                {
+                    VKAttachmentRequest& request = requests[i];
+                    request.aliased = false;
+
+                    vkGetImageMemoryRequirements(m_device, request.image, &requirements[i]);
+                    m_stats.bytesRequested += requirements[i].size;
+
+                    //Lazily allocated memory only ever backs what the tiles actually touch
+                    uint32_t lazyType = 0;
+                    if (request.transient && VKTools::MemoryTypeFromProperties(requirements[i].memoryTypeBits, VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, &lazyType))
+                    {
+                        VKAllocation allocation = {};
+                        if (VKTools::GetAllocator().Allocate(requirements[i], VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, false, allocation, VKMemoryCategory::Attachment))
+                        {
+                            m_allocations.push_back(allocation);
+                            if (!bind(request.image, allocation))
+                                return false;
+
+                            m_stats.lazyAttachments++;
+                            m_stats.bytesLazy += requirements[i].size;
+                            continue;
+                        }
+                    }
+
+                    placed.push_back(&request);
+                }
+
+                //Largest first so the big attachments decide each heap's size
+                std::vector<size_t> order(placed.size());
+                for (size_t i = 0; i < order.size(); i++)
+                    order[i] = static_cast<size_t>(placed[i] - requests.data());
+                std::sort(order.begin(), order.end(), [&requirements](size_t a, size_t b)
+                {
+                    return requirements[a].size > requirements[b].size;
+                });
+
+                std::vector<Heap> heaps;
+                for (size_t i = 0; i < order.size(); i++)
+                {
+                    VKAttachmentRequest& request = requests[order[i]];
+                    const VkMemoryRequirements& reqs = requirements[order[i]];
+
+                    Heap* target = nullptr;
+                    for (size_t h = 0; h < heaps.size() && target == nullptr; h++)
+                    {
+                        Heap& heap = heaps[h];
+                        if ((heap.requirements.memoryTypeBits & reqs.memoryTypeBits) == 0)
+                            continue;
+
+                        bool overlaps = false;
+                        for (size_t u = 0; u < heap.users.size() && !overlaps; u++)
+                        {
+                            const VKAttachmentRequest* user = heap.users[u];
+                            overlaps = request.firstPass <= user->lastPass && user->firstPass <= request.lastPass;
+                        }
+
+                        if (!overlaps)
+                            target = &heap;
+                    }
+
+                    if (target == nullptr)
+                    {
+                        Heap heap;
+                        heap.requirements = reqs;
+                        heaps.push_back(heap);
+                        target = &heaps.back();
+                    }
+                    else
+                    {
+                        target->requirements.size = std::max(target->requirements.size, reqs.size);
+                        target->requirements.alignment = std::max(target->requirements.alignment, reqs.alignment);
+                        target->requirements.memoryTypeBits &= reqs.memoryTypeBits;
+                    }
+
+                    target->users.push_back(&request);
+                }
+
+                for (size_t h = 0; h < heaps.size(); h++)
+                {
+                    Heap& heap = heaps[h];
+
+                    VKAllocation allocation = {};
+                    if (!VKTools::GetAllocator().Allocate(heap.requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false, allocation, VKMemoryCategory::Attachment))
+                    {
+                        HT_ERROR_PRINTF("VKAttachmentAliaser::Build(): Failed to allocate attachment memory\n");
+                        return false;
+                    }
+                    m_allocations.push_back(allocation);
+
+                    for (size_t u = 0; u < heap.users.size(); u++)
+                    {
+                        heap.users[u]->aliased = heap.users.size() > 1;
+                        if (!bind(heap.users[u]->image, allocation))
+                            return false;
+                    }
+
+                    m_stats.bytesAllocated += heap.requirements.size;
+                }
+
+                m_stats.heaps = static_cast<uint32_t>(heaps.size());
+                m_stats.bytesSaved = m_stats.bytesRequested - m_stats.bytesAllocated;
+
+                HT_DEBUG_PRINTF("VKAttachmentAliaser::Build(): %d attachments in %d heaps and %d lazy; %llu KB requested, %llu KB allocated, %llu KB saved\n",
+                    m_stats.attachments, m_stats.heaps, m_stats.lazyAttachments,
+                    static_cast<unsigned long long>(m_stats.bytesRequested / 1024),
+                    static_cast<unsigned long long>(m_stats.bytesAllocated / 1024),
+                    static_cast<unsigned long long>(m_stats.bytesSaved / 1024));
+
+                return true;
+            }
+
+            /** Gets how much memory the last Build needed and saved
+            * \return A copy of the stats
+            */
+            VKAttachmentStats VKAttachmentAliaser::GetStats() const { return m_stats; }
+
+            void VKAttachmentAliaser::release()
+            {
+                //Frames in flight may still be rendering into this memory
+                for (size_t i = 0; i < m_allocations.size(); i++)
+                    VKDeletionQueue::RetireImage(VK_NULL_HANDLE, VK_NULL_HANDLE, m_allocations[i]);
+                m_allocations.clear();
+            }
+
+            bool VKAttachmentAliaser::bind(VkImage image, const VKAllocation& allocation)
+            {
+                VkResult err;
+
+                err = vkBindImageMemory(m_device, image, allocation.memory, allocation.offset);
+                assert(!err);
+                if (err != VK_SUCCESS)
+                {
+                    HT_ERROR_PRINTF("VKAttachmentAliaser::bind(): Failed to bind attachment memory\n");
+                    return false;
+                }
+
+                return true;
+            }
+        }
+    }
+}
@@ -0,0 +1,309 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+#include <ht_vkbufferpool.h>
+#include <ht_vktools.h>
+#include <ht_debug.h>
+#include <cassert>
+
+namespace Hatchit {
+
+    namespace Graphics {
+
+        namespace Vulkan {
+
+            VKBufferPool::VKBufferPool()
+            {
+                m_device = VK_NULL_HANDLE;
+                m_usage = 0;
+                m_bufferSize = DefaultBufferSize;
+                m_category = VKMemoryCategory::Other;
+                m_properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+            }
+
+            VKBufferPool::~VKBufferPool()
+            {
+                DeInitialize();
+            }
+
+            /** Sets up the pool; buffers are only created once they're needed
+            * \param device The device to create buffers on
+            * \param usage What the pooled buffers will be bound as; transfer destination is added
+            * \param queueFamilies Every queue family that touches the buffers
+            * \param category What the pooled buffers hold, for memory accounting
+            * \param properties The memory properties of the pooled buffers
+            * \param bufferSize The size of each large buffer
+            * \return True if the pool is ready
+            */
+            bool VKBufferPool::Initialize(VkDevice device, VkBufferUsageFlags usage, const std::vector<uint32_t>& queueFamilies,
+                VKMemoryCategory category, VkMemoryPropertyFlags properties, VkDeviceSize bufferSize)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                m_device = device;
+                m_usage = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+                m_queueFamilies = queueFamilies;
+                m_bufferSize = bufferSize;
+                m_category = category;
+                m_properties = properties;
+
+                return true;
+            }
+
+            /** Destroys every pooled buffer
+            *
+            * Nothing may still be using any range from the pool.
+            */
+            void VKBufferPool::DeInitialize()
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                for (size_t i = 0; i < m_buffers.size(); i++)
+                {
+                    VKTools::DeleteUniformBuffer(m_buffers[i]->block);
+                    delete m_buffers[i];
+                }
+                m_buffers.clear();
+            }
+
+            /** Takes a range out of one of the pooled buffers
+            * \param size The size of the range
+            * \param alignment The alignment the range's offset needs
+            * \param block Filled with the shared buffer; descriptor.offset and descriptor.range give the range
+            * \return True if a range was found or a new buffer could be made
+            */
+            bool VKBufferPool::Allocate(VkDeviceSize size, VkDeviceSize alignment, UniformBlock_vk& block)
+            {
+                if (size > m_bufferSize)
+                    return false;
+
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                for (size_t i = 0; i < m_buffers.size(); i++)
+                {
+                    if (allocateFrom(m_buffers[i], size, alignment, block))
+                        return true;
+                }
+
+                PoolBuffer* buffer = createBuffer();
+                if (buffer == nullptr)
+                    return false;
+
+                return allocateFrom(buffer, size, alignment, block);
+            }
+
+            /** Returns a range to its buffer
+            * \param block A block handed out by Allocate
+            */
+            void VKBufferPool::Free(const UniformBlock_vk& block)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                for (size_t i = 0; i < m_buffers.size(); i++)
+                {
+                    PoolBuffer* buffer = m_buffers[i];
+                    if (buffer->block.buffer != block.buffer)
+                        continue;
+
+                    auto it = buffer->allocated.find(block.descriptor.offset);
+                    if (it == buffer->allocated.end())
+                    {
+                        HT_ERROR_PRINTF("VKBufferPool::Free(): Range was not allocated from this pool\n");
+                        return;
+                    }
+
+                    VkDeviceSize start = it->second.start;
+                    VkDeviceSize end = it->second.end;
+                    buffer->allocated.erase(it);
+
+                    //Merge with the free ranges on either side
+                    auto next = buffer->free.lower_bound(start);
+                    if (next != buffer->free.end() && next->first == end)
+                    {
+                        end = next->second;
+                        next = buffer->free.erase(next);
+                    }
+                    if (next != buffer->free.begin())
+                    {
+                        auto prev = std::prev(next);
+                        if (prev->second == start)
+                        {
+                            start = prev->first;
+                            buffer->free.erase(prev);
+                        }
+                    }
+
+                    buffer->free[start] = end;
+                    return;
+                }
+
+                HT_ERROR_PRINTF("VKBufferPool::Free(): Buffer does not belong to this pool\n");
+            }
+
+            /** Gets whether a block's buffer is one of the pooled buffers
+            * \param block The block to check
+            * \return True if the block was handed out by this pool
+            */
+            bool VKBufferPool::Owns(const UniformBlock_vk& block) const
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                for (size_t i = 0; i < m_buffers.size(); i++)
+                {
+                    if (m_buffers[i]->block.buffer == block.buffer)
+                        return true;
+                }
+
+                return false;
+            }
+
+            /** Gets the memory behind the pooled buffer a block is a range of
+            * \param block A block handed out by Allocate
+            * \param allocation Filled with the whole buffer's allocation
+            * \return True if the block belongs to this pool
+            */
+            bool VKBufferPool::GetMemory(const UniformBlock_vk& block, VKAllocation& allocation) const
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                for (size_t i = 0; i < m_buffers.size(); i++)
+                {
+                    if (m_buffers[i]->block.buffer == block.buffer)
+                    {
+                        allocation = m_buffers[i]->block.allocation;
+                        return true;
+                    }
+                }
+
+                return false;
+            }
+
+            /** Gets the size of each pooled buffer
+            * \return The largest range the pool can hand out
+            */
+            VkDeviceSize VKBufferPool::GetBufferSize() const { return m_bufferSize; }
+
+            /** Gets how full the pool is
+            * \return A snapshot of the pool's stats
+            */
+            VKBufferPoolStats VKBufferPool::GetStats() const
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                VKBufferPoolStats stats = {};
+                stats.bufferCount = static_cast<uint32_t>(m_buffers.size());
+
+                for (size_t i = 0; i < m_buffers.size(); i++)
+                {
+                    const PoolBuffer* buffer = m_buffers[i];
+
+                    stats.rangeCount += static_cast<uint32_t>(buffer->allocated.size());
+                    for (auto it = buffer->allocated.begin(); it != buffer->allocated.end(); it++)
+                        stats.bytesUsed += it->second.end - it->second.start;
+                    for (auto it = buffer->free.begin(); it != buffer->free.end(); it++)
+                        stats.bytesFree += it->second - it->first;
+                }
+
+                return stats;
+            }
+
+            bool VKBufferPool::allocateFrom(PoolBuffer* buffer, VkDeviceSize size, VkDeviceSize alignment, UniformBlock_vk& block)
+            {
+                if (alignment == 0)
+                    alignment = 1;
+
+                //First fit
+                for (auto it = buffer->free.begin(); it != buffer->free.end(); it++)
+                {
+                    VkDeviceSize start = it->first;
+                    VkDeviceSize end = it->second;
+                    VkDeviceSize offset = ((start + alignment - 1) / alignment) * alignment;
+
+                    if (offset + size > end)
+                        continue;
+
+                    buffer->free.erase(it);
+                    if (offset + size < end)
+                        buffer->free[offset + size] = end;
+
+                    Range range;
+                    range.start = start;
+                    range.end = offset + size;
+                    buffer->allocated[offset] = range;
+
+                    //The memory belongs to the pool so the block carries no allocation of its own
+                    block = {};
+                    if (buffer->block.allocation.mapped != nullptr)
+                        block.allocation.mapped = static_cast<uint8_t*>(buffer->block.allocation.mapped) + offset;
+                    block.buffer = buffer->block.buffer;
+                    block.descriptor.buffer = buffer->block.buffer;
+                    block.descriptor.offset = offset;
+                    block.descriptor.range = size;
+
+                    return true;
+                }
+
+                return false;
+            }
+
+            VKBufferPool::PoolBuffer* VKBufferPool::createBuffer()
+            {
+                VkResult err;
+
+                PoolBuffer* buffer = new PoolBuffer;
+                buffer->block = {};
+
+                VkBufferCreateInfo bufferCreateInfo = {};
+                bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+                bufferCreateInfo.usage = m_usage;
+                bufferCreateInfo.size = m_bufferSize;
+
+                //Shared between the copy and graphics families without ownership transfers
+                if (m_queueFamilies.size() > 1)
+                {
+                    bufferCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+                    bufferCreateInfo.queueFamilyIndexCount = static_cast<uint32_t>(m_queueFamilies.size());
+                    bufferCreateInfo.pQueueFamilyIndices = m_queueFamilies.data();
+                }
+
+                err = vkCreateBuffer(m_device, &bufferCreateInfo, nullptr, &buffer->block.buffer);
+                assert(!err);
+                if (err != VK_SUCCESS)
+                {
+                    HT_ERROR_PRINTF("VKBufferPool::createBuffer(): Failed to create buffer\n");
+                    delete buffer;
+                    return nullptr;
+                }
+
+                if (!VKTools::GetAllocator().AllocateForBuffer(buffer->block.buffer, m_properties, buffer->block.allocation, m_category))
+                {
+                    HT_ERROR_PRINTF("VKBufferPool::createBuffer(): Failed to allocate memory\n");
+                    vkDestroyBuffer(m_device, buffer->block.buffer, nullptr);
+                    delete buffer;
+                    return nullptr;
+                }
+
+                buffer->block.descriptor.buffer = buffer->block.buffer;
+                buffer->block.descriptor.offset = 0;
+                buffer->block.descriptor.range = m_bufferSize;
+
+                buffer->free[0] = m_bufferSize;
+
+                m_buffers.push_back(buffer);
+
+                return buffer;
+            }
+        }
+    }
+}
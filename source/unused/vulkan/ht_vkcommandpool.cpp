@@ -13,6 +13,7 @@
 **/
 
 #include <ht_vkcommandpool.h>
+#include <chrono>   //std::chrono
 
 namespace Hatchit
 {
@@ -25,6 +26,9 @@ namespace Hatchit
                 m_device = device;
 
                 m_commandPool = VK_NULL_HANDLE;
+
+                m_primaryUsed = 0;
+                m_secondaryUsed = 0;
             }
 
             VKCommandPool::~VKCommandPool() 
@@ -32,7 +36,7 @@ namespace Hatchit
                 //Reset all pool memory
                 vkResetCommandPool(m_device, m_commandPool, VK_COMMAND_POOL_RESET_RELEASE_RESOURCES_BIT);
 
-                //Delete the pool
+                //Delete the pool; this frees every buffer allocated from it
                 vkDestroyCommandPool(m_device, m_commandPool, nullptr);
             }
 
@@ -43,7 +47,8 @@ namespace Hatchit
                 commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
                 commandPoolInfo.pNext = nullptr;
                 commandPoolInfo.queueFamilyIndex = 0;
-                commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+                //Buffers are short lived and only reset with the whole pool
+                commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
 
                 VkResult err = vkCreateCommandPool(m_device, &commandPoolInfo, nullptr, &m_commandPool);
                 assert(!err);
@@ -56,10 +61,109 @@ namespace Hatchit
                 return true;
             }
 
+            /** Resets every command buffer allocated from this pool at once
+            *
+            * Must only be called once the GPU has finished with every buffer
+            * handed out since the last reset, i.e. after the frame fence for
+            * this pool has signaled. The buffers are kept and handed out
+            * again by AcquireCommandBuffer.
+            *
+            * \return True if the pool was reset
+            */
+            bool VKCommandPool::VReset()
+            {
+                VkResult err = vkResetCommandPool(m_device, m_commandPool, 0);
+                assert(!err);
+                if (err != VK_SUCCESS)
+                {
+                    HT_ERROR_PRINTF("VKCommandPool::VReset(): Failed to reset command pool!\n");
+                    return false;
+                }
+
+                m_primaryUsed = 0;
+                m_secondaryUsed = 0;
+                m_stats.resets++;
+
+                return true;
+            }
+
             VkCommandPool VKCommandPool::GetVKCommandPool() const
             {
                 return m_commandPool;
             }
+
+            /** Gets a command buffer in the initial state that is valid until the next reset
+            * \param level Whether the buffer will be primary or secondary
+            * \return A recycled or newly allocated buffer; VK_NULL_HANDLE on failure
+            */
+            VkCommandBuffer VKCommandPool::AcquireCommandBuffer(VkCommandBufferLevel level)
+            {
+                const bool primary = level == VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+                std::vector<VkCommandBuffer>& buffers = primary ? m_primaryBuffers : m_secondaryBuffers;
+                size_t& used = primary ? m_primaryUsed : m_secondaryUsed;
+
+                if (used < buffers.size())
+                {
+                    m_stats.allocationsAvoided++;
+                    return buffers[used++];
+                }
+
+                VkCommandBufferAllocateInfo allocateInfo = {};
+                allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+                allocateInfo.pNext = nullptr;
+                allocateInfo.commandPool = m_commandPool;
+                allocateInfo.level = level;
+                allocateInfo.commandBufferCount = 1;
+
+                VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+                VkResult err = vkAllocateCommandBuffers(m_device, &allocateInfo, &commandBuffer);
+                assert(!err);
+                if (err != VK_SUCCESS)
+                {
+                    HT_ERROR_PRINTF("VKCommandPool::AcquireCommandBuffer(): Failed to allocate command buffer!\n");
+                    return VK_NULL_HANDLE;
+                }
+
+                m_stats.allocations++;
+
+                buffers.push_back(commandBuffer);
+                used++;
+
+                return commandBuffer;
+            }
+
+            /** Begins recording a command buffer from this pool and records how long it took
+            * \param commandBuffer The buffer to begin
+            * \param beginInfo The begin info to pass through to Vulkan
+            * \return The result of vkBeginCommandBuffer
+            */
+            VkResult VKCommandPool::BeginCommandBuffer(VkCommandBuffer commandBuffer, const VkCommandBufferBeginInfo& beginInfo)
+            {
+                auto start = std::chrono::high_resolution_clock::now();
+
+                VkResult err = vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+                m_stats.recordNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::high_resolution_clock::now() - start).count();
+
+                return err;
+            }
+
+            /** Ends recording a command buffer from this pool and records how long it took
+            * \param commandBuffer The buffer to end
+            * \return The result of vkEndCommandBuffer
+            */
+            VkResult VKCommandPool::EndCommandBuffer(VkCommandBuffer commandBuffer)
+            {
+                auto start = std::chrono::high_resolution_clock::now();
+
+                VkResult err = vkEndCommandBuffer(commandBuffer);
+
+                m_stats.recordNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::high_resolution_clock::now() - start).count();
+
+                return err;
+            }
         }
     }
 }
\ No newline at end of file
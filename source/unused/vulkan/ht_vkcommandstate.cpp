@@ -0,0 +1,294 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+#include <ht_vkcommandstate.h>
+#include <cstring>      //memcmp, memcpy & memset
+
+namespace Hatchit {
+
+    namespace Graphics {
+
+        namespace Vulkan {
+
+            VKCommandState::VKCommandState(VkCommandBuffer commandBuffer)
+            {
+                m_commandBuffer = commandBuffer;
+                m_stats = {};
+
+                m_pipeline = VK_NULL_HANDLE;
+                m_layout = VK_NULL_HANDLE;
+                for (uint32_t i = 0; i < MaxDescriptorSets; i++)
+                    m_sets[i] = VK_NULL_HANDLE;
+
+                for (uint32_t i = 0; i < MaxVertexBindings; i++)
+                {
+                    m_vertexBuffers[i] = VK_NULL_HANDLE;
+                    m_vertexOffsets[i] = 0;
+                }
+
+                m_indexBuffer = VK_NULL_HANDLE;
+                m_indexOffset = 0;
+                m_indexType = VK_INDEX_TYPE_UINT32;
+
+                m_pushStages = 0;
+                memset(m_pushValid, 0, sizeof(m_pushValid));
+
+                m_viewport = {};
+                m_scissor = {};
+                m_viewportSet = false;
+                m_scissorSet = false;
+            }
+
+            /** Binds a graphics pipeline unless it's already bound
+            * \param pipeline The pipeline to bind
+            */
+            void VKCommandState::BindPipeline(VkPipeline pipeline)
+            {
+                if (pipeline == m_pipeline)
+                {
+                    m_stats.bindsElided++;
+                    return;
+                }
+
+                vkCmdBindPipeline(m_commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+                m_pipeline = pipeline;
+                m_stats.bindsIssued++;
+            }
+
+            /** Binds graphics descriptor sets, leaving out the ones already bound
+            *
+            * Only the span from the first to the last set that differs is
+            * recorded, in one call.
+            *
+            * \param layout The pipeline layout the sets are bound with
+            * \param firstSet The set index of the first set
+            * \param setCount How many consecutive sets to bind
+            * \param sets The sets to bind
+            */
+            void VKCommandState::BindDescriptorSets(VkPipelineLayout layout, uint32_t firstSet, uint32_t setCount, const VkDescriptorSet* sets)
+            {
+                if (setCount == 0)
+                    return;
+
+                setLayout(layout);
+
+                //Too high to track; always bind
+                if (firstSet + setCount > MaxDescriptorSets)
+                {
+                    vkCmdBindDescriptorSets(m_commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, firstSet, setCount, sets, 0, nullptr);
+                    m_stats.bindsIssued++;
+                    return;
+                }
+
+                uint32_t first = setCount;
+                uint32_t last = 0;
+                for (uint32_t i = 0; i < setCount; i++)
+                {
+                    if (m_sets[firstSet + i] == sets[i])
+                        continue;
+
+                    if (first == setCount)
+                        first = i;
+                    last = i;
+                }
+
+                if (first == setCount)
+                {
+                    m_stats.bindsElided++;
+                    return;
+                }
+
+                vkCmdBindDescriptorSets(m_commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, firstSet + first, last - first + 1, sets + first, 0, nullptr);
+                m_stats.bindsIssued++;
+
+                for (uint32_t i = first; i <= last; i++)
+                    m_sets[firstSet + i] = sets[i];
+            }
+
+            /** Binds one vertex buffer unless it's already bound at the same offset
+            * \param binding The vertex input binding
+            * \param buffer The buffer to bind
+            * \param offset Where in the buffer the binding starts
+            */
+            void VKCommandState::BindVertexBuffer(uint32_t binding, VkBuffer buffer, VkDeviceSize offset)
+            {
+                if (binding < MaxVertexBindings)
+                {
+                    if (m_vertexBuffers[binding] == buffer && m_vertexOffsets[binding] == offset)
+                    {
+                        m_stats.bindsElided++;
+                        return;
+                    }
+
+                    m_vertexBuffers[binding] = buffer;
+                    m_vertexOffsets[binding] = offset;
+                }
+
+                vkCmdBindVertexBuffers(m_commandBuffer, binding, 1, &buffer, &offset);
+                m_stats.bindsIssued++;
+            }
+
+            /** Binds an index buffer unless it's already bound the same way
+            * \param buffer The buffer to bind
+            * \param offset Where in the buffer the indices start
+            * \param indexType The size of each index
+            */
+            void VKCommandState::BindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType)
+            {
+                if (m_indexBuffer == buffer && m_indexOffset == offset && m_indexType == indexType)
+                {
+                    m_stats.bindsElided++;
+                    return;
+                }
+
+                vkCmdBindIndexBuffer(m_commandBuffer, buffer, offset, indexType);
+                m_indexBuffer = buffer;
+                m_indexOffset = offset;
+                m_indexType = indexType;
+                m_stats.bindsIssued++;
+            }
+
+            /** Pushes constants unless the same bytes were already pushed to the same stages
+            * \param layout The pipeline layout the constants are pushed with
+            * \param stages The shader stages that read the constants
+            * \param offset Where in push constant memory the data goes
+            * \param size How many bytes to push
+            * \param data The bytes to push
+            */
+            void VKCommandState::PushConstants(VkPipelineLayout layout, VkShaderStageFlags stages, uint32_t offset, uint32_t size, const void* data)
+            {
+                if (size == 0)
+                    return;
+
+                setLayout(layout);
+
+                if (offset + size > MaxPushConstantBytes)
+                {
+                    vkCmdPushConstants(m_commandBuffer, layout, stages, offset, size, data);
+                    m_stats.bindsIssued++;
+                    return;
+                }
+
+                if (stages != m_pushStages)
+                {
+                    memset(m_pushValid, 0, sizeof(m_pushValid));
+                    m_pushStages = stages;
+                }
+
+                bool pushed = memcmp(m_pushData + offset, data, size) == 0;
+                for (uint32_t i = offset; i < offset + size && pushed; i++)
+                    pushed = m_pushValid[i];
+
+                if (pushed)
+                {
+                    m_stats.bindsElided++;
+                    return;
+                }
+
+                vkCmdPushConstants(m_commandBuffer, layout, stages, offset, size, data);
+                m_stats.bindsIssued++;
+
+                memcpy(m_pushData + offset, data, size);
+                memset(m_pushValid + offset, 1, size);
+            }
+
+            /** Sets the first viewport unless it's already set to the same one
+            * \param viewport The viewport to set
+            */
+            void VKCommandState::SetViewport(const VkViewport& viewport)
+            {
+                if (m_viewportSet && memcmp(&m_viewport, &viewport, sizeof(VkViewport)) == 0)
+                {
+                    m_stats.bindsElided++;
+                    return;
+                }
+
+                vkCmdSetViewport(m_commandBuffer, 0, 1, &viewport);
+                m_viewport = viewport;
+                m_viewportSet = true;
+                m_stats.bindsIssued++;
+            }
+
+            /** Sets the first scissor unless it's already set to the same one
+            * \param scissor The scissor to set
+            */
+            void VKCommandState::SetScissor(const VkRect2D& scissor)
+            {
+                if (m_scissorSet && memcmp(&m_scissor, &scissor, sizeof(VkRect2D)) == 0)
+                {
+                    m_stats.bindsElided++;
+                    return;
+                }
+
+                vkCmdSetScissor(m_commandBuffer, 0, 1, &scissor);
+                m_scissor = scissor;
+                m_scissorSet = true;
+                m_stats.bindsIssued++;
+            }
+
+            /** Records an indexed draw with whatever is bound
+            * \param indexCount How many indices to draw
+            * \param instanceCount How many instances to draw
+            * \param firstIndex The first index to draw
+            * \param vertexOffset Added to every index
+            * \param firstInstance The first instance to draw
+            */
+            void VKCommandState::DrawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance)
+            {
+                vkCmdDrawIndexed(m_commandBuffer, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+                m_stats.draws++;
+            }
+
+            /** Records indexed draws whose parameters are read from a buffer
+            *
+            * Counted as one draw however many commands it reads, since it's
+            * only recorded once.
+            *
+            * \param buffer The buffer holding VkDrawIndexedIndirectCommands
+            * \param offset Where the first command is
+            * \param drawCount How many commands to draw
+            * \param stride Bytes from one command to the next
+            */
+            void VKCommandState::DrawIndexedIndirect(VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount, uint32_t stride)
+            {
+                vkCmdDrawIndexedIndirect(m_commandBuffer, buffer, offset, drawCount, stride);
+                m_stats.draws++;
+            }
+
+            VkCommandBuffer VKCommandState::GetVkCommandBuffer() const { return m_commandBuffer; }
+
+            /** Gets how many draws and binds were recorded and how many binds were skipped
+            * \return The counts since this state was created
+            */
+            const RecordStats& VKCommandState::GetStats() const { return m_stats; }
+
+            /*
+                Private methods
+            */
+
+            void VKCommandState::setLayout(VkPipelineLayout layout)
+            {
+                if (layout == m_layout)
+                    return;
+
+                //Sets and push constants bound under another layout can't be counted on
+                for (uint32_t i = 0; i < MaxDescriptorSets; i++)
+                    m_sets[i] = VK_NULL_HANDLE;
+                memset(m_pushValid, 0, sizeof(m_pushValid));
+
+                m_layout = layout;
+            }
+        }
+    }
+}
@@ -0,0 +1,346 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+#include <ht_vkdeletionqueue.h>
+#include <ht_vktools.h>
+#include <ht_debug.h>
+
+namespace Hatchit {
+
+    namespace Graphics {
+
+        namespace Vulkan {
+
+            VkDevice                                VKDeletionQueue::m_device = VK_NULL_HANDLE;
+            VKTimeline*                             VKDeletionQueue::m_timeline = nullptr;
+            std::mutex                              VKDeletionQueue::m_mutex;
+            std::deque<VKDeletionQueue::Retired>    VKDeletionQueue::m_retired;
+            DeletionQueueStats                      VKDeletionQueue::m_stats = {};
+
+            /** Starts deferring deletions against a queue's timeline
+            * \param device The device every retired object belongs to
+            * \param queue The queue whose submissions use the retired objects
+            * \return True if the queue could be used
+            */
+            bool VKDeletionQueue::Initialize(const VkDevice& device, VKQueue* queue)
+            {
+                if (queue == nullptr)
+                {
+                    HT_ERROR_PRINTF("VKDeletionQueue::Initialize: Must be given a valid queue\n");
+                    return false;
+                }
+
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                m_device = device;
+                m_timeline = &queue->GetTimeline();
+                m_stats = {};
+
+                return true;
+            }
+
+            /** Waits for the queue and destroys everything still pending
+            *
+            * Anything retired afterwards is destroyed immediately.
+            */
+            void VKDeletionQueue::DeInitialize()
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                if (m_timeline != nullptr)
+                    m_timeline->WaitIdle();
+
+                for (size_t i = 0; i < m_retired.size(); i++)
+                    destroy(m_retired[i]);
+                m_retired.clear();
+
+                m_stats.bytesReleased += m_stats.bytesPending;
+                m_stats.objectsPending = 0;
+                m_stats.bytesPending = 0;
+
+                m_timeline = nullptr;
+            }
+
+            /** Retires a buffer and its memory
+            * \param uniformBlock The buffer to retire
+            * \param value The timeline value after which the buffer is unused
+            */
+            void VKDeletionQueue::RetireBuffer(const UniformBlock_vk& uniformBlock, uint64_t value)
+            {
+                if (uniformBlock.buffer == VK_NULL_HANDLE && uniformBlock.allocation.memory == VK_NULL_HANDLE)
+                    return;
+
+                Retired retired = makeRetired(value);
+                retired.buffer = uniformBlock.buffer;
+                retired.allocation = uniformBlock.allocation;
+                retired.bytes = uniformBlock.allocation.size;
+
+                retire(retired);
+            }
+
+            /** Retires a texel buffer, its view and its memory
+            * \param texelBlock The texel buffer to retire
+            * \param value The timeline value after which the buffer is unused
+            */
+            void VKDeletionQueue::RetireTexelBuffer(const TexelBlock_vk& texelBlock, uint64_t value)
+            {
+                if (texelBlock.buffer == VK_NULL_HANDLE && texelBlock.allocation.memory == VK_NULL_HANDLE)
+                    return;
+
+                Retired retired = makeRetired(value);
+                retired.buffer = texelBlock.buffer;
+                retired.bufferView = texelBlock.view;
+                retired.allocation = texelBlock.allocation;
+                retired.bytes = texelBlock.allocation.size;
+
+                retire(retired);
+            }
+
+            /** Retires an image, its view and its memory
+            * \param image The image to retire
+            * \param value The timeline value after which the image is unused
+            */
+            void VKDeletionQueue::RetireImage(const Image_vk& image, uint64_t value)
+            {
+                RetireImage(image.image, image.view, image.allocation, value);
+            }
+
+            /** Retires an image, its view and its memory
+            *
+            * Any of the handles may be null.
+            *
+            * \param image The image to retire
+            * \param view A view of the image
+            * \param allocation The memory bound to the image
+            * \param value The timeline value after which the image is unused
+            */
+            void VKDeletionQueue::RetireImage(VkImage image, VkImageView view, const VKAllocation& allocation, uint64_t value)
+            {
+                if (image == VK_NULL_HANDLE && view == VK_NULL_HANDLE && allocation.memory == VK_NULL_HANDLE)
+                    return;
+
+                Retired retired = makeRetired(value);
+                retired.image = image;
+                retired.imageView = view;
+                retired.allocation = allocation;
+                retired.bytes = allocation.size;
+
+                retire(retired);
+            }
+
+            /** Retires a sampler
+            * \param sampler The sampler to retire
+            * \param value The timeline value after which the sampler is unused
+            */
+            void VKDeletionQueue::RetireSampler(VkSampler sampler, uint64_t value)
+            {
+                if (sampler == VK_NULL_HANDLE)
+                    return;
+
+                Retired retired = makeRetired(value);
+                retired.sampler = sampler;
+
+                retire(retired);
+            }
+
+            /** Retires descriptor sets back to their pool
+            *
+            * The pool must have been created with
+            * VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT.
+            *
+            * \param pool The pool the sets were allocated from
+            * \param sets The sets to free
+            * \param value The timeline value after which the sets are unused
+            */
+            void VKDeletionQueue::RetireDescriptorSets(VkDescriptorPool pool, const std::vector<VkDescriptorSet>& sets, uint64_t value)
+            {
+                if (pool == VK_NULL_HANDLE || sets.empty())
+                    return;
+
+                Retired retired = makeRetired(value);
+                retired.descriptorPool = pool;
+                retired.descriptorSets = sets;
+
+                retire(retired);
+            }
+
+            /** Retires a pipeline and its cache
+            * \param pipeline The pipeline to retire
+            * \param cache The pipeline's cache; may be null
+            * \param value The timeline value after which the pipeline is unused
+            */
+            void VKDeletionQueue::RetirePipeline(VkPipeline pipeline, VkPipelineCache cache, uint64_t value)
+            {
+                if (pipeline == VK_NULL_HANDLE && cache == VK_NULL_HANDLE)
+                    return;
+
+                Retired retired = makeRetired(value);
+                retired.pipeline = pipeline;
+                retired.pipelineCache = cache;
+
+                retire(retired);
+            }
+
+            /** Retires a framebuffer
+            * \param framebuffer The framebuffer to retire
+            * \param value The timeline value after which the framebuffer is unused
+            */
+            void VKDeletionQueue::RetireFramebuffer(VkFramebuffer framebuffer, uint64_t value)
+            {
+                if (framebuffer == VK_NULL_HANDLE)
+                    return;
+
+                Retired retired = makeRetired(value);
+                retired.framebuffer = framebuffer;
+
+                retire(retired);
+            }
+
+            /** Retires a render pass
+            * \param renderPass The render pass to retire
+            * \param value The timeline value after which the render pass is unused
+            */
+            void VKDeletionQueue::RetireRenderPass(VkRenderPass renderPass, uint64_t value)
+            {
+                if (renderPass == VK_NULL_HANDLE)
+                    return;
+
+                Retired retired = makeRetired(value);
+                retired.renderPass = renderPass;
+
+                retire(retired);
+            }
+
+            /** Retires anything else by running a function once the GPU is done with it
+            *
+            * Used for objects that don't own their Vulkan handles, like ranges of a
+            * pooled buffer.
+            *
+            * \param release Called with the deletion queue locked; must not retire anything
+            * \param value The timeline value after which the object is unused
+            */
+            void VKDeletionQueue::RetireCallback(const std::function<void()>& release, uint64_t value)
+            {
+                if (!release)
+                    return;
+
+                Retired retired = makeRetired(value);
+                retired.release = release;
+
+                retire(retired);
+            }
+
+            /** Destroys every retired object whose timeline value has completed
+            *
+            * Meant to be called once per frame. Objects are retired in roughly
+            * increasing order, so this stops at the first one still in use.
+            */
+            void VKDeletionQueue::Collect()
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                if (m_timeline == nullptr || m_retired.empty())
+                    return;
+
+                uint64_t completed = m_timeline->GetCompletedValue();
+
+                while (!m_retired.empty() && m_retired.front().value <= completed)
+                {
+                    Retired& retired = m_retired.front();
+
+                    destroy(retired);
+
+                    m_stats.objectsPending--;
+                    m_stats.bytesPending -= retired.bytes;
+                    m_stats.bytesReleased += retired.bytes;
+
+                    m_retired.pop_front();
+                }
+            }
+
+            /** Gets how much is still waiting on the GPU
+            * \return A copy of the current stats
+            */
+            DeletionQueueStats VKDeletionQueue::GetStats()
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                return m_stats;
+            }
+
+            VKDeletionQueue::Retired VKDeletionQueue::makeRetired(uint64_t value)
+            {
+                Retired retired = {};
+                retired.value = value;
+                retired.bytes = 0;
+
+                return retired;
+            }
+
+            void VKDeletionQueue::retire(Retired& retired)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                //Not tracking a queue; nothing can be in flight
+                if (m_timeline == nullptr)
+                {
+                    destroy(retired);
+                    return;
+                }
+
+                if (retired.value == LastSubmission)
+                    retired.value = m_timeline->GetSubmittedValue();
+
+                m_stats.objectsPending++;
+                m_stats.bytesPending += retired.bytes;
+
+                m_retired.push_back(retired);
+            }
+
+            void VKDeletionQueue::destroy(Retired& retired)
+            {
+                if (retired.release)
+                    retired.release();
+
+                //Views before what they view, and memory last
+                if (!retired.descriptorSets.empty())
+                    vkFreeDescriptorSets(m_device, retired.descriptorPool, static_cast<uint32_t>(retired.descriptorSets.size()), retired.descriptorSets.data());
+
+                if (retired.framebuffer != VK_NULL_HANDLE)
+                    vkDestroyFramebuffer(m_device, retired.framebuffer, nullptr);
+                if (retired.renderPass != VK_NULL_HANDLE)
+                    vkDestroyRenderPass(m_device, retired.renderPass, nullptr);
+
+                if (retired.pipeline != VK_NULL_HANDLE)
+                    vkDestroyPipeline(m_device, retired.pipeline, nullptr);
+                if (retired.pipelineCache != VK_NULL_HANDLE)
+                    vkDestroyPipelineCache(m_device, retired.pipelineCache, nullptr);
+
+                if (retired.sampler != VK_NULL_HANDLE)
+                    vkDestroySampler(m_device, retired.sampler, nullptr);
+
+                if (retired.imageView != VK_NULL_HANDLE)
+                    vkDestroyImageView(m_device, retired.imageView, nullptr);
+                if (retired.image != VK_NULL_HANDLE)
+                    vkDestroyImage(m_device, retired.image, nullptr);
+
+                if (retired.bufferView != VK_NULL_HANDLE)
+                    vkDestroyBufferView(m_device, retired.bufferView, nullptr);
+                if (retired.buffer != VK_NULL_HANDLE)
+                    vkDestroyBuffer(m_device, retired.buffer, nullptr);
+
+                VKTools::GetAllocator().Free(retired.allocation);
+            }
+        }
+    }
+}
@@ -0,0 +1,660 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+#include <ht_vkdescriptorallocator.h>
+#include <ht_vkdeletionqueue.h>
+#include <ht_debug.h>
+#include <cassert>
+#include <cstring>      //memcpy
+#include <map>          //std::map
+
+namespace Hatchit {
+
+    namespace Graphics {
+
+        namespace Vulkan {
+
+            /**
+            * The pools one thread allocates from. Only that thread allocates
+            * from them; the mutex is for Free, BeginFrame and GetStats coming
+            * from elsewhere.
+            */
+            struct VKDescriptorThreadPools
+            {
+                struct Pool
+                {
+                    VkDescriptorPool    pool;
+                    uint32_t            maxSets;
+                    uint32_t            used;
+                };
+
+                struct Chain
+                {
+                    std::vector<Pool>   pools;
+                    size_t              current;    //Pool the next allocation tries first
+
+                    Chain() : current(0) {}
+                };
+
+                std::mutex                                  mutex;
+                std::map<uint32_t, Chain>                   longLived;  //By mix
+                std::vector<std::map<uint32_t, Chain>>      transient;  //By frame slot, then mix
+
+                uint32_t    poolCount;
+                uint32_t    sets;
+                uint32_t    transientSets;
+
+                VKDescriptorThreadPools() : poolCount(0), sets(0), transientSets(0) {}
+            };
+
+            static thread_local VKDescriptorThreadPools* t_pools = nullptr;
+            static thread_local uint64_t t_generation = 0;
+
+            VkDevice                                                    VKDescriptorAllocator::m_device = VK_NULL_HANDLE;
+            uint32_t                                                    VKDescriptorAllocator::m_frame = 0;
+            std::mutex                                                  VKDescriptorAllocator::m_mutex;
+            std::vector<std::unique_ptr<VKDescriptorThreadPools>>       VKDescriptorAllocator::m_threads;
+            uint64_t                                                    VKDescriptorAllocator::m_generation = 0;
+            std::mutex                                                  VKDescriptorAllocator::m_mixMutex;
+            std::vector<VKDescriptorAllocator::Mix>                     VKDescriptorAllocator::m_mixes;
+            std::unordered_map<VkDescriptorSetLayout, uint32_t>         VKDescriptorAllocator::m_layoutMixes;
+            std::mutex                                                  VKDescriptorAllocator::m_cacheMutex;
+            std::unordered_multimap<uint64_t, VKDescriptorAllocator::CachedSet>  VKDescriptorAllocator::m_cache;
+            std::unordered_map<VkDescriptorSet, uint64_t>               VKDescriptorAllocator::m_cachedHashes;
+            VKDescriptorAllocatorStats                                  VKDescriptorAllocator::m_stats = {};
+
+            //Handles are pointers on some platforms and integers on others
+            template<typename T>
+            static uint64_t handleBits(T handle)
+            {
+                uint64_t bits = 0;
+                memcpy(&bits, &handle, sizeof(handle));
+                return bits;
+            }
+
+            /** Prepares the allocator; pools are only created once sets are needed
+            * \param device The device pools are created on
+            * \return True if the allocator is ready
+            */
+            bool VKDescriptorAllocator::Initialize(const VkDevice& device)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                m_device = device;
+                m_frame = 0;
+                m_generation++;
+
+                std::lock_guard<std::mutex> mixLock(m_mixMutex);
+
+                //Mix 0 is for layouts nobody registered; roughly what the old shared pool held per set
+                Mix fallback;
+                fallback.sizes.push_back({ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4 });
+                fallback.sizes.push_back({ VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 8 });
+                fallback.sizes.push_back({ VK_DESCRIPTOR_TYPE_SAMPLER, 4 });
+                fallback.sizes.push_back({ VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, 2 });
+
+                m_mixes.clear();
+                m_mixes.push_back(fallback);
+                m_layoutMixes.clear();
+
+                return true;
+            }
+
+            /** Destroys every pool and forgets every cached set
+            *
+            * Nothing may still be using a set. Sets freed or released afterwards are ignored.
+            */
+            void VKDescriptorAllocator::DeInitialize()
+            {
+                std::lock_guard<std::mutex> cacheLock(m_cacheMutex);
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                m_cache.clear();
+                m_cachedHashes.clear();
+                m_stats = {};
+
+                for (size_t i = 0; i < m_threads.size(); i++)
+                {
+                    VKDescriptorThreadPools* pools = m_threads[i].get();
+                    std::lock_guard<std::mutex> poolLock(pools->mutex);
+
+                    for (auto it = pools->longLived.begin(); it != pools->longLived.end(); it++)
+                    {
+                        for (size_t p = 0; p < it->second.pools.size(); p++)
+                            vkDestroyDescriptorPool(m_device, it->second.pools[p].pool, nullptr);
+                    }
+
+                    for (size_t f = 0; f < pools->transient.size(); f++)
+                    {
+                        for (auto it = pools->transient[f].begin(); it != pools->transient[f].end(); it++)
+                        {
+                            for (size_t p = 0; p < it->second.pools.size(); p++)
+                                vkDestroyDescriptorPool(m_device, it->second.pools[p].pool, nullptr);
+                        }
+                    }
+                }
+                m_threads.clear();
+
+                //Threads notice their pools are gone by the generation changing
+                m_generation++;
+                m_device = VK_NULL_HANDLE;
+            }
+
+            /** Records which descriptor types a layout's sets need
+            *
+            * Layouts with the same mix of descriptors share pools. Registering
+            * a handle again replaces what was recorded for it.
+            *
+            * \param layout The layout sets will be allocated with
+            * \param bindings The bindings the layout was created from
+            */
+            void VKDescriptorAllocator::RegisterLayout(VkDescriptorSetLayout layout, const std::vector<VkDescriptorSetLayoutBinding>& bindings)
+            {
+                //Sum up each type; sorted so equal mixes compare equal
+                std::map<VkDescriptorType, uint32_t> counts;
+                for (size_t i = 0; i < bindings.size(); i++)
+                {
+                    if (bindings[i].descriptorCount > 0)
+                        counts[bindings[i].descriptorType] += bindings[i].descriptorCount;
+                }
+
+                Mix mix;
+                for (auto it = counts.begin(); it != counts.end(); it++)
+                    mix.sizes.push_back({ it->first, it->second });
+
+                //A pool needs at least one size even if its sets are empty
+                if (mix.sizes.empty())
+                    mix.sizes.push_back({ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 });
+
+                std::lock_guard<std::mutex> lock(m_mixMutex);
+
+                uint32_t index = static_cast<uint32_t>(m_mixes.size());
+                for (uint32_t i = 1; i < m_mixes.size(); i++)
+                {
+                    const std::vector<VkDescriptorPoolSize>& sizes = m_mixes[i].sizes;
+                    if (sizes.size() != mix.sizes.size())
+                        continue;
+
+                    bool same = true;
+                    for (size_t j = 0; j < sizes.size() && same; j++)
+                        same = sizes[j].type == mix.sizes[j].type && sizes[j].descriptorCount == mix.sizes[j].descriptorCount;
+
+                    if (same)
+                    {
+                        index = i;
+                        break;
+                    }
+                }
+
+                if (index == m_mixes.size())
+                    m_mixes.push_back(mix);
+
+                m_layoutMixes[layout] = index;
+            }
+
+            /** Allocates a long-lived set from the calling thread's pools
+            * \param layout The set's layout
+            * \param allocation Filled with the set and where it came from
+            * \return True if a set was allocated
+            */
+            bool VKDescriptorAllocator::Allocate(VkDescriptorSetLayout layout, VKDescriptorAllocation& allocation)
+            {
+                allocation = {};
+
+                VKDescriptorThreadPools* pools = getThreadPools();
+                if (pools == nullptr)
+                {
+                    HT_ERROR_PRINTF("VKDescriptorAllocator::Allocate(): The allocator has not been initialized\n");
+                    return false;
+                }
+
+                uint32_t mix = getMix(layout);
+
+                std::lock_guard<std::mutex> lock(pools->mutex);
+                if (!allocateFrom(pools, false, mix, layout, allocation))
+                    return false;
+
+                pools->sets++;
+                return true;
+            }
+
+            /** Frees a long-lived set right away
+            *
+            * The GPU must be done with it; use Retire otherwise.
+            *
+            * \param allocation The set to free; cleared afterwards
+            */
+            void VKDescriptorAllocator::Free(VKDescriptorAllocation& allocation)
+            {
+                if (allocation.set == VK_NULL_HANDLE)
+                    return;
+
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                //The pools went away with DeInitialize
+                if (m_device == VK_NULL_HANDLE)
+                {
+                    allocation = {};
+                    return;
+                }
+
+                VKDescriptorThreadPools* pools = allocation.owner;
+                std::lock_guard<std::mutex> poolLock(pools->mutex);
+
+                for (auto it = pools->longLived.begin(); it != pools->longLived.end(); it++)
+                {
+                    std::vector<VKDescriptorThreadPools::Pool>& chain = it->second.pools;
+                    for (size_t i = 0; i < chain.size(); i++)
+                    {
+                        if (chain[i].pool != allocation.pool)
+                            continue;
+
+                        vkFreeDescriptorSets(m_device, allocation.pool, 1, &allocation.set);
+                        chain[i].used--;
+                        pools->sets--;
+
+                        allocation = {};
+                        return;
+                    }
+                }
+
+                HT_ERROR_PRINTF("VKDescriptorAllocator::Free(): Set did not come from the allocator\n");
+                allocation = {};
+            }
+
+            /** Frees a long-lived set once no frame in flight can be using it
+            * \param allocation The set to free
+            */
+            void VKDescriptorAllocator::Retire(const VKDescriptorAllocation& allocation)
+            {
+                if (allocation.set == VK_NULL_HANDLE)
+                    return;
+
+                VKDescriptorAllocation retired = allocation;
+                VKDeletionQueue::RetireCallback([retired]() mutable
+                {
+                    VKDescriptorAllocator::Free(retired);
+                });
+            }
+
+            /** Allocates a set that only lives for the current frame
+            *
+            * The set is valid until BeginFrame is called again with this
+            * frame's slot, so it must not be kept past the frame.
+            *
+            * \param layout The set's layout
+            * \param set Filled with the set
+            * \return True if a set was allocated
+            */
+            bool VKDescriptorAllocator::AllocateTransient(VkDescriptorSetLayout layout, VkDescriptorSet& set)
+            {
+                set = VK_NULL_HANDLE;
+
+                VKDescriptorThreadPools* pools = getThreadPools();
+                if (pools == nullptr)
+                {
+                    HT_ERROR_PRINTF("VKDescriptorAllocator::AllocateTransient(): The allocator has not been initialized\n");
+                    return false;
+                }
+
+                uint32_t mix = getMix(layout);
+
+                std::lock_guard<std::mutex> lock(pools->mutex);
+
+                VKDescriptorAllocation allocation;
+                if (!allocateFrom(pools, true, mix, layout, allocation))
+                    return false;
+
+                pools->transientSets++;
+                set = allocation.set;
+                return true;
+            }
+
+            /** Starts a frame slot, resetting the transient pools it used last time around
+            *
+            * The slot's previous frame must have finished on the GPU.
+            *
+            * \param frame The frame slot being started
+            */
+            void VKDescriptorAllocator::BeginFrame(uint32_t frame)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                m_frame = frame;
+
+                for (size_t i = 0; i < m_threads.size(); i++)
+                {
+                    VKDescriptorThreadPools* pools = m_threads[i].get();
+                    std::lock_guard<std::mutex> poolLock(pools->mutex);
+
+                    pools->transientSets = 0;
+
+                    if (frame >= pools->transient.size())
+                        continue;
+
+                    for (auto it = pools->transient[frame].begin(); it != pools->transient[frame].end(); it++)
+                    {
+                        VKDescriptorThreadPools::Chain& chain = it->second;
+                        for (size_t p = 0; p < chain.pools.size(); p++)
+                        {
+                            if (chain.pools[p].used == 0)
+                                continue;
+
+                            vkResetDescriptorPool(m_device, chain.pools[p].pool, 0);
+                            chain.pools[p].used = 0;
+                        }
+                        chain.current = 0;
+                    }
+                }
+            }
+
+            /** Gets a set with the given writes, sharing one if an identical set is alive
+            *
+            * Writes don't need a destination set; it is filled in. The set
+            * must be handed back with ReleaseCached rather than freed.
+            *
+            * \param layout The set's layout
+            * \param writes What the set should contain
+            * \param set Filled with the set
+            * \return True if a set was found or allocated
+            */
+            bool VKDescriptorAllocator::AcquireCached(VkDescriptorSetLayout layout, std::vector<VkWriteDescriptorSet>& writes, VkDescriptorSet& set)
+            {
+                set = VK_NULL_HANDLE;
+
+                std::vector<uint64_t> key;
+                buildKey(layout, writes, key);
+
+                //FNV-1a over the key
+                uint64_t hash = 14695981039346656037ULL;
+                for (size_t i = 0; i < key.size(); i++)
+                {
+                    hash ^= key[i];
+                    hash *= 1099511628211ULL;
+                }
+
+                std::lock_guard<std::mutex> lock(m_cacheMutex);
+
+                auto range = m_cache.equal_range(hash);
+                for (auto it = range.first; it != range.second; it++)
+                {
+                    if (it->second.key != key)
+                        continue;
+
+                    it->second.references++;
+                    m_stats.cacheHits++;
+
+                    set = it->second.allocation.set;
+                    return true;
+                }
+
+                CachedSet cached;
+                if (!Allocate(layout, cached.allocation))
+                    return false;
+
+                for (size_t i = 0; i < writes.size(); i++)
+                    writes[i].dstSet = cached.allocation.set;
+                vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+                cached.key = key;
+                cached.references = 1;
+                m_cache.insert(std::make_pair(hash, cached));
+                m_cachedHashes[cached.allocation.set] = hash;
+                m_stats.cacheMisses++;
+
+                set = cached.allocation.set;
+                return true;
+            }
+
+            /** Gives back a set from AcquireCached
+            *
+            * The last release retires the set; frames in flight may still use it.
+            *
+            * \param set The set to release
+            */
+            void VKDescriptorAllocator::ReleaseCached(VkDescriptorSet set)
+            {
+                if (set == VK_NULL_HANDLE)
+                    return;
+
+                std::lock_guard<std::mutex> lock(m_cacheMutex);
+
+                auto hashIt = m_cachedHashes.find(set);
+                if (hashIt == m_cachedHashes.end())
+                    return;
+
+                auto range = m_cache.equal_range(hashIt->second);
+                for (auto it = range.first; it != range.second; it++)
+                {
+                    if (it->second.allocation.set != set)
+                        continue;
+
+                    if (--it->second.references == 0)
+                    {
+                        Retire(it->second.allocation);
+                        m_cache.erase(it);
+                        m_cachedHashes.erase(hashIt);
+                    }
+                    return;
+                }
+            }
+
+            /** Gets how many pools and sets there are and how well the cache is doing
+            * \return A snapshot of the allocator's stats
+            */
+            VKDescriptorAllocatorStats VKDescriptorAllocator::GetStats()
+            {
+                VKDescriptorAllocatorStats stats;
+                {
+                    std::lock_guard<std::mutex> cacheLock(m_cacheMutex);
+                    stats = m_stats;
+                    stats.cachedSets = static_cast<uint32_t>(m_cache.size());
+                }
+
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                stats.pools = 0;
+                stats.sets = 0;
+                stats.transientSets = 0;
+                for (size_t i = 0; i < m_threads.size(); i++)
+                {
+                    VKDescriptorThreadPools* pools = m_threads[i].get();
+                    std::lock_guard<std::mutex> poolLock(pools->mutex);
+
+                    stats.pools += pools->poolCount;
+                    stats.sets += pools->sets;
+                    stats.transientSets += pools->transientSets;
+                }
+
+                return stats;
+            }
+
+            VKDescriptorThreadPools* VKDescriptorAllocator::getThreadPools()
+            {
+                if (t_pools != nullptr && t_generation == m_generation)
+                    return t_pools;
+
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                if (m_device == VK_NULL_HANDLE)
+                    return nullptr;
+
+                m_threads.push_back(std::unique_ptr<VKDescriptorThreadPools>(new VKDescriptorThreadPools));
+                t_pools = m_threads.back().get();
+                t_generation = m_generation;
+
+                return t_pools;
+            }
+
+            uint32_t VKDescriptorAllocator::getMix(VkDescriptorSetLayout layout)
+            {
+                std::lock_guard<std::mutex> lock(m_mixMutex);
+
+                auto it = m_layoutMixes.find(layout);
+                if (it == m_layoutMixes.end())
+                    return 0;
+
+                return it->second;
+            }
+
+            /** Allocates from a chain, trying each pool in turn and adding one if they're all full
+            *
+            * Must be called with the thread's pools locked.
+            */
+            bool VKDescriptorAllocator::allocateFrom(VKDescriptorThreadPools* pools, bool transient, uint32_t mix,
+                VkDescriptorSetLayout layout, VKDescriptorAllocation& allocation)
+            {
+                VkResult err;
+
+                if (transient && m_frame >= pools->transient.size())
+                    pools->transient.resize(m_frame + 1);
+
+                VKDescriptorThreadPools::Chain& chain = transient ? pools->transient[m_frame][mix] : pools->longLived[mix];
+
+                VkDescriptorSetAllocateInfo allocInfo = {};
+                allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+                allocInfo.pNext = nullptr;
+                allocInfo.descriptorSetCount = 1;
+                allocInfo.pSetLayouts = &layout;
+
+                //Pools that freed sets may have room again, so every one gets a try
+                for (size_t tried = 0; tried < chain.pools.size(); tried++)
+                {
+                    VKDescriptorThreadPools::Pool& pool = chain.pools[chain.current];
+                    if (pool.used < pool.maxSets)
+                    {
+                        allocInfo.descriptorPool = pool.pool;
+
+                        //Failing here just means the pool ran out of descriptors or is fragmented
+                        err = vkAllocateDescriptorSets(m_device, &allocInfo, &allocation.set);
+                        if (err == VK_SUCCESS)
+                        {
+                            pool.used++;
+                            allocation.pool = pool.pool;
+                            allocation.owner = pools;
+                            return true;
+                        }
+                    }
+
+                    chain.current = (chain.current + 1) % chain.pools.size();
+                }
+
+                //Every pool is full; chain a bigger one
+                uint32_t maxSets = FirstPoolSets;
+                if (!chain.pools.empty())
+                    maxSets = chain.pools.back().maxSets * 2 > MaxPoolSets ? MaxPoolSets : chain.pools.back().maxSets * 2;
+
+                VKDescriptorThreadPools::Pool pool = {};
+                pool.maxSets = maxSets;
+                if (!createPool(mix, maxSets, !transient, pool.pool))
+                    return false;
+
+                pools->poolCount++;
+                chain.pools.push_back(pool);
+                chain.current = chain.pools.size() - 1;
+
+                allocInfo.descriptorPool = pool.pool;
+
+                err = vkAllocateDescriptorSets(m_device, &allocInfo, &allocation.set);
+                assert(!err);
+                if (err != VK_SUCCESS)
+                {
+                    HT_ERROR_PRINTF("VKDescriptorAllocator::allocateFrom(): Failed to allocate descriptor set from a new pool\n");
+                    return false;
+                }
+
+                chain.pools.back().used++;
+                allocation.pool = pool.pool;
+                allocation.owner = pools;
+
+                return true;
+            }
+
+            bool VKDescriptorAllocator::createPool(uint32_t mix, uint32_t maxSets, bool freeable, VkDescriptorPool& pool)
+            {
+                VkResult err;
+
+                std::vector<VkDescriptorPoolSize> poolSizes;
+                {
+                    std::lock_guard<std::mutex> lock(m_mixMutex);
+                    poolSizes = m_mixes[mix].sizes;
+                }
+
+                for (size_t i = 0; i < poolSizes.size(); i++)
+                    poolSizes[i].descriptorCount *= maxSets;
+
+                VkDescriptorPoolCreateInfo poolCreateInfo = {};
+                poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+                poolCreateInfo.pPoolSizes = poolSizes.data();
+                poolCreateInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+                poolCreateInfo.maxSets = maxSets;
+
+                //Transient pools are only ever reset as a whole
+                poolCreateInfo.flags = freeable ? VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT : 0;
+
+                err = vkCreateDescriptorPool(m_device, &poolCreateInfo, nullptr, &pool);
+                assert(!err);
+                if (err != VK_SUCCESS)
+                {
+                    HT_ERROR_PRINTF("VKDescriptorAllocator::createPool(): Failed to create descriptor pool\n");
+                    return false;
+                }
+
+                return true;
+            }
+
+            /** Flattens a layout and its writes into words that identify the set's contents */
+            void VKDescriptorAllocator::buildKey(VkDescriptorSetLayout layout, const std::vector<VkWriteDescriptorSet>& writes, std::vector<uint64_t>& key)
+            {
+                key.clear();
+                key.push_back(handleBits(layout));
+
+                for (size_t i = 0; i < writes.size(); i++)
+                {
+                    const VkWriteDescriptorSet& write = writes[i];
+
+                    key.push_back((static_cast<uint64_t>(write.dstBinding) << 32) | write.dstArrayElement);
+                    key.push_back((static_cast<uint64_t>(write.descriptorType) << 32) | write.descriptorCount);
+
+                    for (uint32_t d = 0; d < write.descriptorCount; d++)
+                    {
+                        switch (write.descriptorType)
+                        {
+                        case VK_DESCRIPTOR_TYPE_SAMPLER:
+                        case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+                        case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+                        case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+                        case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+                            key.push_back(handleBits(write.pImageInfo[d].sampler));
+                            key.push_back(handleBits(write.pImageInfo[d].imageView));
+                            key.push_back(static_cast<uint64_t>(write.pImageInfo[d].imageLayout));
+                            break;
+
+                        case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+                        case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+                            key.push_back(handleBits(write.pTexelBufferView[d]));
+                            break;
+
+                        default:
+                            key.push_back(handleBits(write.pBufferInfo[d].buffer));
+                            key.push_back(write.pBufferInfo[d].offset);
+                            key.push_back(write.pBufferInfo[d].range);
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
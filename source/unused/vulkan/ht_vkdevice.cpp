@@ -65,6 +65,7 @@ namespace Hatchit
                 m_layerNamesCollection.push_back(m_layerNames103);
 
                 m_validate = false;
+                m_physicalDeviceProperties2 = false;
 
                 m_instance = VK_NULL_HANDLE;
 
@@ -112,9 +113,66 @@ namespace Hatchit
             const std::vector<VkDevice>&                            VKDevice::GetVKDevices() const { return m_devices; }
             const std::vector<VkPhysicalDevice>&                    VKDevice::GetVKPhysicalDevices() const { return m_gpus; }
             const std::vector<VkPhysicalDeviceFeatures>&            VKDevice::GetVKPhysicalDeviceFeatures() const { return m_gpuFeatures; }
+            const std::vector<VkPhysicalDeviceProperties>&          VKDevice::GetVKPhysicalDeviceProperties() const { return m_gpuProps; }
             const std::vector<VkPhysicalDeviceMemoryProperties>&    VKDevice::GetVKPhysicalDeviceMemoryProperties() const { return m_gpuMemoryProps; }
             const VkInstance&                                       VKDevice::GetVKInstance() const { return m_instance; }
 
+            /** Gets whether the first device has VK_KHR_timeline_semaphore enabled
+            * \return True if queues may track their submissions with timeline semaphores
+            */
+            bool VKDevice::SupportsTimelineSemaphores() const
+            {
+                return !m_timelineSemaphores.empty() && m_timelineSemaphores[0];
+            }
+
+            /** Gets whether the first device has VK_EXT_memory_budget enabled
+            * \return True if the driver reports a budget and usage for every heap
+            */
+            bool VKDevice::SupportsMemoryBudget() const
+            {
+                return !m_memoryBudgets.empty() && m_memoryBudgets[0];
+            }
+
+            /** Gets whether the first device has the multiDrawIndirect feature enabled
+            * \return True if one indirect draw call may issue more than one draw
+            */
+            bool VKDevice::SupportsMultiDrawIndirect() const
+            {
+                return !m_multiDrawIndirect.empty() && m_multiDrawIndirect[0];
+            }
+
+            /** Gets whether the first device has the drawIndirectFirstInstance feature enabled
+            * \return True if indirect draws may start at an instance other than 0
+            */
+            bool VKDevice::SupportsIndirectFirstInstance() const
+            {
+                return !m_indirectFirstInstance.empty() && m_indirectFirstInstance[0];
+            }
+
+            /** Gets the graphics queue family of the first device
+            * \return The family index; the device's first queue belongs to it
+            */
+            uint32_t VKDevice::GetGraphicsQueueFamily() const
+            {
+                return m_graphicsQueueFamilies.empty() ? 0 : m_graphicsQueueFamilies[0];
+            }
+
+            /** Gets the compute queue family without graphics created on the first device
+            * \return The family index, or -1 if compute only runs on the graphics family
+            */
+            int32_t VKDevice::GetComputeQueueFamily() const
+            {
+                return m_computeQueueFamilies.empty() ? -1 : m_computeQueueFamilies[0];
+            }
+
+            /** Gets the transfer-only queue family created on the first device
+            * \return The family index, or -1 if the device has no such family
+            */
+            int32_t VKDevice::GetTransferQueueFamily() const
+            {
+                return m_transferQueueFamilies.empty() ? -1 : m_transferQueueFamilies[0];
+            }
+
             /*
                 Private methods
             */
@@ -211,7 +269,8 @@ namespace Hatchit
 
             bool VKDevice::queryDeviceCapabilities() 
             {
-                //Get physical device memory props
+                //Get physical device props and memory props
+                m_gpuProps.resize(m_gpus.size());
                 m_gpuMemoryProps.resize(m_gpus.size());
 
                 for (size_t i = 0; i < m_gpus.size(); i++)
@@ -223,6 +282,7 @@ namespace Hatchit
                     VkPhysicalDeviceFeatures gpuFeatures;
                     vkGetPhysicalDeviceFeatures(gpu, &gpuFeatures);
 
+                    vkGetPhysicalDeviceProperties(gpu, &m_gpuProps[i]);
                     vkGetPhysicalDeviceMemoryProperties(gpu, &m_gpuMemoryProps[i]);
 
                     m_gpuFeatures.push_back(gpuFeatures);
@@ -237,6 +297,13 @@ namespace Hatchit
                 bool success = true;
 
                 m_devices.resize(m_gpus.size());
+                m_timelineSemaphores.resize(m_gpus.size(), false);
+                m_memoryBudgets.resize(m_gpus.size(), false);
+                m_multiDrawIndirect.resize(m_gpus.size(), false);
+                m_indirectFirstInstance.resize(m_gpus.size(), false);
+                m_graphicsQueueFamilies.resize(m_gpus.size(), 0);
+                m_computeQueueFamilies.resize(m_gpus.size(), -1);
+                m_transferQueueFamilies.resize(m_gpus.size(), -1);
 
                 for (size_t i = 0; i < m_gpus.size(); i++)
                 {
@@ -249,30 +316,68 @@ namespace Hatchit
                     if (!success)
                         return false;
 
-                    success = checkDeviceExtensions(gpu);
+                    bool timelineSemaphores = false;
+                    bool memoryBudget = false;
+                    success = checkDeviceExtensions(gpu, timelineSemaphores, memoryBudget);
                     assert(success);
                     if (!success)
                         return false;
 
+                    m_timelineSemaphores[i] = timelineSemaphores;
+                    m_memoryBudgets[i] = memoryBudget;
+
+                    if (!selectQueueFamilies(i))
+                        return false;
+
                     float queuePriorities[1] = { 0.0f };
 
-                    VkDeviceQueueCreateInfo queue;
-                    queue.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-                    queue.pNext = nullptr;
-                    queue.queueFamilyIndex = 0; //TODO: Grab this index from the swapchain
-                    queue.queueCount = 1;
-                    queue.pQueuePriorities = queuePriorities;
+                    std::vector<VkDeviceQueueCreateInfo> queues(1);
+                    queues[0].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+                    queues[0].pNext = nullptr;
+                    queues[0].flags = 0;
+                    queues[0].queueFamilyIndex = m_graphicsQueueFamilies[i];
+                    queues[0].queueCount = 1;
+                    queues[0].pQueuePriorities = queuePriorities;
+
+                    //One queue per distinct family; compute and transfer only get their own when the hardware has them
+                    const int32_t ownFamilies[] = { m_computeQueueFamilies[i], m_transferQueueFamilies[i] };
+                    for (size_t f = 0; f < 2; f++)
+                    {
+                        if (ownFamilies[f] < 0)
+                            continue;
+
+                        VkDeviceQueueCreateInfo familyQueue = queues[0];
+                        familyQueue.queueFamilyIndex = static_cast<uint32_t>(ownFamilies[f]);
+                        queues.push_back(familyQueue);
+                    }
+
+                    //Indirect draws are only enabled where the GPU has them; passes fall back without them
+                    VkPhysicalDeviceFeatures enabledFeatures = {};
+                    enabledFeatures.multiDrawIndirect = m_gpuFeatures[i].multiDrawIndirect;
+                    enabledFeatures.drawIndirectFirstInstance = m_gpuFeatures[i].drawIndirectFirstInstance;
+
+                    m_multiDrawIndirect[i] = enabledFeatures.multiDrawIndirect == VK_TRUE;
+                    m_indirectFirstInstance[i] = enabledFeatures.drawIndirectFirstInstance == VK_TRUE;
 
                     VkDeviceCreateInfo device;
                     device.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
                     device.pNext = nullptr;
-                    device.queueCreateInfoCount = 1;
-                    device.pQueueCreateInfos = &queue;
+                    device.queueCreateInfoCount = static_cast<uint32_t>(queues.size());
+                    device.pQueueCreateInfos = queues.data();
                     device.enabledLayerCount = static_cast<uint32_t>(m_enabledLayerNames.size());
                     device.ppEnabledLayerNames = m_enabledLayerNames.data();
                     device.enabledExtensionCount = static_cast<uint32_t>(m_enabledExtensionNames.size());
                     device.ppEnabledExtensionNames = m_enabledExtensionNames.data();
-                    device.pEnabledFeatures = nullptr; //Request specific features here
+                    device.pEnabledFeatures = &enabledFeatures;
+
+#ifdef VK_KHR_timeline_semaphore
+                    VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures = {};
+                    timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+                    timelineFeatures.timelineSemaphore = VK_TRUE;
+
+                    if (timelineSemaphores)
+                        device.pNext = &timelineFeatures;
+#endif
 
                     err = vkCreateDevice(gpu, &device, nullptr, &m_devices[i]);
                     if (err != VK_SUCCESS)
@@ -285,6 +390,61 @@ namespace Hatchit
                 return true;
             }
 
+            /** Picks the queue families a device's queues are created in
+            *
+            * Graphics goes to the first family with graphics. Async compute
+            * goes to the first family with compute but not graphics, and
+            * copies to the first family with transfer alone; either is left
+            * at -1 when the hardware has no such family.
+            *
+            * \param gpu The index of the physical device
+            * \return False if the device has no graphics family
+            */
+            bool VKDevice::selectQueueFamilies(size_t gpu)
+            {
+                uint32_t familyCount = 0;
+                vkGetPhysicalDeviceQueueFamilyProperties(m_gpus[gpu], &familyCount, nullptr);
+                std::vector<VkQueueFamilyProperties> families(familyCount);
+                vkGetPhysicalDeviceQueueFamilyProperties(m_gpus[gpu], &familyCount, families.data());
+
+                int32_t graphicsFamily = -1;
+                m_computeQueueFamilies[gpu] = -1;
+                m_transferQueueFamilies[gpu] = -1;
+
+                for (uint32_t i = 0; i < familyCount; i++)
+                {
+                    const VkQueueFamilyProperties& family = families[i];
+                    if (family.queueCount == 0)
+                        continue;
+
+                    const bool graphics = (family.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+                    const bool compute = (family.queueFlags & VK_QUEUE_COMPUTE_BIT) != 0;
+                    const bool transfer = (family.queueFlags & VK_QUEUE_TRANSFER_BIT) != 0;
+
+                    if (graphics && graphicsFamily < 0)
+                        graphicsFamily = static_cast<int32_t>(i);
+
+                    if (compute && !graphics && m_computeQueueFamilies[gpu] < 0)
+                        m_computeQueueFamilies[gpu] = static_cast<int32_t>(i);
+
+                    //Copies into images at any offset need a granularity of one texel
+                    const VkExtent3D& granularity = family.minImageTransferGranularity;
+                    const bool anyOffset = granularity.width == 1 && granularity.height == 1 && granularity.depth == 1;
+
+                    if (transfer && !graphics && !compute && anyOffset && m_transferQueueFamilies[gpu] < 0)
+                        m_transferQueueFamilies[gpu] = static_cast<int32_t>(i);
+                }
+
+                if (graphicsFamily < 0)
+                {
+                    HT_ERROR_PRINTF("VKDevice::selectQueueFamilies(): Device has no graphics queue family.\n");
+                    return false;
+                }
+
+                m_graphicsQueueFamilies[gpu] = static_cast<uint32_t>(graphicsFamily);
+                return true;
+            }
+
             bool VKDevice::setupProcAddresses()
             {
                 //Pointer to function to get function pointers from device
@@ -298,6 +458,24 @@ namespace Hatchit
                 fpAcquireNextImageKHR = (PFN_vkAcquireNextImageKHR)g_gdpa(m_devices[0], "vkAcquireNextImageKHR");
                 fpQueuePresentKHR = (PFN_vkQueuePresentKHR)g_gdpa(m_devices[0], "vkQueuePresentKHR");
 
+#ifdef VK_KHR_timeline_semaphore
+                if (SupportsTimelineSemaphores())
+                {
+                    fpWaitSemaphoresKHR = (PFN_vkWaitSemaphoresKHR)g_gdpa(m_devices[0], "vkWaitSemaphoresKHR");
+                    fpGetSemaphoreCounterValueKHR = (PFN_vkGetSemaphoreCounterValueKHR)g_gdpa(m_devices[0], "vkGetSemaphoreCounterValueKHR");
+                }
+#endif
+
+#ifdef VK_EXT_memory_budget
+                if (SupportsMemoryBudget())
+                {
+                    fpGetPhysicalDeviceMemoryProperties2KHR = (PFN_vkGetPhysicalDeviceMemoryProperties2KHR)
+                        vkGetInstanceProcAddr(m_instance, "vkGetPhysicalDeviceMemoryProperties2KHR");
+                    if (fpGetPhysicalDeviceMemoryProperties2KHR == nullptr)
+                        m_memoryBudgets[0] = false;
+                }
+#endif
+
                 fpGetPhysicalDeviceSurfaceSupportKHR = (PFN_vkGetPhysicalDeviceSurfaceSupportKHR)
                     vkGetInstanceProcAddr(m_instance, "vkGetPhysicalDeviceSurfaceSupportKHR");
                 if (fpGetPhysicalDeviceSurfaceSupportKHR == nullptr)
@@ -451,6 +629,14 @@ namespace Hatchit
                                 m_enabledExtensionNames.push_back(VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
                             }
                         }
+#ifdef VK_KHR_get_physical_device_properties2
+                        //Required by VK_KHR_timeline_semaphore and VK_EXT_memory_budget; optional
+                        if (!strcmp(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME, instanceExtensions[i].extensionName))
+                        {
+                            m_physicalDeviceProperties2 = true;
+                            m_enabledExtensionNames.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+                        }
+#endif
 
                         assert(m_enabledExtensionNames.size() < 64);
                     }
@@ -495,7 +681,7 @@ namespace Hatchit
                 return true;
             }
 
-            bool VKDevice::checkDeviceExtensions(const VkPhysicalDevice& gpu)
+            bool VKDevice::checkDeviceExtensions(const VkPhysicalDevice& gpu, bool& timelineSemaphores, bool& memoryBudget)
             {
                 VkResult err;
                 uint32_t deviceExtensionCount = 0;
@@ -523,6 +709,22 @@ namespace Hatchit
                         swapchainExtFound = 1;
                         m_enabledExtensionNames.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
                     }
+#ifdef VK_KHR_timeline_semaphore
+                    //Optional; queues fall back to fences without it or the instance extension it needs
+                    if (m_physicalDeviceProperties2 && !strcmp(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME,
+                        deviceExtensions[i].extensionName)) {
+                        timelineSemaphores = true;
+                        m_enabledExtensionNames.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+                    }
+#endif
+#ifdef VK_EXT_memory_budget
+                    //Optional; the budget falls back to a share of each heap's size without it
+                    if (m_physicalDeviceProperties2 && !strcmp(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
+                        deviceExtensions[i].extensionName)) {
+                        memoryBudget = true;
+                        m_enabledExtensionNames.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+                    }
+#endif
                     assert(m_enabledExtensionNames.size() < 64);
                 }
 
@@ -0,0 +1,210 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+#include <ht_vkgeometrypool.h>
+#include <ht_vktools.h>
+#include <ht_vkstaginguploader.h>
+#include <ht_debug.h>
+
+namespace Hatchit {
+
+    namespace Graphics {
+
+        namespace Vulkan {
+
+            VkDevice                VKGeometryPool::m_device = VK_NULL_HANDLE;
+            VKBufferPool            VKGeometryPool::m_vertexPool;
+            VKBufferPool            VKGeometryPool::m_indexPool;
+            std::mutex              VKGeometryPool::m_mutex;
+            VKGeometryPoolStats     VKGeometryPool::m_stats = {};
+
+            /** Prepares the shared buffers; they're only created once a mesh needs them
+            * \param device The device the buffers are created on
+            * \param queueFamilies The families that use the buffers; more than one means concurrent sharing
+            * \return True if the pool is ready
+            */
+            bool VKGeometryPool::Initialize(const VkDevice& device, const std::vector<uint32_t>& queueFamilies)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                m_device = device;
+                m_stats = {};
+
+                if (!m_vertexPool.Initialize(m_device, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, queueFamilies,
+                    VKMemoryCategory::Mesh, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VertexBufferSize))
+                {
+                    HT_ERROR_PRINTF("VKGeometryPool::Initialize(): Could not initialize the vertex pool\n");
+                    return false;
+                }
+
+                if (!m_indexPool.Initialize(m_device, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, queueFamilies,
+                    VKMemoryCategory::Mesh, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, IndexBufferSize))
+                {
+                    HT_ERROR_PRINTF("VKGeometryPool::Initialize(): Could not initialize the index pool\n");
+                    m_vertexPool.DeInitialize();
+                    return false;
+                }
+
+                return true;
+            }
+
+            /** Destroys the shared buffers
+            *
+            * Nothing may still draw from them. Shared ranges freed afterwards are ignored.
+            */
+            void VKGeometryPool::DeInitialize()
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                m_vertexPool.DeInitialize();
+                m_indexPool.DeInitialize();
+                m_device = VK_NULL_HANDLE;
+            }
+
+            /** Places a mesh's vertices and indices on the GPU
+            *
+            * The upload goes through VKStagingUploader and only happens once it
+            * is flushed.
+            *
+            * \param vertices The vertex data
+            * \param vertexCount How many vertices there are
+            * \param vertexStride The size of one vertex
+            * \param indices The 32 bit indices
+            * \param indexCount How many indices there are
+            * \param range Filled with the buffers and where the mesh lives in them
+            * \return True if the mesh was placed and its upload queued
+            */
+            bool VKGeometryPool::Allocate(const void* vertices, uint32_t vertexCount, uint32_t vertexStride,
+                const uint32_t* indices, uint32_t indexCount, VKGeometryRange& range)
+            {
+                range = {};
+
+                if (m_device == VK_NULL_HANDLE)
+                {
+                    HT_ERROR_PRINTF("VKGeometryPool::Allocate(): The pool has not been initialized\n");
+                    return false;
+                }
+
+                VkDeviceSize vertexSize = static_cast<VkDeviceSize>(vertexCount) * vertexStride;
+                VkDeviceSize indexSize = static_cast<VkDeviceSize>(indexCount) * sizeof(uint32_t);
+
+                if (vertexSize == 0 || indexSize == 0)
+                {
+                    HT_ERROR_PRINTF("VKGeometryPool::Allocate(): Mesh has no vertices or indices\n");
+                    return false;
+                }
+
+                range.range.indexCount = indexCount;
+
+                if (vertexSize + indexSize > MaxSharedSize)
+                {
+                    if (!VKTools::CreateDeviceBuffer(static_cast<size_t>(vertexSize), vertices, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &range.vertexBlock))
+                        return false;
+
+                    if (!VKTools::CreateDeviceBuffer(static_cast<size_t>(indexSize), indices, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, &range.indexBlock))
+                    {
+                        VKTools::DeleteDeviceBuffer(range.vertexBlock);
+                        return false;
+                    }
+
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_stats.ownMeshes++;
+
+                    return true;
+                }
+
+                //Aligned to whole vertices and indices so the offsets can be given to the draw instead
+                if (!m_vertexPool.Allocate(vertexSize, vertexStride, range.vertexBlock))
+                {
+                    HT_ERROR_PRINTF("VKGeometryPool::Allocate(): Failed to allocate %u vertices\n", vertexCount);
+                    return false;
+                }
+
+                if (!m_indexPool.Allocate(indexSize, sizeof(uint32_t), range.indexBlock))
+                {
+                    HT_ERROR_PRINTF("VKGeometryPool::Allocate(): Failed to allocate %u indices\n", indexCount);
+                    m_vertexPool.Free(range.vertexBlock);
+                    range = {};
+                    return false;
+                }
+
+                range.shared = true;
+                range.range.vertexOffset = static_cast<int32_t>(range.vertexBlock.descriptor.offset / vertexStride);
+                range.range.firstIndex = static_cast<uint32_t>(range.indexBlock.descriptor.offset / sizeof(uint32_t));
+
+                if (!VKStagingUploader::Upload(vertices, vertexSize, range.vertexBlock.buffer, range.vertexBlock.descriptor.offset) ||
+                    !VKStagingUploader::Upload(indices, indexSize, range.indexBlock.buffer, range.indexBlock.descriptor.offset))
+                {
+                    HT_ERROR_PRINTF("VKGeometryPool::Allocate(): Failed to upload mesh\n");
+                    m_vertexPool.Free(range.vertexBlock);
+                    m_indexPool.Free(range.indexBlock);
+                    range = {};
+                    return false;
+                }
+
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stats.sharedMeshes++;
+
+                return true;
+            }
+
+            /** Gives a mesh's buffers or ranges back
+            *
+            * The GPU must be done with them; retire them through VKDeletionQueue::RetireCallback.
+            *
+            * \param range The mesh to free; cleared afterwards
+            */
+            void VKGeometryPool::Free(VKGeometryRange& range)
+            {
+                if (range.vertexBlock.buffer == VK_NULL_HANDLE && range.indexBlock.buffer == VK_NULL_HANDLE)
+                    return;
+
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                if (!range.shared)
+                {
+                    VKTools::DeleteDeviceBuffer(range.vertexBlock);
+                    VKTools::DeleteDeviceBuffer(range.indexBlock);
+                    m_stats.ownMeshes--;
+                }
+                else if (m_device != VK_NULL_HANDLE)
+                {
+                    m_vertexPool.Free(range.vertexBlock);
+                    m_indexPool.Free(range.indexBlock);
+                    m_stats.sharedMeshes--;
+                }
+
+                range = {};
+            }
+
+            /** Counts the meshes and shared buffers the pool holds
+            * \return The pool's current stats
+            */
+            VKGeometryPoolStats VKGeometryPool::GetStats()
+            {
+                VKBufferPoolStats vertexStats = m_vertexPool.GetStats();
+                VKBufferPoolStats indexStats = m_indexPool.GetStats();
+
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                VKGeometryPoolStats stats = m_stats;
+                stats.vertexBuffers = vertexStats.bufferCount;
+                stats.indexBuffers = indexStats.bufferCount;
+                stats.bytesUsed = vertexStats.bytesUsed + indexStats.bytesUsed;
+
+                return stats;
+            }
+        }
+    }
+}
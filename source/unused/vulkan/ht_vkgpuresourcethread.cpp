@@ -35,9 +35,6 @@ namespace Hatchit
         {
             VKGPUResourceThread::VKGPUResourceThread(VKDevice* device, VKSwapChain* swapchain)
             {
-                m_alive = false;
-                m_tfinished = false;
-                m_locked = false;
                 m_device = device;
                 m_swapchain = swapchain;
             }
@@ -49,92 +46,16 @@ namespace Hatchit
 
             void VKGPUResourceThread::VStart()
             {
+                //Descriptor sets come from VKDescriptorAllocator, which gives every worker its own pools
                 m_alive = true;
 
-                m_thread = std::thread(&VKGPUResourceThread::thread_main, this);
+                for (uint32_t i = 0; i < m_workerCount; i++)
+                    m_threads.push_back(std::thread(&VKGPUResourceThread::thread_main, this));
             }
 
             void VKGPUResourceThread::thread_main()
             {
-                auto device = m_device->GetVKDevices()[0];
-
-                if (!createDescriptorPool(device))
-                {
-                    HT_ERROR_PRINTF("VKGPUResourceThread::thread_main: Failed to create descriptor pool in thread.\n");
-                    Kill();
-                }
-
-                while (m_alive)
-                {
-                    /*Load any resource requests asynchrounsly*/
-                    if (m_requests.empty())
-                        continue;
-
-                    auto request = m_requests.pop();
-                    switch ((*request)->type)
-                    {
-                        case GPUResourceRequest::Type::Texture:
-                        {
-                            auto tRequest = static_cast<TextureRequest*>(*request);
-
-                            ProcessTextureRequest(tRequest);
-                        } break;
-
-                        case GPUResourceRequest::Type::Material:
-                        {
-                            auto mRequest = static_cast<MaterialRequest*>(*request);
-
-                            ProcessMaterialRequest(mRequest);
-                        } break;
-
-                        case GPUResourceRequest::Type::RootLayout:
-                        {
-                            auto rRequest = static_cast<RootLayoutRequest*>(*request);
-
-                            ProcessRootLayoutRequest(rRequest);
-                        } break;
-
-                        case GPUResourceRequest::Type::Pipeline:
-                        {
-                            auto pRequest = static_cast<PipelineRequest*>(*request);
-
-                            ProcessPipelineRequest(pRequest);
-                        } break;
-
-                        case GPUResourceRequest::Type::Shader:
-                        {
-                            auto sRequest = static_cast<ShaderRequest*>(*request);
-
-                            ProcessShaderRequest(sRequest);
-                        } break;
-
-                        case GPUResourceRequest::Type::RenderPass:
-                        {
-                            auto sRequest = static_cast<RenderPassRequest*>(*request);
-
-                            ProcessRenderPassRequest(sRequest);
-                        } break;
-
-                        case GPUResourceRequest::Type::RenderTarget:
-                        {
-                            auto sRequest = static_cast<RenderTargetRequest*>(*request);
-
-                            ProcessRenderTargetRequest(sRequest);
-                        } break;
-
-                        case GPUResourceRequest::Type::Mesh:
-                        {
-                            auto sRequest = static_cast<MeshRequest*>(*request);
-
-                            ProcessMeshRequest(sRequest);
-                        } break;
-                    }
-
-                    m_processed = true;
-                    m_cv.notify_one();
-                }
-
-                vkDestroyDescriptorPool(device, m_descriptorPool, nullptr);
+                runLoads();
             }
 
             void VKGPUResourceThread::VCreateTextureBase(Resource::TextureHandle handle, void ** base)
@@ -156,7 +77,7 @@ namespace Hatchit
                 if (!*_base)
                 {
                     *_base = new VKMaterial;
-                    if (!(*_base)->Initialize(handle, m_device->GetVKDevices()[0], m_descriptorPool))
+                    if (!(*_base)->Initialize(handle, m_device->GetVKDevices()[0]))
                     {
                         HT_DEBUG_PRINTF("Failed to initialize GPU Material Resource.\n");
                     }
@@ -169,7 +90,7 @@ namespace Hatchit
                 if (!*_base)
                 {
                     *_base = new VKRootLayout;
-                    if (!(*_base)->Initialize(handle, m_device->GetVKDevices()[0], m_descriptorPool))
+                    if (!(*_base)->Initialize(handle, m_device->GetVKDevices()[0]))
                     {
                         HT_DEBUG_PRINTF("Failed to initialize GPU RootLayout Resource.\n");
                     }
@@ -182,7 +103,7 @@ namespace Hatchit
                 if (!*_base)
                 {
                     *_base = new VKPipeline;
-                    if (!(*_base)->Initialize(handle, m_device->GetVKDevices()[0], m_descriptorPool))
+                    if (!(*_base)->Initialize(handle, m_device->GetVKDevices()[0]))
                     {
                         HT_DEBUG_PRINTF("Failed to initialize GPU Pipeline Resource.\n");
                     }
@@ -208,7 +129,7 @@ namespace Hatchit
                 if (!*_base)
                 {
                     *_base = new VKRenderPass;
-                    if (!(*_base)->Initialize(handle, m_device->GetVKDevices()[0], m_descriptorPool, m_swapchain))
+                    if (!(*_base)->Initialize(handle, m_device->GetVKDevices()[0], m_swapchain))
                     {
                         HT_DEBUG_PRINTF("Failed to initialize GPU Render Pass.\n");
                     }
@@ -240,47 +161,6 @@ namespace Hatchit
                     }
                 }
             }
-
-            bool VKGPUResourceThread::createDescriptorPool(const VkDevice& device)
-            {
-                VkResult err;
-
-                //Setup the descriptor pool
-                std::vector<VkDescriptorPoolSize> poolSizes;
-
-                VkDescriptorPoolSize uniformSize = {};
-                uniformSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-                uniformSize.descriptorCount = 10;
-
-                VkDescriptorPoolSize imageSize = {};
-                imageSize.type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
-                imageSize.descriptorCount = 16;
-
-                VkDescriptorPoolSize samplerSize = {};
-                samplerSize.type = VK_DESCRIPTOR_TYPE_SAMPLER;
-                samplerSize.descriptorCount = 6;
-
-                poolSizes.push_back(uniformSize);
-                poolSizes.push_back(imageSize);
-                poolSizes.push_back(samplerSize);
-
-                VkDescriptorPoolCreateInfo poolCreateInfo = {};
-                poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-                poolCreateInfo.pPoolSizes = poolSizes.data();
-                poolCreateInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-                poolCreateInfo.maxSets = 16;
-                poolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
-
-                err = vkCreateDescriptorPool(device, &poolCreateInfo, nullptr, &m_descriptorPool);
-                assert(!err);
-                if (err != VK_SUCCESS)
-                {
-                    HT_DEBUG_PRINTF("VKRenderer::setupDescriptorPool: Failed to create descriptor pool\n");
-                    return false;
-                }
-
-                return true;
-            }
         }
     }
 }
\ No newline at end of file
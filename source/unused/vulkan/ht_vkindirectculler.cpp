@@ -0,0 +1,283 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+#include <ht_vkindirectculler.h>
+#include <ht_vkdescriptorallocator.h>
+#include <ht_vkshader.h>
+#include <ht_shader.h>
+#include <ht_debug.h>
+#include <cassert>
+#include <cstring>      //memcpy
+#include <vector>
+
+namespace Hatchit {
+
+    namespace Graphics {
+
+        namespace Vulkan {
+
+            VkDevice                VKIndirectCuller::m_device = VK_NULL_HANDLE;
+            bool                    VKIndirectCuller::m_multiDrawIndirect = false;
+            bool                    VKIndirectCuller::m_indirectFirstInstance = false;
+
+            VkDescriptorSetLayout   VKIndirectCuller::m_setLayout = VK_NULL_HANDLE;
+            VkPipelineLayout        VKIndirectCuller::m_pipelineLayout = VK_NULL_HANDLE;
+            VkPipeline              VKIndirectCuller::m_pipeline = VK_NULL_HANDLE;
+
+            static_assert(sizeof(VKCullObject) == 32, "The culling shader reads VKCullObjects as 32 byte records");
+            static_assert(sizeof(VKCullDraw) == 8, "The culling shader reads VKCullDraws as 8 byte records");
+
+            /** Prepares the culler; the pipeline is only made by CreatePipeline
+            * \param device The device dispatches are recorded for
+            * \param multiDrawIndirect True if the device has the multiDrawIndirect feature enabled
+            * \param indirectFirstInstance True if the device has the drawIndirectFirstInstance feature enabled
+            * \return True if the culler is ready
+            */
+            bool VKIndirectCuller::Initialize(const VkDevice& device, bool multiDrawIndirect, bool indirectFirstInstance)
+            {
+                m_device = device;
+                m_multiDrawIndirect = multiDrawIndirect;
+                m_indirectFirstInstance = indirectFirstInstance;
+
+                return true;
+            }
+
+            /** Destroys the pipeline and its layouts
+            *
+            * Nothing still in flight may use them.
+            */
+            void VKIndirectCuller::DeInitialize()
+            {
+                if (m_device == VK_NULL_HANDLE)
+                    return;
+
+                if (m_pipeline != VK_NULL_HANDLE)
+                    vkDestroyPipeline(m_device, m_pipeline, nullptr);
+                if (m_pipelineLayout != VK_NULL_HANDLE)
+                    vkDestroyPipelineLayout(m_device, m_pipelineLayout, nullptr);
+                if (m_setLayout != VK_NULL_HANDLE)
+                    vkDestroyDescriptorSetLayout(m_device, m_setLayout, nullptr);
+
+                m_pipeline = VK_NULL_HANDLE;
+                m_pipelineLayout = VK_NULL_HANDLE;
+                m_setLayout = VK_NULL_HANDLE;
+                m_device = VK_NULL_HANDLE;
+            }
+
+            /** Loads the culling shader and creates the compute pipeline
+            *
+            * Must be called once the GPU resource pool is up and before any
+            * pass is recorded. The shader is built from shaders/IndirectCull.comp.
+            * A missing shader isn't an error here since no pass may want it;
+            * a GPU driven pass reports it when it has to cull on the CPU.
+            *
+            * \param shaderPath The SPIR-V shader to cull with
+            * \return True if dispatches can be recorded
+            */
+            bool VKIndirectCuller::CreatePipeline(const std::string& shaderPath)
+            {
+                VkResult err;
+
+                if (m_pipeline != VK_NULL_HANDLE)
+                    return true;
+
+                //An earlier attempt failed part way; its layouts wait for DeInitialize
+                if (m_setLayout != VK_NULL_HANDLE)
+                    return false;
+
+                if (m_device == VK_NULL_HANDLE)
+                {
+                    HT_ERROR_PRINTF("VKIndirectCuller::CreatePipeline(): The culler has not been initialized\n");
+                    return false;
+                }
+
+                //Without a first instance every draw would read the same instances
+                if (!m_indirectFirstInstance)
+                    return false;
+
+                ShaderHandle shaderHandle = Shader::GetHandle(shaderPath, shaderPath);
+                if (!shaderHandle.IsValid() || shaderHandle->GetBase() == nullptr)
+                {
+                    HT_DEBUG_PRINTF("VKIndirectCuller::CreatePipeline(): Could not load %s; passes will cull on the CPU\n", shaderPath.c_str());
+                    return false;
+                }
+
+                VkShaderModule shaderModule = static_cast<VKShader*>(shaderHandle->GetBase())->GetShaderModule();
+
+                std::vector<VkDescriptorSetLayoutBinding> bindings(5);
+                for (size_t i = 0; i < bindings.size(); i++)
+                {
+                    bindings[i] = {};
+                    bindings[i].binding = static_cast<uint32_t>(i);
+                    bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                    bindings[i].descriptorCount = 1;
+                    bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+                    bindings[i].pImmutableSamplers = nullptr;
+                }
+
+                VkDescriptorSetLayoutCreateInfo setLayoutInfo = {};
+                setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+                setLayoutInfo.pNext = nullptr;
+                setLayoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+                setLayoutInfo.pBindings = bindings.data();
+
+                err = vkCreateDescriptorSetLayout(m_device, &setLayoutInfo, nullptr, &m_setLayout);
+                assert(!err);
+                if (err != VK_SUCCESS)
+                {
+                    HT_ERROR_PRINTF("VKIndirectCuller::CreatePipeline(): Failed to create descriptor set layout\n");
+                    return false;
+                }
+
+                VKDescriptorAllocator::RegisterLayout(m_setLayout, bindings);
+
+                VkPushConstantRange pushRange = {};
+                pushRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+                pushRange.offset = 0;
+                pushRange.size = sizeof(PushConstants);
+
+                VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+                pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+                pipelineLayoutInfo.pNext = nullptr;
+                pipelineLayoutInfo.setLayoutCount = 1;
+                pipelineLayoutInfo.pSetLayouts = &m_setLayout;
+                pipelineLayoutInfo.pushConstantRangeCount = 1;
+                pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+
+                err = vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, nullptr, &m_pipelineLayout);
+                assert(!err);
+                if (err != VK_SUCCESS)
+                {
+                    HT_ERROR_PRINTF("VKIndirectCuller::CreatePipeline(): Failed to create pipeline layout\n");
+                    return false;
+                }
+
+                VkComputePipelineCreateInfo pipelineInfo = {};
+                pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+                pipelineInfo.pNext = nullptr;
+                pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+                pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+                pipelineInfo.stage.module = shaderModule;
+                pipelineInfo.stage.pName = "main";
+                pipelineInfo.layout = m_pipelineLayout;
+                pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+                pipelineInfo.basePipelineIndex = -1;
+
+                err = vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_pipeline);
+                assert(!err);
+                if (err != VK_SUCCESS)
+                {
+                    HT_ERROR_PRINTF("VKIndirectCuller::CreatePipeline(): Failed to create compute pipeline\n");
+                    m_pipeline = VK_NULL_HANDLE;
+                    return false;
+                }
+
+                return true;
+            }
+
+            /** Gets whether dispatches can be recorded
+            * \return True once CreatePipeline has succeeded
+            */
+            bool VKIndirectCuller::IsAvailable()
+            {
+                return m_pipeline != VK_NULL_HANDLE;
+            }
+
+            /** Gets whether one indirect draw call may issue more than one draw
+            * \return True if the device has the multiDrawIndirect feature enabled
+            */
+            bool VKIndirectCuller::SupportsMultiDraw()
+            {
+                return m_multiDrawIndirect;
+            }
+
+            /** Records a culling dispatch and the barrier that lets draws read what it wrote
+            *
+            * Record outside of any render pass. The descriptor set comes from
+            * the current frame slot's transient pools.
+            *
+            * \param commandBuffer The command buffer to record into
+            * \param frustum The frustum to test every object against
+            * \param dispatch The buffers to read and write
+            * \return True if the dispatch was recorded
+            */
+            bool VKIndirectCuller::RecordCull(VkCommandBuffer commandBuffer, const Frustum& frustum, const VKCullDispatch& dispatch)
+            {
+                if (!IsAvailable())
+                {
+                    HT_ERROR_PRINTF("VKIndirectCuller::RecordCull(): The culling pipeline has not been created\n");
+                    return false;
+                }
+
+                if (dispatch.objectCount == 0)
+                    return true;
+
+                VkDescriptorSet set;
+                if (!VKDescriptorAllocator::AllocateTransient(m_setLayout, set))
+                {
+                    HT_ERROR_PRINTF("VKIndirectCuller::RecordCull(): Failed to allocate descriptor set\n");
+                    return false;
+                }
+
+                VkDescriptorBufferInfo bufferInfos[5];
+                bufferInfos[0] = { dispatch.objects.buffer, dispatch.objects.offset, dispatch.objects.size };
+                bufferInfos[1] = { dispatch.instances.buffer, dispatch.instances.offset, dispatch.instances.size };
+                bufferInfos[2] = { dispatch.commands.buffer, dispatch.commands.offset, dispatch.commands.size };
+                bufferInfos[3] = { dispatch.output, 0, dispatch.outputSize };
+                bufferInfos[4] = { dispatch.draws.buffer, dispatch.draws.offset, dispatch.draws.size };
+
+                VkWriteDescriptorSet writes[5];
+                for (uint32_t i = 0; i < 5; i++)
+                {
+                    writes[i] = {};
+                    writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                    writes[i].pNext = nullptr;
+                    writes[i].dstSet = set;
+                    writes[i].dstBinding = i;
+                    writes[i].descriptorCount = 1;
+                    writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                    writes[i].pBufferInfo = &bufferInfos[i];
+                }
+
+                vkUpdateDescriptorSets(m_device, 5, writes, 0, nullptr);
+
+                PushConstants pushConstants = {};
+                memcpy(pushConstants.planes, frustum.GetPlanes(), sizeof(pushConstants.planes));
+                pushConstants.objectCount = dispatch.objectCount;
+
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &set, 0, nullptr);
+                vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+
+                vkCmdDispatch(commandBuffer, (dispatch.objectCount + GroupSize - 1) / GroupSize, 1, 1);
+
+                //Draws read the counts as indirect parameters and the copied instances as vertex input;
+                //a following dispatch sharing the commands adds to the same counts
+                VkMemoryBarrier barrier = {};
+                barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+                barrier.pNext = nullptr;
+                barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+                barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT |
+                    VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+                vkCmdPipelineBarrier(commandBuffer,
+                    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                    VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                    0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+                return true;
+            }
+        }
+    }
+}
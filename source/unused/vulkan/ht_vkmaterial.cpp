@@ -17,6 +17,10 @@
 #include <ht_vktexture.h>
 #include <ht_renderpass.h>
 #include <ht_vkpipeline.h>
+#include <ht_vkdeletionqueue.h>
+#include <ht_vkuniformarena.h>
+#include <ht_vkdescriptorallocator.h>
+#include <algorithm>    //std::lower_bound, std::min, std::max
 #include <cassert>
 
 namespace Hatchit {
@@ -27,12 +31,14 @@ namespace Hatchit {
 
             using namespace Resource;
 
-            VKMaterial::VKMaterial() {}
+            VKMaterial::VKMaterial() 
+            {
+                m_uniformRange = {};
+            }
 
-            bool VKMaterial::Initialize(Resource::MaterialHandle handle, const VkDevice& device, const VkDescriptorPool& descriptorPool)
+            bool VKMaterial::Initialize(Resource::MaterialHandle handle, const VkDevice& device)
             {
                 m_device = &device;
-                m_descriptorPool = &descriptorPool;
 
                 if (!handle.IsValid())
                 {
@@ -73,6 +79,31 @@ namespace Hatchit {
                 const VKRootLayout* rootLayout = renderPass->GetVKRootLayout();
                 m_descriptorSetLayouts = rootLayout->VKGetDescriptorSetLayouts();
 
+                //Lay every chunk out in one uniform range, each at a bindable offset
+                VkDeviceSize alignment = VKUniformArena::GetAlignment();
+                size_t rangeSize = 0;
+                for (size_t i = 0; i < m_shaderVariables.size(); i++)
+                {
+                    m_chunkOffsets.push_back(rangeSize);
+                    rangeSize += static_cast<size_t>(((m_shaderVariables[i]->GetSize() + alignment - 1) / alignment) * alignment);
+
+                    getSetSlot(m_shaderVariableLocations[i].set);
+                }
+
+                if (rangeSize > 0 && !VKUniformArena::Allocate(rangeSize, m_uniformRange))
+                {
+                    HT_ERROR_PRINTF("VKMaterial::Initialize Failed to allocate uniform range\n");
+                    return false;
+                }
+
+                //No slot's copy has been written yet
+                m_pendingRanges.assign(VKUniformArena::GetFrameCount(), std::vector<DirtyRange>(m_shaderVariables.size()));
+                for (size_t i = 0; i < m_shaderVariables.size(); i++)
+                {
+                    for (size_t f = 0; f < m_pendingRanges.size(); f++)
+                        m_pendingRanges[f][i] = { 0, m_shaderVariables[i]->GetSize() };
+                }
+
                 std::vector<Resource::Material::TexturePath> texturePaths = handle->GetTexturePaths();
                 //Map layout location to file handle
                 for (size_t i = 0; i < texturePaths.size(); i++)
@@ -92,26 +123,38 @@ namespace Hatchit {
                     m_textureLocations.push_back(location);
                     m_textures.push_back(texture);
 
+                    //Eviction swaps the texture's view out from under our descriptor sets
+                    m_textureListeners.push_back(texture->AddResidencyListener([this]() { rebuildDescriptorSet(); }));
+
                     //Record which descriptor set layouts we need
-                    m_materialLayouts.push_back(m_descriptorSetLayouts[location.set]);
+                    getSetSlot(location.set);
                 }
 
-                setupDescriptorSet();
+                if (!setupDescriptorSet())
+                    return false;
 
-                return true;
+                //Every chunk starts out dirty, so this uploads all of them
+                return VUpdate();
             }
 
             VKMaterial::~VKMaterial() 
             {
-                //Free descriptor sets
-                uint32_t descriptorSetCount = static_cast<uint32_t>(m_materialSets.size());
-                VkDescriptorSet* descriptorSets = m_materialSets.data();
+                for (size_t i = 0; i < m_textures.size(); i++)
+                    m_textures[i]->RemoveResidencyListener(m_textureListeners[i]);
 
-                vkFreeDescriptorSets(*m_device, *m_descriptorPool, descriptorSetCount, descriptorSets);
+                //Shared sets are only retired once every material using them lets go
+                for (size_t f = 0; f < m_materialSets.size(); f++)
+                {
+                    for (size_t i = 0; i < m_materialSets[f].size(); i++)
+                        VKDescriptorAllocator::ReleaseCached(m_materialSets[f][i]);
+                }
 
-                //Destroy unifrom blocks
-                //vkFreeMemory(*m_device, m_uniformVSBuffer.memory, nullptr);
-                //vkDestroyBuffer(*m_device, m_uniformVSBuffer.buffer, nullptr);
+                //Hand the uniform range back once no frame reads it
+                VKUniformRange uniformRange = m_uniformRange;
+                VKDeletionQueue::RetireCallback([uniformRange]() mutable
+                {
+                    VKUniformArena::Free(uniformRange);
+                });
             }
 
 
@@ -136,38 +179,92 @@ namespace Hatchit {
                 return m_pipeline;
             }
 
+            /** Copies changed shader variables into the current frame slot's copy of the uniform range
+            *
+            * A change is remembered for every slot and written to each one
+            * as its frame comes around, so frames still in flight keep the
+            * values they were recorded with. Only the bytes that changed
+            * since a slot was last written are copied; untouched chunks
+            * cost nothing.
+            *
+            * \return False if a write didn't fit the range
+            */
             bool VKMaterial::VUpdate() 
             {
-                //TODO: Figure out what data is going into what buffers
-                /*if (m_shaderVariables.size() == 0)
+                std::lock_guard<std::mutex> lock(m_updateMutex);
+
+                if (m_pendingRanges.empty())
                     return true;
 
-                uint8_t* pData;
-                std::vector<Math::Matrix4> variableList;
+                const uint32_t frame = VKUniformArena::GetFrame() % static_cast<uint32_t>(m_pendingRanges.size());
 
+                bool success = true;
                 for (size_t i = 0; i < m_shaderVariables.size(); i++)
                 {
-                    m_shaderVariables[i]->GetByteData();
-                    m_shaderVariables[i]->GetSize();
+                    ShaderVariableChunk* chunk = m_shaderVariables[i];
+                    if (chunk->IsDirty())
+                    {
+                        size_t begin, end;
+                        chunk->GetDirtyRange(begin, end);
+
+                        for (size_t f = 0; f < m_pendingRanges.size(); f++)
+                        {
+                            DirtyRange& pending = m_pendingRanges[f][i];
+                            if (pending.end <= pending.begin)
+                                pending = { begin, end };
+                            else
+                                pending = { std::min(pending.begin, begin), std::max(pending.end, end) };
+                        }
+
+                        chunk->ClearDirty();
+                    }
+
+                    DirtyRange& pending = m_pendingRanges[frame][i];
+                    if (pending.end <= pending.begin)
+                        continue;
+
+                    success &= VKUniformArena::Write(m_uniformRange, m_chunkOffsets[i] + pending.begin,
+                        chunk->GetByteData() + pending.begin, pending.end - pending.begin);
+
+                    pending = { 0, 0 };
                 }
 
-                VkResult err = vkMapMemory(*m_device, m_uniformVSBuffer.memory, 0, sizeof(m_shaderVariables), 0, (void**)&pData);
-                assert(!err);
-                
-                memcpy(pData, variableList.data(), size);
-                
-                vkUnmapMemory(*m_device, m_uniformVSBuffer.memory);
-                */
-                return true;
+                return success;
             }
 
-            const void VKMaterial::BindMaterial(const VkCommandBuffer& commandBuffer, const VkPipelineLayout& pipelineLayout) const
+            const void VKMaterial::BindMaterial(VKCommandState& state, const VkPipelineLayout& pipelineLayout) const
             { 
-                if (m_materialSets.size() <= 0)
+                if (m_materialSets.size() <= 0 || m_materialSets[0].size() <= 0)
                     return;
 
-                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 3, 
-                    static_cast<uint32_t>(m_materialSets.size()), m_materialSets.data(), 0, nullptr);
+                VKMarkUsed();
+
+                //Each frame slot binds the sets that point at its own copy of the uniforms
+                const std::vector<VkDescriptorSet>& materialSets = m_materialSets[VKUniformArena::GetFrame() % m_materialSets.size()];
+
+                //Bind each run of consecutive set indices with one call
+                size_t first = 0;
+                while (first < materialSets.size())
+                {
+                    size_t count = 1;
+                    while (first + count < materialSets.size() && m_setIndices[first + count] == m_setIndices[first] + count)
+                        count++;
+
+                    state.BindDescriptorSets(pipelineLayout, m_setIndices[first], static_cast<uint32_t>(count), &materialSets[first]);
+
+                    first += count;
+                }
+            }
+
+            /** Keeps the budget from evicting the textures this frame samples
+            *
+            * Binding the material does this already; call it when a recorded
+            * command buffer that binds the material is submitted again.
+            */
+            void VKMaterial::VKMarkUsed() const
+            {
+                for (size_t i = 0; i < m_textures.size(); i++)
+                    m_textures[i]->VKMarkUsed();
             }
 
             bool VKMaterial::setupDescriptorSet()
@@ -175,54 +272,125 @@ namespace Hatchit {
                 if (m_materialLayouts.size() <= 0)
                     return true;
 
-                VkResult err;
+                //The writes point into these, so they can't move until they're done
+                std::vector<VkDescriptorImageInfo> textureDescriptors(m_textures.size());
+                std::vector<VkDescriptorBufferInfo> chunkDescriptors(m_shaderVariables.size());
 
-                //Setup the descriptor sets
-                VkDescriptorSetAllocateInfo allocInfo = {};
-                allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-                allocInfo.descriptorPool = *m_descriptorPool;
-                allocInfo.descriptorSetCount = static_cast<uint32_t>(m_materialLayouts.size());
-                allocInfo.pSetLayouts = m_materialLayouts.data();
+                //Texture descriptors are the same for every frame slot
+                for (size_t i = 0; i < m_textures.size(); i++)
+                {
+                    //Create Texture description
+                    VkDescriptorImageInfo& textureDescriptor = textureDescriptors[i];
+                    textureDescriptor.sampler = nullptr; //Sampler applied in shader
+                    textureDescriptor.imageView = m_textures[i]->GetView();
+                    textureDescriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+                }
 
-                m_materialSets.resize(m_materialLayouts.size());
-                err = vkAllocateDescriptorSets(*m_device, &allocInfo, m_materialSets.data());
-                assert(!err);
-                if (err != VK_SUCCESS)
+                //One group of sets per frame slot, each pointing at that slot's copy of the uniforms
+                std::vector<std::vector<VkDescriptorSet>> frameSets(std::max<size_t>(m_pendingRanges.size(), 1));
+                for (size_t f = 0; f < frameSets.size(); f++)
                 {
-                    HT_DEBUG_PRINTF("VKMaterial::VPrepare: Failed to allocate descriptor set\n");
-                    return false;
+                    //Writes for each set; the allocator fills in the destination
+                    std::vector<std::vector<VkWriteDescriptorSet>> setWrites(m_materialLayouts.size());
+
+                    //Setup writes for shader variables; each chunk binds its own slice of the range
+                    VkDescriptorBufferInfo slotDescriptor = VKUniformArena::GetDescriptor(m_uniformRange, static_cast<uint32_t>(f));
+                    for (size_t i = 0; i < m_shaderVariables.size(); i++)
+                    {
+                        LayoutLocation location = m_shaderVariableLocations[i];
+
+                        VkDescriptorBufferInfo& chunkDescriptor = chunkDescriptors[i];
+                        chunkDescriptor.buffer = slotDescriptor.buffer;
+                        chunkDescriptor.offset = slotDescriptor.offset + m_chunkOffsets[i];
+                        chunkDescriptor.range = m_shaderVariables[i]->GetSize();
+
+                        VkWriteDescriptorSet uniformWrite = {};
+                        uniformWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                        uniformWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+                        uniformWrite.dstBinding = location.binding;
+                        uniformWrite.pBufferInfo = &chunkDescriptor;
+                        uniformWrite.descriptorCount = 1;
+
+                        setWrites[getSetSlot(location.set)].push_back(uniformWrite);
+                    }
+
+                    //Setup writes for textures
+                    for (size_t i = 0; i < m_textures.size(); i++)
+                    {
+                        LayoutLocation location = m_textureLocations[i];
+
+                        VkWriteDescriptorSet samplerFSWrite = {};
+                        samplerFSWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                        samplerFSWrite.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+                        samplerFSWrite.dstBinding = location.binding;
+                        samplerFSWrite.pImageInfo = &textureDescriptors[i];
+                        samplerFSWrite.descriptorCount = 1;
+
+                        setWrites[getSetSlot(location.set)].push_back(samplerFSWrite);
+                    }
+
+                    //Materials sampling the same textures end up sharing sets, and so do
+                    //the slots of a set that holds no uniforms
+                    std::vector<VkDescriptorSet>& sets = frameSets[f];
+                    sets.assign(m_materialLayouts.size(), VK_NULL_HANDLE);
+                    for (size_t i = 0; i < sets.size(); i++)
+                    {
+                        if (!VKDescriptorAllocator::AcquireCached(m_materialLayouts[i], setWrites[i], sets[i]))
+                        {
+                            HT_DEBUG_PRINTF("VKMaterial::setupDescriptorSet: Failed to allocate descriptor set\n");
+
+                            for (size_t g = 0; g <= f; g++)
+                            {
+                                for (size_t j = 0; j < frameSets[g].size(); j++)
+                                {
+                                    if (frameSets[g][j] != VK_NULL_HANDLE)
+                                        VKDescriptorAllocator::ReleaseCached(frameSets[g][j]);
+                                }
+                            }
+                            return false;
+                        }
+                    }
                 }
 
-                std::vector<VkWriteDescriptorSet> descSetWrites = {};
-                uint32_t writeCount = 0;
+                m_materialSets = frameSets;
 
+                return true;
+            }
 
-                //Setup writes for textures
-                for (size_t i = 0; i < m_textures.size(); i++)
-                {
-                    LayoutLocation location = m_textureLocations[i];
-                    VKTexture* texture = m_textures[i];
+            void VKMaterial::rebuildDescriptorSet()
+            {
+                //Frames in flight may still have the old sets bound
+                std::vector<std::vector<VkDescriptorSet>> oldSets = m_materialSets;
+                if (!setupDescriptorSet())
+                    return;
 
-                    //Create Texture description
-                    VkDescriptorImageInfo textureDescriptor = {};
-                    textureDescriptor.sampler = nullptr; //Sampler applied in shader
-                    textureDescriptor.imageView = texture->GetView();
-                    textureDescriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+                for (size_t f = 0; f < oldSets.size(); f++)
+                {
+                    for (size_t i = 0; i < oldSets[f].size(); i++)
+                        VKDescriptorAllocator::ReleaseCached(oldSets[f][i]);
+                }
+            }
 
-                    VkWriteDescriptorSet samplerFSWrite = {};
-                    samplerFSWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                    samplerFSWrite.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
-                    samplerFSWrite.dstSet = m_materialSets[writeCount++];
-                    samplerFSWrite.dstBinding = location.binding;
-                    samplerFSWrite.pImageInfo = &textureDescriptor;
-                    samplerFSWrite.descriptorCount = 1;
+            /** Finds which of the material's descriptor sets is bound at a set index
+            *
+            * Sets are created as they're first asked for, so textures and
+            * shader variables at the same index share one set.
+            *
+            * \param set The set index from a layout location
+            * \return The slot in m_setIndices, m_materialLayouts and m_materialSets
+            */
+            size_t VKMaterial::getSetSlot(uint32_t set)
+            {
+                auto it = std::lower_bound(m_setIndices.begin(), m_setIndices.end(), set);
+                size_t slot = static_cast<size_t>(it - m_setIndices.begin());
 
-                    descSetWrites.push_back(samplerFSWrite);
+                if (it == m_setIndices.end() || *it != set)
+                {
+                    m_setIndices.insert(it, set);
+                    m_materialLayouts.insert(m_materialLayouts.begin() + slot, m_descriptorSetLayouts[set]);
                 }
 
-                vkUpdateDescriptorSets(*m_device, static_cast<uint32_t>(descSetWrites.size()), descSetWrites.data(), 0, nullptr);
-
-                return true;
+                return slot;
             }
         }
     }
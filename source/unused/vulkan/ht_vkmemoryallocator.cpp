@@ -0,0 +1,638 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+#include <ht_vkmemoryallocator.h>
+#include <ht_debug.h>
+#include <algorithm>
+#include <cassert>
+#include <cstring>  //std::memset
+
+namespace Hatchit {
+
+    namespace Graphics {
+
+        namespace Vulkan {
+
+            const VkDeviceSize VKMemoryAllocator::DefaultBlockSize;
+            const uint32_t VKMemoryAllocator::MinOrder;
+
+            VKMemoryAllocator::VKMemoryAllocator()
+            {
+                m_device = VK_NULL_HANDLE;
+                m_memoryProperties = {};
+                m_bufferImageGranularity = 1;
+                m_functions = {};
+                m_blockSize = DefaultBlockSize;
+                std::memset(m_heapUsage, 0, sizeof(m_heapUsage));
+            }
+
+            VKMemoryAllocator::~VKMemoryAllocator()
+            {
+                DeInitialize();
+            }
+
+            /** Prepares the allocator for a device
+            * \param device The device to allocate from
+            * \param memoryProperties The memory types and heaps of the device
+            * \param bufferImageGranularity The device's bufferImageGranularity limit
+            * \param functions Replacement allocation functions; null to call Vulkan directly
+            * \param blockSize The size of the shared blocks, rounded up to a power of two
+            * \return True if the allocator is ready
+            */
+            bool VKMemoryAllocator::Initialize(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties,
+                VkDeviceSize bufferImageGranularity, const VKMemoryFunctions* functions, VkDeviceSize blockSize)
+            {
+                std::lock_guard<std::recursive_mutex> lock(m_mutex);
+
+                m_device = device;
+                m_memoryProperties = memoryProperties;
+                m_bufferImageGranularity = std::max<VkDeviceSize>(bufferImageGranularity, 1);
+
+                if (functions != nullptr)
+                {
+                    m_functions = *functions;
+                }
+                else
+                {
+                    m_functions.allocate = vkAllocateMemory;
+                    m_functions.free = vkFreeMemory;
+                    m_functions.map = vkMapMemory;
+                    m_functions.unmap = vkUnmapMemory;
+                }
+
+                m_blockSize = static_cast<VkDeviceSize>(1) << std::max(orderOf(blockSize), MinOrder + 1);
+
+                return true;
+            }
+
+            /** Returns every block to the driver
+            *
+            * Anything still allocated is freed along with its block.
+            */
+            void VKMemoryAllocator::DeInitialize()
+            {
+                std::lock_guard<std::recursive_mutex> lock(m_mutex);
+
+                if (!m_blocks.empty())
+                {
+                    VKMemoryStats stats = GetStats();
+                    if (stats.allocationCount > 0)
+                        HT_DEBUG_PRINTF("VKMemoryAllocator::DeInitialize(): %d allocations were never freed\n", stats.allocationCount);
+                }
+
+                while (!m_blocks.empty())
+                    destroyBlock(m_blocks.back());
+
+                std::memset(m_heapUsage, 0, sizeof(m_heapUsage));
+            }
+
+            /** Allocates a range of memory
+            * \param requirements The size, alignment and memory types the resource allows
+            * \param properties The memory properties the range must have
+            * \param linear True for buffers and linearly tiled images; false for optimally tiled images
+            * \param allocation Filled with the range on success
+            * \param category What the range is for; its size is accounted under it until freed
+            * \param userData Handed back to the move callback when defragmenting
+            * \return True if the range was allocated
+            */
+            bool VKMemoryAllocator::Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+                bool linear, VKAllocation& allocation, VKMemoryCategory category, void* userData)
+            {
+                std::lock_guard<std::recursive_mutex> lock(m_mutex);
+
+                VkDeviceSize size = std::max(requirements.size, requirements.alignment);
+
+                //Try each type that fits, in the device's order of preference
+                for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++)
+                {
+                    if ((requirements.memoryTypeBits & (1 << i)) == 0)
+                        continue;
+                    if ((m_memoryProperties.memoryTypes[i].propertyFlags & properties) != properties)
+                        continue;
+
+                    if (allocateFromType(i, size, linear, nullptr, true, allocation, category, userData))
+                    {
+                        uint32_t heap = m_memoryProperties.memoryTypes[i].heapIndex;
+                        m_heapUsage[heap].categories[static_cast<uint32_t>(category)] += allocation.size;
+                        return true;
+                    }
+                }
+
+                HT_ERROR_PRINTF("VKMemoryAllocator::Allocate(): Failed to allocate %d bytes\n", static_cast<uint32_t>(requirements.size));
+                return false;
+            }
+
+            /** Allocates memory for a buffer and binds it
+            * \param buffer The buffer to back with memory
+            * \param properties The memory properties the buffer needs
+            * \param allocation Filled with the range on success
+            * \param category What the buffer is for
+            * \param userData Handed back to the move callback when defragmenting
+            * \return True if memory was allocated and bound
+            */
+            bool VKMemoryAllocator::AllocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties,
+                VKAllocation& allocation, VKMemoryCategory category, void* userData)
+            {
+                VkResult err;
+
+                VkMemoryRequirements memReqs;
+                vkGetBufferMemoryRequirements(m_device, buffer, &memReqs);
+
+                if (!Allocate(memReqs, properties, true, allocation, category, userData))
+                    return false;
+
+                err = vkBindBufferMemory(m_device, buffer, allocation.memory, allocation.offset);
+                assert(!err);
+                if (err != VK_SUCCESS)
+                {
+                    HT_ERROR_PRINTF("VKMemoryAllocator::AllocateForBuffer(): Failed to bind memory\n");
+                    Free(allocation);
+                    return false;
+                }
+
+                return true;
+            }
+
+            /** Allocates memory for an image and binds it
+            * \param image The image to back with memory
+            * \param linearTiling True if the image was created with VK_IMAGE_TILING_LINEAR
+            * \param properties The memory properties the image needs
+            * \param allocation Filled with the range on success
+            * \param category What the image is for
+            * \param userData Handed back to the move callback when defragmenting
+            * \return True if memory was allocated and bound
+            */
+            bool VKMemoryAllocator::AllocateForImage(VkImage image, bool linearTiling, VkMemoryPropertyFlags properties,
+                VKAllocation& allocation, VKMemoryCategory category, void* userData)
+            {
+                VkResult err;
+
+                VkMemoryRequirements memReqs;
+                vkGetImageMemoryRequirements(m_device, image, &memReqs);
+
+                if (!Allocate(memReqs, properties, linearTiling, allocation, category, userData))
+                    return false;
+
+                err = vkBindImageMemory(m_device, image, allocation.memory, allocation.offset);
+                assert(!err);
+                if (err != VK_SUCCESS)
+                {
+                    HT_ERROR_PRINTF("VKMemoryAllocator::AllocateForImage(): Failed to bind memory\n");
+                    Free(allocation);
+                    return false;
+                }
+
+                return true;
+            }
+
+            /** Returns a range to its block
+            *
+            * Empty blocks are given back to the driver as long as another block
+            * of the same kind remains. The allocation is cleared.
+            *
+            * \param allocation The range to free
+            */
+            void VKMemoryAllocator::Free(VKAllocation& allocation)
+            {
+                if (allocation.memory == VK_NULL_HANDLE)
+                    return;
+
+                std::lock_guard<std::recursive_mutex> lock(m_mutex);
+
+                auto blockIt = m_blockLookup.find(allocation.memory);
+                if (blockIt == m_blockLookup.end())
+                {
+                    HT_ERROR_PRINTF("VKMemoryAllocator::Free(): Memory was not allocated by this allocator\n");
+                    return;
+                }
+
+                Block* block = blockIt->second;
+                uint32_t heap = m_memoryProperties.memoryTypes[block->memoryType].heapIndex;
+                if (block->dedicated)
+                {
+                    const Range& range = block->allocated[0];
+                    m_heapUsage[heap].categories[static_cast<uint32_t>(range.category)] -= block->used;
+                    destroyBlock(block);
+                    allocation = {};
+                    return;
+                }
+
+                auto it = block->allocated.find(allocation.offset);
+                if (it == block->allocated.end())
+                {
+                    HT_ERROR_PRINTF("VKMemoryAllocator::Free(): Range was already freed\n");
+                    return;
+                }
+
+                uint32_t order = it->second.order;
+                m_heapUsage[heap].categories[static_cast<uint32_t>(it->second.category)] -= static_cast<VkDeviceSize>(1) << order;
+                block->allocated.erase(it);
+                block->used -= static_cast<VkDeviceSize>(1) << order;
+
+                releaseRange(block, allocation.offset, order);
+
+                //Keep one empty block around so alternating alloc/free doesn't hit the driver
+                if (block->used == 0)
+                {
+                    for (size_t i = 0; i < m_blocks.size(); i++)
+                    {
+                        Block* other = m_blocks[i];
+                        if (other != block && !other->dedicated && other->memoryType == block->memoryType && other->linear == block->linear)
+                        {
+                            destroyBlock(block);
+                            break;
+                        }
+                    }
+                }
+
+                allocation = {};
+            }
+
+            /** Sets the callback Defragment uses to move allocations
+            * \param callback The callback; Defragment does nothing without one
+            */
+            void VKMemoryAllocator::SetMoveCallback(MoveCallback callback)
+            {
+                std::lock_guard<std::recursive_mutex> lock(m_mutex);
+                m_moveCallback = callback;
+            }
+
+            /** Compacts shared blocks
+            *
+            * For every memory type with more than one block, the least used block
+            * is emptied into the others through the move callback and released
+            * once nothing is left in it. No new blocks are created.
+            *
+            * \param maxMoves The most allocations to move in this call
+            * \return The number of allocations moved
+            */
+            uint32_t VKMemoryAllocator::Defragment(uint32_t maxMoves)
+            {
+                std::lock_guard<std::recursive_mutex> lock(m_mutex);
+
+                if (!m_moveCallback)
+                    return 0;
+
+                //Find the least used block of every memory type and kind that has company
+                std::vector<Block*> sources;
+                for (size_t i = 0; i < m_blocks.size(); i++)
+                {
+                    Block* block = m_blocks[i];
+                    if (block->dedicated)
+                        continue;
+
+                    Block* least = block;
+                    bool shared = false;
+                    for (size_t j = 0; j < m_blocks.size(); j++)
+                    {
+                        Block* other = m_blocks[j];
+                        if (other == block || other->dedicated || other->memoryType != block->memoryType || other->linear != block->linear)
+                            continue;
+
+                        shared = true;
+                        if (other->used < least->used || (other->used == least->used && other < least))
+                            least = other;
+                    }
+
+                    if (shared && least == block)
+                        sources.push_back(block);
+                }
+
+                uint32_t moves = 0;
+                for (size_t i = 0; i < sources.size() && moves < maxMoves; i++)
+                {
+                    Block* block = sources[i];
+
+                    //Copy the ranges out first; moving changes the map
+                    std::vector<std::pair<VkDeviceSize, Range>> ranges(block->allocated.begin(), block->allocated.end());
+
+                    for (size_t j = 0; j < ranges.size() && moves < maxMoves; j++)
+                    {
+                        VKAllocation from = {};
+                        from.memory = block->memory;
+                        from.offset = ranges[j].first;
+                        from.size = static_cast<VkDeviceSize>(1) << ranges[j].second.order;
+                        from.mapped = block->mapped ? static_cast<uint8_t*>(block->mapped) + from.offset : nullptr;
+                        from.memoryType = block->memoryType;
+                        from.userData = ranges[j].second.userData;
+                        from.category = ranges[j].second.category;
+
+                        //Moves stay in the same heap, so the category usage doesn't change
+                        VKAllocation to = {};
+                        if (!allocateFromType(block->memoryType, from.size, block->linear, block, false, to, from.category, from.userData))
+                            break;
+
+                        if (!m_moveCallback(from, to))
+                        {
+                            uint32_t heap = m_memoryProperties.memoryTypes[to.memoryType].heapIndex;
+                            m_heapUsage[heap].categories[static_cast<uint32_t>(to.category)] += to.size;
+                            Free(to);
+                            continue;
+                        }
+
+                        //Don't let Free release the block under us; it's done below once empty
+                        block->allocated.erase(from.offset);
+                        block->used -= from.size;
+                        releaseRange(block, from.offset, ranges[j].second.order);
+
+                        moves++;
+                    }
+
+                    if (block->used == 0)
+                        destroyBlock(block);
+                }
+
+                return moves;
+            }
+
+            /** Gets how the allocator's memory is being used
+            * \return A snapshot of the allocator's stats
+            */
+            VKMemoryStats VKMemoryAllocator::GetStats() const
+            {
+                std::lock_guard<std::recursive_mutex> lock(m_mutex);
+
+                VKMemoryStats stats = {};
+
+                for (size_t i = 0; i < m_blocks.size(); i++)
+                {
+                    const Block* block = m_blocks[i];
+
+                    stats.bytesReserved += block->size;
+                    stats.bytesUsed += block->used;
+
+                    if (block->dedicated)
+                    {
+                        stats.dedicatedCount++;
+                        stats.allocationCount++;
+                        continue;
+                    }
+
+                    stats.blockCount++;
+                    stats.allocationCount += static_cast<uint32_t>(block->allocated.size());
+                    stats.bytesFree += block->size - block->used;
+
+                    for (size_t j = block->freeLists.size(); j > 0; j--)
+                    {
+                        if (!block->freeLists[j - 1].empty())
+                        {
+                            VkDeviceSize largest = static_cast<VkDeviceSize>(1) << (j - 1 + MinOrder);
+                            stats.largestFreeRange = std::max(stats.largestFreeRange, largest);
+                            break;
+                        }
+                    }
+                }
+
+                if (stats.bytesFree > 0)
+                    stats.fragmentation = 1.0f - static_cast<float>(stats.largestFreeRange) / static_cast<float>(stats.bytesFree);
+
+                return stats;
+            }
+
+            /** Gets how much of a memory heap the allocator holds
+            * \param heap The heap index
+            * \return The memory reserved from the heap and handed out of it by category
+            */
+            VKHeapUsage VKMemoryAllocator::GetHeapUsage(uint32_t heap) const
+            {
+                std::lock_guard<std::recursive_mutex> lock(m_mutex);
+
+                if (heap >= VK_MAX_MEMORY_HEAPS)
+                    return VKHeapUsage();
+
+                return m_heapUsage[heap];
+            }
+
+            /** Gets the properties of a memory type
+            * \param memoryType The memory type index, as in VKAllocation::memoryType
+            * \return The type's property flags
+            */
+            VkMemoryPropertyFlags VKMemoryAllocator::GetMemoryTypeProperties(uint32_t memoryType) const
+            {
+                if (memoryType >= m_memoryProperties.memoryTypeCount)
+                    return 0;
+
+                return m_memoryProperties.memoryTypes[memoryType].propertyFlags;
+            }
+
+            bool VKMemoryAllocator::allocateFromType(uint32_t memoryType, VkDeviceSize size, bool linear, const Block* exclude,
+                bool allowNewBlock, VKAllocation& allocation, VKMemoryCategory category, void* userData)
+            {
+                VkDeviceSize blockSize = blockSizeFor(memoryType);
+                uint32_t order = std::max(orderOf(size), MinOrder);
+
+                //Anything over half a block would waste most of it
+                if ((static_cast<VkDeviceSize>(1) << order) > blockSize / 2)
+                {
+                    if (!allowNewBlock)
+                        return false;
+
+                    Block* block = createBlock(memoryType, size, linear, true);
+                    if (block == nullptr)
+                        return false;
+
+                    block->used = size;
+                    block->allocated[0] = { order, category, userData };
+
+                    allocation.memory = block->memory;
+                    allocation.offset = 0;
+                    allocation.size = size;
+                    allocation.mapped = block->mapped;
+                    allocation.memoryType = memoryType;
+                    allocation.userData = userData;
+                    allocation.category = category;
+
+                    return true;
+                }
+
+                for (size_t i = 0; i < m_blocks.size(); i++)
+                {
+                    Block* block = m_blocks[i];
+                    if (block == exclude || block->dedicated || block->memoryType != memoryType)
+                        continue;
+                    if (segregates() && block->linear != linear)
+                        continue;
+
+                    if (allocateFromBlock(block, order, allocation, category, userData))
+                        return true;
+                }
+
+                if (!allowNewBlock)
+                    return false;
+
+                Block* block = createBlock(memoryType, blockSize, linear, false);
+                if (block == nullptr)
+                    return false;
+
+                return allocateFromBlock(block, order, allocation, category, userData);
+            }
+
+            bool VKMemoryAllocator::allocateFromBlock(Block* block, uint32_t order, VKAllocation& allocation,
+                VKMemoryCategory category, void* userData)
+            {
+                size_t wanted = order - MinOrder;
+                if (wanted >= block->freeLists.size())
+                    return false;
+
+                //Find the smallest free range that fits
+                size_t found = wanted;
+                while (found < block->freeLists.size() && block->freeLists[found].empty())
+                    found++;
+                if (found == block->freeLists.size())
+                    return false;
+
+                VkDeviceSize offset = *block->freeLists[found].begin();
+                block->freeLists[found].erase(block->freeLists[found].begin());
+
+                //Split it down, putting the upper halves back
+                while (found > wanted)
+                {
+                    found--;
+                    block->freeLists[found].insert(offset + (static_cast<VkDeviceSize>(1) << (found + MinOrder)));
+                }
+
+                VkDeviceSize size = static_cast<VkDeviceSize>(1) << order;
+
+                block->allocated[offset] = { order, category, userData };
+                block->used += size;
+
+                allocation.memory = block->memory;
+                allocation.offset = offset;
+                allocation.size = size;
+                allocation.mapped = block->mapped ? static_cast<uint8_t*>(block->mapped) + offset : nullptr;
+                allocation.memoryType = block->memoryType;
+                allocation.userData = userData;
+                allocation.category = category;
+
+                return true;
+            }
+
+            VKMemoryAllocator::Block* VKMemoryAllocator::createBlock(uint32_t memoryType, VkDeviceSize size, bool linear, bool dedicated)
+            {
+                VkResult err;
+
+                VkMemoryAllocateInfo memAllocInfo = {};
+                memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+                memAllocInfo.pNext = nullptr;
+                memAllocInfo.allocationSize = size;
+                memAllocInfo.memoryTypeIndex = memoryType;
+
+                VkDeviceMemory memory;
+                err = m_functions.allocate(m_device, &memAllocInfo, nullptr, &memory);
+                if (err != VK_SUCCESS)
+                {
+                    //Not fatal; the caller may try another memory type
+                    HT_DEBUG_PRINTF("VKMemoryAllocator::createBlock(): Failed to allocate %d bytes from memory type %d\n", static_cast<uint32_t>(size), memoryType);
+                    return nullptr;
+                }
+
+                //Host visible memory stays mapped for its whole life
+                void* mapped = nullptr;
+                if (m_memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+                {
+                    err = m_functions.map(m_device, memory, 0, VK_WHOLE_SIZE, 0, &mapped);
+                    assert(!err);
+                    if (err != VK_SUCCESS)
+                    {
+                        HT_ERROR_PRINTF("VKMemoryAllocator::createBlock(): Failed to map memory\n");
+                        m_functions.free(m_device, memory, nullptr);
+                        return nullptr;
+                    }
+                }
+
+                Block* block = new Block;
+                block->memory = memory;
+                block->size = size;
+                block->used = 0;
+                block->mapped = mapped;
+                block->memoryType = memoryType;
+                block->linear = linear;
+                block->dedicated = dedicated;
+
+                if (!dedicated)
+                {
+                    block->freeLists.resize(orderOf(size) - MinOrder + 1);
+                    block->freeLists.back().insert(0);
+                }
+
+                m_blocks.push_back(block);
+                m_blockLookup[memory] = block;
+                m_heapUsage[m_memoryProperties.memoryTypes[memoryType].heapIndex].reserved += size;
+
+                return block;
+            }
+
+            void VKMemoryAllocator::destroyBlock(Block* block)
+            {
+                if (block->mapped != nullptr)
+                    m_functions.unmap(m_device, block->memory);
+
+                m_functions.free(m_device, block->memory, nullptr);
+                m_heapUsage[m_memoryProperties.memoryTypes[block->memoryType].heapIndex].reserved -= block->size;
+
+                m_blockLookup.erase(block->memory);
+                m_blocks.erase(std::find(m_blocks.begin(), m_blocks.end(), block));
+
+                delete block;
+            }
+
+            void VKMemoryAllocator::releaseRange(Block* block, VkDeviceSize offset, uint32_t order)
+            {
+                //Merge with free buddies as far up as they go
+                size_t level = order - MinOrder;
+                while (level + 1 < block->freeLists.size())
+                {
+                    VkDeviceSize buddy = offset ^ (static_cast<VkDeviceSize>(1) << (level + MinOrder));
+
+                    auto it = block->freeLists[level].find(buddy);
+                    if (it == block->freeLists[level].end())
+                        break;
+
+                    block->freeLists[level].erase(it);
+                    offset = std::min(offset, buddy);
+                    level++;
+                }
+
+                block->freeLists[level].insert(offset);
+            }
+
+            VkDeviceSize VKMemoryAllocator::blockSizeFor(uint32_t memoryType) const
+            {
+                //Small heaps get smaller blocks so one block can't take most of the heap
+                VkDeviceSize heapSize = m_memoryProperties.memoryHeaps[m_memoryProperties.memoryTypes[memoryType].heapIndex].size;
+
+                VkDeviceSize size = m_blockSize;
+                while (size > (static_cast<VkDeviceSize>(1) << (MinOrder + 4)) && size * 8 > heapSize)
+                    size >>= 1;
+
+                return size;
+            }
+
+            bool VKMemoryAllocator::segregates() const
+            {
+                //Every range is at least this aligned, so smaller granularities never conflict
+                return m_bufferImageGranularity > (static_cast<VkDeviceSize>(1) << MinOrder);
+            }
+
+            uint32_t VKMemoryAllocator::orderOf(VkDeviceSize size)
+            {
+                uint32_t order = 0;
+                while ((static_cast<VkDeviceSize>(1) << order) < size)
+                    order++;
+
+                return order;
+            }
+        }
+    }
+}
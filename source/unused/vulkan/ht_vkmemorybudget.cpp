@@ -0,0 +1,362 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+#include <ht_vkmemorybudget.h>
+#include <ht_vktools.h>
+#include <ht_gpuresourcepool.h>
+#include <ht_debug.h>
+#include <algorithm>    //std::sort, std::find
+#include <cstring>      //std::memset
+
+namespace Hatchit {
+
+    namespace Graphics {
+
+        namespace Vulkan {
+
+            const float                         VKMemoryBudget::DefaultBudgetFraction = 0.8f;
+
+            VkPhysicalDevice                    VKMemoryBudget::m_gpu = VK_NULL_HANDLE;
+            VkPhysicalDeviceMemoryProperties    VKMemoryBudget::m_memoryProperties = {};
+            bool                                VKMemoryBudget::m_budgetExtension = false;
+            uint32_t                            VKMemoryBudget::m_framesInFlight = 1;
+            float                               VKMemoryBudget::m_budgetFraction = VKMemoryBudget::DefaultBudgetFraction;
+            std::atomic<uint64_t>               VKMemoryBudget::m_frame(1);
+            std::atomic<uint64_t>               VKMemoryBudget::m_residencyVersion(1);
+            uint64_t                            VKMemoryBudget::m_cooldownUntil = 0;
+            std::mutex                          VKMemoryBudget::m_mutex;
+            std::vector<VKEvictable*>           VKMemoryBudget::m_resources;
+            VKHeapBudget                        VKMemoryBudget::m_heaps[VK_MAX_MEMORY_HEAPS];
+
+            VKEvictable::VKEvictable()
+                : m_lastUsed(VKMemoryBudget::GetFrame()) {}
+
+            /** Marks the resource as used by the frame being built
+            */
+            void VKEvictable::VKMarkUsed()
+            {
+                m_lastUsed.store(VKMemoryBudget::GetFrame(), std::memory_order_relaxed);
+            }
+
+            /** Gets the last frame the resource was used in
+            * \return The frame number from VKMemoryBudget::GetFrame
+            */
+            uint64_t VKEvictable::VKGetLastUsed() const
+            {
+                return m_lastUsed.load(std::memory_order_relaxed);
+            }
+
+            /** Starts tracking the memory heaps of a device
+            * \param gpu The physical device the heaps belong to
+            * \param memoryProperties The memory types and heaps of the device
+            * \param budgetExtension True if the device enabled VK_EXT_memory_budget
+            * \param framesInFlight How many frames may still be using a resource after its last use
+            * \return True
+            */
+            bool VKMemoryBudget::Initialize(VkPhysicalDevice gpu, const VkPhysicalDeviceMemoryProperties& memoryProperties,
+                bool budgetExtension, uint32_t framesInFlight)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                m_gpu = gpu;
+                m_memoryProperties = memoryProperties;
+                m_budgetExtension = budgetExtension;
+                m_framesInFlight = std::max(framesInFlight, 1u);
+                m_cooldownUntil = 0;
+
+                updateHeaps();
+
+                for (uint32_t i = 0; i < m_memoryProperties.memoryHeapCount; i++)
+                {
+                    HT_DEBUG_PRINTF("VKMemoryBudget::Initialize(): Heap %d: %llu MB, budget %llu MB%s\n", i,
+                        static_cast<unsigned long long>(m_heaps[i].size / (1024 * 1024)),
+                        static_cast<unsigned long long>(m_heaps[i].budget / (1024 * 1024)),
+                        m_heaps[i].deviceLocal ? ", device local" : "");
+                }
+
+                return true;
+            }
+
+            /** Stops tracking; registered resources are forgotten
+            */
+            void VKMemoryBudget::DeInitialize()
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                m_resources.clear();
+                m_gpu = VK_NULL_HANDLE;
+            }
+
+            /** Lets the budget evict a resource
+            * \param resource The resource; must be unregistered before it is destroyed
+            */
+            void VKMemoryBudget::Register(VKEvictable* resource)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_resources.push_back(resource);
+            }
+
+            /** Stops the budget from evicting a resource
+            *
+            * Blocks while a frame is beginning, so the resource is never
+            * destroyed in the middle of being evicted.
+            *
+            * \param resource The resource to forget
+            */
+            void VKMemoryBudget::Unregister(VKEvictable* resource)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                auto it = std::find(m_resources.begin(), m_resources.end(), resource);
+                if (it != m_resources.end())
+                {
+                    *it = m_resources.back();
+                    m_resources.pop_back();
+                }
+            }
+
+            /** Moves on to the next frame and brings memory use back under budget
+            *
+            * Must be called after the frame slot has been waited on and the
+            * deletion queue collected, so usage reflects what was freed.
+            */
+            void VKMemoryBudget::BeginFrame()
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                uint64_t frame = ++m_frame;
+
+                if (m_gpu == VK_NULL_HANDLE)
+                    return;
+
+                updateHeaps();
+
+                VkDeviceSize overage = 0;
+                VkDeviceSize headroom = 0;
+                for (uint32_t i = 0; i < m_memoryProperties.memoryHeapCount; i++)
+                {
+                    const VKHeapBudget& heap = m_heaps[i];
+                    if (!heap.deviceLocal)
+                        continue;
+
+                    if (heap.usage > heap.budget)
+                        overage += heap.usage - heap.budget;
+                    else
+                        headroom += heap.budget - heap.usage;
+                }
+
+                //Freed memory only shows up once the frames using it are done
+                if (frame < m_cooldownUntil)
+                    return;
+
+                if (overage > 0)
+                {
+                    VkDeviceSize freed = evict(overage);
+                    if (freed > 0)
+                    {
+                        HT_DEBUG_PRINTF("VKMemoryBudget::BeginFrame(): %llu KB over budget; evicted %llu KB\n",
+                            static_cast<unsigned long long>(overage / 1024), static_cast<unsigned long long>(freed / 1024));
+
+                        m_cooldownUntil = frame + m_framesInFlight + 1;
+                    }
+                }
+                else if (headroom > 0)
+                {
+                    restore(headroom);
+                }
+            }
+
+            /** Gets the number of the frame being built
+            * \return A number that goes up by one every BeginFrame
+            */
+            uint64_t VKMemoryBudget::GetFrame()
+            {
+                return m_frame.load(std::memory_order_relaxed);
+            }
+
+            /** Gets a number that changes whenever a resource is evicted or restored
+            *
+            * Evicting or restoring replaces a resource's buffers, images or
+            * descriptor sets, so anything recorded against them is stale.
+            *
+            * \return A number that goes up with every eviction and restore
+            */
+            uint64_t VKMemoryBudget::GetResidencyVersion()
+            {
+                return m_residencyVersion.load(std::memory_order_acquire);
+            }
+
+            /** Gets how many memory heaps the device has
+            * \return The heap count
+            */
+            uint32_t VKMemoryBudget::GetHeapCount()
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                return m_memoryProperties.memoryHeapCount;
+            }
+
+            /** Gets the budget and usage of a heap as of the last BeginFrame
+            * \param heap The heap index
+            * \return The heap's budget
+            */
+            VKHeapBudget VKMemoryBudget::GetHeapBudget(uint32_t heap)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                if (heap >= m_memoryProperties.memoryHeapCount)
+                    return VKHeapBudget();
+
+                return m_heaps[heap];
+            }
+
+            /** Sets how much of each heap may be used when the driver doesn't report a budget
+            * \param fraction Between 0 and 1
+            */
+            void VKMemoryBudget::SetBudgetFraction(float fraction)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_budgetFraction = std::min(std::max(fraction, 0.0f), 1.0f);
+            }
+
+            void VKMemoryBudget::updateHeaps()
+            {
+                std::memset(m_heaps, 0, sizeof(m_heaps));
+
+                VkDeviceSize driverBudget[VK_MAX_MEMORY_HEAPS] = {};
+                VkDeviceSize driverUsage[VK_MAX_MEMORY_HEAPS] = {};
+                bool fromDriver = false;
+
+#ifdef VK_EXT_memory_budget
+                if (m_budgetExtension && fpGetPhysicalDeviceMemoryProperties2KHR != nullptr)
+                {
+                    VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProps = {};
+                    budgetProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+                    VkPhysicalDeviceMemoryProperties2KHR memProps = {};
+                    memProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR;
+                    memProps.pNext = &budgetProps;
+
+                    fpGetPhysicalDeviceMemoryProperties2KHR(m_gpu, &memProps);
+
+                    for (uint32_t i = 0; i < m_memoryProperties.memoryHeapCount; i++)
+                    {
+                        driverBudget[i] = budgetProps.heapBudget[i];
+                        driverUsage[i] = budgetProps.heapUsage[i];
+                    }
+                    fromDriver = true;
+                }
+#endif
+
+                for (uint32_t i = 0; i < m_memoryProperties.memoryHeapCount; i++)
+                {
+                    VKHeapBudget& heap = m_heaps[i];
+                    VKHeapUsage usage = VKTools::GetAllocator().GetHeapUsage(i);
+
+                    heap.size = m_memoryProperties.memoryHeaps[i].size;
+                    heap.deviceLocal = (m_memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+                    heap.reserved = usage.reserved;
+
+                    VkDeviceSize handedOut = 0;
+                    for (uint32_t c = 0; c < static_cast<uint32_t>(VKMemoryCategory::Count); c++)
+                    {
+                        heap.categories[c] = usage.categories[c];
+                        handedOut += usage.categories[c];
+                    }
+
+                    if (fromDriver)
+                    {
+                        heap.budget = driverBudget[i];
+                        heap.usage = driverUsage[i];
+                    }
+                    else
+                    {
+                        //Blocks stay reserved after eviction empties them, so only count what's handed out
+                        heap.budget = static_cast<VkDeviceSize>(static_cast<double>(heap.size) * m_budgetFraction);
+                        heap.usage = handedOut;
+                    }
+                }
+            }
+
+            VkDeviceSize VKMemoryBudget::evict(VkDeviceSize overage)
+            {
+                uint64_t frame = m_frame.load(std::memory_order_relaxed);
+
+                //Only what no frame in flight can still be drawing with
+                std::vector<VKEvictable*> candidates;
+                for (size_t i = 0; i < m_resources.size(); i++)
+                {
+                    VKEvictable* resource = m_resources[i];
+                    if (frame - resource->VKGetLastUsed() > m_framesInFlight)
+                        candidates.push_back(resource);
+                }
+
+                std::sort(candidates.begin(), candidates.end(), [](const VKEvictable* a, const VKEvictable* b)
+                {
+                    return a->VKGetLastUsed() < b->VKGetLastUsed();
+                });
+
+                VkDeviceSize freed = 0;
+                for (size_t i = 0; i < candidates.size() && freed < overage; i++)
+                {
+                    VKEvictable* resource = candidates[i];
+
+                    VkDeviceSize bytes = resource->VKEvict();
+                    if (bytes == 0)
+                        continue;
+
+                    freed += bytes;
+                    m_residencyVersion++;
+                    GPUResourcePool::NotifyResidency(resource->VKGetResourceType(), resource->VKGetResourceBase(), false);
+                }
+
+                return freed;
+            }
+
+            void VKMemoryBudget::restore(VkDeviceSize headroom)
+            {
+                uint64_t frame = m_frame.load(std::memory_order_relaxed);
+
+                //Most recently used first; those are the ones on screen
+                std::vector<VKEvictable*> candidates;
+                for (size_t i = 0; i < m_resources.size(); i++)
+                {
+                    VKEvictable* resource = m_resources[i];
+                    if (resource->VKIsEvicted() && frame - resource->VKGetLastUsed() <= 1)
+                        candidates.push_back(resource);
+                }
+
+                std::sort(candidates.begin(), candidates.end(), [](const VKEvictable* a, const VKEvictable* b)
+                {
+                    return a->VKGetLastUsed() > b->VKGetLastUsed();
+                });
+
+                for (size_t i = 0; i < candidates.size(); i++)
+                {
+                    VKEvictable* resource = candidates[i];
+
+                    VkDeviceSize bytes = resource->VKGetRestoreSize();
+                    if (bytes > headroom)
+                        continue;
+
+                    if (!resource->VKRestore())
+                        continue;
+
+                    headroom -= bytes;
+                    m_residencyVersion++;
+                    GPUResourcePool::NotifyResidency(resource->VKGetResourceType(), resource->VKGetResourceBase(), true);
+                }
+            }
+        }
+    }
+}
@@ -15,7 +15,9 @@
 #include <ht_mesh.h>
 #include <ht_vkmesh.h>
 #include <ht_vkdevice.h>
-#include <ht_vktools.h>
+#include <ht_vkgeometrypool.h>
+#include <ht_vkdeletionqueue.h>
+#include <ht_gpuresourcepool.h>
 #include <ht_debug.h>
 
 namespace Hatchit {
@@ -23,15 +25,21 @@ namespace Hatchit {
         namespace Vulkan {
         
             VKMesh::VKMesh()
-            {}
+            {
+                m_geometry = {};
+                m_resident = false;
+            }
 
             VKMesh::~VKMesh() 
             {
-                vkDestroyBuffer(m_device, m_vertexBlock.buffer, nullptr);
-                vkFreeMemory(m_device, m_vertexBlock.memory, nullptr);
+                //Has to go first so the budget can't evict us while we're torn down
+                VKMemoryBudget::Unregister(this);
 
-                vkDestroyBuffer(m_device, m_indexBlock.buffer, nullptr);
-                vkFreeMemory(m_device, m_indexBlock.memory, nullptr);
+                VKGeometryRange geometry = m_geometry;
+                VKDeletionQueue::RetireCallback([geometry]() mutable
+                {
+                    VKGeometryPool::Free(geometry);
+                });
             }
 
             bool VKMesh::Initialize(Resource::Mesh* mesh, const VkDevice& device)
@@ -39,12 +47,12 @@ namespace Hatchit {
                 m_device = device;
 
                 //Generate Vertex Buffer
-                std::vector<Vertex> vertexBuffer; 
-
                 std::vector<aiVector3D> verticies = mesh->getVertices();
                 std::vector<aiVector3D> normals = mesh->getNormals();
                 std::vector<aiVector3D> uvs = mesh->getUVs();
 
+                m_vertices.clear();
+                m_vertices.reserve(verticies.size());
                 for (uint32_t i = 0; i < verticies.size(); i++)
                 {
                     Vertex vertex;
@@ -55,39 +63,127 @@ namespace Hatchit {
                     if(uvs.size() > 0)
                         vertex.uv = aiVector2D(uvs[i][0], uvs[i][1]);
 
-                    vertexBuffer.push_back(vertex);
+                    m_vertices.push_back(vertex);
                 }
 
-                size_t vertexBufferSize = vertexBuffer.size() * sizeof(Vertex);
-
                 //Generate Index buffer 
-                std::vector<uint32_t> indexBuffer;
-
                 std::vector<aiFace> indicies = mesh->getIndices();
 
+                m_indices.clear();
                 for (uint32_t i = 0; i < indicies.size(); i++)
                 {
                     aiFace face = indicies[i];
                     for (uint32_t f = 0; f < face.mNumIndices; f++)
-                        indexBuffer.push_back(face.mIndices[f]);
+                        m_indices.push_back(face.mIndices[f]);
                 }
 
-                m_indexCount = static_cast<uint32_t>(indexBuffer.size());
-                size_t indexBufferSize = m_indexCount * sizeof(uint32_t);
+                m_indexCount = static_cast<uint32_t>(m_indices.size());
 
-                if (!VKTools::CreateUniformBuffer(vertexBufferSize, vertexBuffer.data(), &m_vertexBlock))
+                if (!upload())
                     return false;
 
-                if (!VKTools::CreateUniformBuffer(indexBufferSize, indexBuffer.data(), &m_indexBlock))
-                    return false;
+                m_resident = true;
+                VKMemoryBudget::Register(this);
 
                 return true;
             }
 
             uint32_t VKMesh::VGetIndexCount() { return m_indexCount; }
 
-            UniformBlock_vk VKMesh::GetVertexBlock() { return m_vertexBlock; }
-            UniformBlock_vk VKMesh::GetIndexBlock() { return m_indexBlock; }
+            UniformBlock_vk VKMesh::GetVertexBlock() { return m_geometry.vertexBlock; }
+            UniformBlock_vk VKMesh::GetIndexBlock() { return m_geometry.indexBlock; }
+
+            /** Makes sure the mesh's buffers are on the GPU and marks it used
+            *
+            * Safe to call from several recording threads at once. Evictions
+            * only happen while a frame begins, so a resident mesh stays
+            * resident until the frame is recorded.
+            *
+            * \return True if the buffers can be drawn from
+            */
+            bool VKMesh::VKMakeResident()
+            {
+                VKMarkUsed();
+
+                if (m_resident.load(std::memory_order_acquire))
+                    return true;
+
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_resident.load(std::memory_order_relaxed))
+                    return true;
+
+                if (!upload())
+                {
+                    HT_DEBUG_PRINTF("VKMesh::VKMakeResident(): Failed to upload evicted mesh\n");
+                    return false;
+                }
+
+                m_resident.store(true, std::memory_order_release);
+                GPUResourcePool::NotifyResidency(GPUResourceRequest::Type::Mesh, VKGetResourceBase(), true);
+
+                return true;
+            }
+
+            /** Drops the mesh's buffers, keeping the CPU copy
+            *
+            * Meshes in the shared geometry buffers are left alone; freeing
+            * their ranges gives no memory back.
+            *
+            * \return The device memory freed
+            */
+            VkDeviceSize VKMesh::VKEvict()
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                if (!m_resident.load(std::memory_order_relaxed))
+                    return 0;
+
+                if (m_geometry.shared)
+                    return 0;
+
+                VkDeviceSize freed = m_geometry.vertexBlock.allocation.size + m_geometry.indexBlock.allocation.size;
+
+                VKGeometryRange geometry = m_geometry;
+                VKDeletionQueue::RetireCallback([geometry]() mutable
+                {
+                    VKGeometryPool::Free(geometry);
+                });
+
+                m_geometry = {};
+                m_resident.store(false, std::memory_order_release);
+
+                return freed;
+            }
+
+            bool VKMesh::VKRestore() { return VKMakeResident(); }
+
+            VkDeviceSize VKMesh::VKGetRestoreSize() const
+            {
+                if (m_resident.load(std::memory_order_relaxed))
+                    return 0;
+
+                return m_vertices.size() * sizeof(Vertex) + m_indices.size() * sizeof(uint32_t);
+            }
+
+            bool VKMesh::VKIsEvicted() const { return !m_resident.load(std::memory_order_relaxed); }
+
+            VKMemoryCategory VKMesh::VKGetCategory() const { return VKMemoryCategory::Mesh; }
+
+            GPUResourceRequest::Type VKMesh::VKGetResourceType() const { return GPUResourceRequest::Type::Mesh; }
+
+            void* VKMesh::VKGetResourceBase() { return static_cast<MeshBase*>(this); }
+
+            bool VKMesh::upload()
+            {
+                //Device-local; the contents arrive through the staging ring before the first draw
+                if (!VKGeometryPool::Allocate(m_vertices.data(), static_cast<uint32_t>(m_vertices.size()), sizeof(Vertex),
+                    m_indices.data(), static_cast<uint32_t>(m_indices.size()), m_geometry))
+                    return false;
+
+                m_range = m_geometry.range;
+
+                return true;
+            }
 
         }
     }
@@ -16,6 +16,7 @@
 #include <ht_rootlayout.h>
 #include <ht_renderpass.h>
 #include <ht_vktools.h>
+#include <ht_vkdeletionqueue.h>
 
 #include <cassert>
 
@@ -36,19 +37,11 @@ namespace Hatchit {
 
             VKPipeline::~VKPipeline() 
             {
-                //Destroy buffer
-                vkUnmapMemory(m_device, m_uniformVSBuffer.memory);
-                VKTools::DeleteUniformBuffer(m_uniformVSBuffer);
-
-                //Destroy descriptor sets
-                vkFreeDescriptorSets(m_device, m_descriptorPool, 1, &m_descriptorSet);
-
-                //Destroy Pipeline
-                vkDestroyPipelineCache(m_device, m_pipelineCache, nullptr);
-                vkDestroyPipeline(m_device, m_pipeline, nullptr);
+                //Retire Pipeline
+                VKDeletionQueue::RetirePipeline(m_pipeline, m_pipelineCache);
             }
 
-            bool VKPipeline::Initialize(const Resource::PipelineHandle& handle, const VkDevice& device, const VkDescriptorPool& descriptorPool)
+            bool VKPipeline::Initialize(const Resource::PipelineHandle& handle, const VkDevice& device)
             {
                 if (!handle.IsValid())
                 {
@@ -57,7 +50,6 @@ namespace Hatchit {
                 }
 
                 m_device = device;
-                m_descriptorPool = descriptorPool;
 
                 setVertexLayout(handle->GetVertexLayout());
                 setInstanceLayout(handle->GetInstanceLayout());
@@ -95,9 +87,6 @@ namespace Hatchit {
                 if (!preparePipeline())
                     return false;
 
-                if (!prepareDescriptorSet())
-                    return false;
-
                 return true;
             }
 
@@ -145,59 +134,34 @@ namespace Hatchit {
 
             bool VKPipeline::VUpdate()
             {
-                //TODO: Organize push constant data other than just matricies
-                size_t size = m_shaderVariables->GetSize();
-                if (size == 0)
-                    return true;
-
-                //clear out old data
-                m_pushData.clear();
-                m_descriptorData.clear();
-
-                //if we have 128 bytes or less, add it to the push constants
-                if(size <= 128)
-                {
-                    m_pushData.resize(size);
-                    memcpy(m_pushData.data(), m_shaderVariables->GetByteData(), size);
-                }
-                //if we have extra, memory it overflows to a seperate buffer
-                else
-                {
-                    m_pushData.resize(128);
-                    memcpy(m_pushData.data(), m_shaderVariables->GetByteData(), 128);
-
-                    m_descriptorData.resize(size - 128);
-                    memcpy(m_descriptorData.data(), m_shaderVariables->GetByteData() + 128, size - 128);
-                }
-
-                //Push data onto descriptor set memory
-                memcpy(m_uniformBindPoint, m_descriptorData.data(), m_descriptorData.size());
-
+                //Render passes copy the variables into their own push constants and
+                //uniforms as they record, so there is nothing shared to update here
                 return true;
             }
 
             VkPipeline VKPipeline::GetVKPipeline() { return m_pipeline; }
 
+            const ShaderVariableChunk* VKPipeline::GetShaderVariables() const { return m_shaderVariables; }
+
             /**
-            \fn void VKPipeline::BindPipeline(const VkCommandBuffer& commandBuffer, const VkPipelineLayout& pipelineLayout)
+            \fn void VKPipeline::BindPipeline(VKCommandState& state, const BYTE* pushData, uint32_t pushSize)
             \brief Binds this pipeline to a command buffer
-            \param commandBuffer A reference to the command buffer you want to bind to
-            \param pipelineLayout The pipeline layout to reference when binding data
-
-            This function binds the pipeline as a graphics pipeline and sends all of the pipeline's data to the given command buffer. 
-            This includes up to 128 bytes of push constant data and all other data sent via a descriptor set.
+            \param state The state of the command buffer you want to bind to
+            \param pushData Up to 128 bytes of push constant data the caller built for this recording
+            \param pushSize The size of pushData
+
+            This function binds the pipeline as a graphics pipeline and sends the given push constant data to the given command buffer.
+            The render pass binds its own copy of the data past that. Nothing in the pipeline changes, so any number of
+            command buffers may bind it at once.
+            Anything the command buffer already has bound is skipped.
             **/
-            void VKPipeline::BindPipeline(const VkCommandBuffer& commandBuffer)
+            void VKPipeline::BindPipeline(VKCommandState& state, const BYTE* pushData, uint32_t pushSize) const
             {
                 //Bind to the graphics pipeline point
-                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
+                state.BindPipeline(m_pipeline);
 
                 //Send a push for each type of data to send; vectors, matricies, ints etc.
-                uint32_t pushDataSize = static_cast<uint32_t>(m_pushData.size());
-                vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, pushDataSize, m_pushData.data());
-
-                //Bind the appropriate descriptor set for all the descriptor data
-                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 1, 1, &m_descriptorSet, 0, nullptr);
+                state.PushConstants(m_pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, pushSize, pushData);
             }
 
             /*
@@ -530,59 +494,6 @@ namespace Hatchit {
                 return true;
             }
 
-            bool VKPipeline::prepareDescriptorSet() 
-            {
-                VkResult err;
-
-                size_t bufferSize = 128;
-                VKTools::CreateUniformBuffer(bufferSize, nullptr, &m_uniformVSBuffer);
-
-                m_uniformVSBuffer.descriptor.offset = 0;
-                m_uniformVSBuffer.descriptor.range = bufferSize;
-
-                VkDescriptorSetLayout layout = m_rootLayout->VKGetDescriptorSetLayouts()[1]; //Hack as fuck
-
-                VkDescriptorSetAllocateInfo allocInfo = {};
-                allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-                allocInfo.pNext = nullptr;
-                allocInfo.descriptorPool = m_descriptorPool;
-                allocInfo.descriptorSetCount = 1;
-                allocInfo.pSetLayouts = &layout;
-
-                err = vkAllocateDescriptorSets(m_device, &allocInfo, &m_descriptorSet);
-                assert(!err);
-                if (err != VK_SUCCESS)
-                {
-                    HT_ERROR_PRINTF("VKPipeline::prepareDescriptorSet: Failed to allocate descriptor set\n");
-                    return false;
-                }
-
-                std::vector<VkWriteDescriptorSet> descSetWrites = {};
-
-                VkWriteDescriptorSet uniformVSWrite = {};
-                uniformVSWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                uniformVSWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-                uniformVSWrite.dstSet = m_descriptorSet;
-                uniformVSWrite.dstBinding = 0;
-                uniformVSWrite.pBufferInfo = &m_uniformVSBuffer.descriptor;
-                uniformVSWrite.descriptorCount = 1;
-
-                descSetWrites.push_back(uniformVSWrite);
-
-                vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(descSetWrites.size()), descSetWrites.data(), 0, nullptr);
-
-                //Map memory to bind point once; will unmap on shutdown
-                err = vkMapMemory(m_device, m_uniformVSBuffer.memory, 0, bufferSize, 0, (void**)&m_uniformBindPoint);
-                assert(!err);
-                if (err != VK_SUCCESS)
-                {
-                    HT_ERROR_PRINTF("VKPipeline::prepareDescriptorSet: Failed to map descriptor set memory to bind point\n");
-                    return false;
-                }
-
-                return true;
-            }
-
             VkFormat VKPipeline::formatFromType(const Resource::ShaderVariable::Type& type) const
             {
                 using namespace Resource;
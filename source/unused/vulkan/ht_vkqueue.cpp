@@ -13,8 +13,7 @@
 **/
 
 #include <ht_vkqueue.h>
-#include <cassert>
-#include <vector>
+#include <ht_debug.h>     //HT_DEBUG_PRINTF
 
 namespace Hatchit
 {
@@ -26,6 +25,7 @@ namespace Hatchit
             {
                 m_queueType = queueType;
                 m_queue = VK_NULL_HANDLE;
+                m_queueFamily = 0;
             }
 
             VKQueue::~VKQueue() 
@@ -36,49 +36,44 @@ namespace Hatchit
             bool VKQueue::Initialize(const VKDevice* dev)
             {
                 VkDevice device = dev->GetVKDevices()[0];
-                VkPhysicalDevice gpu = dev->GetVKPhysicalDevices()[0];
 
-                // Find a queue that supports graphics operations
-                int32_t graphicsQueueIndex = -1;
-                uint32_t queueCount;
-                vkGetPhysicalDeviceQueueFamilyProperties(gpu, &queueCount, NULL);
-                assert(queueCount >= 1);
-
-                std::vector<VkQueueFamilyProperties> queueProps;
-                queueProps.resize(queueCount);
-                vkGetPhysicalDeviceQueueFamilyProperties(gpu, &queueCount, queueProps.data());
+                //The device picked every family when it created its queues. Compute and copy queues only
+                //exist on families of their own; sharing the graphics queue would need outside locking.
+                int32_t family = -1;
+                switch (m_queueType)
+                {
+                case QueueType::GRAPHICS:
+                    family = static_cast<int32_t>(dev->GetGraphicsQueueFamily());
+                    break;
+                case QueueType::COMPUTE:
+                    family = dev->GetComputeQueueFamily();
+                    break;
+                case QueueType::COPY:
+                    family = dev->GetTransferQueueFamily();
+                    break;
+                }
 
-                for (uint32_t i = 0; i < queueCount; i++)
+                if (family < 0)
                 {
-                    if (queueProps[i].queueFlags & VK_QUEUE_GRAPHICS_BIT &&
-                        m_queueType == QueueType::GRAPHICS)
-                    {
-                        graphicsQueueIndex = i;
-                        break;
-                    }
-                    else if (queueProps[i].queueFlags & VK_QUEUE_COMPUTE_BIT &&
-                        m_queueType == QueueType::COMPUTE)
-                    {
-                        graphicsQueueIndex = i;
-                        break;
-                    }
-                    else if (queueProps[i].queueFlags & VK_QUEUE_TRANSFER_BIT &&
-                        m_queueType == QueueType::COPY)
-                    {
-                        graphicsQueueIndex = i;
-                        break;
-                    }
+                    HT_DEBUG_PRINTF("VKQueue::Initialize(): The device has no queue family of its own for this queue type; use the graphics queue.\n");
+                    return false;
                 }
-                assert(graphicsQueueIndex >= 0);
-                assert(graphicsQueueIndex < static_cast<int32_t>(queueCount));
 
-                // Get the graphics queue
-                vkGetDeviceQueue(device, graphicsQueueIndex, 0, &m_queue);
+                //The device created one queue in each of these families
+                vkGetDeviceQueue(device, static_cast<uint32_t>(family), 0, &m_queue);
+                m_queueFamily = static_cast<uint32_t>(family);
+
+                if (!m_timeline.Initialize(device, m_queue, dev->SupportsTimelineSemaphores()))
+                    return false;
 
                 return true;
             }
 
             const VkQueue& VKQueue::GetVKQueue() const { return m_queue; }
+
+            uint32_t VKQueue::GetVKQueueFamily() const { return m_queueFamily; }
+
+            VKTimeline& VKQueue::GetTimeline() { return m_timeline; }
         }
     }
 }
\ No newline at end of file
@@ -19,7 +19,14 @@
 #include <ht_vkmaterial.h>
 #include <ht_vkmesh.h>
 #include <ht_vktools.h>
+#include <ht_vkdeletionqueue.h>
+#include <ht_vkdescriptorallocator.h>
+#include <ht_vkmemorybudget.h>
+#include <ht_vkindirectculler.h>
 #include <ht_rootlayout.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 
 namespace Hatchit {
 
@@ -32,56 +39,66 @@ namespace Hatchit {
                 m_width = 0;
                 m_height = 0;
 
+                m_depthImage = {};
+                m_framebuffer = VK_NULL_HANDLE;
+                m_attachmentsReady = false;
+                m_aliased = false;
+                m_attachmentVersion = 0;
+                m_buildCount = 0;
+                m_reportedCPUCulling = false;
+                m_resident = ResidentCullSet();
+
                 m_view = Math::Matrix4();
                 m_proj = Math::Matrix4();
-
-                m_commandBuffer = VK_NULL_HANDLE;
             }
 
             VKRenderPass::~VKRenderPass() 
             {
-                //Free input descriptor sets
-                vkFreeDescriptorSets(m_device, m_descriptorPool, static_cast<uint32_t>(m_inputTargetDescriptorSets.size()), m_inputTargetDescriptorSets.data());
+                //Frames in flight may still use any of these; retire them instead of destroying
+                for (size_t i = 0; i < m_inputTargetAllocations.size(); i++)
+                    VKDescriptorAllocator::Retire(m_inputTargetAllocations[i]);
 
-                //Destroy framebuffer images
-                for (size_t i = 0; i < m_colorImages.size(); i++)
+                //Attachment images; their memory belongs to the swapchain's aliaser
+                retireAttachments();
+
+                //A retained recording may still be in flight
+                for (size_t i = 0; i < m_retainedSlots.size(); i++)
                 {
-                    Image_vk image = m_colorImages[i];
+                    VKCommandPool* commandPool = m_retainedSlots[i].commandPool;
+                    if (commandPool != nullptr)
+                        VKDeletionQueue::RetireCallback([commandPool]() { delete commandPool; });
 
-                    vkDestroyImageView(m_device, image.view, nullptr);
-                    vkDestroyImage(m_device, image.image, nullptr);
-                    vkFreeMemory(m_device, image.memory, nullptr);
+                    if (m_retainedSlots[i].instanceBlock.buffer != VK_NULL_HANDLE)
+                        VKDeletionQueue::RetireBuffer(m_retainedSlots[i].instanceBlock);
                 }
 
-                //Destroy depth image
-                vkDestroyImageView(m_device, m_depthImage.view, nullptr);
-                vkDestroyImage(m_device, m_depthImage.image, nullptr);
-                vkFreeMemory(m_device, m_depthImage.memory, nullptr);
-                
-                //Free instance texel buffers
-                for (auto it = m_instanceBlocks.begin(); it != m_instanceBlocks.end(); it++)
+                for (size_t i = 0; i < m_indirectSlots.size(); i++)
                 {
-                    UniformBlock_vk instanceBlock = it->second;
-                    if (instanceBlock.buffer != VK_NULL_HANDLE)
-                        VKTools::DeleteUniformBuffer(instanceBlock);
+                    if (m_indirectSlots[i].outputBlock.buffer != VK_NULL_HANDLE)
+                        VKDeletionQueue::RetireBuffer(m_indirectSlots[i].outputBlock);
                 }
-                m_instanceBlocks.clear();
 
-                //Destroy framebuffer
-                vkDestroyFramebuffer(m_device, m_framebuffer, nullptr);
+                if (m_resident.objectBlock.buffer != VK_NULL_HANDLE)
+                    VKDeletionQueue::RetireBuffer(m_resident.objectBlock);
+                if (m_resident.instanceBlock.buffer != VK_NULL_HANDLE)
+                    VKDeletionQueue::RetireBuffer(m_resident.instanceBlock);
+
+                for (auto it = m_pipelineUniforms.begin(); it != m_pipelineUniforms.end(); it++)
+                    retirePipelineUniforms(it->second);
 
-                //Destroy the render pass
-                vkDestroyRenderPass(m_device, m_renderPass, nullptr);
+                VKDeletionQueue::RetireRenderPass(m_renderPass);
             }
 
-            bool VKRenderPass::Initialize(const Resource::RenderPassHandle& handle, const VkDevice& device,
-                const VkDescriptorPool& descriptorPool, const VKSwapChain* swapchain)
+            bool VKRenderPass::Initialize(const Resource::RenderPassHandle& handle, const VkDevice& device, const VKSwapChain* swapchain)
             {
                 m_device = device;
-                m_descriptorPool = descriptorPool;
 
                 m_swapchain = swapchain;
 
+                m_commandBuffers.resize(m_swapchain->GetFrameCount(), VK_NULL_HANDLE);
+                m_retainedSlots.resize(m_swapchain->GetFrameCount());
+                m_indirectSlots.resize(m_swapchain->GetFrameCount());
+
                 ////Load resources
 
                 if (!handle.IsValid())
@@ -106,6 +123,8 @@ namespace Hatchit {
                     uint32_t targetSetIndex = inputTargets[i].set;
                     uint32_t targetBindingIndex = inputTargets[i].binding;
 
+                    m_inputPaths.push_back(targetPath);
+
                     RenderTargetHandle renderTargetHandle = RenderTarget::GetHandle(targetPath, targetPath);
                     m_renderTargets.push_back(renderTargetHandle); //Save so it doesn't deref
                     VKRenderTarget* inputTarget = static_cast<VKRenderTarget*>(renderTargetHandle->GetBase());
@@ -115,17 +134,22 @@ namespace Hatchit {
 
                 for (size_t i = 0; i < outputPaths.size(); i++)
                 {
+                    m_outputPaths.push_back(outputPaths[i]);
+
                     RenderTargetHandle outputTargetHandle = RenderTarget::GetHandle(outputPaths[i], outputPaths[i]);
                     m_renderTargets.push_back(outputTargetHandle);
                     m_outputRenderTargets.push_back(outputTargetHandle);
                 }
 
-                if (!setupAttachmentImages())
-                    return false;
+                //If width and height were not set, lets use the size of the screen that the renderer reports
+                if (m_width == 0)
+                    m_width = m_swapchain->GetWidth();
+                if (m_height == 0)
+                    m_height = m_swapchain->GetHeight();
+
+                //Attachments and the framebuffer wait until the swapchain knows where this pass runs in the frame
                 if (!setupRenderPass())
                     return false;
-                if (!setupFramebuffer())
-                    return false;
                 if (!setupDescriptorSets(mappedInputTargets))
                     return false;
 
@@ -138,227 +162,231 @@ namespace Hatchit {
                 
             }
 
-            bool VKRenderPass::VBuildCommandList(const ICommandPool* commandPool) 
+            bool VKRenderPass::VBuildCommandList(const CommandRecordContext& context) 
             {
-                if (!allocateCommandBuffer(static_cast<const VKCommandPool*>(commandPool)))
-                    return false;
+                VKCommandPool* vkCommandPool = static_cast<VKCommandPool*>((*context.pools)[context.index]);
 
-                //Setup the order of the commands we will issue in the command list
-                BuildRenderRequestHeirarchy();
-
-                //Free instance texel buffers
-                for (auto it = m_instanceBlocks.begin(); it != m_instanceBlocks.end(); it++)
+                if (!m_attachmentsReady)
                 {
-                    UniformBlock_vk instanceBlock = it->second;
-                    if (instanceBlock.buffer != VK_NULL_HANDLE)
-                        VKTools::DeleteUniformBuffer(instanceBlock);
+                    HT_DEBUG_PRINTF("VKRenderPass::VBuildCommandList(): Attachments were never prepared by the swapchain.\n");
+                    return false;
                 }
-                m_instanceBlocks.clear();
 
-                //Create block of data for instance variables for each mesh
-                for (auto it = m_instanceData.begin(); it != m_instanceData.end(); it++)
+                //The swapchain has already waited for this slot so its resources are free to reuse
+                const uint32_t frame = m_swapchain->GetCurrentFrame();
+
+                //Setup the order of the commands we will issue in the command list. A pass culled
+                //on the GPU keeps everything here; if it falls back to recording on the CPU after
+                //all, this frame just draws unculled.
+                const bool gpuCulled = m_gpuDriven && VKIndirectCuller::IsAvailable();
+                if (m_gpuDriven && !gpuCulled && !m_reportedCPUCulling)
                 {
-                    std::vector<ShaderVariableChunk*> chunks = it->second;
+                    HT_ERROR_PRINTF("VKRenderPass::VBuildCommandList(): Pass asked for GPU culling but the culling pipeline is unavailable; "
+                        "culling on the CPU. IndirectCull.spv must be loadable and the device must support drawIndirectFirstInstance.\n");
+                    m_reportedCPUCulling = true;
+                }
+                BuildRenderRequestHeirarchy(context.scheduler, !gpuCulled);
 
-                    BYTE* allChunkData = nullptr;
-                    size_t chunkSize = chunks[0]->GetSize();
-                    size_t totalDataSize = chunkSize * chunks.size();
+                m_recordStats = {};
+                m_buildCount++;
 
-                    allChunkData = new BYTE[totalDataSize];
+                //Transposed into copies; the pass's own matrices stay as they were set
+                Math::Matrix4 invView = Math::MMMatrixTranspose(Math::MMMatrixInverse(m_view));
+                Math::Matrix4 view = Math::MMMatrixTranspose(m_view);
+                Math::Matrix4 proj = Math::MMMatrixTranspose(m_proj);
 
-                    for (size_t i = 0; i < chunks.size(); i++)
-                    {
-                        ShaderVariableChunk* chunk = chunks[i];
-                        memcpy(allChunkData + i * chunkSize, chunk->GetByteData(), chunkSize);
-                    }
+                //Write camera data for every pipeline up front. Chunks only read
+                //what's bound here so they may be recorded in any order.
+                FrameVector<PipelineBinding> bindings(m_pipelineList.size(), PipelineBinding(), FrameAllocator<PipelineBinding>(&m_frameArena));
+                FrameVector<DrawChunk> chunks(FrameAllocator<DrawChunk>(&m_frameArena));
+                for (size_t p = 0; p < m_pipelineList.size(); p++)
+                {
+                    VKPipeline* pipeline = static_cast<VKPipeline*>(m_pipelineList[p].pipeline->GetBase());
 
-                    m_instanceBlocks[it->first] = {};
-                    if (!VKTools::CreateUniformBuffer(totalDataSize, allChunkData, &m_instanceBlocks[it->first]))
+                    //Pipelines are only read from here on; passes recording at the same time don't touch them
+                    PipelineBinding& binding = bindings[p];
+                    binding.pipeline = pipeline;
+                    if (!buildPushConstants(pipeline, proj, view, binding) ||
+                        !writePipelineUniforms(pipeline, invView, binding.uniformSet))
                         return false;
 
-                    //It's on the GPU now so we don't need this
-                    delete[] allChunkData;
-                }
-
-                VkResult err;
-
-                VkCommandBufferInheritanceInfo inheritanceInfo = {};
-                inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
-                inheritanceInfo.pNext = nullptr;
-                inheritanceInfo.renderPass = VK_NULL_HANDLE;
-                inheritanceInfo.subpass = 0;
-                inheritanceInfo.framebuffer = VK_NULL_HANDLE;
-                inheritanceInfo.occlusionQueryEnable = VK_FALSE;
-                inheritanceInfo.queryFlags = 0;
-                inheritanceInfo.pipelineStatistics = 0;
+                    const FrameVector<RenderableInstances>& renderables = m_pipelineList[p].renderables;
+                    size_t chunkSize = m_chunkSize > 0 ? m_chunkSize : renderables.size();
 
-                VkCommandBufferBeginInfo beginInfo = {};
-                beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-                beginInfo.pNext = nullptr;
-                beginInfo.flags = 0;
-                beginInfo.pInheritanceInfo = &inheritanceInfo;
+                    //Copy changed material variables into their uniform ranges; clean materials cost a check
+                    MaterialBase* lastMaterial = nullptr;
+                    for (size_t r = 0; r < renderables.size(); r++)
+                    {
+                        MaterialBase* material = renderables[r].renderable.material->GetBase();
+                        if (material == lastMaterial)
+                            continue;
 
-                //Get the current clear color from the renderer
-                VkClearValue clearColor = m_swapchain->GetVKClearColor();
+                        material->VUpdate();
+                        lastMaterial = material;
+                    }
 
-                std::vector<VkClearValue> clearValues;
-                for (size_t i = 0; i < m_outputRenderTargets.size(); i++)
-                {
-                    RenderTargetHandle renderTargetHandle = m_outputRenderTargets[i];
-                    VKRenderTarget* renderTarget = static_cast<VKRenderTarget*>(renderTargetHandle->GetBase());
+                    for (size_t first = 0; first < renderables.size(); first += chunkSize)
+                    {
+                        DrawChunk chunk;
+                        chunk.binding = &binding;
+                        chunk.renderables = &renderables;
+                        chunk.first = first;
+                        chunk.last = std::min(first + chunkSize, renderables.size());
 
-                    const VkClearValue* targetClearColor = renderTarget->GetClearColor();
-                    //If a clear color is provided by the render target, lets use that
-                    if (targetClearColor == nullptr)
-                        clearValues.push_back(clearColor);
-                    else
-                        clearValues.push_back(*targetClearColor);
+                        chunks.push_back(chunk);
+                    }
                 }
-                clearValues.push_back({1.0f, 0.0f});
 
-                VkRenderPassBeginInfo renderPassBeginInfo = {};
-                renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-                renderPassBeginInfo.pNext = nullptr;
-                renderPassBeginInfo.renderPass = m_renderPass;
-                renderPassBeginInfo.framebuffer = m_framebuffer;
-                renderPassBeginInfo.renderArea.offset.x = 0;
-                renderPassBeginInfo.renderArea.offset.y = 0;
-                renderPassBeginInfo.renderArea.extent.width = m_width;
-                renderPassBeginInfo.renderArea.extent.height = m_height;
-                renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-                renderPassBeginInfo.pClearValues = clearValues.data();
+                prunePipelineUniforms();
 
-                VkViewport viewport = {};
-                viewport.width = static_cast<float>(m_width);
-                viewport.height = static_cast<float>(m_height);
-                viewport.minDepth = 0.0f;
-                viewport.maxDepth = 1.0f;
+                //What's drawn depends on the camera, so a GPU driven pass is recorded every frame
+                if (gpuCulled && canDrawIndirect())
+                    return buildIndirect(vkCommandPool, frame, bindings);
 
-                VkRect2D scissor = {};
-                scissor.extent.width = m_width;
-                scissor.extent.height = m_height;
-                scissor.offset.x = 0;
-                scissor.offset.y = 0;
-                
-                err = vkBeginCommandBuffer(m_commandBuffer, &beginInfo);
-                assert(!err);
-                if (err != VK_SUCCESS)
+                //Nothing scheduled for just this frame, so last time's recording may still be good
+                if (m_retainedOnly)
+                    return buildRetained(frame, chunks);
+
+                //The pool is reset as a whole every frame so we take a recycled buffer each time we record
+                VkCommandBuffer commandBuffer = vkCommandPool->AcquireCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+                if (commandBuffer == VK_NULL_HANDLE)
                 {
-                    HT_DEBUG_PRINTF("VKRenderPass::VBuildCommandList(): Failed to build command buffer.\n");
+                    HT_DEBUG_PRINTF("VKRenderPass::VBuildCommandList(): Failed to acquire command buffer.\n");
                     return false;
                 }
+                m_commandBuffers[frame] = commandBuffer;
 
-                /*
-                    BEGIN BUFFER COMMANDS
-                */
-
-                vkCmdBeginRenderPass(m_commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-                vkCmdSetViewport(m_commandBuffer, 0, 1, &viewport);
-                vkCmdSetScissor(m_commandBuffer, 0, 1, &scissor);
-
-                //Bind sampler set from root layout
-                VkPipelineLayout vkPipelineLayout = m_rootLayout->VKGetPipelineLayout();
-
-                vkCmdBindDescriptorSets(m_commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vkPipelineLayout, 0, 1, &m_rootLayout->VKGetSamplerSet(), 0, nullptr);
-
-                for (auto iterator = m_pipelineList.begin(); iterator != m_pipelineList.end(); ++iterator)
+                //Write every mesh's instance chunks straight into this frame's slice of the upload ring
+                VKUploadRing* uploadRing = m_swapchain->GetUploadRing();
+                FrameVector<VKUploadRange> instanceRanges(m_instanceData.size(), VKUploadRange(), FrameAllocator<VKUploadRange>(&m_frameArena));
+                for (size_t m = 0; m < m_instanceData.size(); m++)
                 {
-                    PipelineHandle pipelineHandle = iterator->first;
-                    VKPipeline* pipeline = static_cast<VKPipeline*>(pipelineHandle->GetBase());
-
-                    //Calculate inverse view
-                    Math::Matrix4 invView = Math::MMMatrixTranspose(Math::MMMatrixInverse(m_view));
+                    const FrameVector<ShaderVariableChunk*>& instanceChunks = m_instanceData[m].chunks;
+                    if (instanceChunks.empty())
+                        continue;
 
-                    m_view = Math::MMMatrixTranspose(m_view);
-                    m_proj = Math::MMMatrixTranspose(m_proj);
+                    size_t chunkSize = instanceChunks[0]->GetSize();
+                    size_t totalDataSize = chunkSize * instanceChunks.size();
 
-                    //The numbers indicate the byte offset in memory that these values are written to
-                    pipeline->VSetMatrix4(0, m_proj);
-                    pipeline->VSetMatrix4(64, m_view);
-                    pipeline->VSetMatrix4(128, invView);
-                    pipeline->VSetInt(192, m_width);
-                    pipeline->VSetInt(196, m_height);
-                    pipeline->VUpdate();
-
-                    pipeline->BindPipeline(m_commandBuffer);
+                    VKUploadRange& range = instanceRanges[m];
+                    if (!uploadRing->Allocate(totalDataSize, 16, range))
+                        return false;
 
-                    //Bind input textures
-                    if(m_inputTargetDescriptorSets.size() > 0)
-                        vkCmdBindDescriptorSets(m_commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vkPipelineLayout, m_firstInputTargetSetIndex,
-                            static_cast<uint32_t>(m_inputTargetDescriptorSets.size()), m_inputTargetDescriptorSets.data(), 0, nullptr);
+                    BYTE* instanceData = static_cast<BYTE*>(range.mapped);
+                    for (size_t i = 0; i < instanceChunks.size(); i++)
+                        memcpy(instanceData + i * chunkSize, instanceChunks[i]->GetByteData(), chunkSize);
+                }
 
-                    std::vector<RenderableInstances> renderables = iterator->second;
+                //Only worth going wide if there's more than one chunk to hand out
+                const bool recordSecondaries = chunks.size() > 1 && context.scheduler != nullptr;
 
-                    VkDeviceSize offsets[] = { 0 };
+                FrameVector<VkCommandBuffer> secondaryBuffers(recordSecondaries ? chunks.size() : 0, VK_NULL_HANDLE,
+                    FrameAllocator<VkCommandBuffer>(&m_frameArena));
+                FrameVector<RecordStats> secondaryStats(secondaryBuffers.size(), RecordStats(),
+                    FrameAllocator<RecordStats>(&m_frameArena));
+                if (recordSecondaries)
+                {
+                    std::atomic_bool failed(false);
+                    JobCounter recorded;
 
-                    for (uint32_t i = 0; i < renderables.size(); i++)
+                    for (size_t i = 0; i < chunks.size(); i++)
                     {
-                        Renderable renderable = renderables[i].renderable;
-                        uint32_t count = renderables[i].count;
-
-                        MaterialHandle materialHandle = renderable.material;
-                        MeshHandle meshHandle = renderable.mesh;
-                    
-                        VKMaterial* material = static_cast<VKMaterial*>(materialHandle->GetBase());
-                        VKMesh* mesh = static_cast<VKMesh*>(meshHandle->GetBase());
-
-                        material->BindMaterial(m_commandBuffer, vkPipelineLayout);
-                    
-                        //Bind instance buffer
-                        if (m_instanceBlocks.find(meshHandle) != m_instanceBlocks.end())
+                        context.scheduler->Schedule([this, &context, &chunks, &instanceRanges, &secondaryBuffers, &secondaryStats, &failed, i](uint32_t index)
                         {
-                            UniformBlock_vk instanceBlock = m_instanceBlocks[meshHandle];
-                            vkCmdBindVertexBuffers(m_commandBuffer, 1, 1, &instanceBlock.buffer, offsets);
-                        }
+                            //Record with the pool belonging to whichever thread picked this chunk up
+                            VKCommandPool* chunkPool = static_cast<VKCommandPool*>((*context.pools)[index]);
+                            if (!recordSecondary(chunkPool, chunks[i], instanceRanges, secondaryBuffers[i], secondaryStats[i]))
+                                failed = true;
+                        }, &recorded);
+                    }
 
-                        UniformBlock_vk vertBlock = mesh->GetVertexBlock();
-                        UniformBlock_vk indexBlock = mesh->GetIndexBlock();
-                        uint32_t indexCount = mesh->VGetIndexCount();
+                    //Help record our own chunks rather than sitting idle
+                    context.scheduler->Wait(&recorded);
 
-                        vkCmdBindVertexBuffers(m_commandBuffer, 0, 1, &vertBlock.buffer, offsets);
-                        vkCmdBindIndexBuffer(m_commandBuffer, indexBlock.buffer, 0, VK_INDEX_TYPE_UINT32);
-                        
-                        vkCmdDrawIndexed(m_commandBuffer, indexCount, count, 0, 0, 0);
+                    if (failed)
+                    {
+                        HT_DEBUG_PRINTF("VKRenderPass::VBuildCommandList(): Failed to record secondary command buffers.\n");
+                        return false;
                     }
 
+                    for (size_t i = 0; i < secondaryStats.size(); i++)
+                    {
+                        m_recordStats.draws += secondaryStats[i].draws;
+                        m_recordStats.bindsIssued += secondaryStats[i].bindsIssued;
+                        m_recordStats.bindsElided += secondaryStats[i].bindsElided;
+                    }
                 }
 
-                vkCmdEndRenderPass(m_commandBuffer);
+                return recordPrimary(vkCommandPool, commandBuffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, chunks, instanceRanges, secondaryBuffers);
+            }
+
+            const VkRenderPass& VKRenderPass::GetVkRenderPass() const { return m_renderPass; }
 
-                /*
-                    END BUFFER COMMANDS
-                */
+            const VkCommandBuffer& VKRenderPass::GetVkCommandBuffer() const { return m_commandBuffers[m_swapchain->GetCurrentFrame()]; }
 
-                //Blit to render targets
-                for (size_t i = 0; i < m_outputRenderTargets.size(); i++)
-                {
-                    VKRenderTarget* renderTarget = static_cast<VKRenderTarget*>(m_outputRenderTargets[i]->GetBase());
+            const VKRootLayout* VKRenderPass::GetVKRootLayout() const { return m_rootLayout; }
 
-                    if (!renderTarget->Blit(m_commandBuffer, m_colorImages[i]))
-                        return false;
-                }
-                
-                err = vkEndCommandBuffer(m_commandBuffer);
-                assert(!err);
-                if (err != VK_SUCCESS)
-                {
-                    HT_DEBUG_PRINTF("VKRenderPass::VBuildCommandList(): Failed to end command buffer.\n");
+            const std::vector<RenderTargetHandle>& VKRenderPass::GetOutputRenderTargets() const { return m_outputRenderTargets; }
+
+            /** Recreates this pass's attachment images without memory
+            *
+            * The previous images, views and framebuffer are retired. Every
+            * attachment lives only for this pass, so each is requested with a
+            * lifetime of just its position.
+            *
+            * \param position The level of the render graph this pass runs in
+            * \param requests The requests to append this pass's attachments to
+            * \return True if the images were created
+            */
+            bool VKRenderPass::VKPrepareAttachments(uint32_t position, std::vector<VKAttachmentRequest>& requests)
+            {
+                retireAttachments();
+
+                if (!setupAttachmentImages())
                     return false;
+
+                for (size_t i = 0; i < m_colorImages.size(); i++)
+                {
+                    VKAttachmentRequest request = {};
+                    request.image = m_colorImages[i].image;
+                    request.transient = false; //Blitted into the render target afterwards
+                    request.firstPass = position;
+                    request.lastPass = position;
+                    requests.push_back(request);
                 }
 
-                
+                VKAttachmentRequest depthRequest = {};
+                depthRequest.image = m_depthImage.image;
+                depthRequest.transient = true;
+                depthRequest.firstPass = position;
+                depthRequest.lastPass = position;
+                requests.push_back(depthRequest);
 
                 return true;
             }
 
-            const VkRenderPass& VKRenderPass::GetVkRenderPass() const { return m_renderPass; }
+            /** Creates the attachment views and framebuffer once memory is bound
+            * \param aliased True if any attachment shares memory with another pass
+            * \return True if the pass is ready to record
+            */
+            bool VKRenderPass::VKBindAttachments(bool aliased)
+            {
+                if (!setupAttachmentViews())
+                    return false;
+                if (!setupFramebuffer())
+                    return false;
 
-            const VkCommandBuffer& VKRenderPass::GetVkCommandBuffer() const { return m_commandBuffer; }
+                m_aliased = aliased;
+                m_attachmentsReady = true;
+                m_attachmentVersion++;
 
-            const VKRootLayout* VKRenderPass::GetVKRootLayout() const { return m_rootLayout; }
+                return true;
+            }
 
-            const std::vector<RenderTargetHandle>& VKRenderPass::GetOutputRenderTargets() const { return m_outputRenderTargets; }
+            /** Gets whether this pass has attachments bound to memory
+            * \return True once VKBindAttachments has succeeded
+            */
+            bool VKRenderPass::VKAttachmentsReady() const { return m_attachmentsReady; }
 
             /*
                 Private methods
@@ -383,7 +411,8 @@ namespace Hatchit {
                     description.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
                     description.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
                     description.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-                    description.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+                    //Cleared every time and possibly aliased, so old contents never matter
+                    description.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
                     description.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
                     description.flags = 0;
 
@@ -400,10 +429,11 @@ namespace Hatchit {
                 depthAttachment.format = VKTools::GetPreferredDepthFormat();
                 depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
                 depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-                depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+                //Depth is never read after the pass, which lets it stay transient
+                depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
                 depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
                 depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-                depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+                depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
                 depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
                 depthAttachment.flags = 0;
 
@@ -452,17 +482,9 @@ namespace Hatchit {
             bool VKRenderPass::setupAttachmentImages() 
             {
                 VkFormat depthFormat = VKTools::GetPreferredDepthFormat();
-                VKTools::CreateSetupCommandBuffer();
-                VkCommandBuffer setupCommand = VKTools::GetSetupCommandBuffer();
 
                 VkResult err;
 
-                //If width and height were not set, lets use the size of the screen that the renderer reports
-                if (m_width == 0)
-                    m_width = m_swapchain->GetWidth();
-                if (m_height == 0)
-                    m_height = m_swapchain->GetHeight();
-
                 //Create an image for every output texture
                 for (size_t i = 0; i < m_outputRenderTargets.size(); i++)
                 {
@@ -470,7 +492,7 @@ namespace Hatchit {
                     VkFormat colorFormat = vkRenderTarget->GetVKColorFormat();
 
                     //Attachment image that we will push back into a vector
-                    Image_vk colorImage;
+                    Image_vk colorImage = {};
 
                     uint32_t width = vkRenderTarget->GetWidth();
                     uint32_t height = vkRenderTarget->GetHeight();
@@ -493,11 +515,6 @@ namespace Hatchit {
                     imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
                     imageInfo.flags = 0;
 
-                    VkMemoryAllocateInfo memAllocInfo = {};
-                    memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-
-                    VkMemoryRequirements memReqs;
-
                     err = vkCreateImage(m_device, &imageInfo, nullptr, &colorImage.image);
                     assert(!err);
                     if (err != VK_SUCCESS)
@@ -506,49 +523,6 @@ namespace Hatchit {
                         return false;
                     }
 
-                    vkGetImageMemoryRequirements(m_device, colorImage.image, &memReqs);
-                    memAllocInfo.allocationSize = memReqs.size;
-                    VKTools::MemoryTypeFromProperties(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memAllocInfo.memoryTypeIndex);
-
-                    err = vkAllocateMemory(m_device, &memAllocInfo, nullptr, &colorImage.memory);
-                    assert(!err);
-                    if (err != VK_SUCCESS)
-                    {
-                        HT_ERROR_PRINTF("VKRenderPass::setupAttachmentImages(): Could not allocate color image memory!\n");
-                        return false;
-                    }
-
-                    err = vkBindImageMemory(m_device, colorImage.image, colorImage.memory, 0);
-                    if (err != VK_SUCCESS)
-                    {
-                        HT_ERROR_PRINTF("VKRenderPass::setupAttachmentImages(): Could not bind color image memory!\n");
-                        return false;
-                    }
-
-                    VKTools::SetImageLayout(setupCommand, colorImage.image, VK_IMAGE_ASPECT_COLOR_BIT,
-                        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-
-                    VkImageViewCreateInfo viewInfo = {};
-                    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-                    viewInfo.pNext = nullptr;
-                    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-                    viewInfo.format = colorFormat;
-                    viewInfo.flags = 0;
-                    viewInfo.subresourceRange = {};
-                    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-                    viewInfo.subresourceRange.baseMipLevel = 0;
-                    viewInfo.subresourceRange.levelCount = 1;
-                    viewInfo.subresourceRange.baseArrayLayer = 0;
-                    viewInfo.subresourceRange.layerCount = 1;
-                    viewInfo.image = colorImage.image;
-
-                    err = vkCreateImageView(m_device, &viewInfo, nullptr, &colorImage.view);
-                    if (err != VK_SUCCESS)
-                    {
-                        HT_DEBUG_PRINTF("VKRenderTarget::VPrepare(): Error creating color image view!\n");
-                        return false;
-                    }
-
                     m_colorImages.push_back(colorImage);
                 }
 
@@ -563,49 +537,55 @@ namespace Hatchit {
                 imageInfo.arrayLayers = 1;
                 imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
                 imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-                imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+                imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
                 imageInfo.flags = 0;
 
-                VkMemoryAllocateInfo memAllocInfo = {};
-                memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-
-                VkMemoryRequirements memReqs;
-
                 err = vkCreateImage(m_device, &imageInfo, nullptr, &m_depthImage.image);
                 assert(!err);
                 if (err != VK_SUCCESS)
                 {
-                    HT_DEBUG_PRINTF("VKRenderTarget::VPrepare(): Error creating color image!\n");
+                    HT_DEBUG_PRINTF("VKRenderPass::setupAttachmentImages(): Error creating depth image!\n");
                     return false;
                 }
 
-                vkGetImageMemoryRequirements(m_device, m_depthImage.image, &memReqs);
-                memAllocInfo.allocationSize = memReqs.size;
-                VKTools::MemoryTypeFromProperties(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memAllocInfo.memoryTypeIndex);
+                return true;
+            }
 
-                err = vkAllocateMemory(m_device, &memAllocInfo, nullptr, &m_depthImage.memory);
-                assert(!err);
-                if (err != VK_SUCCESS)
-                {
-                    HT_DEBUG_PRINTF("VKRenderTarget::VPrepare(): Error allocating color image memory!\n");
-                    return false;
-                }
+            bool VKRenderPass::setupAttachmentViews()
+            {
+                VkResult err;
 
-                err = vkBindImageMemory(m_device, m_depthImage.image, m_depthImage.memory, 0);
-                if (err != VK_SUCCESS)
+                for (size_t i = 0; i < m_colorImages.size(); i++)
                 {
-                    HT_DEBUG_PRINTF("VKRenderTarget::VPrepare(): Error binding color image memory!\n");
-                    return false;
-                }
+                    VKRenderTarget* vkRenderTarget = static_cast<VKRenderTarget*>(m_outputRenderTargets[i]->GetBase());
+
+                    VkImageViewCreateInfo viewInfo = {};
+                    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+                    viewInfo.pNext = nullptr;
+                    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+                    viewInfo.format = vkRenderTarget->GetVKColorFormat();
+                    viewInfo.flags = 0;
+                    viewInfo.subresourceRange = {};
+                    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                    viewInfo.subresourceRange.baseMipLevel = 0;
+                    viewInfo.subresourceRange.levelCount = 1;
+                    viewInfo.subresourceRange.baseArrayLayer = 0;
+                    viewInfo.subresourceRange.layerCount = 1;
+                    viewInfo.image = m_colorImages[i].image;
 
-                VKTools::SetImageLayout(setupCommand, m_depthImage.image, VK_IMAGE_ASPECT_DEPTH_BIT,
-                    VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+                    err = vkCreateImageView(m_device, &viewInfo, nullptr, &m_colorImages[i].view);
+                    if (err != VK_SUCCESS)
+                    {
+                        HT_DEBUG_PRINTF("VKRenderPass::setupAttachmentViews(): Error creating color image view!\n");
+                        return false;
+                    }
+                }
 
                 VkImageViewCreateInfo viewInfo = {};
                 viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
                 viewInfo.pNext = nullptr;
                 viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-                viewInfo.format = depthFormat;
+                viewInfo.format = VKTools::GetPreferredDepthFormat();
                 viewInfo.flags = 0;
                 viewInfo.subresourceRange = {};
                 viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
@@ -618,14 +598,30 @@ namespace Hatchit {
                 err = vkCreateImageView(m_device, &viewInfo, nullptr, &m_depthImage.view);
                 if (err != VK_SUCCESS)
                 {
-                    HT_DEBUG_PRINTF("VKRenderTarget::VPrepare(): Error creating color image view!\n");
+                    HT_DEBUG_PRINTF("VKRenderPass::setupAttachmentViews(): Error creating depth image view!\n");
                     return false;
                 }
 
-                VKTools::FlushSetupCommandBuffer();
-
                 return true;
             }
+
+            void VKRenderPass::retireAttachments()
+            {
+                //Memory is owned by the aliaser, so only the images and views go
+                for (size_t i = 0; i < m_colorImages.size(); i++)
+                    VKDeletionQueue::RetireImage(m_colorImages[i].image, m_colorImages[i].view, VKAllocation());
+                m_colorImages.clear();
+
+                VKDeletionQueue::RetireImage(m_depthImage.image, m_depthImage.view, VKAllocation());
+                m_depthImage = {};
+
+                VKDeletionQueue::RetireFramebuffer(m_framebuffer);
+                m_framebuffer = VK_NULL_HANDLE;
+
+                m_attachmentsReady = false;
+                m_aliased = false;
+            }
+
             bool VKRenderPass::setupFramebuffer() 
             {
                 VkResult err;
@@ -658,40 +654,1209 @@ namespace Hatchit {
                 return true;
             }
 
-            bool VKRenderPass::allocateCommandBuffer(const VKCommandPool* commandPool)
+            /** Records the whole pass into a primary command buffer
+            * \param commandPool The pool commandBuffer came from
+            * \param commandBuffer The buffer to record into
+            * \param usage Usage flags to begin the buffer with
+            * \param chunks Every chunk of draws, in order
+            * \param instanceRanges Where each draw's instance data is
+            * \param secondaryBuffers The chunks already recorded, or empty to record them inline
+            * \param indirect What to cull and draw indirectly instead of the chunks, or nullptr
+            * \return True if the buffer was recorded
+            */
+            bool VKRenderPass::recordPrimary(VKCommandPool* commandPool, VkCommandBuffer commandBuffer, VkCommandBufferUsageFlags usage,
+                const FrameVector<DrawChunk>& chunks, const FrameVector<VKUploadRange>& instanceRanges,
+                const FrameVector<VkCommandBuffer>& secondaryBuffers, const IndirectDraws* indirect)
             {
                 VkResult err;
 
-                if (m_commandBuffer != VK_NULL_HANDLE)
-                    return true;
+                VkCommandBufferInheritanceInfo inheritanceInfo = {};
+                inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+                inheritanceInfo.pNext = nullptr;
+                inheritanceInfo.renderPass = VK_NULL_HANDLE;
+                inheritanceInfo.subpass = 0;
+                inheritanceInfo.framebuffer = VK_NULL_HANDLE;
+                inheritanceInfo.occlusionQueryEnable = VK_FALSE;
+                inheritanceInfo.queryFlags = 0;
+                inheritanceInfo.pipelineStatistics = 0;
 
-                //Create internal command buffer
-                VkCommandBufferAllocateInfo cmdBufferAllocInfo = {};
-                cmdBufferAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-                cmdBufferAllocInfo.commandPool = (commandPool->GetVKCommandPool());
-                cmdBufferAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-                cmdBufferAllocInfo.commandBufferCount = 1;
+                VkCommandBufferBeginInfo beginInfo = {};
+                beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+                beginInfo.pNext = nullptr;
+                beginInfo.flags = usage;
+                beginInfo.pInheritanceInfo = &inheritanceInfo;
 
-                vkDeviceWaitIdle(m_device);
+                //Get the current clear color from the renderer
+                VkClearValue clearColor = m_swapchain->GetVKClearColor();
 
-                err = vkAllocateCommandBuffers(m_device, &cmdBufferAllocInfo, &m_commandBuffer);
-                assert(!err);
-                if (err != VK_SUCCESS)
+                FrameVector<VkClearValue> clearValues(FrameAllocator<VkClearValue>(&m_frameArena));
+                for (size_t i = 0; i < m_outputRenderTargets.size(); i++)
                 {
-                    HT_DEBUG_PRINTF("VKRenderer::prepareDescriptorLayout(): Failed to allocate command buffer\n");
-                    return false;
-                }
-
-                return true;
-            }
+                    RenderTargetHandle renderTargetHandle = m_outputRenderTargets[i];
+                    VKRenderTarget* renderTarget = static_cast<VKRenderTarget*>(renderTargetHandle->GetBase());
 
-            bool VKRenderPass::setupDescriptorSets(std::map<uint32_t, std::map<uint32_t, VKRenderTarget*>> inputTargets)
+                    const VkClearValue* targetClearColor = renderTarget->GetClearColor();
+                    //If a clear color is provided by the render target, lets use that
+                    if (targetClearColor == nullptr)
+                        clearValues.push_back(clearColor);
+                    else
+                        clearValues.push_back(*targetClearColor);
+                }
+                clearValues.push_back({1.0f, 0.0f});
+
+                VkRenderPassBeginInfo renderPassBeginInfo = {};
+                renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+                renderPassBeginInfo.pNext = nullptr;
+                renderPassBeginInfo.renderPass = m_renderPass;
+                renderPassBeginInfo.framebuffer = m_framebuffer;
+                renderPassBeginInfo.renderArea.offset.x = 0;
+                renderPassBeginInfo.renderArea.offset.y = 0;
+                renderPassBeginInfo.renderArea.extent.width = m_width;
+                renderPassBeginInfo.renderArea.extent.height = m_height;
+                renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+                renderPassBeginInfo.pClearValues = clearValues.data();
+
+                err = commandPool->BeginCommandBuffer(commandBuffer, beginInfo);
+                assert(!err);
+                if (err != VK_SUCCESS)
+                {
+                    HT_DEBUG_PRINTF("VKRenderPass::recordPrimary(): Failed to build command buffer.\n");
+                    return false;
+                }
+
+                /*
+                    BEGIN BUFFER COMMANDS
+                */
+
+                //Dispatches can't run inside a render pass, so culling goes first
+                if (indirect != nullptr)
+                {
+                    recordResidentCopies(commandBuffer, *indirect);
+
+                    if (!VKIndirectCuller::RecordCull(commandBuffer, indirect->frustum, indirect->resident) ||
+                        !VKIndirectCuller::RecordCull(commandBuffer, indirect->frustum, indirect->cull))
+                    {
+                        HT_DEBUG_PRINTF("VKRenderPass::recordPrimary(): Failed to record culling dispatch.\n");
+                        return false;
+                    }
+                }
+
+                //Our attachments share memory with an earlier pass; let its attachment work finish first
+                if (m_aliased)
+                {
+                    VkMemoryBarrier aliasBarrier = {};
+                    aliasBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+                    aliasBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+                    aliasBarrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+                    vkCmdPipelineBarrier(commandBuffer,
+                        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+                        0, 1, &aliasBarrier, 0, nullptr, 0, nullptr);
+                }
+
+                if (!secondaryBuffers.empty())
+                {
+                    //Stitch the chunks back together in their original order
+                    vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+                    vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(secondaryBuffers.size()), secondaryBuffers.data());
+                }
+                else
+                {
+                    vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+                    //One state for every chunk so binds carry over from chunk to chunk
+                    VKCommandState state(commandBuffer);
+                    if (indirect != nullptr)
+                        recordIndirect(state, *indirect);
+                    else
+                    {
+                        for (size_t i = 0; i < chunks.size(); i++)
+                            recordChunk(state, chunks[i], instanceRanges);
+                    }
+
+                    const RecordStats& stats = state.GetStats();
+                    m_recordStats.draws += stats.draws;
+                    m_recordStats.bindsIssued += stats.bindsIssued;
+                    m_recordStats.bindsElided += stats.bindsElided;
+                }
+
+                vkCmdEndRenderPass(commandBuffer);
+
+                /*
+                    END BUFFER COMMANDS
+                */
+
+                //Blit to render targets
+                for (size_t i = 0; i < m_outputRenderTargets.size(); i++)
+                {
+                    VKRenderTarget* renderTarget = static_cast<VKRenderTarget*>(m_outputRenderTargets[i]->GetBase());
+
+                    if (!renderTarget->Blit(commandBuffer, m_colorImages[i]))
+                        return false;
+                }
+                
+                err = commandPool->EndCommandBuffer(commandBuffer);
+                assert(!err);
+                if (err != VK_SUCCESS)
+                {
+                    HT_DEBUG_PRINTF("VKRenderPass::recordPrimary(): Failed to end command buffer.\n");
+                    return false;
+                }
+
+                return true;
+            }
+
+            /** Submits this slot's recording of the retained requests again, or records it anew
+            *
+            * Recording again is only needed when something the recording baked in
+            * changed: the draw list, the camera pushed with each pipeline, the
+            * attachments, the clear color or the residency of anything drawn.
+            * Otherwise only changed instance data is copied.
+            *
+            * \param frame The frame slot being built
+            * \param chunks Every chunk of draws, in order
+            * \return True if the slot has a command buffer ready to submit
+            */
+            bool VKRenderPass::buildRetained(uint32_t frame, const FrameVector<DrawChunk>& chunks)
             {
-                if (inputTargets.size() <= 0)
+                RetainedSlot& slot = m_retainedSlots[frame];
+
+                if (slot.commandPool == nullptr)
+                {
+                    VKCommandPool* commandPool = new VKCommandPool(m_device);
+                    if (!commandPool->VInitialize())
+                    {
+                        delete commandPool;
+                        HT_ERROR_PRINTF("VKRenderPass::buildRetained(): Failed to create command pool.\n");
+                        return false;
+                    }
+
+                    slot.commandPool = commandPool;
+                }
+
+                const uint64_t residencyVersion = VKMemoryBudget::GetResidencyVersion();
+                const VkClearValue clearColor = m_swapchain->GetVKClearColor();
+                const bool listChanged = !slot.recorded || slot.listVersion != m_retainedListVersion;
+
+                FrameVector<VKUploadRange> instanceRanges(m_instanceData.size(), VKUploadRange(), FrameAllocator<VKUploadRange>(&m_frameArena));
+                bool moved = false;
+                if (!writeRetainedInstances(slot, listChanged, instanceRanges, moved))
+                    return false;
+
+                bool record = listChanged || moved ||
+                    slot.cameraVersion != m_cameraVersion ||
+                    slot.attachmentVersion != m_attachmentVersion ||
+                    slot.residencyVersion != residencyVersion ||
+                    memcmp(&slot.clearColor, &clearColor, sizeof(VkClearValue)) != 0;
+
+                if (!record)
+                {
+                    //Binding marks what's drawn as used; nothing is bound this time so mark it here
+                    for (size_t p = 0; p < m_pipelineList.size(); p++)
+                    {
+                        const FrameVector<RenderableInstances>& renderables = m_pipelineList[p].renderables;
+                        for (size_t r = 0; r < renderables.size(); r++)
+                        {
+                            static_cast<VKMaterial*>(renderables[r].renderable.material->GetBase())->VKMarkUsed();
+                            static_cast<VKMesh*>(renderables[r].renderable.mesh->GetBase())->VKMarkUsed();
+                        }
+                    }
+
+                    m_commandBuffers[frame] = slot.commandBuffer;
+                    m_recordStats = slot.recordStats;
                     return true;
+                }
+
+                //This slot's last submission is finished, so everything it recorded can go
+                slot.recorded = false;
+                if (!slot.commandPool->VReset())
+                    return false;
+
+                VkCommandBuffer commandBuffer = slot.commandPool->AcquireCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+                if (commandBuffer == VK_NULL_HANDLE)
+                {
+                    HT_DEBUG_PRINTF("VKRenderPass::buildRetained(): Failed to acquire command buffer.\n");
+                    return false;
+                }
+
+                //Recorded inline; secondaries from this frame's pools wouldn't outlive their reset
+                FrameVector<VkCommandBuffer> secondaryBuffers(FrameAllocator<VkCommandBuffer>(&m_frameArena));
+                if (!recordPrimary(slot.commandPool, commandBuffer, 0, chunks, instanceRanges, secondaryBuffers))
+                    return false;
+
+                m_commandBuffers[frame] = commandBuffer;
+
+                slot.commandBuffer = commandBuffer;
+                slot.listVersion = m_retainedListVersion;
+                slot.cameraVersion = m_cameraVersion;
+                slot.attachmentVersion = m_attachmentVersion;
+                slot.residencyVersion = residencyVersion;
+                slot.clearColor = clearColor;
+                slot.recordStats = m_recordStats;
+                slot.recorded = true;
+
+                return true;
+            }
+
+            /** Copies retained instance data into a frame slot's instance buffer
+            *
+            * Draws are laid out one after another, so the layout only changes
+            * with the draw list. Unless rewriting, only chunks whose version
+            * differs from what the slot last wrote are copied.
+            *
+            * \param slot The frame slot to write
+            * \param rewrite True to copy every chunk
+            * \param instanceRanges Filled with where each draw's instance data is
+            * \param moved Set if the slot's buffer had to be replaced
+            * \return True unless a bigger buffer was needed and couldn't be made
+            */
+            bool VKRenderPass::writeRetainedInstances(RetainedSlot& slot, bool rewrite, FrameVector<VKUploadRange>& instanceRanges, bool& moved)
+            {
+                VkDeviceSize size = 0;
+                for (size_t m = 0; m < m_instanceData.size(); m++)
+                {
+                    const FrameVector<ShaderVariableChunk*>& instanceChunks = m_instanceData[m].chunks;
+                    if (instanceChunks.empty())
+                        continue;
+
+                    size = (size + 15) & ~static_cast<VkDeviceSize>(15);
+                    size += instanceChunks[0]->GetSize() * instanceChunks.size();
+                }
 
+                if (size > slot.instanceCapacity)
+                {
+                    VkDeviceSize capacity = slot.instanceCapacity > 0 ? slot.instanceCapacity : 4096;
+                    while (capacity < size)
+                        capacity *= 2;
+
+                    //Coherent so changed instances never have to be flushed
+                    UniformBlock_vk block = {};
+                    if (!createInstanceBuffer(capacity, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, block))
+                        return false;
+
+                    //Only this slot's recordings ever read it
+                    if (slot.instanceBlock.buffer != VK_NULL_HANDLE)
+                        VKDeletionQueue::RetireBuffer(slot.instanceBlock);
+
+                    slot.instanceBlock = block;
+                    slot.instanceCapacity = capacity;
+
+                    rewrite = true;
+                    moved = true;
+                }
+
+                if (rewrite)
+                    slot.writtenVersions.clear();
+
+                BYTE* mapped = static_cast<BYTE*>(slot.instanceBlock.allocation.mapped);
+
+                VkDeviceSize offset = 0;
+                size_t position = 0;
+                for (size_t m = 0; m < m_instanceData.size(); m++)
+                {
+                    const FrameVector<ShaderVariableChunk*>& instanceChunks = m_instanceData[m].chunks;
+                    const FrameVector<uint64_t>& versions = m_instanceData[m].versions;
+                    if (instanceChunks.empty())
+                        continue;
+
+                    size_t chunkSize = instanceChunks[0]->GetSize();
+                    offset = (offset + 15) & ~static_cast<VkDeviceSize>(15);
+
+                    VKUploadRange& range = instanceRanges[m];
+                    range.buffer = slot.instanceBlock.buffer;
+                    range.offset = offset;
+                    range.size = chunkSize * instanceChunks.size();
+                    range.mapped = mapped + offset;
+
+                    for (size_t i = 0; i < instanceChunks.size(); i++, position++)
+                    {
+                        if (rewrite)
+                            slot.writtenVersions.push_back(0);
+                        else if (slot.writtenVersions[position] == versions[i])
+                            continue;
+
+                        memcpy(mapped + offset + i * chunkSize, instanceChunks[i]->GetByteData(), chunkSize);
+                        slot.writtenVersions[position] = versions[i];
+                    }
+
+                    offset += range.size;
+                }
+
+                return true;
+            }
+
+            bool VKRenderPass::createInstanceBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, UniformBlock_vk& block)
+            {
                 VkResult err;
 
+                VkBufferCreateInfo bufferCreateInfo = {};
+                bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+                bufferCreateInfo.usage = usage;
+                bufferCreateInfo.size = size;
+
+                err = vkCreateBuffer(m_device, &bufferCreateInfo, nullptr, &block.buffer);
+                assert(!err);
+                if (err != VK_SUCCESS)
+                {
+                    HT_DEBUG_PRINTF("VKRenderPass::createInstanceBuffer(): Failed to create buffer\n");
+                    return false;
+                }
+
+                if (!VKTools::GetAllocator().AllocateForBuffer(block.buffer, properties, block.allocation, VKMemoryCategory::Uniform))
+                {
+                    HT_DEBUG_PRINTF("VKRenderPass::createInstanceBuffer(): Failed to allocate memory\n");
+                    vkDestroyBuffer(m_device, block.buffer, nullptr);
+                    block.buffer = VK_NULL_HANDLE;
+                    return false;
+                }
+
+                block.descriptor.buffer = block.buffer;
+                block.descriptor.offset = 0;
+                block.descriptor.range = size;
+
+                return true;
+            }
+
+            bool VKRenderPass::recordSecondary(VKCommandPool* commandPool, const DrawChunk& chunk,
+                const FrameVector<VKUploadRange>& instanceRanges, VkCommandBuffer& commandBuffer, RecordStats& stats) const
+            {
+                VkResult err;
+
+                commandBuffer = commandPool->AcquireCommandBuffer(VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+                if (commandBuffer == VK_NULL_HANDLE)
+                    return false;
+
+                //Secondaries execute entirely inside this pass's only subpass
+                VkCommandBufferInheritanceInfo inheritanceInfo = {};
+                inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+                inheritanceInfo.pNext = nullptr;
+                inheritanceInfo.renderPass = m_renderPass;
+                inheritanceInfo.subpass = 0;
+                inheritanceInfo.framebuffer = m_framebuffer;
+                inheritanceInfo.occlusionQueryEnable = VK_FALSE;
+                inheritanceInfo.queryFlags = 0;
+                inheritanceInfo.pipelineStatistics = 0;
+
+                VkCommandBufferBeginInfo beginInfo = {};
+                beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+                beginInfo.pNext = nullptr;
+                beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+                beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+                err = commandPool->BeginCommandBuffer(commandBuffer, beginInfo);
+                assert(!err);
+                if (err != VK_SUCCESS)
+                {
+                    HT_DEBUG_PRINTF("VKRenderPass::recordSecondary(): Failed to begin secondary command buffer.\n");
+                    return false;
+                }
+
+                //Secondaries start with nothing bound
+                VKCommandState state(commandBuffer);
+                recordChunk(state, chunk, instanceRanges);
+                stats = state.GetStats();
+
+                err = commandPool->EndCommandBuffer(commandBuffer);
+                assert(!err);
+                if (err != VK_SUCCESS)
+                {
+                    HT_DEBUG_PRINTF("VKRenderPass::recordSecondary(): Failed to end secondary command buffer.\n");
+                    return false;
+                }
+
+                return true;
+            }
+
+            void VKRenderPass::recordChunk(VKCommandState& state, const DrawChunk& chunk,
+                const FrameVector<VKUploadRange>& instanceRanges) const
+            {
+                //Dynamic state and bindings aren't inherited by secondaries so every chunk sets its own;
+                //chunks recorded inline after one another skip whatever is already set
+                bindPassState(state, *chunk.binding);
+
+                VkPipelineLayout vkPipelineLayout = m_rootLayout->VKGetPipelineLayout();
+
+                const FrameVector<RenderableInstances>& renderables = *chunk.renderables;
+
+                for (size_t i = chunk.first; i < chunk.last; i++)
+                {
+                    const Renderable& renderable = renderables[i].renderable;
+                    uint32_t count = renderables[i].count;
+
+                    VKMaterial* material = static_cast<VKMaterial*>(renderable.material->GetBase());
+                    VKMesh* mesh = static_cast<VKMesh*>(renderable.mesh->GetBase());
+
+                    //Evicted meshes are uploaded again here; the upload is flushed before this frame is submitted
+                    if (!mesh->VKMakeResident())
+                        continue;
+
+                    material->BindMaterial(state, vkPipelineLayout);
+
+                    //Bind instance data at its offset in the upload ring
+                    const VKUploadRange& instanceRange = instanceRanges[renderables[i].instanceIndex];
+                    if (instanceRange.buffer != VK_NULL_HANDLE)
+                        state.BindVertexBuffer(1, instanceRange.buffer, instanceRange.offset);
+
+                    UniformBlock_vk vertBlock = mesh->GetVertexBlock();
+                    UniformBlock_vk indexBlock = mesh->GetIndexBlock();
+                    const MeshRange& range = mesh->GetRange();
+
+                    //Meshes in the same geometry buffers bind them once and draw by range
+                    state.BindVertexBuffer(0, vertBlock.buffer, 0);
+                    state.BindIndexBuffer(indexBlock.buffer, 0, VK_INDEX_TYPE_UINT32);
+
+                    state.DrawIndexed(range.indexCount, count, range.firstIndex, range.vertexOffset, 0);
+                }
+            }
+
+            /** Sets the dynamic state and binds a pipeline with the pass's own descriptor sets
+            * \param state The state of the command buffer being recorded
+            * \param binding The pipeline the next draws use and this pass's uniforms for it
+            */
+            void VKRenderPass::bindPassState(VKCommandState& state, const PipelineBinding& binding) const
+            {
+                VkViewport viewport = {};
+                viewport.width = static_cast<float>(m_width);
+                viewport.height = static_cast<float>(m_height);
+                viewport.minDepth = 0.0f;
+                viewport.maxDepth = 1.0f;
+
+                VkRect2D scissor = {};
+                scissor.extent.width = m_width;
+                scissor.extent.height = m_height;
+                scissor.offset.x = 0;
+                scissor.offset.y = 0;
+
+                state.SetViewport(viewport);
+                state.SetScissor(scissor);
+
+                //Bind sampler set from root layout
+                VkPipelineLayout vkPipelineLayout = m_rootLayout->VKGetPipelineLayout();
+
+                state.BindDescriptorSets(vkPipelineLayout, 0, 1, &m_rootLayout->VKGetSamplerSet());
+
+                binding.pipeline->BindPipeline(state, binding.pushData, binding.pushSize);
+
+                //Bind this pass's copy of the pipeline's uniforms
+                state.BindDescriptorSets(vkPipelineLayout, 1, 1, &binding.uniformSet);
+
+                //Bind input textures
+                if (m_inputTargetDescriptorSets.size() > 0)
+                    state.BindDescriptorSets(vkPipelineLayout, m_firstInputTargetSetIndex,
+                        static_cast<uint32_t>(m_inputTargetDescriptorSets.size()), m_inputTargetDescriptorSets.data());
+            }
+
+            /** Builds the push constants a pipeline is bound with in this frame's arena
+            *
+            * The pipeline's first 128 bytes of shader variables are copied with
+            * the pass's projection and view written over them.
+            *
+            * \param pipeline The pipeline about to be drawn with
+            * \param proj The transposed projection matrix of this pass
+            * \param view The transposed view matrix of this pass
+            * \param binding Given the push constant data and its size
+            * \return False if the frame arena couldn't hold the data
+            */
+            bool VKRenderPass::buildPushConstants(const VKPipeline* pipeline, const Math::Matrix4& proj, const Math::Matrix4& view, PipelineBinding& binding)
+            {
+                const ShaderVariableChunk* variables = pipeline->GetShaderVariables();
+                size_t pushSize = std::min<size_t>(variables->GetSize(), 128);
+
+                //Room for the camera even if the pipeline declares less; only pushSize bytes are pushed
+                BYTE* data = static_cast<BYTE*>(m_frameArena.Allocate(128, 16));
+                if (data == nullptr)
+                    return false;
+                memset(data, 0, 128);
+                memcpy(data, variables->GetByteData(), pushSize);
+
+                //The numbers indicate the byte offset in memory that these values are written to
+                memcpy(data, &proj, sizeof(float) * 16);
+                memcpy(data + 64, &view, sizeof(float) * 16);
+
+                binding.pushData = data;
+                binding.pushSize = static_cast<uint32_t>(pushSize);
+                return true;
+            }
+
+            /** Writes this pass's copy of a pipeline's uniforms for the current frame slot
+            *
+            * Everything past a pipeline's 128 bytes of push constants is copied,
+            * with the pass's inverse view and size written over the start of it.
+            * Only the current slot's copy is written, so frames still in flight
+            * keep reading what they were recorded with.
+            *
+            * \param pipeline The pipeline about to be drawn with
+            * \param invView The transposed inverse of this pass's view matrix
+            * \param uniformSet Set to the descriptor set of the slot's copy
+            * \return True if the uniforms were written
+            */
+            bool VKRenderPass::writePipelineUniforms(VKPipeline* pipeline, const Math::Matrix4& invView, VkDescriptorSet& uniformSet)
+            {
+                const ShaderVariableChunk* variables = pipeline->GetShaderVariables();
+
+                //Whatever doesn't fit in push constants, but never less than the shaders expect
+                size_t variableSize = variables->GetSize();
+                size_t overflow = variableSize > 128 ? variableSize - 128 : 0;
+                size_t size = std::max<size_t>(overflow, 128);
+
+                //A pipeline created where an old one was freed may not be the same size
+                PipelineUniforms& uniforms = m_pipelineUniforms[pipeline];
+                if (uniforms.sets.empty() || uniforms.range.block.descriptor.range != size)
+                {
+                    retirePipelineUniforms(uniforms);
+                    if (!allocatePipelineUniforms(size, uniforms))
+                    {
+                        m_pipelineUniforms.erase(pipeline);
+                        return false;
+                    }
+                }
+                uniforms.lastBuild = m_buildCount;
+
+                BYTE* data = static_cast<BYTE*>(m_frameArena.Allocate(size, 16));
+                if (data == nullptr)
+                    return false;
+                memset(data, 0, size);
+                if (overflow > 0)
+                    memcpy(data, variables->GetByteData() + 128, overflow);
+
+                //The numbers indicate the byte offset from the end of the push constants
+                int32_t width = static_cast<int32_t>(m_width);
+                int32_t height = static_cast<int32_t>(m_height);
+                memcpy(data, &invView, sizeof(float) * 16);
+                memcpy(data + 64, &width, sizeof(int32_t));
+                memcpy(data + 68, &height, sizeof(int32_t));
+
+                if (!VKUniformArena::Write(uniforms.range, 0, data, size))
+                    return false;
+
+                uniformSet = uniforms.sets[VKUniformArena::GetFrame() % uniforms.sets.size()].set;
+                return true;
+            }
+
+            /** Allocates a uniform range with a copy and a descriptor set per frame slot
+            * \param size The size of one copy
+            * \param uniforms Filled in with the range and sets
+            * \return True if everything was allocated
+            */
+            bool VKRenderPass::allocatePipelineUniforms(size_t size, PipelineUniforms& uniforms)
+            {
+                if (!VKUniformArena::Allocate(size, uniforms.range))
+                {
+                    HT_ERROR_PRINTF("VKRenderPass::allocatePipelineUniforms(): Failed to allocate uniform range\n");
+                    return false;
+                }
+
+                VkDescriptorSetLayout layout = m_rootLayout->VKGetDescriptorSetLayouts()[1];
+
+                uniforms.sets.resize(uniforms.range.copies);
+                for (uint32_t f = 0; f < uniforms.range.copies; f++)
+                {
+                    if (!VKDescriptorAllocator::Allocate(layout, uniforms.sets[f]))
+                    {
+                        HT_ERROR_PRINTF("VKRenderPass::allocatePipelineUniforms(): Failed to allocate descriptor set\n");
+                        uniforms.sets.resize(f);
+                        retirePipelineUniforms(uniforms);
+                        return false;
+                    }
+
+                    VkDescriptorBufferInfo descriptor = VKUniformArena::GetDescriptor(uniforms.range, f);
+
+                    VkWriteDescriptorSet uniformVSWrite = {};
+                    uniformVSWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                    uniformVSWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+                    uniformVSWrite.dstSet = uniforms.sets[f].set;
+                    uniformVSWrite.dstBinding = 0;
+                    uniformVSWrite.pBufferInfo = &descriptor;
+                    uniformVSWrite.descriptorCount = 1;
+
+                    vkUpdateDescriptorSets(m_device, 1, &uniformVSWrite, 0, nullptr);
+                }
+
+                //Retained recordings bound the sets this replaces
+                for (size_t i = 0; i < m_retainedSlots.size(); i++)
+                    m_retainedSlots[i].recorded = false;
+
+                return true;
+            }
+
+            /** Hands a pipeline's uniform range and sets back once no frame in flight reads them
+            * \param uniforms The uniforms to retire; left empty
+            */
+            void VKRenderPass::retirePipelineUniforms(PipelineUniforms& uniforms)
+            {
+                for (size_t i = 0; i < uniforms.sets.size(); i++)
+                    VKDescriptorAllocator::Retire(uniforms.sets[i]);
+                uniforms.sets.clear();
+
+                if (uniforms.range.block.buffer != VK_NULL_HANDLE)
+                {
+                    VKUniformRange range = uniforms.range;
+                    VKDeletionQueue::RetireCallback([range]() mutable
+                    {
+                        VKUniformArena::Free(range);
+                    });
+                }
+                uniforms.range = {};
+            }
+
+            ///Retires the uniforms of pipelines the pass hasn't drawn with since every frame slot came around
+            void VKRenderPass::prunePipelineUniforms()
+            {
+                if (m_pipelineUniforms.size() <= m_pipelineList.size())
+                    return;
+
+                const uint64_t frameCount = m_swapchain->GetFrameCount();
+                for (auto it = m_pipelineUniforms.begin(); it != m_pipelineUniforms.end();)
+                {
+                    if (m_buildCount - it->second.lastBuild > frameCount)
+                    {
+                        retirePipelineUniforms(it->second);
+                        it = m_pipelineUniforms.erase(it);
+                    }
+                    else
+                        it++;
+                }
+            }
+
+            /** Checks that this frame's instance data can be copied about by the culling shader
+            *
+            * The shader copies whole words, and every draw under a pipeline
+            * reads its instances from one binding, so instance data has to be
+            * a multiple of four bytes and the same size throughout a pipeline.
+            *
+            * \return True if the frame can be culled and drawn indirectly
+            */
+            bool VKRenderPass::canDrawIndirect() const
+            {
+                for (size_t p = 0; p < m_pipelineList.size(); p++)
+                {
+                    const FrameVector<RenderableInstances>& renderables = m_pipelineList[p].renderables;
+
+                    size_t stride = 0;
+                    for (size_t r = 0; r < renderables.size(); r++)
+                    {
+                        const FrameVector<ShaderVariableChunk*>& instanceChunks = m_instanceData[renderables[r].instanceIndex].chunks;
+
+                        size_t chunkSize = instanceChunks[0]->GetSize();
+                        if (chunkSize == 0 || chunkSize % 4 != 0 || (stride != 0 && chunkSize != stride))
+                            return false;
+
+                        stride = chunkSize;
+                    }
+                }
+
+                return true;
+            }
+
+            /** Records this frame with every instance culled on the GPU
+            *
+            * Retained instances stay in m_resident from frame to frame; only
+            * the ones whose version changed are staged in the upload ring and
+            * copied over. Scheduled instances only live for this frame, so
+            * their instance data and VKCullObjects are written into this
+            * frame's slice of the ring, along with one draw per material and
+            * mesh and the table saying where each draw's instances go. Two
+            * dispatches, one over the resident set and one over the
+            * scheduled instances, pack what's visible into the slot's output
+            * buffer, a region per pipeline, and set each draw's instance count.
+            *
+            * \param commandPool This frame's pool for the recording thread
+            * \param frame The frame slot being built
+            * \param bindings How each pipeline in m_pipelineList is bound this frame
+            * \return True if the frame was recorded
+            */
+            bool VKRenderPass::buildIndirect(VKCommandPool* commandPool, uint32_t frame, const FrameVector<PipelineBinding>& bindings)
+            {
+                VkCommandBuffer commandBuffer = commandPool->AcquireCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+                if (commandBuffer == VK_NULL_HANDLE)
+                {
+                    HT_DEBUG_PRINTF("VKRenderPass::buildIndirect(): Failed to acquire command buffer.\n");
+                    return false;
+                }
+                m_commandBuffers[frame] = commandBuffer;
+
+                IndirectDraws draws = { VKCullDispatch(), VKCullDispatch(), FrameVector<VkDeviceSize>(FrameAllocator<VkDeviceSize>(&m_frameArena)),
+                    Frustum(m_view, m_proj), bindings.data(),
+                    VK_NULL_HANDLE, FrameVector<VkBufferCopy>(FrameAllocator<VkBufferCopy>(&m_frameArena)),
+                    VK_NULL_HANDLE, FrameVector<VkBufferCopy>(FrameAllocator<VkBufferCopy>(&m_frameArena)) };
+                VKCullDispatch& dispatch = draws.cull;
+
+                //Sized up front so every buffer is allocated once
+                uint32_t commandCount = 0;
+                uint32_t residentCount = 0;
+                VkDeviceSize residentBytes = 0;
+                VkDeviceSize instanceBytes = 0;
+                VkDeviceSize outputBytes = 0;
+                for (size_t p = 0; p < m_pipelineList.size(); p++)
+                {
+                    outputBytes = (outputBytes + 15) & ~static_cast<VkDeviceSize>(15);
+                    draws.pipelineOffsets.push_back(outputBytes);
+
+                    const FrameVector<RenderableInstances>& renderables = m_pipelineList[p].renderables;
+                    for (size_t r = 0; r < renderables.size(); r++)
+                    {
+                        const MeshInstanceData& instanceData = m_instanceData[renderables[r].instanceIndex];
+                        VkDeviceSize stride = instanceData.chunks[0]->GetSize();
+
+                        for (size_t i = 0; i < instanceData.versions.size(); i++)
+                        {
+                            if (instanceData.versions[i] != 0)
+                            {
+                                residentCount++;
+                                residentBytes += stride;
+                            }
+                            else
+                            {
+                                dispatch.objectCount++;
+                                instanceBytes += stride;
+                            }
+                        }
+
+                        outputBytes += stride * instanceData.chunks.size();
+                        commandCount++;
+                    }
+                }
+
+                if (!stageResident(draws, residentCount, residentBytes))
+                    return false;
+
+                //Resident draws come first in the table, so VKCullObjects kept from earlier frames still index it right
+                uint32_t residentDraws = static_cast<uint32_t>(m_resident.drawSizes.size());
+
+                if (residentCount > 0 || dispatch.objectCount > 0)
+                {
+                    VKUploadRing* uploadRing = m_swapchain->GetUploadRing();
+                    if (!uploadRing->Allocate((residentDraws + commandCount) * sizeof(VKCullDraw), VKIndirectCuller::Alignment, dispatch.draws) ||
+                        !uploadRing->Allocate(commandCount * sizeof(VkDrawIndexedIndirectCommand), VKIndirectCuller::Alignment, dispatch.commands))
+                        return false;
+
+                    if (dispatch.objectCount > 0 &&
+                        (!uploadRing->Allocate(dispatch.objectCount * sizeof(VKCullObject), VKIndirectCuller::Alignment, dispatch.objects) ||
+                        !uploadRing->Allocate(instanceBytes, VKIndirectCuller::Alignment, dispatch.instances)))
+                        return false;
+
+                    IndirectSlot& slot = m_indirectSlots[frame];
+                    if (outputBytes > slot.outputCapacity)
+                    {
+                        VkDeviceSize capacity = slot.outputCapacity > 0 ? slot.outputCapacity : 4096;
+                        while (capacity < outputBytes)
+                            capacity *= 2;
+
+                        //Only ever written and read by the GPU
+                        UniformBlock_vk block = {};
+                        if (!createInstanceBuffer(capacity, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, block))
+                            return false;
+
+                        if (slot.outputBlock.buffer != VK_NULL_HANDLE)
+                            VKDeletionQueue::RetireBuffer(slot.outputBlock);
+
+                        slot.outputBlock = block;
+                        slot.outputCapacity = capacity;
+                    }
+
+                    dispatch.output = slot.outputBlock.buffer;
+                    dispatch.outputSize = slot.outputCapacity;
+                }
+
+                draws.resident.draws = dispatch.draws;
+                draws.resident.commands = dispatch.commands;
+                draws.resident.output = dispatch.output;
+                draws.resident.outputSize = dispatch.outputSize;
+
+                VKCullDraw* drawTable = static_cast<VKCullDraw*>(dispatch.draws.mapped);
+                VKCullObject* objects = static_cast<VKCullObject*>(dispatch.objects.mapped);
+                BYTE* instances = static_cast<BYTE*>(dispatch.instances.mapped);
+                VkDrawIndexedIndirectCommand* commands = static_cast<VkDrawIndexedIndirectCommand*>(dispatch.commands.mapped);
+
+                uint32_t object = 0;
+                uint32_t command = 0;
+                uint32_t residentDraw = 0;
+                VkDeviceSize source = 0;
+                for (size_t p = 0; p < m_pipelineList.size(); p++)
+                {
+                    const FrameVector<RenderableInstances>& renderables = m_pipelineList[p].renderables;
+
+                    //Instances of every draw under a pipeline sit one draw after another
+                    uint32_t firstInstance = 0;
+                    for (size_t r = 0; r < renderables.size(); r++, command++)
+                    {
+                        const MeshInstanceData& instanceData = m_instanceData[renderables[r].instanceIndex];
+                        VKMesh* mesh = static_cast<VKMesh*>(renderables[r].renderable.mesh->GetBase());
+
+                        uint32_t stride = static_cast<uint32_t>(instanceData.chunks[0]->GetSize());
+                        VkDeviceSize destination = draws.pipelineOffsets[p] + static_cast<VkDeviceSize>(firstInstance) * stride;
+
+                        //Evicted meshes are uploaded again here; one that can't be draws nothing
+                        VkDrawIndexedIndirectCommand& drawCommand = commands[command];
+                        bool resident = mesh->VKMakeResident();
+                        const MeshRange& range = mesh->GetRange();
+                        drawCommand.indexCount = resident ? range.indexCount : 0;
+                        drawCommand.instanceCount = 0;
+                        drawCommand.firstIndex = resident ? range.firstIndex : 0;
+                        drawCommand.vertexOffset = resident ? range.vertexOffset : 0;
+                        drawCommand.firstInstance = firstInstance;
+
+                        VKCullDraw target = { command, static_cast<uint32_t>(destination / 4) };
+                        drawTable[residentDraws + command] = target;
+
+                        bool hasRetained = false;
+                        for (size_t i = 0; i < instanceData.chunks.size(); i++)
+                        {
+                            if (instanceData.versions[i] != 0)
+                            {
+                                hasRetained = true;
+                                continue;
+                            }
+
+                            memcpy(instances + source, instanceData.chunks[i]->GetByteData(), stride);
+
+                            const BoundingSphere& bounds = instanceData.bounds[i];
+
+                            VKCullObject& cullObject = objects[object++];
+                            cullObject.sphere[0] = bounds.x;
+                            cullObject.sphere[1] = bounds.y;
+                            cullObject.sphere[2] = bounds.z;
+                            cullObject.sphere[3] = bounds.radius;
+                            cullObject.draw = residentDraws + command;
+                            cullObject.sourceWord = static_cast<uint32_t>(source / 4);
+                            cullObject.strideWords = stride / 4;
+                            cullObject.padding = 0;
+
+                            source += stride;
+                        }
+
+                        //Retained instances of this draw land in the same place as its scheduled ones
+                        if (hasRetained)
+                            drawTable[residentDraw++] = target;
+
+                        firstInstance += renderables[r].count;
+                    }
+                }
+
+                //Recorded inline; the draws are few however many instances there are
+                FrameVector<DrawChunk> chunks(FrameAllocator<DrawChunk>(&m_frameArena));
+                FrameVector<VKUploadRange> instanceRanges(FrameAllocator<VKUploadRange>(&m_frameArena));
+                FrameVector<VkCommandBuffer> secondaryBuffers(FrameAllocator<VkCommandBuffer>(&m_frameArena));
+
+                if (!recordPrimary(commandPool, commandBuffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, chunks, instanceRanges, secondaryBuffers, &draws))
+                    return false;
+
+                //The copies that bring the resident set up to date are recorded; it can be trusted again
+                m_resident.listVersion = m_retainedListVersion;
+                return true;
+            }
+
+            /** Stages the retained instances that changed since m_resident was last written
+            *
+            * Retained instances sit in m_resident in m_retainedKeys order, so
+            * where their instance data goes only moves with the retained list.
+            * Which draw an instance falls in can also move when scheduled
+            * requests split or join draws; resident draw k is the k-th draw
+            * this frame holding retained instances. Only instances whose
+            * version differs from the one written are staged, along with
+            * every VKCullObject when the draws moved. Everything is written
+            * again when the list changed or the buffers had to grow.
+            *
+            * m_resident is left marked for a full rewrite; buildIndirect
+            * clears the mark once the copies are recorded.
+            *
+            * \param draws This frame's draws; receives the copies and the resident dispatch
+            * \param residentCount Retained instances this frame
+            * \param residentBytes Size of their instance data
+            * \return True unless a buffer couldn't be made or staging space allocated
+            */
+            bool VKRenderPass::stageResident(IndirectDraws& draws, uint32_t residentCount, VkDeviceSize residentBytes)
+            {
+                ResidentCullSet& resident = m_resident;
+
+                bool rewrite = resident.listVersion != m_retainedListVersion || resident.writtenVersions.size() != residentCount;
+
+                FrameVector<uint32_t> drawSizes(FrameAllocator<uint32_t>(&m_frameArena));
+                for (size_t m = 0; m < m_instanceData.size(); m++)
+                {
+                    const FrameVector<uint64_t>& versions = m_instanceData[m].versions;
+
+                    uint32_t retained = static_cast<uint32_t>(versions.size() - std::count(versions.begin(), versions.end(), 0));
+                    if (retained > 0)
+                        drawSizes.push_back(retained);
+                }
+
+                //Only the GPU reads them; they're filled with copies out of the upload ring
+                auto grow = [this, &rewrite](VkDeviceSize size, UniformBlock_vk& block, VkDeviceSize& blockCapacity) -> bool
+                {
+                    if (size <= blockCapacity)
+                        return true;
+
+                    VkDeviceSize capacity = blockCapacity > 0 ? blockCapacity : 4096;
+                    while (capacity < size)
+                        capacity *= 2;
+
+                    UniformBlock_vk newBlock = {};
+                    if (!createInstanceBuffer(capacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, newBlock))
+                        return false;
+
+                    //Earlier frames may still be culling out of the old one
+                    if (block.buffer != VK_NULL_HANDLE)
+                        VKDeletionQueue::RetireBuffer(block);
+
+                    block = newBlock;
+                    blockCapacity = capacity;
+                    rewrite = true;
+                    return true;
+                };
+
+                //Marked first so nothing half written is ever trusted
+                resident.listVersion = 0;
+
+                if (!grow(residentCount * sizeof(VKCullObject), resident.objectBlock, resident.objectCapacity) ||
+                    !grow(residentBytes, resident.instanceBlock, resident.instanceCapacity))
+                    return false;
+
+                bool redraw = rewrite || drawSizes.size() != resident.drawSizes.size() ||
+                    !std::equal(drawSizes.begin(), drawSizes.end(), resident.drawSizes.begin());
+
+                if (rewrite)
+                    resident.writtenVersions.assign(residentCount, 0);
+                if (redraw)
+                    resident.drawSizes.assign(drawSizes.begin(), drawSizes.end());
+
+                //Sized up front so staging is allocated once
+                uint32_t stagedObjects = 0;
+                VkDeviceSize stagedBytes = 0;
+                size_t position = 0;
+                for (size_t m = 0; m < m_instanceData.size(); m++)
+                {
+                    const MeshInstanceData& instanceData = m_instanceData[m];
+                    for (size_t i = 0; i < instanceData.versions.size(); i++)
+                    {
+                        if (instanceData.versions[i] == 0)
+                            continue;
+
+                        bool changed = resident.writtenVersions[position++] != instanceData.versions[i];
+                        if (changed)
+                            stagedBytes += instanceData.chunks[i]->GetSize();
+                        if (changed || redraw)
+                            stagedObjects++;
+                    }
+                }
+
+                VKUploadRange objectStaging = {};
+                VKUploadRange instanceStaging = {};
+                VKUploadRing* uploadRing = m_swapchain->GetUploadRing();
+                if (stagedObjects > 0 && !uploadRing->Allocate(stagedObjects * sizeof(VKCullObject), VKIndirectCuller::Alignment, objectStaging))
+                    return false;
+                if (stagedBytes > 0 && !uploadRing->Allocate(stagedBytes, VKIndirectCuller::Alignment, instanceStaging))
+                    return false;
+
+                draws.objectSource = objectStaging.buffer;
+                draws.instanceSource = instanceStaging.buffer;
+
+                //Neighbouring instances usually change together, so copies that run on are merged
+                auto addCopy = [](FrameVector<VkBufferCopy>& copies, VkDeviceSize source, VkDeviceSize destination, VkDeviceSize size)
+                {
+                    if (!copies.empty())
+                    {
+                        VkBufferCopy& last = copies.back();
+                        if (last.srcOffset + last.size == source && last.dstOffset + last.size == destination)
+                        {
+                            last.size += size;
+                            return;
+                        }
+                    }
+
+                    copies.push_back({ source, destination, size });
+                };
+
+                VKCullObject* objects = static_cast<VKCullObject*>(objectStaging.mapped);
+                BYTE* instances = static_cast<BYTE*>(instanceStaging.mapped);
+
+                uint32_t object = 0;
+                VkDeviceSize staged = 0;
+                VkDeviceSize source = 0;
+                uint32_t draw = 0;
+                position = 0;
+                for (size_t m = 0; m < m_instanceData.size(); m++)
+                {
+                    const MeshInstanceData& instanceData = m_instanceData[m];
+                    if (instanceData.chunks.empty())
+                        continue;
+
+                    uint32_t stride = static_cast<uint32_t>(instanceData.chunks[0]->GetSize());
+
+                    bool hasRetained = false;
+                    for (size_t i = 0; i < instanceData.versions.size(); i++)
+                    {
+                        uint64_t version = instanceData.versions[i];
+                        if (version == 0)
+                            continue;
+
+                        hasRetained = true;
+
+                        bool changed = resident.writtenVersions[position] != version;
+                        if (changed)
+                        {
+                            memcpy(instances + staged, instanceData.chunks[i]->GetByteData(), stride);
+                            addCopy(draws.instanceCopies, instanceStaging.offset + staged, source, stride);
+                            staged += stride;
+
+                            resident.writtenVersions[position] = version;
+                        }
+
+                        if (changed || redraw)
+                        {
+                            const BoundingSphere& bounds = instanceData.bounds[i];
+
+                            VKCullObject& cullObject = objects[object];
+                            cullObject.sphere[0] = bounds.x;
+                            cullObject.sphere[1] = bounds.y;
+                            cullObject.sphere[2] = bounds.z;
+                            cullObject.sphere[3] = bounds.radius;
+                            cullObject.draw = draw;
+                            cullObject.sourceWord = static_cast<uint32_t>(source / 4);
+                            cullObject.strideWords = stride / 4;
+                            cullObject.padding = 0;
+
+                            addCopy(draws.objectCopies, objectStaging.offset + object * sizeof(VKCullObject),
+                                position * sizeof(VKCullObject), sizeof(VKCullObject));
+                            object++;
+                        }
+
+                        position++;
+                        source += stride;
+                    }
+
+                    if (hasRetained)
+                        draw++;
+                }
+
+                VKCullDispatch& dispatch = draws.resident;
+                dispatch.objects = { resident.objectBlock.buffer, 0, residentCount * sizeof(VKCullObject), nullptr };
+                dispatch.objectCount = residentCount;
+                dispatch.instances = { resident.instanceBlock.buffer, 0, residentBytes, nullptr };
+
+                return true;
+            }
+
+            /** Records the copies stageResident staged into m_resident
+            *
+            * \param commandBuffer The frame's primary command buffer, ahead of the culling dispatches
+            * \param draws This frame's draws
+            */
+            void VKRenderPass::recordResidentCopies(VkCommandBuffer commandBuffer, const IndirectDraws& draws) const
+            {
+                if (draws.objectCopies.empty() && draws.instanceCopies.empty())
+                    return;
+
+                //Earlier frames may still be culling out of what's about to be overwritten
+                VkMemoryBarrier barrier = {};
+                barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+                barrier.pNext = nullptr;
+                barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+                barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+                vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                    0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+                if (!draws.objectCopies.empty())
+                    vkCmdCopyBuffer(commandBuffer, draws.objectSource, m_resident.objectBlock.buffer,
+                        static_cast<uint32_t>(draws.objectCopies.size()), draws.objectCopies.data());
+                if (!draws.instanceCopies.empty())
+                    vkCmdCopyBuffer(commandBuffer, draws.instanceSource, m_resident.instanceBlock.buffer,
+                        static_cast<uint32_t>(draws.instanceCopies.size()), draws.instanceCopies.data());
+
+                //And this frame's culling reads what was copied
+                barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+                vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                    0, 1, &barrier, 0, nullptr, 0, nullptr);
+            }
+
+            /** Records the indirect draws of a GPU driven frame
+            *
+            * With multi-draw, draws after one another that share a material
+            * and geometry buffers go in one call, whichever meshes they draw.
+            * Otherwise every draw is its own.
+            *
+            * \param state The state of the command buffer being recorded
+            * \param draws What buildIndirect wrote for this frame
+            */
+            void VKRenderPass::recordIndirect(VKCommandState& state, const IndirectDraws& draws) const
+            {
+                VkPipelineLayout vkPipelineLayout = m_rootLayout->VKGetPipelineLayout();
+
+                const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+                const bool multiDraw = VKIndirectCuller::SupportsMultiDraw();
+
+                uint32_t command = 0;
+                for (size_t p = 0; p < m_pipelineList.size(); p++)
+                {
+                    const FrameVector<RenderableInstances>& renderables = m_pipelineList[p].renderables;
+
+                    bindPassState(state, draws.bindings[p]);
+
+                    //Every draw's firstInstance counts from the start of its pipeline's region
+                    state.BindVertexBuffer(1, draws.cull.output, draws.pipelineOffsets[p]);
+
+                    size_t r = 0;
+                    while (r < renderables.size())
+                    {
+                        VKMaterial* material = static_cast<VKMaterial*>(renderables[r].renderable.material->GetBase());
+                        VKMesh* mesh = static_cast<VKMesh*>(renderables[r].renderable.mesh->GetBase());
+
+                        //Already made resident when the draw was written; this only fails if that did
+                        if (!mesh->VKMakeResident())
+                        {
+                            r++;
+                            command++;
+                            continue;
+                        }
+
+                        UniformBlock_vk vertBlock = mesh->GetVertexBlock();
+                        UniformBlock_vk indexBlock = mesh->GetIndexBlock();
+
+                        //Draws that would bind exactly the same things ride along in one call
+                        uint32_t run = 1;
+                        while (multiDraw && r + run < renderables.size())
+                        {
+                            const Renderable& next = renderables[r + run].renderable;
+                            if (next.material->GetBase() != material)
+                                break;
+
+                            VKMesh* nextMesh = static_cast<VKMesh*>(next.mesh->GetBase());
+                            if (!nextMesh->VKMakeResident())
+                                break;
+
+                            UniformBlock_vk nextVertBlock = nextMesh->GetVertexBlock();
+                            UniformBlock_vk nextIndexBlock = nextMesh->GetIndexBlock();
+                            if (nextVertBlock.buffer != vertBlock.buffer || nextIndexBlock.buffer != indexBlock.buffer)
+                                break;
+
+                            run++;
+                        }
+
+                        material->BindMaterial(state, vkPipelineLayout);
+
+                        state.BindVertexBuffer(0, vertBlock.buffer, 0);
+                        state.BindIndexBuffer(indexBlock.buffer, 0, VK_INDEX_TYPE_UINT32);
+
+                        state.DrawIndexedIndirect(draws.cull.commands.buffer, draws.cull.commands.offset + static_cast<VkDeviceSize>(command) * stride, run, stride);
+
+                        r += run;
+                        command += run;
+                    }
+                }
+            }
+
+            bool VKRenderPass::setupDescriptorSets(std::map<uint32_t, std::map<uint32_t, VKRenderTarget*>> inputTargets)
+            {
+                if (inputTargets.size() <= 0)
+                    return true;
+
                 //Get the root layout so that we can determine which set layouts we'll need
                 std::vector<VkDescriptorSetLayout> allDescriptorSetLayouts = m_rootLayout->VKGetDescriptorSetLayouts();
 
@@ -711,20 +1876,18 @@ namespace Hatchit {
                     }
                 }
 
-                //Allocate space for every descriptor set at once; each entry in the top level map (inputTargets) is a set
-                VkDescriptorSetAllocateInfo allocInfo = {};
-                allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-                allocInfo.descriptorPool = m_descriptorPool;
-                allocInfo.descriptorSetCount = static_cast<uint32_t>(inputTargets.size());
-                allocInfo.pSetLayouts = usedDescriptorSetLayouts.data();
-
+                //Each entry in the top level map (inputTargets) is a set
+                m_inputTargetAllocations.resize(inputTargets.size());
                 m_inputTargetDescriptorSets.resize(inputTargets.size());
-                err = vkAllocateDescriptorSets(m_device, &allocInfo, m_inputTargetDescriptorSets.data());
-                assert(!err);
-                if (err != VK_SUCCESS)
+                for (size_t i = 0; i < usedDescriptorSetLayouts.size(); i++)
                 {
-                    HT_ERROR_PRINTF("VKRenderPass::setupDescriptorSets(): Failed to allocate descriptor set\n");
-                    return false;
+                    if (!VKDescriptorAllocator::Allocate(usedDescriptorSetLayouts[i], m_inputTargetAllocations[i]))
+                    {
+                        HT_ERROR_PRINTF("VKRenderPass::setupDescriptorSets(): Failed to allocate descriptor set\n");
+                        return false;
+                    }
+
+                    m_inputTargetDescriptorSets[i] = m_inputTargetAllocations[i].set;
                 }
 
                 //Setup descriptor set writes
@@ -25,6 +25,7 @@
 #include <ht_vkrendertarget.h>
 #include <ht_vkswapchain.h>
 #include <ht_vktools.h>
+#include <ht_vkdeletionqueue.h>
 
 namespace Hatchit {
 
@@ -46,11 +47,8 @@ namespace Hatchit {
                 if (m_clearColor != nullptr)
                     delete m_clearColor;
 
-                vkFreeMemory(m_device, m_texture.image.memory, nullptr);
-                vkDestroyImage(m_device, m_texture.image.image, nullptr);
-                vkDestroyImageView(m_device, m_texture.image.view, nullptr);
-
-                vkDestroySampler(m_device, m_texture.sampler, nullptr);
+                VKDeletionQueue::RetireImage(m_texture.image);
+                VKDeletionQueue::RetireSampler(m_texture.sampler);
             }
             
             bool VKRenderTarget::Initialize(const Resource::RenderTargetHandle& handle, const VkDevice& device, const VkPhysicalDevice& gpu, const VKSwapChain* swapchain)
@@ -205,11 +203,6 @@ namespace Hatchit {
                 imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
                 imageCreateInfo.flags = 0;
 
-                VkMemoryAllocateInfo memAllocInfo = {};
-                memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-                
-                VkMemoryRequirements memReqs;
-
                 err = vkCreateImage(m_device, &imageCreateInfo, nullptr, &m_texture.image.image);
                 assert(!err);
                 if (err != VK_SUCCESS)
@@ -218,34 +211,12 @@ namespace Hatchit {
                     return false;
                 }
 
-                vkGetImageMemoryRequirements(m_device, m_texture.image.image, &memReqs);
-                memAllocInfo.allocationSize = memReqs.size;
-
-                bool success = VKTools::MemoryTypeFromProperties(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memAllocInfo.memoryTypeIndex);
-                assert(success);
-                if (!success)
-                {
-                    HT_DEBUG_PRINTF("VKTexture::VBufferImage(): Failed to find memory properties!\n");
-                    return false;
-                }
-
-
-                err = vkAllocateMemory(m_device, &memAllocInfo, nullptr, &m_texture.image.memory);
-                assert(!err);
-                if (err != VK_SUCCESS)
+                if (!VKTools::GetAllocator().AllocateForImage(m_texture.image.image, false, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_texture.image.allocation, VKMemoryCategory::Attachment))
                 {
                     HT_DEBUG_PRINTF("VKRenderTarget::setupTargetTexture(): Error allocating target texture image memory!\n");
                     return false;
                 }
 
-                err = vkBindImageMemory(m_device, m_texture.image.image, m_texture.image.memory, 0);
-                assert(!err);
-                if (err != VK_SUCCESS)
-                {
-                    HT_DEBUG_PRINTF("VKRenderTarget::setupTargetTexture(): Error binding target texture image memory!\n");
-                    return false;
-                }
-
                 m_texture.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
                 VKTools::SetImageLayout(setupCommandBuffer, m_texture.image.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, m_texture.layout);
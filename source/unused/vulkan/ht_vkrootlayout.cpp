@@ -14,6 +14,7 @@
 
 #include <ht_vkrootlayout.h>
 #include <ht_vksampler.h>
+#include <ht_vkdescriptorallocator.h>
 #include <ht_rootlayout_resource.h>
 
 namespace Hatchit
@@ -27,13 +28,16 @@ namespace Hatchit
                 m_device = VK_NULL_HANDLE;
 
                 m_pipelineLayout = VK_NULL_HANDLE;
-                m_samplerSet = VK_NULL_HANDLE;
+                m_samplerSet = {};
             }
 
             VKRootLayout::~VKRootLayout() 
             {
                 if (m_device != VK_NULL_HANDLE)
                 {
+                    //Frames in flight may still have it bound
+                    VKDescriptorAllocator::Retire(m_samplerSet);
+
                     //Destroy samplers
                     for (size_t i = 0; i < m_samplers.size(); i++)
                         delete m_samplers[i];
@@ -51,7 +55,7 @@ namespace Hatchit
                 }
             }
 
-            bool VKRootLayout::Initialize(const Resource::RootLayoutHandle& handle, const VkDevice& device, const VkDescriptorPool& descriptorPool)
+            bool VKRootLayout::Initialize(const Resource::RootLayoutHandle& handle, const VkDevice& device)
             {
                 using namespace Resource;
 
@@ -108,6 +112,7 @@ namespace Hatchit
                 }
 
                 m_descriptorSetLayouts.push_back(immutableSamplersSetLayout);
+                VKDescriptorAllocator::RegisterLayout(immutableSamplersSetLayout, immutableBindings);
 
                 //Parse layout parameters
                 std::vector<RootLayout::Parameter> parameters = handle->GetParameters();
@@ -212,6 +217,7 @@ namespace Hatchit
                             }
 
                             m_descriptorSetLayouts.push_back(descriptorSetLayout);
+                            VKDescriptorAllocator::RegisterLayout(descriptorSetLayout, descriptorSetLayoutBindings);
                         } 
                         break;
 
@@ -257,7 +263,7 @@ namespace Hatchit
                     return false;
                 }
 
-                if (!setupSamplerSet(device, descriptorPool))
+                if (!setupSamplerSet(device))
                 {
                     HT_ERROR_PRINTF("VKRootLayout::Initialize(): Could not create sampler descriptor set!\n");
                     return false;
@@ -267,24 +273,13 @@ namespace Hatchit
             }
 
             const VkPipelineLayout& VKRootLayout::VKGetPipelineLayout() const { return m_pipelineLayout; }
-            const VkDescriptorSet& VKRootLayout::VKGetSamplerSet() const { return m_samplerSet; }
+            const VkDescriptorSet& VKRootLayout::VKGetSamplerSet() const { return m_samplerSet.set; }
             std::vector<VkDescriptorSetLayout> VKRootLayout::VKGetDescriptorSetLayouts() const { return m_descriptorSetLayouts; }
             std::vector<VkPushConstantRange> VKRootLayout::VKGetPushConstantRanges() const { return m_pushConstantRanges;  }
 
-            bool VKRootLayout::setupSamplerSet(const VkDevice& device, const VkDescriptorPool& descriptorPool) 
+            bool VKRootLayout::setupSamplerSet(const VkDevice& device) 
             {
-                VkResult err;
-
-                VkDescriptorSetAllocateInfo allocInfo = {};
-                allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-                allocInfo.pNext = nullptr;
-                allocInfo.descriptorPool = descriptorPool;
-                allocInfo.descriptorSetCount = 1;
-                allocInfo.pSetLayouts = &m_descriptorSetLayouts[0];
-
-                err = vkAllocateDescriptorSets(device, &allocInfo, &m_samplerSet);
-                assert(!err);
-                if (err != VK_SUCCESS)
+                if (!VKDescriptorAllocator::Allocate(m_descriptorSetLayouts[0], m_samplerSet))
                     return false;
 
                 std::vector<VkDescriptorImageInfo> samplerInfo;
@@ -301,7 +296,7 @@ namespace Hatchit
                 write.descriptorCount = static_cast<uint32_t>(samplerInfo.size());
                 write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
                 write.pImageInfo = samplerInfo.data();
-                write.dstSet = m_samplerSet;
+                write.dstSet = m_samplerSet.set;
                 write.dstBinding = 0;
                 
                 vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
@@ -0,0 +1,678 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+#include <ht_vkstaginguploader.h>
+#include <ht_vktools.h>
+#include <ht_debug.h>
+#include <algorithm>    //std::min, std::max
+#include <cassert>
+#include <cstring>      //memcpy
+
+namespace Hatchit {
+
+    namespace Graphics {
+
+        namespace Vulkan {
+
+            //Keeps every staging offset valid for vkCmdCopyBuffer and vkCmdCopyBufferToImage
+            static const VkDeviceSize StagingAlignment = 16;
+
+            VkDevice                                VKStagingUploader::m_device = VK_NULL_HANDLE;
+            VKTimeline*                             VKStagingUploader::m_timeline = nullptr;
+            VKTimeline*                             VKStagingUploader::m_graphicsTimeline = nullptr;
+            bool                                    VKStagingUploader::m_dedicated = false;
+            VkCommandPool                           VKStagingUploader::m_commandPool = VK_NULL_HANDLE;
+            VkCommandPool                           VKStagingUploader::m_graphicsCommandPool = VK_NULL_HANDLE;
+            UniformBlock_vk                         VKStagingUploader::m_staging = {};
+            VkDeviceSize                            VKStagingUploader::m_stagingSize = 0;
+            uint64_t                                VKStagingUploader::m_head = 0;
+            uint64_t                                VKStagingUploader::m_tail = 0;
+            std::mutex                              VKStagingUploader::m_mutex;
+            std::vector<VKStagingUploader::Copy>    VKStagingUploader::m_copies;
+            std::vector<VKStagingUploader::ImageCopy>       VKStagingUploader::m_imageCopies;
+            std::vector<VKStagingUploader::PendingImage>    VKStagingUploader::m_images;
+            std::deque<VKStagingUploader::Batch>    VKStagingUploader::m_batches;
+            uint64_t                                VKStagingUploader::m_lastValue = 0;
+            VKStagingStats                          VKStagingUploader::m_stats = {};
+
+            /** Creates the staging ring and the command pools copies are recorded from
+            * \param device The device to upload to
+            * \param copyQueue The queue copies are submitted to
+            * \param graphicsQueue The queue that reads the uploaded buffers
+            * \param stagingSize The size of the staging ring
+            * \return True if the ring and pool were created
+            */
+            bool VKStagingUploader::Initialize(const VkDevice& device, VKQueue* copyQueue, VKQueue* graphicsQueue,
+                VkDeviceSize stagingSize)
+            {
+                if (copyQueue == nullptr || graphicsQueue == nullptr)
+                {
+                    HT_ERROR_PRINTF("VKStagingUploader::Initialize: Must be given valid queues\n");
+                    return false;
+                }
+
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                VkResult err;
+
+                m_device = device;
+                m_timeline = &copyQueue->GetTimeline();
+                m_graphicsTimeline = &graphicsQueue->GetTimeline();
+                m_dedicated = copyQueue != graphicsQueue;
+                m_stagingSize = stagingSize;
+                m_head = 0;
+                m_tail = 0;
+                m_lastValue = 0;
+                m_stats = {};
+                m_stats.stagingSize = stagingSize;
+
+                VkCommandPoolCreateInfo commandPoolInfo = {};
+                commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+                commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+                commandPoolInfo.queueFamilyIndex = copyQueue->GetVKQueueFamily();
+
+                err = vkCreateCommandPool(m_device, &commandPoolInfo, nullptr, &m_commandPool);
+                assert(!err);
+                if (err != VK_SUCCESS)
+                {
+                    HT_ERROR_PRINTF("VKStagingUploader::Initialize: Could not create a command pool\n");
+                    return false;
+                }
+
+                //Mip blits and final layouts of images need a graphics queue
+                if (m_dedicated)
+                {
+                    commandPoolInfo.queueFamilyIndex = graphicsQueue->GetVKQueueFamily();
+
+                    err = vkCreateCommandPool(m_device, &commandPoolInfo, nullptr, &m_graphicsCommandPool);
+                    assert(!err);
+                    if (err != VK_SUCCESS)
+                    {
+                        HT_ERROR_PRINTF("VKStagingUploader::Initialize: Could not create a graphics command pool\n");
+                        return false;
+                    }
+                }
+
+                VkBufferCreateInfo bufferCreateInfo = {};
+                bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+                bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+                bufferCreateInfo.size = m_stagingSize;
+
+                err = vkCreateBuffer(m_device, &bufferCreateInfo, nullptr, &m_staging.buffer);
+                assert(!err);
+                if (err != VK_SUCCESS)
+                {
+                    HT_ERROR_PRINTF("VKStagingUploader::Initialize: Could not create the staging buffer\n");
+                    return false;
+                }
+
+                if (!VKTools::GetAllocator().AllocateForBuffer(m_staging.buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_staging.allocation, VKMemoryCategory::Staging))
+                {
+                    HT_ERROR_PRINTF("VKStagingUploader::Initialize: Could not allocate staging memory\n");
+                    vkDestroyBuffer(m_device, m_staging.buffer, nullptr);
+                    m_staging.buffer = VK_NULL_HANDLE;
+                    return false;
+                }
+
+                m_staging.descriptor.buffer = m_staging.buffer;
+                m_staging.descriptor.offset = 0;
+                m_staging.descriptor.range = m_stagingSize;
+
+                return true;
+            }
+
+            /** Submits anything queued, waits for every copy and frees the ring
+            */
+            void VKStagingUploader::DeInitialize()
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                if (m_timeline == nullptr)
+                    return;
+
+                flush();
+                m_timeline->WaitIdle();
+                m_graphicsTimeline->WaitIdle();
+                retireBatches();
+
+                if (m_commandPool != VK_NULL_HANDLE)
+                    vkDestroyCommandPool(m_device, m_commandPool, nullptr);
+                m_commandPool = VK_NULL_HANDLE;
+
+                if (m_graphicsCommandPool != VK_NULL_HANDLE)
+                    vkDestroyCommandPool(m_device, m_graphicsCommandPool, nullptr);
+                m_graphicsCommandPool = VK_NULL_HANDLE;
+
+                if (m_staging.buffer != VK_NULL_HANDLE)
+                    VKTools::DeleteUniformBuffer(m_staging);
+                m_staging = {};
+
+                m_timeline = nullptr;
+                m_graphicsTimeline = nullptr;
+            }
+
+            /** Queues a copy of data into a buffer
+            *
+            * The data is written to the staging ring right away, so it may be
+            * freed as soon as this returns. The copy itself happens on the
+            * next Flush. Uploads larger than half the ring are split.
+            *
+            * \param data The data to upload
+            * \param size The size of data in bytes
+            * \param buffer The buffer to copy into; must allow transfer destination
+            * \param offset Where in buffer the data goes
+            * \return True if the copy was queued
+            */
+            bool VKStagingUploader::Upload(const void* data, VkDeviceSize size, VkBuffer buffer, VkDeviceSize offset)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                if (m_timeline == nullptr)
+                {
+                    HT_ERROR_PRINTF("VKStagingUploader::Upload(): Uploader was not initialized\n");
+                    return false;
+                }
+
+                const uint8_t* bytes = static_cast<const uint8_t*>(data);
+                VkDeviceSize maxChunk = m_stagingSize / 2;
+                VkDeviceSize done = 0;
+
+                while (done < size)
+                {
+                    VkDeviceSize chunk = std::min(size - done, maxChunk);
+                    VkDeviceSize stagingOffset = 0;
+
+                    if (!reserve(chunk, stagingOffset))
+                    {
+                        HT_ERROR_PRINTF("VKStagingUploader::Upload(): Could not reserve staging space\n");
+                        return false;
+                    }
+
+                    memcpy(static_cast<uint8_t*>(m_staging.allocation.mapped) + stagingOffset, bytes + done, static_cast<size_t>(chunk));
+
+                    Copy copy;
+                    copy.buffer = buffer;
+                    copy.region.srcOffset = stagingOffset;
+                    copy.region.dstOffset = offset + done;
+                    copy.region.size = chunk;
+                    m_copies.push_back(copy);
+
+                    m_stats.bytesUploaded += chunk;
+                    m_stats.copies++;
+
+                    done += chunk;
+                }
+
+                return true;
+            }
+
+            /** Queues copies of an image's levels and the generation of the rest
+            *
+            * The data is written to the staging ring right away. Levels are
+            * split into bands of rows when they don't fit in half the ring. The
+            * image must be in undefined layout; once the batch has run every
+            * level is in shader read only layout.
+            *
+            * \param upload The image and the data of its largest levels
+            * \return True if the copies were queued
+            */
+            bool VKStagingUploader::UploadImage(const VKImageUpload& upload)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                if (m_timeline == nullptr)
+                {
+                    HT_ERROR_PRINTF("VKStagingUploader::UploadImage(): Uploader was not initialized\n");
+                    return false;
+                }
+
+                if (upload.dataLevels == 0 || upload.dataLevels > upload.mipLevels)
+                {
+                    HT_ERROR_PRINTF("VKStagingUploader::UploadImage(): Image must be given between one and all of its levels\n");
+                    return false;
+                }
+
+                //Listed first so a flush part way through still moves it to transfer layout before any copy
+                PendingImage pending;
+                pending.upload = upload;
+                pending.transitioned = false;
+                pending.complete = false;
+                m_images.push_back(pending);
+                size_t index = m_images.size() - 1;
+
+                const uint8_t* bytes = static_cast<const uint8_t*>(upload.data);
+                VkDeviceSize maxChunk = m_stagingSize / 2;
+
+                for (uint32_t level = 0; level < upload.dataLevels; level++)
+                {
+                    uint32_t width = std::max(upload.width >> level, 1u);
+                    uint32_t height = std::max(upload.height >> level, 1u);
+                    VkDeviceSize rowSize = static_cast<VkDeviceSize>(width) * upload.texelSize;
+
+                    uint32_t bandRows = static_cast<uint32_t>(std::max<VkDeviceSize>(maxChunk / rowSize, 1));
+                    if (rowSize > maxChunk)
+                    {
+                        HT_ERROR_PRINTF("VKStagingUploader::UploadImage(): A row of the image does not fit in the staging ring\n");
+                        m_images.erase(m_images.begin() + index);
+                        return false;
+                    }
+
+                    for (uint32_t row = 0; row < height; row += bandRows)
+                    {
+                        uint32_t rows = std::min(bandRows, height - row);
+                        VkDeviceSize size = rowSize * rows;
+                        VkDeviceSize stagingOffset = 0;
+
+                        //A flush in here may have shifted the list; only this image can still be incomplete
+                        if (!reserve(size, stagingOffset))
+                        {
+                            HT_ERROR_PRINTF("VKStagingUploader::UploadImage(): Could not reserve staging space\n");
+                            m_images.back().complete = true;
+                            return false;
+                        }
+
+                        memcpy(static_cast<uint8_t*>(m_staging.allocation.mapped) + stagingOffset, bytes, static_cast<size_t>(size));
+                        bytes += size;
+
+                        ImageCopy copy = {};
+                        copy.image = upload.image;
+                        copy.region.bufferOffset = stagingOffset;
+                        copy.region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                        copy.region.imageSubresource.mipLevel = level;
+                        copy.region.imageSubresource.baseArrayLayer = 0;
+                        copy.region.imageSubresource.layerCount = 1;
+                        copy.region.imageOffset = { 0, static_cast<int32_t>(row), 0 };
+                        copy.region.imageExtent = { width, rows, 1 };
+                        m_imageCopies.push_back(copy);
+
+                        m_stats.bytesUploaded += size;
+                        m_stats.copies++;
+                    }
+                }
+
+                m_images.back().complete = true;
+
+                return true;
+            }
+
+            /** Submits every queued copy as one batch
+            * \return The copy timeline value that covers everything uploaded so far
+            */
+            uint64_t VKStagingUploader::Flush()
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                if (m_timeline == nullptr)
+                    return 0;
+
+                return flush();
+            }
+
+            /** Frees the staging space of finished batches and starts new per-frame stats
+            */
+            void VKStagingUploader::BeginFrame()
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                if (m_timeline == nullptr)
+                    return;
+
+                retireBatches();
+
+                m_stats.bytesUploaded = 0;
+                m_stats.copies = 0;
+                m_stats.batches = 0;
+                m_stats.images = 0;
+            }
+
+            /** Gets whether copies go to a different queue than rendering
+            * \return True if graphics submissions have to wait on GetTimeline()
+            */
+            bool VKStagingUploader::IsDedicated() { return m_dedicated; }
+
+            /** Gets the timeline of the copy queue
+            * \return The timeline Flush values belong to
+            */
+            VKTimeline* VKStagingUploader::GetTimeline() { return m_timeline; }
+
+            /** Gets this frame's upload traffic and how much staging space is in use
+            * \return A copy of the current stats
+            */
+            VKStagingStats VKStagingUploader::GetStats()
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                VKStagingStats stats = m_stats;
+                stats.bytesOutstanding = m_head - m_tail;
+
+                return stats;
+            }
+
+            bool VKStagingUploader::reserve(VkDeviceSize size, VkDeviceSize& offset)
+            {
+                for (;;)
+                {
+                    retireBatches();
+
+                    uint64_t head = (m_head + StagingAlignment - 1) & ~(StagingAlignment - 1);
+                    VkDeviceSize position = head % m_stagingSize;
+
+                    //Never split a copy across the end of the ring
+                    if (position + size > m_stagingSize)
+                    {
+                        head += m_stagingSize - position;
+                        position = 0;
+                    }
+
+                    if (head + size - m_tail <= m_stagingSize)
+                    {
+                        offset = position;
+                        m_head = head + size;
+                        return true;
+                    }
+
+                    //Out of room; get the queued copies going and wait for the oldest batch
+                    if (!m_copies.empty() || !m_imageCopies.empty())
+                        flush();
+
+                    if (m_batches.empty())
+                        return false;
+
+                    if (!m_timeline->Wait(m_batches.front().value))
+                        return false;
+                }
+            }
+
+            uint64_t VKStagingUploader::flush()
+            {
+                VkResult err;
+
+                if (m_copies.empty() && m_imageCopies.empty() && m_images.empty())
+                    return m_lastValue;
+
+                VkCommandBuffer commandBuffer = beginCommands(m_commandPool);
+                if (commandBuffer == VK_NULL_HANDLE)
+                    return m_lastValue;
+
+                //One copy command per run of regions going to the same buffer
+                std::vector<VkBufferCopy> regions;
+                for (size_t i = 0; i < m_copies.size(); i++)
+                {
+                    regions.push_back(m_copies[i].region);
+
+                    if (i + 1 == m_copies.size() || m_copies[i + 1].buffer != m_copies[i].buffer)
+                    {
+                        vkCmdCopyBuffer(commandBuffer, m_staging.buffer, m_copies[i].buffer, static_cast<uint32_t>(regions.size()), regions.data());
+                        regions.clear();
+                    }
+                }
+
+                //New images go to transfer destination layout before their first copy
+                std::vector<VkImageMemoryBarrier> barriers;
+                for (size_t i = 0; i < m_images.size(); i++)
+                {
+                    if (m_images[i].transitioned)
+                        continue;
+
+                    VkImageMemoryBarrier barrier = {};
+                    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                    barrier.srcAccessMask = 0;
+                    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+                    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    barrier.image = m_images[i].upload.image;
+                    barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, m_images[i].upload.mipLevels, 0, 1 };
+                    barriers.push_back(barrier);
+
+                    m_images[i].transitioned = true;
+                }
+
+                if (!barriers.empty())
+                {
+                    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+                }
+
+                std::vector<VkBufferImageCopy> imageRegions;
+                for (size_t i = 0; i < m_imageCopies.size(); i++)
+                {
+                    imageRegions.push_back(m_imageCopies[i].region);
+
+                    if (i + 1 == m_imageCopies.size() || m_imageCopies[i + 1].image != m_imageCopies[i].image)
+                    {
+                        vkCmdCopyBufferToImage(commandBuffer, m_staging.buffer, m_imageCopies[i].image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                            static_cast<uint32_t>(imageRegions.size()), imageRegions.data());
+                        imageRegions.clear();
+                    }
+                }
+
+                //Images with all of their copies recorded can be finished; one
+                //caught part way through an upload waits for the next batch
+                std::vector<VKImageUpload> finished;
+                for (size_t i = 0; i < m_images.size();)
+                {
+                    if (m_images[i].complete)
+                    {
+                        finished.push_back(m_images[i].upload);
+                        m_images.erase(m_images.begin() + i);
+                    }
+                    else
+                    {
+                        i++;
+                    }
+                }
+
+                //On the graphics queue the copies only need to land before they're read;
+                //a dedicated queue is synchronized by the semaphore wait instead
+                if (!m_dedicated)
+                {
+                    finishImages(commandBuffer, finished);
+
+                    VkMemoryBarrier barrier = {};
+                    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+                    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                    barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+
+                    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                        0, 1, &barrier, 0, nullptr, 0, nullptr);
+                }
+
+                err = vkEndCommandBuffer(commandBuffer);
+                assert(!err);
+
+                VkSubmitInfo submitInfo = {};
+                submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+                submitInfo.commandBufferCount = 1;
+                submitInfo.pCommandBuffers = &commandBuffer;
+
+                uint64_t value = 0;
+                if (!m_timeline->Submit(submitInfo, &value))
+                {
+                    HT_ERROR_PRINTF("VKStagingUploader::flush(): Failed to submit copies\n");
+                    vkFreeCommandBuffers(m_device, m_commandPool, 1, &commandBuffer);
+                    m_copies.clear();
+                    m_imageCopies.clear();
+                    return m_lastValue;
+                }
+
+                Batch batch = {};
+                batch.value = value;
+                batch.end = m_head;
+                batch.commandBuffer = commandBuffer;
+
+                //Blits need the graphics queue; it waits for the copies first
+                if (m_dedicated && !finished.empty())
+                {
+                    VkCommandBuffer finishCommandBuffer = beginCommands(m_graphicsCommandPool);
+                    if (finishCommandBuffer != VK_NULL_HANDLE)
+                    {
+                        finishImages(finishCommandBuffer, finished);
+
+                        err = vkEndCommandBuffer(finishCommandBuffer);
+                        assert(!err);
+
+                        VkSubmitInfo finishInfo = {};
+                        finishInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+                        finishInfo.commandBufferCount = 1;
+                        finishInfo.pCommandBuffers = &finishCommandBuffer;
+
+                        std::vector<VKTimelineWait> waits(1);
+                        waits[0].timeline = m_timeline;
+                        waits[0].value = value;
+                        waits[0].stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+                        if (m_graphicsTimeline->Submit(finishInfo, waits, &batch.finishValue))
+                        {
+                            batch.finishCommandBuffer = finishCommandBuffer;
+                        }
+                        else
+                        {
+                            HT_ERROR_PRINTF("VKStagingUploader::flush(): Failed to submit image finish\n");
+                            vkFreeCommandBuffers(m_device, m_graphicsCommandPool, 1, &finishCommandBuffer);
+                        }
+                    }
+                }
+
+                m_batches.push_back(batch);
+
+                m_copies.clear();
+                m_imageCopies.clear();
+                m_lastValue = value;
+                m_stats.batches++;
+                m_stats.images += static_cast<uint32_t>(finished.size());
+
+                return value;
+            }
+
+            VkCommandBuffer VKStagingUploader::beginCommands(VkCommandPool pool)
+            {
+                VkResult err;
+
+                VkCommandBufferAllocateInfo allocateInfo = {};
+                allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+                allocateInfo.commandPool = pool;
+                allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+                allocateInfo.commandBufferCount = 1;
+
+                VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+                err = vkAllocateCommandBuffers(m_device, &allocateInfo, &commandBuffer);
+                assert(!err);
+                if (err != VK_SUCCESS)
+                {
+                    HT_ERROR_PRINTF("VKStagingUploader::beginCommands(): Failed to allocate command buffer\n");
+                    return VK_NULL_HANDLE;
+                }
+
+                VkCommandBufferBeginInfo beginInfo = {};
+                beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+                beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+                err = vkBeginCommandBuffer(commandBuffer, &beginInfo);
+                assert(!err);
+
+                return commandBuffer;
+            }
+
+            void VKStagingUploader::finishImages(VkCommandBuffer commandBuffer, const std::vector<VKImageUpload>& images)
+            {
+                for (size_t i = 0; i < images.size(); i++)
+                {
+                    const VKImageUpload& image = images[i];
+
+                    VkImageMemoryBarrier barrier = {};
+                    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    barrier.image = image.image;
+                    barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+                    //Each missing level is blitted down from the one above it
+                    for (uint32_t level = image.dataLevels; level < image.mipLevels; level++)
+                    {
+                        barrier.subresourceRange.baseMipLevel = level - 1;
+                        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+                        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+                        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+                        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                            0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+                        VkImageBlit blit = {};
+                        blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1 };
+                        blit.srcOffsets[1] = { static_cast<int32_t>(std::max(image.width >> (level - 1), 1u)),
+                            static_cast<int32_t>(std::max(image.height >> (level - 1), 1u)), 1 };
+                        blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+                        blit.dstOffsets[1] = { static_cast<int32_t>(std::max(image.width >> level, 1u)),
+                            static_cast<int32_t>(std::max(image.height >> level, 1u)), 1 };
+
+                        vkCmdBlitImage(commandBuffer, image.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                            image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+                    }
+
+                    //Blit sources ended up in transfer source layout, everything else in destination
+                    std::vector<VkImageMemoryBarrier> barriers;
+                    for (uint32_t level = 0; level < image.mipLevels; level++)
+                    {
+                        bool blitSource = level + 1 >= image.dataLevels && level + 1 < image.mipLevels;
+
+                        barrier.subresourceRange.baseMipLevel = level;
+                        barrier.srcAccessMask = blitSource ? VK_ACCESS_TRANSFER_READ_BIT : VK_ACCESS_TRANSFER_WRITE_BIT;
+                        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+                        barrier.oldLayout = blitSource ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+                        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                        barriers.push_back(barrier);
+                    }
+
+                    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                        0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+                }
+            }
+
+            void VKStagingUploader::retireBatches()
+            {
+                if (!m_batches.empty())
+                {
+                    uint64_t completed = m_timeline->GetCompletedValue();
+
+                    while (!m_batches.empty() && m_batches.front().value <= completed)
+                    {
+                        Batch& batch = m_batches.front();
+
+                        //Its command buffer may still be executing on the graphics queue
+                        if (batch.finishCommandBuffer != VK_NULL_HANDLE)
+                        {
+                            if (!m_graphicsTimeline->IsComplete(batch.finishValue))
+                                break;
+                            vkFreeCommandBuffers(m_device, m_graphicsCommandPool, 1, &batch.finishCommandBuffer);
+                        }
+
+                        m_tail = batch.end;
+                        vkFreeCommandBuffers(m_device, m_commandPool, 1, &batch.commandBuffer);
+                        m_batches.pop_front();
+                    }
+                }
+
+                //Nothing in flight or queued; start again from the front of the ring
+                if (m_batches.empty() && m_copies.empty() && m_imageCopies.empty())
+                {
+                    m_head = 0;
+                    m_tail = 0;
+                }
+            }
+        }
+    }
+}
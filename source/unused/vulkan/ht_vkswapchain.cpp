@@ -16,6 +16,12 @@
 #include <ht_vkrootlayout.h>
 #include <ht_rootlayout.h>
 #include <ht_vktools.h>
+#include <ht_vkdeletionqueue.h>
+#include <ht_vkstaginguploader.h>
+#include <ht_vkmemorybudget.h>
+#include <ht_vkuniformarena.h>
+#include <ht_vkdescriptorallocator.h>
+#include <algorithm>          //std::max
 
 namespace Hatchit {
 
@@ -35,10 +41,18 @@ namespace Hatchit {
 
                 m_currentBuffer = 0;
 
+                m_frameCount = rendererParams.framesInFlight;
+                if (m_frameCount < 1)
+                    m_frameCount = 1;
+                else if (m_frameCount > 3)
+                    m_frameCount = 3;
+                m_currentFrame = 0;
+
                 //TODO: Worry about different queue types
                 if (queue->GetQueueType() != QueueType::GRAPHICS)
                     HT_ERROR_PRINTF("Providing a non-graphics queue to the swapchain is currently undefined");
                 m_queue = queue->GetVKQueue();
+                m_timeline = &queue->GetTimeline();
 
                 Color clearColor = rendererParams.clearColor;
                 m_clearColor.color = { clearColor.r, clearColor.g, clearColor.b, clearColor.a };
@@ -46,15 +60,21 @@ namespace Hatchit {
                 m_window = rendererParams.window;
                 m_display = rendererParams.display;
 
-                m_presentSemaphore = VK_NULL_HANDLE;
-                m_renderSemaphore = VK_NULL_HANDLE;
-                m_submitInfo = {};
+                m_submitStages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+                m_inputPass = nullptr;
+                m_uploadRing = nullptr;
 
                 m_dirty = true;
             }
 
             VKSwapChain::~VKSwapChain()
             {
+                //Nothing may be destroyed while a frame is still using it
+                waitForFrames();
+
+                destroyFrames();
+
                 destroyPipeline();
 
                 destroyDepth();
@@ -70,6 +90,37 @@ namespace Hatchit {
                 destroySurface();
             }
 
+            /** Waits for the current frame slot and acquires the next swapchain image
+            *
+            * Once this returns, anything indexed by GetCurrentFrame() is no longer
+            * in use by the GPU and may be rewritten.
+            */
+            void VKSwapChain::VBeginFrame()
+            {
+                VkResult err;
+
+                FrameSync& frame = m_frames[m_currentFrame];
+
+                m_timeline->Wait(frame.value);
+
+                //Anything retired by the frames that have finished can go now
+                VKDeletionQueue::Collect();
+
+                //Eviction goes after Collect so usage reflects what it just freed
+                VKMemoryBudget::BeginFrame();
+
+                m_uploadRing->BeginFrame(m_currentFrame);
+                VKDescriptorAllocator::BeginFrame(m_currentFrame);
+                VKUniformArena::BeginFrame(m_currentFrame);
+                VKStagingUploader::BeginFrame();
+
+                //Nothing built while executing the last frame is still referenced
+                m_frameArena.Reset();
+
+                err = VKGetNextImage(frame.acquireSemaphore);
+                assert(!err);
+            }
+
             void VKSwapChain::VClear(float* color) 
             {
                 m_clearColor.color = { color[0], color[1], color[2], color[3] };
@@ -84,6 +135,9 @@ namespace Hatchit {
                 if (!vkPrepare())
                     HT_ERROR_PRINTF("VKSwapChain(): Failed to prepare subsystems");
 
+                if (!prepareFrames())
+                    HT_ERROR_PRINTF("VKSwapChain(): Failed to prepare frame synchronization");
+
                 if (!vkPrepareResources())
                     HT_ERROR_PRINTF("VKSwapChain(): Failed to prepare necessary resources");
 
@@ -95,12 +149,13 @@ namespace Hatchit {
                 m_dirty = true;
             }
 
-            void VKSwapChain::VExecute(std::vector<RenderPassHandle> renderPasses)
+            void VKSwapChain::VExecute(const std::vector<RenderPassHandle>& renderPasses)
             {
                 if (renderPasses.size() <= 0)
                     return;
 
-                std::vector<VkCommandBuffer> commandBuffers;
+                FrameVector<VkCommandBuffer> commandBuffers(FrameAllocator<VkCommandBuffer>(&m_frameArena));
+                commandBuffers.reserve(renderPasses.size());
 
                 for (uint32_t i = 0; i < renderPasses.size(); i++)
                 {
@@ -110,19 +165,100 @@ namespace Hatchit {
                     commandBuffers.push_back(command);
                 }
 
-                VkResult err;
-
-                //Submit swapchain command
-                VkSubmitInfo submitInfo = m_submitInfo;
-                submitInfo.waitSemaphoreCount = 0;
-                submitInfo.pWaitSemaphores = nullptr;
+                //Submit render pass commands; the timeline value VPresent waits
+                //for covers these as well since it follows them on the queue
+                VkSubmitInfo submitInfo = {};
+                submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
                 submitInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
                 submitInfo.pCommandBuffers = commandBuffers.data();
-                submitInfo.signalSemaphoreCount = 0;
-                submitInfo.pSignalSemaphores = nullptr;
 
-                err = vkQueueSubmit(m_queue, 1, &submitInfo, VK_NULL_HANDLE);
-                assert(!err);
+                //Get any pending buffer uploads going; on a separate copy queue the
+                //render passes wait for them before reading vertices
+                uint64_t uploadValue = VKStagingUploader::Flush();
+
+                //Make this frame's uniform writes visible before anything reads them
+                VKUniformArena::Flush();
+
+                //Cleared rather than rebuilt so it keeps its capacity between frames
+                m_executeWaits.clear();
+                if (VKStagingUploader::IsDedicated() && uploadValue > 0)
+                {
+                    VKTimelineWait wait;
+                    wait.timeline = VKStagingUploader::GetTimeline();
+                    wait.value = uploadValue;
+                    wait.stage = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+                    m_executeWaits.push_back(wait);
+                }
+
+                if (!m_timeline->Submit(submitInfo, m_executeWaits))
+                    HT_ERROR_PRINTF("VKSwapChain::VExecute(): Failed to submit render passes\n");
+            }
+
+            /** Binds attachment memory for every pass in the render graph
+            *
+            * Attachments only live for their pass, so passes on different
+            * levels of the graph can share memory. The layout is only rebuilt
+            * when the graph changes or a pass has lost its attachments.
+            *
+            * \param levels The compiled render graph
+            */
+            void VKSwapChain::VPrepareRenderPasses(const std::vector<std::vector<RenderPassHandle>>& levels)
+            {
+                std::vector<std::vector<VKRenderPass*>> passLevels(levels.size());
+                bool dirty = false;
+
+                for (size_t i = 0; i < levels.size(); i++)
+                {
+                    for (size_t j = 0; j < levels[i].size(); j++)
+                    {
+                        VKRenderPass* vkpass = static_cast<VKRenderPass*>(levels[i][j]->GetBase());
+                        passLevels[i].push_back(vkpass);
+
+                        if (!vkpass->VKAttachmentsReady())
+                            dirty = true;
+                    }
+                }
+
+                if (!dirty && passLevels == m_attachmentLevels)
+                    return;
+
+                std::vector<VKAttachmentRequest> requests;
+                std::vector<size_t> firstRequest;
+                for (size_t i = 0; i < passLevels.size(); i++)
+                {
+                    for (size_t j = 0; j < passLevels[i].size(); j++)
+                    {
+                        firstRequest.push_back(requests.size());
+                        if (!passLevels[i][j]->VKPrepareAttachments(static_cast<uint32_t>(i), requests))
+                        {
+                            HT_ERROR_PRINTF("VKSwapChain::VPrepareRenderPasses(): Failed to create pass attachments\n");
+                            return;
+                        }
+                    }
+                }
+                firstRequest.push_back(requests.size());
+
+                if (!m_attachments.Build(requests))
+                {
+                    HT_ERROR_PRINTF("VKSwapChain::VPrepareRenderPasses(): Failed to bind attachment memory\n");
+                    return;
+                }
+
+                size_t pass = 0;
+                for (size_t i = 0; i < passLevels.size(); i++)
+                {
+                    for (size_t j = 0; j < passLevels[i].size(); j++, pass++)
+                    {
+                        bool aliased = false;
+                        for (size_t r = firstRequest[pass]; r < firstRequest[pass + 1]; r++)
+                            aliased = aliased || requests[r].aliased;
+
+                        if (!passLevels[i][j]->VKBindAttachments(aliased))
+                            HT_ERROR_PRINTF("VKSwapChain::VPrepareRenderPasses(): Failed to create pass framebuffer\n");
+                    }
+                }
+
+                m_attachmentLevels = passLevels;
             }
 
             void VKSwapChain::VSetInput(RenderPassHandle handle)
@@ -135,28 +271,34 @@ namespace Hatchit {
             {
                 VkResult err;
 
-                err = VKGetNextImage(m_presentSemaphore);
-                assert(!err);
-
-                assert(VKPostPresentBarrier(m_queue));
+                FrameSync& frame = m_frames[m_currentFrame];
 
-                //Submit swapchain command
-                VkSubmitInfo swapChainSubmit = m_submitInfo;
-                swapChainSubmit.commandBufferCount = 1;
-                swapChainSubmit.pCommandBuffers = &m_swapchainBuffers[m_currentBuffer].command;
-                swapChainSubmit.signalSemaphoreCount = 0;
-                swapChainSubmit.pSignalSemaphores = nullptr;
+                //Transition, draw and transition back in a single batch that waits
+                //on the acquired image; its timeline value marks this frame slot done
+                VkCommandBuffer commands[] = {
+                    m_postPresentCommands[m_currentBuffer],
+                    m_swapchainBuffers[m_currentBuffer].command,
+                    m_prePresentCommands[m_currentBuffer]
+                };
 
-                err = vkQueueSubmit(m_queue, 1, &swapChainSubmit, VK_NULL_HANDLE);
-                assert(!err);
+                VkSubmitInfo swapChainSubmit = {};
+                swapChainSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+                swapChainSubmit.waitSemaphoreCount = 1;
+                swapChainSubmit.pWaitSemaphores = &frame.acquireSemaphore;
+                swapChainSubmit.pWaitDstStageMask = &m_submitStages;
+                swapChainSubmit.commandBufferCount = 3;
+                swapChainSubmit.pCommandBuffers = commands;
+                swapChainSubmit.signalSemaphoreCount = 1;
+                swapChainSubmit.pSignalSemaphores = &frame.renderSemaphore;
 
-                assert(VKPrePresentBarrier(m_queue));
+                if (!m_timeline->Submit(swapChainSubmit, &frame.value))
+                    HT_ERROR_PRINTF("VKSwapChain::VPresent(): Failed to submit swapchain commands\n");
 
-                err = VKPresent(m_queue, VK_NULL_HANDLE);
+                err = VKPresent(m_queue, frame.renderSemaphore);
                 assert(!err);
 
-                err = vkQueueWaitIdle(m_queue);
-                assert(!err);
+                //Move on without waiting; VBeginFrame waits for the slot when it comes back around
+                m_currentFrame = (m_currentFrame + 1) % m_frameCount;
             }
 
             const VkCommandBuffer& VKSwapChain::GetVKCurrentCommand() const
@@ -178,6 +320,25 @@ namespace Hatchit {
                 return m_clearColor;
             }
 
+            /** Gets the ring per-frame data is uploaded through
+            *
+            * Ranges taken from it are valid until this frame slot comes around again.
+            *
+            * \return The swapchain's upload ring
+            */
+            VKUploadRing* VKSwapChain::GetUploadRing() const
+            {
+                return m_uploadRing;
+            }
+
+            /** Gets how much attachment memory the render graph needs and how much aliasing saved
+            * \return The stats from the last attachment layout
+            */
+            VKAttachmentStats VKSwapChain::GetAttachmentStats() const
+            {
+                return m_attachments.GetStats();
+            }
+
             bool VKSwapChain::vkPrepare()
             {
                 VkResult err;
@@ -289,28 +450,6 @@ namespace Hatchit {
                 if (!prepareFramebuffers(swapchainExtent))
                     return false;
 
-                //Setup semaphores and submission info
-                VkSemaphoreCreateInfo semaphoreCreateInfo = {};
-                semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-                semaphoreCreateInfo.pNext = nullptr;
-                semaphoreCreateInfo.flags = 0;
-
-                err = vkCreateSemaphore(m_device, &semaphoreCreateInfo, nullptr, &m_presentSemaphore);
-                assert(!err);
-
-                err = vkCreateSemaphore(m_device, &semaphoreCreateInfo, nullptr, &m_renderSemaphore);
-                assert(!err);
-
-                m_submitStages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-
-                m_submitInfo = {};
-                m_submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-                m_submitInfo.pWaitDstStageMask = &m_submitStages;
-                m_submitInfo.waitSemaphoreCount = 1;
-                m_submitInfo.pWaitSemaphores = &m_presentSemaphore;
-                m_submitInfo.signalSemaphoreCount = 1;
-                m_submitInfo.pSignalSemaphores = &m_renderSemaphore;
-
                 VKTools::FlushSetupCommandBuffer();
 
                 return true;
@@ -358,6 +497,9 @@ namespace Hatchit {
                 if (!m_dirty)
                     return true;
 
+                //The pool reset below invalidates commands that may still be in flight
+                waitForFrames();
+
                 /*
                     Allocate space for the swapchain command buffers
                 */
@@ -551,11 +693,24 @@ namespace Hatchit {
                     present.waitSemaphoreCount = 1;
                 }
 
+                //Our own queue is shared with other threads through its timeline
+                if (queue == m_queue)
+                    return m_timeline->Present(present);
+
                 return fpQueuePresentKHR(queue, &present);
             }
 
             void VKSwapChain::VKSetIncomingRenderPass(VKRenderPass* renderPass)
             {
+                //The descriptor set and swapchain commands only need rebuilding
+                //when the pass changes; rewriting them every frame would stomp
+                //on frames that are still in flight
+                if (renderPass == m_inputPass)
+                    return;
+
+                waitForFrames();
+
+                m_inputPass = renderPass;
                 m_dirty = true;
 
                 m_inputTextures.clear();
@@ -1280,6 +1435,72 @@ namespace Hatchit {
                 return true;
             }
 
+            bool VKSwapChain::prepareFrames()
+            {
+                if (m_frames.size() > 0)
+                    return true;
+
+                VkResult err;
+
+                VkSemaphoreCreateInfo semaphoreCreateInfo = {};
+                semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+                semaphoreCreateInfo.pNext = nullptr;
+                semaphoreCreateInfo.flags = 0;
+
+                m_frames.resize(m_frameCount);
+                for (uint32_t i = 0; i < m_frameCount; i++)
+                {
+                    FrameSync& frame = m_frames[i];
+                    frame = {};
+
+                    //Value 0 is always complete so the first wait on each slot returns immediately
+                    frame.value = 0;
+
+                    err = vkCreateSemaphore(m_device, &semaphoreCreateInfo, nullptr, &frame.acquireSemaphore);
+                    assert(!err);
+                    if (err != VK_SUCCESS)
+                    {
+                        HT_DEBUG_PRINTF("VKSwapChain::prepareFrames(): Failed to create acquire semaphore for frame %d\n", i);
+                        return false;
+                    }
+
+                    err = vkCreateSemaphore(m_device, &semaphoreCreateInfo, nullptr, &frame.renderSemaphore);
+                    assert(!err);
+                    if (err != VK_SUCCESS)
+                    {
+                        HT_DEBUG_PRINTF("VKSwapChain::prepareFrames(): Failed to create render semaphore for frame %d\n", i);
+                        return false;
+                    }
+                }
+
+                //Per-frame instance and uniform data is written into one ring rather than fresh buffers
+                m_uploadRing = new VKUploadRing;
+                if (!m_uploadRing->Initialize(m_device, m_frameCount))
+                {
+                    HT_DEBUG_PRINTF("VKSwapChain::prepareFrames(): Failed to create upload ring\n");
+                    return false;
+                }
+
+                m_attachments.Initialize(m_device);
+
+                m_currentFrame = 0;
+
+                return true;
+            }
+
+            void VKSwapChain::waitForFrames()
+            {
+                if (m_frames.size() <= 0)
+                    return;
+
+                //Only the newest frame matters; the timeline completes in order
+                uint64_t newest = 0;
+                for (size_t i = 0; i < m_frames.size(); i++)
+                    newest = std::max(newest, m_frames[i].value);
+
+                m_timeline->Wait(newest);
+            }
+
             bool VKSwapChain::submitBarrier(const VkQueue& queue, const VkCommandBuffer& command)
             {
                 VkResult err;
@@ -1346,6 +1567,21 @@ namespace Hatchit {
             {
                 fpDestroySwapchainKHR(m_device, m_swapchain, nullptr);
             }
+            void VKSwapChain::destroyFrames()
+            {
+                for (size_t i = 0; i < m_frames.size(); i++)
+                {
+                    vkDestroySemaphore(m_device, m_frames[i].acquireSemaphore, nullptr);
+                    vkDestroySemaphore(m_device, m_frames[i].renderSemaphore, nullptr);
+                }
+                m_frames.clear();
+
+                delete m_uploadRing;
+                m_uploadRing = nullptr;
+
+                m_attachments.DeInitialize();
+                m_attachmentLevels.clear();
+            }
 
         }
     }
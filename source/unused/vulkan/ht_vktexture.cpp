@@ -14,6 +14,9 @@
 
 #include <ht_vktexture.h>
 #include <ht_vktools.h>
+#include <ht_vkdeletionqueue.h>
+#include <ht_vkstaginguploader.h>
+#include <algorithm>    //std::min, std::max
 
 namespace Hatchit {
 
@@ -21,14 +24,50 @@ namespace Hatchit {
 
         namespace Vulkan {
 
+            //Halves an image with a 2x2 box filter; odd edges reuse their last row or column
+            static void downsample(const BYTE* src, uint32_t width, uint32_t height, uint32_t channels, std::vector<BYTE>& dst)
+            {
+                uint32_t dstWidth = std::max(width >> 1, 1u);
+                uint32_t dstHeight = std::max(height >> 1, 1u);
+                dst.resize(static_cast<size_t>(dstWidth) * dstHeight * channels);
+
+                for (uint32_t y = 0; y < dstHeight; y++)
+                {
+                    const BYTE* row0 = src + static_cast<size_t>(std::min(y * 2, height - 1)) * width * channels;
+                    const BYTE* row1 = src + static_cast<size_t>(std::min(y * 2 + 1, height - 1)) * width * channels;
+
+                    for (uint32_t x = 0; x < dstWidth; x++)
+                    {
+                        size_t x0 = static_cast<size_t>(std::min(x * 2, width - 1)) * channels;
+                        size_t x1 = static_cast<size_t>(std::min(x * 2 + 1, width - 1)) * channels;
+
+                        BYTE* out = &dst[(static_cast<size_t>(y) * dstWidth + x) * channels];
+                        for (uint32_t c = 0; c < channels; c++)
+                            out[c] = static_cast<BYTE>((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+                    }
+                }
+            }
+
             VKTexture::VKTexture()
-            {}
+            {
+                m_image = VK_NULL_HANDLE;
+                m_view = VK_NULL_HANDLE;
+                m_allocation = {};
+                m_dataLevels = 1;
+                m_format = VK_FORMAT_UNDEFINED;
+                m_texelSize = 4;
+                m_fullChain = 1;
+                m_baseLevel = 0;
+                m_residentSize = 0;
+                m_nextListener = 0;
+            }
 
             VKTexture::~VKTexture()
             {
-                vkDestroyImageView(m_device, m_view, nullptr);
-                vkDestroyImage(m_device, m_image, nullptr);
-                vkFreeMemory(m_device, m_deviceMemory, nullptr);
+                //Has to go first so the budget can't evict us while we're torn down
+                VKMemoryBudget::Unregister(this);
+
+                VKDeletionQueue::RetireImage(m_image, m_view, m_allocation);
             }
 
             bool VKTexture::Initialize(Resource::TextureHandle handle, const VkDevice& device)
@@ -42,9 +81,18 @@ namespace Hatchit {
                 m_width = handle->GetWidth();
                 m_height = handle->GetHeight();
                 m_channels = handle->GetChannels();
-                m_mipLevels = handle->GetMIPLevels();
 
-                return VKBufferImage();
+                //Resources only hand over their base level; the rest are generated
+                m_dataLevels = 1;
+
+                if (!VKBufferImage())
+                    return false;
+
+                //Only textures whose data we can hold on to can be evicted and brought back
+                m_resource = handle;
+                VKMemoryBudget::Register(this);
+
+                return true;
             }
 
             bool VKTexture::Initialize(const VkDevice& device, const BYTE* data, uint32_t width, uint32_t height, uint32_t channelCount, uint32_t mipLevels)
@@ -56,150 +104,297 @@ namespace Hatchit {
                 m_width = width;
                 m_height = height;
                 m_channels = channelCount;
-                m_mipLevels = mipLevels;
+                m_dataLevels = std::max(mipLevels, 1u);
 
                 return VKBufferImage();
             }
 
             VkImageView VKTexture::GetView() { return m_view; }
 
+            /** Registers a function to call whenever the texture's view is replaced
+            * \param listener The function to call
+            * \return An id to pass to RemoveResidencyListener
+            */
+            uint32_t VKTexture::AddResidencyListener(const std::function<void()>& listener)
+            {
+                std::lock_guard<std::mutex> lock(m_listenerMutex);
 
-            bool VKTexture::VKBufferImage()
+                uint32_t id = m_nextListener++;
+                m_listeners[id] = listener;
+                return id;
+            }
+
+            /** Stops calling a listener
+            * \param id The id AddResidencyListener returned
+            */
+            void VKTexture::RemoveResidencyListener(uint32_t id)
             {
-                VkResult err;
+                std::lock_guard<std::mutex> lock(m_listenerMutex);
+                m_listeners.erase(id);
+            }
+
+            /** Drops the texture's largest mip level
+            * \return The device memory freed, or 0 if it's already down to one texel
+            */
+            VkDeviceSize VKTexture::VKEvict()
+            {
+                if (m_baseLevel + 1 >= m_fullChain)
+                    return 0;
+
+                VkDeviceSize before = m_allocation.size;
+                if (!replaceImage(m_baseLevel + 1))
+                    return 0;
 
-                VkFormat format;
+                return before > m_allocation.size ? before - m_allocation.size : 0;
+            }
+
+            /** Uploads the full chain again
+            * \return True if the texture is back at full resolution
+            */
+            bool VKTexture::VKRestore()
+            {
+                if (m_baseLevel == 0)
+                    return true;
+
+                return replaceImage(0);
+            }
+
+            VkDeviceSize VKTexture::VKGetRestoreSize() const
+            {
+                if (m_baseLevel == 0 || m_residentSize <= m_allocation.size)
+                    return 0;
+
+                return m_residentSize - m_allocation.size;
+            }
+
+            bool VKTexture::VKIsEvicted() const { return m_baseLevel > 0; }
+
+            VKMemoryCategory VKTexture::VKGetCategory() const { return VKMemoryCategory::Texture; }
+
+            GPUResourceRequest::Type VKTexture::VKGetResourceType() const { return GPUResourceRequest::Type::Texture; }
+
+            void* VKTexture::VKGetResourceBase() { return static_cast<TextureBase*>(this); }
+
+            bool VKTexture::VKBufferImage()
+            {
                 if (m_channels == 4 || m_channels == 3)
                 {
-                    format = VK_FORMAT_R8G8B8A8_UNORM;
+                    m_format = VK_FORMAT_R8G8B8A8_UNORM;
+                    m_texelSize = 4;
                 }
                 else if (m_channels == 1)
                 {
-                    format = VK_FORMAT_R32_SFLOAT;
+                    m_format = VK_FORMAT_R8_UNORM;
+                    m_texelSize = 1;
                 }
                 else
                 {
                     HT_DEBUG_PRINTF("VKTexture::VKBufferImage(): Warning: could not determine texture format from channel count; using preferred image format");
-                    format = VKTools::GetPreferredColorFormat();
+                    m_format = VKTools::GetPreferredColorFormat();
+                    m_texelSize = 4;
 
                     //HT_DEBUG_PRINTF("VKTexture::VKBufferImage() Error; could not determine format for texture");
                     //return false;
                 }
 
-                //Create Image assuming linear tiling!
+                m_fullChain = 1;
+                while ((std::max(m_width, m_height) >> m_fullChain) > 0)
+                    m_fullChain++;
+                m_dataLevels = std::min(m_dataLevels, m_fullChain);
+
+                if (!createImage(0))
+                    return false;
+
+                m_baseLevel = 0;
+                m_residentSize = m_allocation.size;
+
+                return true;
+            }
+
+            bool VKTexture::createImage(uint32_t baseLevel)
+            {
+                VkResult err;
+
+                uint32_t width = std::max(m_width >> baseLevel, 1u);
+                uint32_t height = std::max(m_height >> baseLevel, 1u);
+
+                //Levels the data holds from baseLevel down; past them the base level is filtered on the CPU
+                std::vector<BYTE> filtered;
+                const BYTE* source = m_data;
+                uint32_t dataLevels = 1;
+                if (baseLevel < m_dataLevels)
+                {
+                    for (uint32_t level = 0; level < baseLevel; level++)
+                        source += static_cast<size_t>(std::max(m_width >> level, 1u)) * std::max(m_height >> level, 1u) * m_channels;
+                    dataLevels = m_dataLevels - baseLevel;
+                }
+                else
+                {
+                    std::vector<BYTE> scratch;
+                    uint32_t level = m_dataLevels - 1;
+                    for (uint32_t i = 0; i < level; i++)
+                        source += static_cast<size_t>(std::max(m_width >> i, 1u)) * std::max(m_height >> i, 1u) * m_channels;
+
+                    for (; level < baseLevel; level++)
+                    {
+                        downsample(source, std::max(m_width >> level, 1u), std::max(m_height >> level, 1u), m_channels, filtered);
+                        scratch.swap(filtered);
+                        source = scratch.data();
+                    }
+                    filtered.swap(scratch);
+                    source = filtered.data();
+                }
+
+                //Size of every level the data holds, largest first
+                VkDeviceSize texelCount = 0;
+                for (uint32_t level = 0; level < dataLevels; level++)
+                    texelCount += static_cast<VkDeviceSize>(std::max(width >> level, 1u)) * std::max(height >> level, 1u);
+
+                //There's no three channel format worth sampling, so pad to four
+                std::vector<BYTE> expanded;
+                const BYTE* data = source;
+                if (m_channels == 3)
+                {
+                    expanded.resize(static_cast<size_t>(texelCount * 4));
+                    for (VkDeviceSize i = 0; i < texelCount; i++)
+                    {
+                        expanded[i * 4 + 0] = source[i * 3 + 0];
+                        expanded[i * 4 + 1] = source[i * 3 + 1];
+                        expanded[i * 4 + 2] = source[i * 3 + 2];
+                        expanded[i * 4 + 3] = 0xFF;
+                    }
+                    data = expanded.data();
+                }
+
+                //Fill out the rest of the chain on the GPU when the format allows it
+                uint32_t mipLevels = VKTools::SupportsBlit(m_format) ? m_fullChain - baseLevel : dataLevels;
+
+                const std::vector<uint32_t>& queueFamilies = VKTools::GetQueueFamilies();
+
                 VkImageCreateInfo imageCreateInfo = {};
                 imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
                 imageCreateInfo.pNext = nullptr;
                 imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-                imageCreateInfo.format = format;
-                imageCreateInfo.extent = { static_cast<uint32_t>(m_width), static_cast<uint32_t>(m_height), 1 };
-                imageCreateInfo.mipLevels = m_mipLevels;
+                imageCreateInfo.format = m_format;
+                imageCreateInfo.extent = { width, height, 1 };
+                imageCreateInfo.mipLevels = mipLevels;
                 imageCreateInfo.arrayLayers = 1;
                 imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-                imageCreateInfo.tiling = VK_IMAGE_TILING_LINEAR;
-                imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
+                imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+                imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
                 imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+                imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
                 imageCreateInfo.flags = 0;
-                
-                VkMemoryAllocateInfo memAllocInfo = {};
-                memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-                
-                VkMemoryRequirements memReqs;
-
-                //Create Image
-                err = vkCreateImage(m_device, &imageCreateInfo, nullptr, &m_image);
-                assert(!err);
-                if (err != VK_SUCCESS)
-                {
-                    HT_DEBUG_PRINTF("VKTexture::VBufferImage(): Failed to create image\n");
-                    return false;
-                }
-
-                VKTools::CreateSetupCommandBuffer();
-
-                //Set the image to be GENERAL before binding so it can map properly
-                VKTools::SetImageLayout(m_image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
 
-                VKTools::FlushSetupCommandBuffer();
-
-                //Get memory requirements
-                vkGetImageMemoryRequirements(m_device, m_image, &memReqs);
-                memAllocInfo.allocationSize = memReqs.size;
-                
-                bool success = VKTools::MemoryTypeFromProperties(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &memAllocInfo.memoryTypeIndex);
-                assert(success);
-                if (!success)
+                //Written on the transfer queue and read on the graphics queue
+                if (queueFamilies.size() > 1)
                 {
-                    HT_DEBUG_PRINTF("VKTexture::VBufferImage(): Failed to find memory properties!\n");
-                    return false;
+                    imageCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+                    imageCreateInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilies.size());
+                    imageCreateInfo.pQueueFamilyIndices = queueFamilies.data();
                 }
 
-                //Allocate host memory
-                err = vkAllocateMemory(m_device, &memAllocInfo, nullptr, &m_deviceMemory);
+                //Create Image
+                VkImage image;
+                err = vkCreateImage(m_device, &imageCreateInfo, nullptr, &image);
                 assert(!err);
                 if (err != VK_SUCCESS)
                 {
-                    HT_DEBUG_PRINTF("VKTexture::VBufferImage(): Failed to allocate memory!\n");
+                    HT_DEBUG_PRINTF("VKTexture::createImage(): Failed to create image\n");
                     return false;
                 }
 
-                //Bind allocated image
-                err = vkBindImageMemory(m_device, m_image, m_deviceMemory, 0);
-                assert(!err);
-                if (err != VK_SUCCESS)
+                VKAllocation allocation = {};
+                if (!VKTools::GetAllocator().AllocateForImage(image, false, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, allocation, VKMemoryCategory::Texture))
                 {
-                    HT_DEBUG_PRINTF("VKTexture::VBufferImage(): Failed to bind image!\n");
+                    HT_DEBUG_PRINTF("VKTexture::createImage(): Failed to allocate memory!\n");
+                    vkDestroyImage(m_device, image, nullptr);
                     return false;
                 }
 
-                VkImageSubresource subRes = {};
-                subRes.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-
-                VkSubresourceLayout subResLayout;
-                void* pData;
-
-                vkGetImageSubresourceLayout(m_device, m_image, &subRes, &subResLayout);
-                
-                //Map memory
-                err = vkMapMemory(m_device, m_deviceMemory, 0, memReqs.size, 0, &pData);
-                if (err != VK_SUCCESS)
+                //Queued with every other upload; it's in shader read layout once the batch has run
+                VKImageUpload upload = {};
+                upload.image = image;
+                upload.width = width;
+                upload.height = height;
+                upload.texelSize = m_texelSize;
+                upload.mipLevels = mipLevels;
+                upload.dataLevels = dataLevels;
+                upload.data = data;
+
+                if (!VKStagingUploader::UploadImage(upload))
                 {
-                    HT_DEBUG_PRINTF("VKTexture::VBufferImage(): Failed to map memory!\n");
+                    HT_DEBUG_PRINTF("VKTexture::createImage(): Failed to upload image!\n");
+                    vkDestroyImage(m_device, image, nullptr);
+                    VKTools::GetAllocator().Free(allocation);
                     return false;
                 }
 
-                //Copy image data
-                memcpy(pData, m_data, m_width * m_height * m_channels);
-
-                vkUnmapMemory(m_device, m_deviceMemory);
-
-                //Set the image to be shader read only
-                VKTools::CreateSetupCommandBuffer();
-
-                m_imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-                VKTools::SetImageLayout(m_image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_GENERAL, m_imageLayout);
-
-                VKTools::FlushSetupCommandBuffer();
-
                 //Setup the image view
                 VkImageViewCreateInfo viewInfo = {};
                 viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
                 viewInfo.pNext = nullptr;
                 viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-                viewInfo.format = format;
+                viewInfo.format = m_format;
                 viewInfo.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
                 viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
                 viewInfo.subresourceRange.baseMipLevel = 0;
                 viewInfo.subresourceRange.baseArrayLayer = 0;
                 viewInfo.subresourceRange.layerCount = 1;
-                viewInfo.subresourceRange.levelCount = m_mipLevels;
-                viewInfo.image = m_image;
-                err = vkCreateImageView(m_device, &viewInfo, nullptr, &m_view);
+                viewInfo.subresourceRange.levelCount = mipLevels;
+                viewInfo.image = image;
+
+                VkImageView view;
+                err = vkCreateImageView(m_device, &viewInfo, nullptr, &view);
                 assert(!err);
+                if (err != VK_SUCCESS)
+                {
+                    HT_DEBUG_PRINTF("VKTexture::createImage(): Failed to create image view!\n");
+                    //The queued upload may still write to it
+                    VKDeletionQueue::RetireImage(image, VK_NULL_HANDLE, allocation);
+                    return false;
+                }
+
+                m_image = image;
+                m_view = view;
+                m_allocation = allocation;
+                m_mipLevels = mipLevels;
+                m_imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
                 return true;
             }
 
+            bool VKTexture::replaceImage(uint32_t baseLevel)
+            {
+                VkImage oldImage = m_image;
+                VkImageView oldView = m_view;
+                VKAllocation oldAllocation = m_allocation;
+
+                if (!createImage(baseLevel))
+                    return false;
+
+                //Frames in flight may still be sampling the old image
+                VKDeletionQueue::RetireImage(oldImage, oldView, oldAllocation);
+                m_baseLevel = baseLevel;
+
+                notifyListeners();
+
+                return true;
+            }
+
+            void VKTexture::notifyListeners()
+            {
+                std::vector<std::function<void()>> listeners;
+                {
+                    std::lock_guard<std::mutex> lock(m_listenerMutex);
+                    for (auto it = m_listeners.begin(); it != m_listeners.end(); ++it)
+                        listeners.push_back(it->second);
+                }
+
+                for (size_t i = 0; i < listeners.size(); i++)
+                    listeners[i]();
+            }
+
         }
 
     }
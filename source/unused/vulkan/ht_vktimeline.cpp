@@ -0,0 +1,409 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+#include <ht_vktimeline.h>  //VKTimeline
+#include <ht_debug.h>       //HT_ERROR_PRINTF
+#include <cassert>          //assert
+
+namespace Hatchit
+{
+    namespace Graphics
+    {
+        namespace Vulkan
+        {
+            VKTimeline::VKTimeline()
+            {
+                m_device = VK_NULL_HANDLE;
+                m_queue = VK_NULL_HANDLE;
+                m_semaphore = VK_NULL_HANDLE;
+                m_useTimelineSemaphore = false;
+                m_submitted = 0;
+                m_completed = 0;
+            }
+
+            VKTimeline::~VKTimeline()
+            {
+                DeInitialize();
+            }
+
+            /** Initializes the timeline for a queue
+            * \param device The device that owns the queue
+            * \param queue The queue whose submissions are tracked
+            * \param useTimelineSemaphore True if the device has VK_KHR_timeline_semaphore enabled
+            * \return True if the timeline was initialized
+            */
+            bool VKTimeline::Initialize(VkDevice device, VkQueue queue, bool useTimelineSemaphore)
+            {
+                m_device = device;
+                m_queue = queue;
+                m_submitted = 0;
+                m_completed = 0;
+                m_useTimelineSemaphore = false;
+
+#ifdef VK_KHR_timeline_semaphore
+                if (useTimelineSemaphore && fpWaitSemaphoresKHR && fpGetSemaphoreCounterValueKHR)
+                {
+                    VkResult err;
+
+                    VkSemaphoreTypeCreateInfoKHR typeInfo = {};
+                    typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+                    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+                    typeInfo.initialValue = 0;
+
+                    VkSemaphoreCreateInfo semaphoreInfo = {};
+                    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+                    semaphoreInfo.pNext = &typeInfo;
+
+                    err = vkCreateSemaphore(m_device, &semaphoreInfo, nullptr, &m_semaphore);
+                    assert(!err);
+                    if (err != VK_SUCCESS)
+                    {
+                        HT_ERROR_PRINTF("VKTimeline::Initialize(): Failed to create timeline semaphore\n");
+                        return false;
+                    }
+
+                    m_useTimelineSemaphore = true;
+                }
+#endif
+
+                return true;
+            }
+
+            /** Waits for every submission and releases the timeline's objects
+            */
+            void VKTimeline::DeInitialize()
+            {
+                if (m_device == VK_NULL_HANDLE)
+                    return;
+
+                WaitIdle();
+
+                if (m_semaphore != VK_NULL_HANDLE)
+                    vkDestroySemaphore(m_device, m_semaphore, nullptr);
+                m_semaphore = VK_NULL_HANDLE;
+
+                for (size_t i = 0; i < m_pending.size(); i++)
+                    vkDestroyFence(m_device, m_pending[i].fence, nullptr);
+                m_pending.clear();
+
+                for (size_t i = 0; i < m_freeFences.size(); i++)
+                    vkDestroyFence(m_device, m_freeFences[i], nullptr);
+                m_freeFences.clear();
+
+                m_device = VK_NULL_HANDLE;
+            }
+
+            /** Submits work to the queue and gives it the next timeline value
+            * \param submitInfo The work to submit. Its semaphores are kept.
+            * \param value Filled with the value that completes with this submission. May be null.
+            * \return True if the work was submitted
+            */
+            bool VKTimeline::Submit(const VkSubmitInfo& submitInfo, uint64_t* value)
+            {
+                return Submit(submitInfo, std::vector<VKTimelineWait>(), value);
+            }
+
+            /** Submits work that waits on other queues and gives it the next timeline value
+            *
+            * Waits on timelines backed by fences are done on the calling thread
+            * before submitting.
+            *
+            * \param submitInfo The work to submit. Its semaphores are kept.
+            * \param waits Values other timelines must reach before the work may run
+            * \param value Filled with the value that completes with this submission. May be null.
+            * \return True if the work was submitted
+            */
+            bool VKTimeline::Submit(const VkSubmitInfo& submitInfo, const std::vector<VKTimelineWait>& waits, uint64_t* value)
+            {
+                VkResult err;
+
+                std::vector<VkSemaphore> waitSemaphores(submitInfo.pWaitSemaphores,
+                    submitInfo.pWaitSemaphores + submitInfo.waitSemaphoreCount);
+                std::vector<VkPipelineStageFlags> waitStages(submitInfo.pWaitDstStageMask,
+                    submitInfo.pWaitDstStageMask + submitInfo.waitSemaphoreCount);
+                std::vector<uint64_t> waitValues(submitInfo.waitSemaphoreCount, 0);
+
+                for (size_t i = 0; i < waits.size(); i++)
+                {
+                    const VKTimelineWait& wait = waits[i];
+
+                    if (m_useTimelineSemaphore && wait.timeline->UsesTimelineSemaphore())
+                    {
+                        waitSemaphores.push_back(wait.timeline->GetVKSemaphore());
+                        waitStages.push_back(wait.stage);
+                        waitValues.push_back(wait.value);
+                    }
+                    else if (!wait.timeline->Wait(wait.value))
+                    {
+                        HT_ERROR_PRINTF("VKTimeline::Submit(): Failed waiting on another queue\n");
+                        return false;
+                    }
+                }
+
+                std::vector<VkSemaphore> signalSemaphores(submitInfo.pSignalSemaphores,
+                    submitInfo.pSignalSemaphores + submitInfo.signalSemaphoreCount);
+                std::vector<uint64_t> signalValues(submitInfo.signalSemaphoreCount, 0);
+
+                VkSubmitInfo submit = submitInfo;
+                submit.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+                submit.pWaitSemaphores = waitSemaphores.data();
+                submit.pWaitDstStageMask = waitStages.data();
+
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                const uint64_t signal = m_submitted + 1;
+
+                if (m_useTimelineSemaphore)
+                {
+#ifdef VK_KHR_timeline_semaphore
+                    signalSemaphores.push_back(m_semaphore);
+                    signalValues.push_back(signal);
+
+                    //Binary semaphores ignore their entries in the value arrays
+                    VkTimelineSemaphoreSubmitInfoKHR timelineInfo = {};
+                    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+                    timelineInfo.pNext = submitInfo.pNext;
+                    timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+                    timelineInfo.pWaitSemaphoreValues = waitValues.data();
+                    timelineInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size());
+                    timelineInfo.pSignalSemaphoreValues = signalValues.data();
+
+                    submit.pNext = &timelineInfo;
+                    submit.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+                    submit.pSignalSemaphores = signalSemaphores.data();
+
+                    err = vkQueueSubmit(m_queue, 1, &submit, VK_NULL_HANDLE);
+                    assert(!err);
+                    if (err != VK_SUCCESS)
+                    {
+                        HT_ERROR_PRINTF("VKTimeline::Submit(): Failed to submit to queue\n");
+                        return false;
+                    }
+#endif
+                }
+                else
+                {
+                    VkFence fence;
+                    if (!acquireFence(fence))
+                        return false;
+
+                    err = vkQueueSubmit(m_queue, 1, &submit, fence);
+                    assert(!err);
+                    if (err != VK_SUCCESS)
+                    {
+                        HT_ERROR_PRINTF("VKTimeline::Submit(): Failed to submit to queue\n");
+                        m_freeFences.push_back(fence);
+                        return false;
+                    }
+
+                    m_pending.push_back({ signal, fence });
+                }
+
+                m_submitted = signal;
+
+                if (value)
+                    *value = signal;
+
+                return true;
+            }
+
+            /** Presents on the timeline's queue
+            *
+            * Presenting doesn't advance the timeline, but it uses the queue and has
+            * to be kept apart from submissions made by other threads.
+            *
+            * \param presentInfo The swapchain images to present
+            * \return The result of vkQueuePresentKHR
+            */
+            VkResult VKTimeline::Present(const VkPresentInfoKHR& presentInfo)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                return fpQueuePresentKHR(m_queue, &presentInfo);
+            }
+
+            /** Gets the value of the newest submission
+            * \return The value the queue reaches once everything submitted so far completes
+            */
+            uint64_t VKTimeline::GetSubmittedValue() const
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                return m_submitted;
+            }
+
+            /** Polls the GPU for the newest completed value
+            * \return Every submission with this value or lower has completed
+            */
+            uint64_t VKTimeline::GetCompletedValue()
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                if (m_useTimelineSemaphore)
+                {
+#ifdef VK_KHR_timeline_semaphore
+                    uint64_t value = 0;
+                    if (fpGetSemaphoreCounterValueKHR(m_device, m_semaphore, &value) == VK_SUCCESS && value > m_completed)
+                        m_completed = value;
+#endif
+                }
+                else
+                {
+                    retireFences();
+                }
+
+                return m_completed;
+            }
+
+            /** Polls whether the GPU has reached a value
+            * \param value The value to check
+            * \return True if every submission up to value has completed
+            */
+            bool VKTimeline::IsComplete(uint64_t value)
+            {
+                return GetCompletedValue() >= value;
+            }
+
+            /** Blocks until the GPU reaches a value
+            *
+            * With the fence fallback the timeline's lock is held while waiting, so
+            * submissions to this queue from other threads wait too. A timeline
+            * semaphore is waited on without holding it.
+            *
+            * \param value The value to wait for
+            * \param timeout Nanoseconds to wait before giving up
+            * \return True if the value was reached
+            */
+            bool VKTimeline::Wait(uint64_t value, uint64_t timeout)
+            {
+                if (IsComplete(value))
+                    return true;
+
+                std::unique_lock<std::mutex> lock(m_mutex);
+
+                if (value > m_submitted)
+                {
+                    HT_ERROR_PRINTF("VKTimeline::Wait(): Waiting on a value that was never submitted\n");
+                    return false;
+                }
+
+                VkResult err = VK_SUCCESS;
+
+                if (m_useTimelineSemaphore)
+                {
+#ifdef VK_KHR_timeline_semaphore
+                    VkSemaphoreWaitInfoKHR waitInfo = {};
+                    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+                    waitInfo.semaphoreCount = 1;
+                    waitInfo.pSemaphores = &m_semaphore;
+                    waitInfo.pValues = &value;
+
+                    lock.unlock();
+                    err = fpWaitSemaphoresKHR(m_device, &waitInfo, timeout);
+                    lock.lock();
+
+                    if (err == VK_SUCCESS && value > m_completed)
+                        m_completed = value;
+#endif
+                }
+                else
+                {
+                    //Fences signal in submission order, so wait on the first that covers the value
+                    for (size_t i = 0; i < m_pending.size(); i++)
+                    {
+                        if (m_pending[i].value < value)
+                            continue;
+
+                        err = vkWaitForFences(m_device, 1, &m_pending[i].fence, VK_TRUE, timeout);
+                        break;
+                    }
+
+                    retireFences();
+                }
+
+                if (err != VK_SUCCESS && err != VK_TIMEOUT)
+                    HT_ERROR_PRINTF("VKTimeline::Wait(): Failed waiting on the GPU\n");
+
+                return m_completed >= value;
+            }
+
+            /** Blocks until everything submitted so far has completed
+            * \return True if the queue has caught up
+            */
+            bool VKTimeline::WaitIdle()
+            {
+                return Wait(GetSubmittedValue());
+            }
+
+            /** Gets whether this timeline is backed by a timeline semaphore
+            * \return False if it falls back to fences
+            */
+            bool VKTimeline::UsesTimelineSemaphore() const
+            {
+                return m_useTimelineSemaphore;
+            }
+
+            /** Gets the timeline semaphore
+            * \return The semaphore, or VK_NULL_HANDLE with the fence fallback
+            */
+            const VkSemaphore& VKTimeline::GetVKSemaphore() const
+            {
+                return m_semaphore;
+            }
+
+            /*
+                Private Methods
+            */
+
+            bool VKTimeline::acquireFence(VkFence& fence)
+            {
+                retireFences();
+
+                if (!m_freeFences.empty())
+                {
+                    fence = m_freeFences.back();
+                    m_freeFences.pop_back();
+                    return true;
+                }
+
+                VkFenceCreateInfo fenceInfo = {};
+                fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+                VkResult err = vkCreateFence(m_device, &fenceInfo, nullptr, &fence);
+                assert(!err);
+                if (err != VK_SUCCESS)
+                {
+                    HT_ERROR_PRINTF("VKTimeline::acquireFence(): Failed to create fence\n");
+                    return false;
+                }
+
+                return true;
+            }
+
+            void VKTimeline::retireFences()
+            {
+                while (!m_pending.empty())
+                {
+                    PendingFence& pending = m_pending.front();
+                    if (vkGetFenceStatus(m_device, pending.fence) != VK_SUCCESS)
+                        break;
+
+                    m_completed = pending.value;
+
+                    vkResetFences(m_device, 1, &pending.fence);
+                    m_freeFences.push_back(pending.fence);
+                    m_pending.pop_front();
+                }
+            }
+        }
+    }
+}
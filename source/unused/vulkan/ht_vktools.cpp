@@ -13,6 +13,7 @@
 **/
 
 #include <ht_vktools.h>
+#include <ht_vkstaginguploader.h>
 
 namespace Hatchit 
 {
@@ -23,14 +24,26 @@ namespace Hatchit
             VkCommandPool                    VKTools::m_setupCommandPool;
             VkCommandBuffer                  VKTools::m_setupCommandBuffer;
             VkDevice                         VKTools::m_device;
+            VkPhysicalDevice                 VKTools::m_gpu;
             VkQueue                          VKTools::m_queue;
+            VKTimeline*                      VKTools::m_timeline;
             VkPhysicalDeviceMemoryProperties VKTools::m_gpuMemoryProps;
+            VKMemoryAllocator                VKTools::m_allocator;
+            std::vector<uint32_t>            VKTools::m_queueFamilies;
 
-            bool VKTools::Initialize(const VKDevice* device, const VKQueue* queue) 
+            bool VKTools::Initialize(const VKDevice* device, VKQueue* queue) 
             {
                 m_device = device->GetVKDevices()[0];
+                m_gpu = device->GetVKPhysicalDevices()[0];
                 m_gpuMemoryProps = device->GetVKPhysicalDeviceMemoryProperties()[0];
 
+                VkDeviceSize granularity = device->GetVKPhysicalDeviceProperties()[0].limits.bufferImageGranularity;
+                if (!m_allocator.Initialize(m_device, m_gpuMemoryProps, granularity))
+                {
+                    HT_ERROR_PRINTF("VKTools::Initialize: Could not initialize the memory allocator");
+                    return false;
+                }
+
                 if (queue->GetQueueType() != QueueType::GRAPHICS)
                 {
                     HT_ERROR_PRINTF("VKTools::Initialize: Must be given a valid graphics queue");
@@ -39,6 +52,13 @@ namespace Hatchit
 
                 //Got a valid queue, lets just get the VkQueue inside it
                 m_queue = queue->GetVKQueue();
+                m_timeline = &queue->GetTimeline();
+
+                //Device-local buffers are shared with the transfer queue when there is one
+                m_queueFamilies.clear();
+                m_queueFamilies.push_back(queue->GetVKQueueFamily());
+                if (device->GetTransferQueueFamily() >= 0)
+                    m_queueFamilies.push_back(static_cast<uint32_t>(device->GetTransferQueueFamily()));
 
                 m_setupCommandBuffer = VK_NULL_HANDLE;
 
@@ -49,7 +69,7 @@ namespace Hatchit
                 commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
                 commandPoolInfo.pNext = nullptr;
                 commandPoolInfo.flags = 0;
-                commandPoolInfo.queueFamilyIndex = 0;
+                commandPoolInfo.queueFamilyIndex = queue->GetVKQueueFamily();
 
                 err = vkCreateCommandPool(m_device, &commandPoolInfo, nullptr, &m_setupCommandPool);
                 assert(!err);
@@ -69,6 +89,8 @@ namespace Hatchit
                 vkFreeCommandBuffers(m_device, m_setupCommandPool, 1, &m_setupCommandBuffer);
 
                 vkDestroyCommandPool(m_device, m_setupCommandPool, nullptr);
+
+                m_allocator.DeInitialize();
             }
 
             bool VKTools::CreateUniformBuffer(size_t dataSize, void* data, UniformBlock_vk* uniformBlock) 
@@ -90,60 +112,18 @@ namespace Hatchit
                     return false;
                 }
 
-                //Setup buffer requirements
-                VkMemoryRequirements memReqs;
-                vkGetBufferMemoryRequirements(m_device, uniformBlock->buffer, &memReqs);
-
-                VkMemoryAllocateInfo memAllocInfo = {};
-                memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-                memAllocInfo.pNext = nullptr;
-                memAllocInfo.allocationSize = memReqs.size;
-                memAllocInfo.memoryTypeIndex = 0;
-
-                bool okay = MemoryTypeFromProperties(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &memAllocInfo.memoryTypeIndex);
-                assert(okay);
-                if (!okay)
-                {
-                    HT_DEBUG_PRINTF("VKMesh::createBuffer(): Failed to get memory type\n");
-                    return false;
-                }
-
-                //Allocate and fill memory
-                void* pData;
-
-                err = vkAllocateMemory(m_device, &memAllocInfo, nullptr, &uniformBlock->memory);
-                assert(!err);
-                if (err != VK_SUCCESS)
+                //Sub-allocate persistently mapped memory and bind it; coherent so we never have to flush
+                if (!m_allocator.AllocateForBuffer(uniformBlock->buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformBlock->allocation, VKMemoryCategory::Uniform))
                 {
                     HT_DEBUG_PRINTF("VKMesh::createBuffer(): Failed to allocate memory\n");
+                    vkDestroyBuffer(m_device, uniformBlock->buffer, nullptr);
+                    uniformBlock->buffer = VK_NULL_HANDLE;
                     return false;
                 }
 
                 //We may not ask for a buffer that has anything in it
                 if (data != nullptr)
-                {
-                    err = vkMapMemory(m_device, uniformBlock->memory, 0, dataSize, 0, &pData);
-                    assert(!err);
-                    if (err != VK_SUCCESS)
-                    {
-                        HT_DEBUG_PRINTF("VKMesh::createBuffer(): Failed to map memory\n");
-                        return false;
-                    }
-
-                    //Actually copy data into location
-                    memcpy(pData, data, dataSize);
-
-                    //Unmap memory and then bind to the uniform
-                    vkUnmapMemory(m_device, uniformBlock->memory);
-                }
-
-                err = vkBindBufferMemory(m_device, uniformBlock->buffer, uniformBlock->memory, 0);
-                assert(!err);
-                if (err != VK_SUCCESS)
-                {
-                    HT_DEBUG_PRINTF("VKMesh::VBuffer(): Failed to bind memory\n");
-                    return false;
-                }
+                    memcpy(uniformBlock->allocation.mapped, data, dataSize);
 
                 uniformBlock->descriptor.buffer = uniformBlock->buffer;
                 uniformBlock->descriptor.offset = 0;
@@ -170,60 +150,18 @@ namespace Hatchit
                     return false;
                 }
 
-                //Setup buffer requirements
-                VkMemoryRequirements memReqs;
-                vkGetBufferMemoryRequirements(m_device, texelBlock->buffer, &memReqs);
-
-                VkMemoryAllocateInfo memAllocInfo = {};
-                memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-                memAllocInfo.pNext = nullptr;
-                memAllocInfo.allocationSize = memReqs.size;
-                memAllocInfo.memoryTypeIndex = 0;
-
-                bool okay = MemoryTypeFromProperties(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &memAllocInfo.memoryTypeIndex);
-                assert(okay);
-                if (!okay)
-                {
-                    HT_DEBUG_PRINTF("VKMesh::createBuffer(): Failed to get memory type\n");
-                    return false;
-                }
-
-                //Allocate and fill memory
-                void* pData;
-
-                err = vkAllocateMemory(m_device, &memAllocInfo, nullptr, &texelBlock->memory);
-                assert(!err);
-                if (err != VK_SUCCESS)
+                //Sub-allocate persistently mapped memory and bind it; coherent so we never have to flush
+                if (!m_allocator.AllocateForBuffer(texelBlock->buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, texelBlock->allocation, VKMemoryCategory::Uniform))
                 {
                     HT_DEBUG_PRINTF("VKMesh::createBuffer(): Failed to allocate memory\n");
+                    vkDestroyBuffer(m_device, texelBlock->buffer, nullptr);
+                    texelBlock->buffer = VK_NULL_HANDLE;
                     return false;
                 }
 
                 //We may not ask for a buffer that has anything in it
                 if (data != nullptr)
-                {
-                    err = vkMapMemory(m_device, texelBlock->memory, 0, dataSize, 0, &pData);
-                    assert(!err);
-                    if (err != VK_SUCCESS)
-                    {
-                        HT_DEBUG_PRINTF("VKMesh::createBuffer(): Failed to map memory\n");
-                        return false;
-                    }
-
-                    //Actually copy data into location
-                    memcpy(pData, data, dataSize);
-
-                    //Unmap memory and then bind to the uniform
-                    vkUnmapMemory(m_device, texelBlock->memory);
-                }
-
-                err = vkBindBufferMemory(m_device, texelBlock->buffer, texelBlock->memory, 0);
-                assert(!err);
-                if (err != VK_SUCCESS)
-                {
-                    HT_DEBUG_PRINTF("VKMesh::VBuffer(): Failed to bind memory\n");
-                    return false;
-                }
+                    memcpy(texelBlock->allocation.mapped, data, dataSize);
 
                 //Create a buffer view
                 VkBufferViewCreateInfo viewInfo = {};
@@ -243,13 +181,89 @@ namespace Hatchit
             void VKTools::DeleteUniformBuffer(UniformBlock_vk& uniformBlock) 
             {
                 vkDestroyBuffer(m_device, uniformBlock.buffer, nullptr);
-                vkFreeMemory(m_device, uniformBlock.memory, nullptr);
+                m_allocator.Free(uniformBlock.allocation);
             }
             void VKTools::DeleteTexelBuffer(TexelBlock_vk& texelBlock) 
             {
                 vkDestroyBufferView(m_device, texelBlock.view, nullptr);
                 vkDestroyBuffer(m_device, texelBlock.buffer, nullptr);
-                vkFreeMemory(m_device, texelBlock.memory, nullptr);
+                m_allocator.Free(texelBlock.allocation);
+            }
+
+            /** Creates a device-local buffer and uploads data into it through the staging ring
+            *
+            * Every call makes a buffer of its own; meshes share buffers through
+            * VKGeometryPool instead. The upload only happens once VKStagingUploader
+            * is flushed.
+            *
+            * \param dataSize The size of the buffer
+            * \param data The initial contents; may be null
+            * \param usage How the buffer will be bound
+            * \param block Filled with the buffer
+            * \return True if the buffer was created and its upload queued
+            */
+            bool VKTools::CreateDeviceBuffer(size_t dataSize, const void* data, VkBufferUsageFlags usage, UniformBlock_vk* block)
+            {
+                VkResult err;
+
+                *block = {};
+
+                VkBufferCreateInfo bufferCreateInfo = {};
+                bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+                bufferCreateInfo.usage = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+                bufferCreateInfo.size = dataSize;
+
+                if (m_queueFamilies.size() > 1)
+                {
+                    bufferCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+                    bufferCreateInfo.queueFamilyIndexCount = static_cast<uint32_t>(m_queueFamilies.size());
+                    bufferCreateInfo.pQueueFamilyIndices = m_queueFamilies.data();
+                }
+
+                err = vkCreateBuffer(m_device, &bufferCreateInfo, nullptr, &block->buffer);
+                assert(!err);
+                if (err != VK_SUCCESS)
+                {
+                    HT_DEBUG_PRINTF("VKTools::CreateDeviceBuffer(): Failed to create buffer\n");
+                    return false;
+                }
+
+                VKMemoryCategory category = (usage & (VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT)) ?
+                    VKMemoryCategory::Mesh : VKMemoryCategory::Other;
+                if (!m_allocator.AllocateForBuffer(block->buffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, block->allocation, category))
+                {
+                    HT_DEBUG_PRINTF("VKTools::CreateDeviceBuffer(): Failed to allocate memory\n");
+                    vkDestroyBuffer(m_device, block->buffer, nullptr);
+                    block->buffer = VK_NULL_HANDLE;
+                    return false;
+                }
+
+                block->descriptor.buffer = block->buffer;
+                block->descriptor.offset = 0;
+                block->descriptor.range = dataSize;
+
+                if (data != nullptr && !VKStagingUploader::Upload(data, dataSize, block->buffer, 0))
+                {
+                    HT_DEBUG_PRINTF("VKTools::CreateDeviceBuffer(): Failed to upload buffer contents\n");
+                    DeleteDeviceBuffer(*block);
+                    return false;
+                }
+
+                return true;
+            }
+
+            /** Frees a buffer made by CreateDeviceBuffer
+            *
+            * The GPU must be done with the buffer.
+            *
+            * \param block The buffer to free
+            */
+            void VKTools::DeleteDeviceBuffer(UniformBlock_vk& block)
+            {
+                if (block.allocation.memory != VK_NULL_HANDLE)
+                    DeleteUniformBuffer(block);
+
+                block = {};
             }
 
             VkFormat VKTools::GetPreferredColorFormat()
@@ -304,8 +318,6 @@ namespace Hatchit
                 err = vkEndCommandBuffer(m_setupCommandBuffer);
                 assert(!err);
 
-                VkFence nullFence = VK_NULL_HANDLE;
-
                 VkSubmitInfo submitInfo = {};
                 submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
                 submitInfo.pNext = nullptr;
@@ -317,11 +329,10 @@ namespace Hatchit
                 submitInfo.signalSemaphoreCount = 0;
                 submitInfo.pSignalSemaphores = nullptr;
 
-                err = vkQueueSubmit(m_queue, 1, &submitInfo, nullFence);
-                assert(!err);
-
-                err = vkQueueWaitIdle(m_queue);
-                assert(!err);
+                //Only wait for our own submission instead of idling the whole queue
+                uint64_t value = 0;
+                if (!m_timeline->Submit(submitInfo, &value) || !m_timeline->Wait(value))
+                    HT_ERROR_PRINTF("VKTools::FlushSetupCommandBuffer(): Failed to flush the setup command buffer\n");
 
                 vkFreeCommandBuffers(m_device, m_setupCommandPool, 1, &m_setupCommandBuffer);
                 m_setupCommandBuffer = VK_NULL_HANDLE;
@@ -329,6 +340,31 @@ namespace Hatchit
 
             VkCommandBuffer VKTools::GetSetupCommandBuffer() { return m_setupCommandBuffer; }
 
+            /** Gets the allocator every Vulkan resource takes its memory from
+            * \return The shared memory allocator
+            */
+            VKMemoryAllocator& VKTools::GetAllocator() { return m_allocator; }
+
+            /** Gets every queue family that uses device-local resources
+            * \return The graphics family, followed by the transfer family if there is one
+            */
+            const std::vector<uint32_t>& VKTools::GetQueueFamilies() { return m_queueFamilies; }
+
+            /** Gets whether mip levels of an optimally tiled image can be blitted with linear filtering
+            * \param format The image's format
+            * \return True if the format can be both source and destination of a linear blit
+            */
+            bool VKTools::SupportsBlit(VkFormat format)
+            {
+                VkFormatProperties formatProps;
+                vkGetPhysicalDeviceFormatProperties(m_gpu, format, &formatProps);
+
+                VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                    VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+                return (formatProps.optimalTilingFeatures & needed) == needed;
+            }
+
             //Reused helpers
             bool VKTools::SetImageLayout(VkCommandBuffer commandBuffer, VkImage image, VkImageAspectFlags aspectMask,
                 VkImageLayout oldImageLayout, VkImageLayout newImageLayout) 
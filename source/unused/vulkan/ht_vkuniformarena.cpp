@@ -0,0 +1,324 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+#include <ht_vkuniformarena.h>
+#include <ht_vktools.h>
+#include <ht_debug.h>
+#include <algorithm>    //std::sort, std::max
+#include <cassert>
+#include <cstring>      //memcpy
+
+namespace Hatchit {
+
+    namespace Graphics {
+
+        namespace Vulkan {
+
+            VkDevice                            VKUniformArena::m_device = VK_NULL_HANDLE;
+            VkDeviceSize                        VKUniformArena::m_alignment = 256;
+            VkDeviceSize                        VKUniformArena::m_atomSize = 1;
+            uint32_t                            VKUniformArena::m_frameCount = 1;
+            std::atomic<uint32_t>               VKUniformArena::m_frame(0);
+            VKBufferPool                        VKUniformArena::m_pool;
+            std::mutex                          VKUniformArena::m_mutex;
+            std::vector<VkMappedMemoryRange>    VKUniformArena::m_dirty;
+            VKUniformArenaStats                 VKUniformArena::m_stats = {};
+            VkDeviceSize                        VKUniformArena::m_pendingBytes = 0;
+            uint32_t                            VKUniformArena::m_pendingWrites = 0;
+
+            /** Prepares the arena; buffers are only created once ranges are needed
+            * \param device The device the buffers are created on
+            * \param limits The device's limits, for uniform offset and flush alignment
+            * \param frameCount How many frame slots may be in flight; every range keeps a copy for each
+            * \param bufferSize The size of each shared uniform buffer
+            * \return True if the arena is ready
+            */
+            bool VKUniformArena::Initialize(const VkDevice& device, const VkPhysicalDeviceLimits& limits, uint32_t frameCount, VkDeviceSize bufferSize)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                m_device = device;
+                m_frameCount = std::max(frameCount, 1u);
+                m_frame.store(0, std::memory_order_relaxed);
+                m_atomSize = std::max<VkDeviceSize>(limits.nonCoherentAtomSize, 1);
+
+                //Both are powers of two, so the larger one satisfies both
+                m_alignment = std::max<VkDeviceSize>(limits.minUniformBufferOffsetAlignment, m_atomSize);
+
+                m_dirty.clear();
+                m_stats = {};
+                m_pendingBytes = 0;
+                m_pendingWrites = 0;
+
+                //Host visible without asking for coherent; Flush covers memory that isn't
+                return m_pool.Initialize(m_device, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, std::vector<uint32_t>(),
+                    VKMemoryCategory::Uniform, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, bufferSize);
+            }
+
+            /** Destroys every shared buffer
+            *
+            * Nothing may still be using any range. Ranges freed afterwards are ignored.
+            */
+            void VKUniformArena::DeInitialize()
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                m_pool.DeInitialize();
+                m_dirty.clear();
+                m_device = VK_NULL_HANDLE;
+            }
+
+            /** Takes a range out of one of the shared buffers, with a copy for every frame slot
+            * \param size The size of one copy
+            * \param range Filled with the range on success
+            * \return True if a range was found or a new buffer could be made
+            */
+            bool VKUniformArena::Allocate(VkDeviceSize size, VKUniformRange& range)
+            {
+                range = {};
+
+                if (m_device == VK_NULL_HANDLE)
+                {
+                    HT_ERROR_PRINTF("VKUniformArena::Allocate(): The arena has not been initialized\n");
+                    return false;
+                }
+
+                VkDeviceSize rounded = ((std::max<VkDeviceSize>(size, 1) + m_atomSize - 1) / m_atomSize) * m_atomSize;
+
+                //Every copy starts on a bindable offset
+                VkDeviceSize stride = ((rounded + m_alignment - 1) / m_alignment) * m_alignment;
+
+                UniformBlock_vk block;
+                if (!m_pool.Allocate(stride * m_frameCount, m_alignment, block))
+                {
+                    HT_ERROR_PRINTF("VKUniformArena::Allocate(): Failed to allocate %llu bytes\n", static_cast<unsigned long long>(size));
+                    return false;
+                }
+
+                VKAllocation allocation;
+                if (!m_pool.GetMemory(block, allocation) || allocation.mapped == nullptr)
+                {
+                    HT_ERROR_PRINTF("VKUniformArena::Allocate(): Uniform memory is not mapped\n");
+                    m_pool.Free(block);
+                    return false;
+                }
+
+                //Bind only the bytes asked for
+                block.descriptor.range = size;
+
+                range.block = block;
+                range.memory = allocation.memory;
+                range.memoryOffset = allocation.offset + block.descriptor.offset;
+                range.size = rounded;
+                range.stride = stride;
+                range.copies = m_frameCount;
+                range.mapped = static_cast<uint8_t*>(block.allocation.mapped);
+                range.coherent = (VKTools::GetAllocator().GetMemoryTypeProperties(allocation.memoryType) & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stats.ranges++;
+
+                return true;
+            }
+
+            /** Returns a range to the arena
+            *
+            * The GPU must be done with it; retire it through VKDeletionQueue::RetireCallback.
+            *
+            * \param range The range to free; cleared afterwards
+            */
+            void VKUniformArena::Free(VKUniformRange& range)
+            {
+                if (range.block.buffer == VK_NULL_HANDLE)
+                    return;
+
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                if (m_device != VK_NULL_HANDLE)
+                {
+                    m_pool.Free(range.block);
+                    m_stats.ranges--;
+                }
+
+                range = {};
+            }
+
+            /** Sets which frame slot's copies Write goes to
+            *
+            * Call once the slot's previous frame is done on the GPU and before
+            * anything for the new frame is written.
+            *
+            * \param frame The frame slot about to be recorded
+            */
+            void VKUniformArena::BeginFrame(uint32_t frame)
+            {
+                m_frame.store(frame % m_frameCount, std::memory_order_relaxed);
+            }
+
+            /** Copies data into the current frame slot's copy of a range
+            * \param range The range to write
+            * \param offset Where in the range to write
+            * \param data The bytes to copy
+            * \param size How many bytes to copy
+            * \return False if the write would run past the end of the range
+            */
+            bool VKUniformArena::Write(const VKUniformRange& range, VkDeviceSize offset, const void* data, VkDeviceSize size)
+            {
+                if (size == 0)
+                    return true;
+
+                if (range.mapped == nullptr || offset + size > range.size)
+                {
+                    HT_ERROR_PRINTF("VKUniformArena::Write(): Write of %llu bytes at %llu does not fit the range\n",
+                        static_cast<unsigned long long>(size), static_cast<unsigned long long>(offset));
+                    return false;
+                }
+
+                const VkDeviceSize copyOffset = (m_frame.load(std::memory_order_relaxed) % range.copies) * range.stride;
+                memcpy(range.mapped + copyOffset + offset, data, static_cast<size_t>(size));
+
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                m_pendingBytes += size;
+                m_pendingWrites++;
+
+                if (range.coherent)
+                    return true;
+
+                //Widened to whole atoms; the range itself is atom aligned so this stays inside it
+                VkDeviceSize begin = range.memoryOffset + copyOffset + offset;
+                VkDeviceSize end = range.memoryOffset + copyOffset + offset + size;
+                begin = (begin / m_atomSize) * m_atomSize;
+                end = ((end + m_atomSize - 1) / m_atomSize) * m_atomSize;
+
+                VkMappedMemoryRange dirty = {};
+                dirty.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+                dirty.pNext = nullptr;
+                dirty.memory = range.memory;
+                dirty.offset = begin;
+                dirty.size = end - begin;
+                m_dirty.push_back(dirty);
+
+                return true;
+            }
+
+            /** Makes every write since the last Flush visible to the device
+            *
+            * Overlapping and neighbouring writes are merged first. Nothing
+            * is done for coherent memory.
+            *
+            * \return True if the driver accepted the flush
+            */
+            bool VKUniformArena::Flush()
+            {
+                VkResult err;
+
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                m_stats.bytesWritten = m_pendingBytes;
+                m_stats.writes = m_pendingWrites;
+                m_stats.flushedRanges = 0;
+                m_pendingBytes = 0;
+                m_pendingWrites = 0;
+
+                if (m_dirty.empty() || m_device == VK_NULL_HANDLE)
+                    return true;
+
+                std::sort(m_dirty.begin(), m_dirty.end(), [](const VkMappedMemoryRange& a, const VkMappedMemoryRange& b)
+                {
+                    if (a.memory != b.memory)
+                        return a.memory < b.memory;
+                    return a.offset < b.offset;
+                });
+
+                size_t merged = 0;
+                for (size_t i = 1; i < m_dirty.size(); i++)
+                {
+                    VkMappedMemoryRange& last = m_dirty[merged];
+                    const VkMappedMemoryRange& next = m_dirty[i];
+
+                    if (next.memory == last.memory && next.offset <= last.offset + last.size)
+                    {
+                        last.size = std::max(last.size, next.offset + next.size - last.offset);
+                        continue;
+                    }
+
+                    m_dirty[++merged] = next;
+                }
+                m_dirty.resize(merged + 1);
+
+                err = vkFlushMappedMemoryRanges(m_device, static_cast<uint32_t>(m_dirty.size()), m_dirty.data());
+                assert(!err);
+
+                m_stats.flushedRanges = static_cast<uint32_t>(m_dirty.size());
+                m_dirty.clear();
+
+                if (err != VK_SUCCESS)
+                {
+                    HT_ERROR_PRINTF("VKUniformArena::Flush(): Failed to flush mapped memory\n");
+                    return false;
+                }
+
+                return true;
+            }
+
+            /** Describes one frame slot's copy of a range for a descriptor write
+            * \param range The range to describe
+            * \param frame The frame slot whose copy is bound
+            * \return The buffer, offset and size of that copy
+            */
+            VkDescriptorBufferInfo VKUniformArena::GetDescriptor(const VKUniformRange& range, uint32_t frame)
+            {
+                VkDescriptorBufferInfo descriptor = range.block.descriptor;
+                if (range.copies > 0)
+                    descriptor.offset += (frame % range.copies) * range.stride;
+
+                return descriptor;
+            }
+
+            /** Gets the alignment of every range
+            * \return An alignment suitable for uniform buffer offsets inside a range
+            */
+            VkDeviceSize VKUniformArena::GetAlignment()
+            {
+                return m_alignment;
+            }
+
+            /** Gets how many copies every range keeps
+            * \return The number of frame slots
+            */
+            uint32_t VKUniformArena::GetFrameCount()
+            {
+                return m_frameCount;
+            }
+
+            /** Gets the frame slot Write currently goes to
+            * \return The slot last given to BeginFrame
+            */
+            uint32_t VKUniformArena::GetFrame()
+            {
+                return m_frame.load(std::memory_order_relaxed);
+            }
+
+            /** Gets how much was written and flushed
+            * \return A snapshot of the arena's stats
+            */
+            VKUniformArenaStats VKUniformArena::GetStats()
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                return m_stats;
+            }
+        }
+    }
+}
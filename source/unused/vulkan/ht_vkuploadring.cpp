@@ -0,0 +1,237 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+#include <ht_vkuploadring.h>
+#include <ht_vktools.h>
+#include <ht_vkdeletionqueue.h>
+#include <ht_debug.h>
+#include <cassert>
+
+namespace Hatchit {
+
+    namespace Graphics {
+
+        namespace Vulkan {
+
+            VKUploadRing::VKUploadRing()
+            {
+                m_device = VK_NULL_HANDLE;
+                m_block = {};
+                m_frameCount = 0;
+                m_frame = 0;
+                m_bytesPerFrame = 0;
+                m_head = 0;
+                m_allocations = 0;
+                m_overflowBytes = 0;
+            }
+
+            VKUploadRing::~VKUploadRing()
+            {
+                DeInitialize();
+            }
+
+            /** Creates the ring's buffer
+            * \param device The device to create the buffer on
+            * \param frameCount The number of frame slots; one region is made for each
+            * \param bytesPerFrame The size of each region
+            * \return True if the buffer was created and mapped
+            */
+            bool VKUploadRing::Initialize(VkDevice device, uint32_t frameCount, VkDeviceSize bytesPerFrame)
+            {
+                m_device = device;
+                m_frameCount = frameCount;
+                m_frame = 0;
+                m_bytesPerFrame = bytesPerFrame;
+                m_head = 0;
+                m_allocations = 0;
+                m_overflow.resize(frameCount);
+                m_overflowBytes = 0;
+
+                if (!createBuffer(m_bytesPerFrame * m_frameCount, m_block))
+                {
+                    HT_ERROR_PRINTF("VKUploadRing::Initialize(): Failed to create ring buffer\n");
+                    return false;
+                }
+
+                return true;
+            }
+
+            /** Frees the ring's buffers
+            *
+            * Every frame using the ring must have finished on the GPU.
+            */
+            void VKUploadRing::DeInitialize()
+            {
+                if (m_block.buffer != VK_NULL_HANDLE)
+                    VKTools::DeleteUniformBuffer(m_block);
+                m_block = {};
+
+                for (size_t i = 0; i < m_overflow.size(); i++)
+                {
+                    for (size_t j = 0; j < m_overflow[i].size(); j++)
+                        VKTools::DeleteUniformBuffer(m_overflow[i][j]);
+                }
+                m_overflow.clear();
+            }
+
+            /** Rewinds a frame slot's region
+            *
+            * The slot must no longer be in use by the GPU. If the last frame
+            * overflowed, the ring is grown first; the old buffer is retired
+            * since other slots may still be reading it.
+            *
+            * \param frame The frame slot that is about to be recorded
+            */
+            void VKUploadRing::BeginFrame(uint32_t frame)
+            {
+                std::lock_guard<std::mutex> lock(m_overflowMutex);
+
+                //This slot's one-off buffers are finished with
+                for (size_t i = 0; i < m_overflow[frame].size(); i++)
+                    VKTools::DeleteUniformBuffer(m_overflow[frame][i]);
+                m_overflow[frame].clear();
+
+                if (m_overflowBytes > 0)
+                {
+                    VkDeviceSize needed = m_head + m_overflowBytes;
+                    VkDeviceSize bytesPerFrame = m_bytesPerFrame;
+                    while (bytesPerFrame < needed)
+                        bytesPerFrame *= 2;
+
+                    UniformBlock_vk block = {};
+                    if (createBuffer(bytesPerFrame * m_frameCount, block))
+                    {
+                        VKDeletionQueue::RetireBuffer(m_block);
+                        m_block = block;
+                        m_bytesPerFrame = bytesPerFrame;
+                    }
+                    else
+                    {
+                        HT_ERROR_PRINTF("VKUploadRing::BeginFrame(): Failed to grow ring buffer\n");
+                    }
+
+                    m_overflowBytes = 0;
+                }
+
+                m_frame = frame;
+                m_head = 0;
+                m_allocations = 0;
+            }
+
+            /** Takes a range out of the current frame's region
+            * \param size The size of the range
+            * \param alignment The alignment the range's offset needs; must be a power of two
+            * \param range Filled with the range on success
+            * \return True if a range was handed out
+            */
+            bool VKUploadRing::Allocate(VkDeviceSize size, VkDeviceSize alignment, VKUploadRange& range)
+            {
+                if (alignment == 0)
+                    alignment = 1;
+
+                m_allocations++;
+
+                //Bump the head without locking; losers of a race just try again
+                VkDeviceSize head = m_head.load();
+                VkDeviceSize offset;
+                do
+                {
+                    offset = (head + alignment - 1) & ~(alignment - 1);
+                    if (offset + size > m_bytesPerFrame)
+                        break;
+                } while (!m_head.compare_exchange_weak(head, offset + size));
+
+                if (offset + size <= m_bytesPerFrame)
+                {
+                    VkDeviceSize base = m_bytesPerFrame * m_frame;
+
+                    range.buffer = m_block.buffer;
+                    range.offset = base + offset;
+                    range.size = size;
+                    range.mapped = static_cast<uint8_t*>(m_block.allocation.mapped) + base + offset;
+
+                    return true;
+                }
+
+                //Out of room; give this range its own buffer until the ring grows
+                UniformBlock_vk block = {};
+                if (!createBuffer(size, block))
+                {
+                    HT_ERROR_PRINTF("VKUploadRing::Allocate(): Failed to create overflow buffer\n");
+                    return false;
+                }
+
+                range.buffer = block.buffer;
+                range.offset = 0;
+                range.size = size;
+                range.mapped = block.allocation.mapped;
+
+                std::lock_guard<std::mutex> lock(m_overflowMutex);
+                m_overflow[m_frame].push_back(block);
+                m_overflowBytes += size + alignment;
+
+                return true;
+            }
+
+            /** Gets how much of the current frame's region has been used
+            * \return A snapshot of the ring's stats
+            */
+            VKUploadRingStats VKUploadRing::GetStats() const
+            {
+                VKUploadRingStats stats = {};
+                stats.allocations = m_allocations;
+                stats.overflowBuffers = m_overflow.empty() ? 0 : static_cast<uint32_t>(m_overflow[m_frame].size());
+                stats.bytesUsed = m_head;
+                stats.bytesPerFrame = m_bytesPerFrame;
+
+                return stats;
+            }
+
+            bool VKUploadRing::createBuffer(VkDeviceSize size, UniformBlock_vk& block)
+            {
+                VkResult err;
+
+                VkBufferCreateInfo bufferCreateInfo = {};
+                bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+                //Storage and indirect too, so culling inputs and draw commands can be written straight in,
+                //and a transfer source for staging into device local buffers
+                bufferCreateInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+                bufferCreateInfo.size = size;
+
+                err = vkCreateBuffer(m_device, &bufferCreateInfo, nullptr, &block.buffer);
+                assert(!err);
+                if (err != VK_SUCCESS)
+                {
+                    HT_DEBUG_PRINTF("VKUploadRing::createBuffer(): Failed to create buffer\n");
+                    return false;
+                }
+
+                if (!VKTools::GetAllocator().AllocateForBuffer(block.buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, block.allocation, VKMemoryCategory::Uniform))
+                {
+                    HT_DEBUG_PRINTF("VKUploadRing::createBuffer(): Failed to allocate memory\n");
+                    vkDestroyBuffer(m_device, block.buffer, nullptr);
+                    block.buffer = VK_NULL_HANDLE;
+                    return false;
+                }
+
+                block.descriptor.buffer = block.buffer;
+                block.descriptor.offset = 0;
+                block.descriptor.range = size;
+
+                return true;
+            }
+        }
+    }
+}
@@ -48,6 +48,18 @@ namespace Hatchit
                 fpAcquireNextImageKHR;
             PFN_vkQueuePresentKHR
                 fpQueuePresentKHR;
+
+#ifdef VK_KHR_timeline_semaphore
+            PFN_vkWaitSemaphoresKHR
+                fpWaitSemaphoresKHR = nullptr;
+            PFN_vkGetSemaphoreCounterValueKHR
+                fpGetSemaphoreCounterValueKHR = nullptr;
+#endif
+
+#ifdef VK_EXT_memory_budget
+            PFN_vkGetPhysicalDeviceMemoryProperties2KHR
+                fpGetPhysicalDeviceMemoryProperties2KHR = nullptr;
+#endif
         }
     }
 }
@@ -26,6 +26,14 @@ namespace Hatchit {
             {
                 m_vkDevice = VK_NULL_HANDLE;
                 m_vkPhysicalDevice = VK_NULL_HANDLE;
+
+                m_graphicsQueueFamily = VK_QUEUE_FAMILY_IGNORED;
+                m_computeQueueFamily = VK_QUEUE_FAMILY_IGNORED;
+                m_transferQueueFamily = VK_QUEUE_FAMILY_IGNORED;
+
+                m_graphicsQueue = VK_NULL_HANDLE;
+                m_computeQueue = VK_NULL_HANDLE;
+                m_transferQueue = VK_NULL_HANDLE;
             }
 
             VKDevice::~VKDevice()
@@ -41,23 +49,35 @@ namespace Hatchit {
                 if (!QueryPhysicalDeviceInfo())
                     return false;
 
+                if (!SelectQueueFamilies())
+                    return false;
+
                 VkResult err = VK_SUCCESS;
 
                 float QueueProperties[] = { 0.0f };
 
-                VkDeviceQueueCreateInfo queue = {};
-                queue.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-                queue.pNext = nullptr;
-                queue.queueFamilyIndex = 0; //TODO: This could be subject to change
-                queue.queueCount = 1;
-                queue.pQueuePriorities = QueueProperties;
+                //One queue from every distinct family we picked
+                std::set<uint32_t> families = { m_graphicsQueueFamily, m_computeQueueFamily, m_transferQueueFamily };
+
+                std::vector<VkDeviceQueueCreateInfo> queues;
+                for (uint32_t family : families)
+                {
+                    VkDeviceQueueCreateInfo queue = {};
+                    queue.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+                    queue.pNext = nullptr;
+                    queue.queueFamilyIndex = family;
+                    queue.queueCount = 1;
+                    queue.pQueuePriorities = QueueProperties;
+
+                    queues.push_back(queue);
+                }
 
 
                 VkDeviceCreateInfo device = {};
                 device.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
                 device.pNext = nullptr;
-                device.queueCreateInfoCount = 1;
-                device.pQueueCreateInfos = &queue;
+                device.queueCreateInfoCount = static_cast<uint32_t>(queues.size());
+                device.pQueueCreateInfos = queues.data();
                 device.enabledExtensionCount = 1;
                 std::vector<const char *> extensions;
                 extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
@@ -72,6 +92,9 @@ namespace Hatchit {
                     return false;
                 }
 
+                vkGetDeviceQueue(m_vkDevice, m_graphicsQueueFamily, 0, &m_graphicsQueue);
+                vkGetDeviceQueue(m_vkDevice, m_computeQueueFamily, 0, &m_computeQueue);
+                vkGetDeviceQueue(m_vkDevice, m_transferQueueFamily, 0, &m_transferQueue);
 
                 return true;
             }
@@ -80,6 +103,216 @@ namespace Hatchit {
                 return m_vkPhysicalDeviceProperties;
             }
 
+            /** Gets the queue family graphics work is submitted to
+            * \return The graphics queue family index
+            */
+            uint32_t VKDevice::GraphicsQueueFamily() const
+            {
+                return m_graphicsQueueFamily;
+            }
+
+            /** Gets the queue family compute work is submitted to
+            * \return The compute queue family index; the graphics family if there is no async compute family
+            */
+            uint32_t VKDevice::ComputeQueueFamily() const
+            {
+                return m_computeQueueFamily;
+            }
+
+            /** Gets the queue family uploads are submitted to
+            * \return The transfer queue family index; the graphics family if there is no dedicated transfer family
+            */
+            uint32_t VKDevice::TransferQueueFamily() const
+            {
+                return m_transferQueueFamily;
+            }
+
+            /** Gets the graphics queue
+            * \return The first queue of the graphics family
+            */
+            VkQueue VKDevice::GraphicsQueue() const
+            {
+                return m_graphicsQueue;
+            }
+
+            /** Gets the compute queue
+            *
+            * This is the graphics queue itself when there is no async compute family.
+            * The same VkQueue must never be submitted to from two threads at once.
+            *
+            * \return The first queue of the compute family
+            */
+            VkQueue VKDevice::ComputeQueue() const
+            {
+                return m_computeQueue;
+            }
+
+            /** Gets the transfer queue
+            *
+            * This is the graphics queue itself when there is no dedicated transfer family.
+            * The same VkQueue must never be submitted to from two threads at once.
+            *
+            * \return The first queue of the transfer family
+            */
+            VkQueue VKDevice::TransferQueue() const
+            {
+                return m_transferQueue;
+            }
+
+            /** Gets whether compute work runs on its own family
+            * \return True if compute can overlap graphics
+            */
+            bool VKDevice::HasAsyncComputeQueue() const
+            {
+                return m_computeQueueFamily != m_graphicsQueueFamily;
+            }
+
+            /** Gets whether uploads run on a transfer-only family
+            * \return True if uploads can overlap graphics
+            */
+            bool VKDevice::HasDedicatedTransferQueue() const
+            {
+                return m_transferQueueFamily != m_graphicsQueueFamily;
+            }
+
+            /** Records the release half of a buffer's queue family ownership transfer
+            *
+            * Record this on the source queue and AcquireBuffer on the destination queue,
+            * with a semaphore between the two submissions. Nothing is recorded when both
+            * families are the same.
+            *
+            * \param cmd Command buffer of the source family
+            * \param buffer The buffer to hand over
+            * \param srcFamily The family that owns the buffer now
+            * \param dstFamily The family that will own the buffer
+            * \param srcAccess How the source queue last accessed the buffer
+            * \param srcStage The stage of that last access
+            */
+            void VKDevice::ReleaseBuffer(VkCommandBuffer cmd, VkBuffer buffer, uint32_t srcFamily, uint32_t dstFamily,
+                VkAccessFlags srcAccess, VkPipelineStageFlags srcStage)
+            {
+                if (srcFamily == dstFamily)
+                    return;
+
+                VkBufferMemoryBarrier barrier = {};
+                barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+                barrier.srcAccessMask = srcAccess;
+                barrier.dstAccessMask = 0;
+                barrier.srcQueueFamilyIndex = srcFamily;
+                barrier.dstQueueFamilyIndex = dstFamily;
+                barrier.buffer = buffer;
+                barrier.offset = 0;
+                barrier.size = VK_WHOLE_SIZE;
+
+                vkCmdPipelineBarrier(cmd, srcStage, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                    0, nullptr, 1, &barrier, 0, nullptr);
+            }
+
+            /** Records the acquire half of a buffer's queue family ownership transfer
+            *
+            * Nothing is recorded when both families are the same; the semaphore
+            * between the two submissions already orders the accesses.
+            *
+            * \param cmd Command buffer of the destination family
+            * \param buffer The buffer to take over
+            * \param srcFamily The family that released the buffer
+            * \param dstFamily The family that will own the buffer
+            * \param dstAccess How the destination queue will access the buffer
+            * \param dstStage The stage of that first access
+            */
+            void VKDevice::AcquireBuffer(VkCommandBuffer cmd, VkBuffer buffer, uint32_t srcFamily, uint32_t dstFamily,
+                VkAccessFlags dstAccess, VkPipelineStageFlags dstStage)
+            {
+                if (srcFamily == dstFamily)
+                    return;
+
+                VkBufferMemoryBarrier barrier = {};
+                barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+                barrier.srcAccessMask = 0;
+                barrier.dstAccessMask = dstAccess;
+                barrier.srcQueueFamilyIndex = srcFamily;
+                barrier.dstQueueFamilyIndex = dstFamily;
+                barrier.buffer = buffer;
+                barrier.offset = 0;
+                barrier.size = VK_WHOLE_SIZE;
+
+                vkCmdPipelineBarrier(cmd, dstStage, dstStage, 0,
+                    0, nullptr, 1, &barrier, 0, nullptr);
+            }
+
+            /** Records the release half of an image's queue family ownership transfer
+            *
+            * The layouts must match the ones given to AcquireImage; the transition happens
+            * between the two halves. Nothing is recorded when both families are the same.
+            *
+            * \param cmd Command buffer of the source family
+            * \param image The image to hand over
+            * \param range The subresources to hand over
+            * \param oldLayout The layout the image is in now
+            * \param newLayout The layout the destination queue wants
+            * \param srcFamily The family that owns the image now
+            * \param dstFamily The family that will own the image
+            * \param srcAccess How the source queue last accessed the image
+            * \param srcStage The stage of that last access
+            */
+            void VKDevice::ReleaseImage(VkCommandBuffer cmd, VkImage image, const VkImageSubresourceRange& range,
+                VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t srcFamily, uint32_t dstFamily,
+                VkAccessFlags srcAccess, VkPipelineStageFlags srcStage)
+            {
+                if (srcFamily == dstFamily)
+                    return;
+
+                VkImageMemoryBarrier barrier = {};
+                barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                barrier.srcAccessMask = srcAccess;
+                barrier.dstAccessMask = 0;
+                barrier.oldLayout = oldLayout;
+                barrier.newLayout = newLayout;
+                barrier.srcQueueFamilyIndex = srcFamily;
+                barrier.dstQueueFamilyIndex = dstFamily;
+                barrier.image = image;
+                barrier.subresourceRange = range;
+
+                vkCmdPipelineBarrier(cmd, srcStage, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                    0, nullptr, 0, nullptr, 1, &barrier);
+            }
+
+            /** Records the acquire half of an image's queue family ownership transfer
+            *
+            * When both families are the same this only records the layout transition.
+            *
+            * \param cmd Command buffer of the destination family
+            * \param image The image to take over
+            * \param range The subresources to take over
+            * \param oldLayout The layout given to ReleaseImage
+            * \param newLayout The layout the destination queue wants
+            * \param srcFamily The family that released the image
+            * \param dstFamily The family that will own the image
+            * \param dstAccess How the destination queue will access the image
+            * \param dstStage The stage of that first access
+            */
+            void VKDevice::AcquireImage(VkCommandBuffer cmd, VkImage image, const VkImageSubresourceRange& range,
+                VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t srcFamily, uint32_t dstFamily,
+                VkAccessFlags dstAccess, VkPipelineStageFlags dstStage)
+            {
+                if (srcFamily == dstFamily && oldLayout == newLayout)
+                    return;
+
+                VkImageMemoryBarrier barrier = {};
+                barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                barrier.srcAccessMask = 0;
+                barrier.dstAccessMask = dstAccess;
+                barrier.oldLayout = oldLayout;
+                barrier.newLayout = newLayout;
+                barrier.srcQueueFamilyIndex = (srcFamily == dstFamily) ? VK_QUEUE_FAMILY_IGNORED : srcFamily;
+                barrier.dstQueueFamilyIndex = (srcFamily == dstFamily) ? VK_QUEUE_FAMILY_IGNORED : dstFamily;
+                barrier.image = image;
+                barrier.subresourceRange = range;
+
+                vkCmdPipelineBarrier(cmd, dstStage, dstStage, 0,
+                    0, nullptr, 0, nullptr, 1, &barrier);
+            }
+
             VKDevice::operator VkDevice()
             {
                 return m_vkDevice;
@@ -135,9 +368,61 @@ namespace Hatchit {
                 vkGetPhysicalDeviceProperties(m_vkPhysicalDevice, &m_vkPhysicalDeviceProperties);
                 vkGetPhysicalDeviceMemoryProperties(m_vkPhysicalDevice, &m_vkPhysicalDeviceMemoryProperties);
 
+                uint32_t familyCount = 0;
+                vkGetPhysicalDeviceQueueFamilyProperties(m_vkPhysicalDevice, &familyCount, nullptr);
+                m_vkQueueFamilyProperties.resize(familyCount);
+                vkGetPhysicalDeviceQueueFamilyProperties(m_vkPhysicalDevice, &familyCount, m_vkQueueFamilyProperties.data());
+
+
+                return true;
+            }
+
+            bool VKDevice::SelectQueueFamilies()
+            {
+                const uint32_t familyCount = static_cast<uint32_t>(m_vkQueueFamilyProperties.size());
+
+                m_graphicsQueueFamily = VK_QUEUE_FAMILY_IGNORED;
+                m_computeQueueFamily = VK_QUEUE_FAMILY_IGNORED;
+                m_transferQueueFamily = VK_QUEUE_FAMILY_IGNORED;
+
+                for (uint32_t i = 0; i < familyCount; i++)
+                {
+                    const VkQueueFamilyProperties& family = m_vkQueueFamilyProperties[i];
+                    if (family.queueCount == 0)
+                        continue;
+
+                    const bool graphics = (family.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+                    const bool compute = (family.queueFlags & VK_QUEUE_COMPUTE_BIT) != 0;
+                    const bool transfer = (family.queueFlags & VK_QUEUE_TRANSFER_BIT) != 0;
+
+                    if (graphics && m_graphicsQueueFamily == VK_QUEUE_FAMILY_IGNORED)
+                        m_graphicsQueueFamily = i;
+
+                    if (compute && !graphics && m_computeQueueFamily == VK_QUEUE_FAMILY_IGNORED)
+                        m_computeQueueFamily = i;
+
+                    //Copies into images at any offset need a granularity of one texel
+                    const VkExtent3D& granularity = family.minImageTransferGranularity;
+                    const bool anyOffset = granularity.width == 1 && granularity.height == 1 && granularity.depth == 1;
+
+                    if (transfer && !graphics && !compute && anyOffset && m_transferQueueFamily == VK_QUEUE_FAMILY_IGNORED)
+                        m_transferQueueFamily = i;
+                }
+
+                if (m_graphicsQueueFamily == VK_QUEUE_FAMILY_IGNORED)
+                {
+                    HT_ERROR_PRINTF("VKDevice::SelectQueueFamilies() Device has no graphics queue family.\n");
+                    return false;
+                }
+
+                //Graphics families always support compute and transfer
+                if (m_computeQueueFamily == VK_QUEUE_FAMILY_IGNORED)
+                    m_computeQueueFamily = m_graphicsQueueFamily;
+                if (m_transferQueueFamily == VK_QUEUE_FAMILY_IGNORED)
+                    m_transferQueueFamily = m_graphicsQueueFamily;
 
                 return true;
             }
         }
     }
-}
\ No newline at end of file
+}
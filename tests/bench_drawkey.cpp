@@ -0,0 +1,134 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+/**
+* Times DrawKeySorter::Sort on 10k, 100k and 1M draw keys made the way
+* RenderPassBase builds them: 64 pipelines, 1024 materials, 4096 meshes
+* and a random depth. Each size is sorted with std::stable_sort for
+* reference, with the radix sort on this thread, and with the radix sort
+* spread across a JobScheduler with a worker per hardware thread. Every
+* result is checked against std::stable_sort's.
+*
+* g++ -std=c++11 -O2 -pthread -Itests/support -Iinclude/unused
+*     tests/bench_drawkey.cpp source/unused/ht_drawkey.cpp source/unused/ht_jobscheduler.cpp
+*/
+
+#include <ht_drawkey.h>
+#include <algorithm>    //std::sort & std::stable_sort
+#include <chrono>       //std::chrono::steady_clock
+#include <cstdio>       //printf
+#include <random>       //std::mt19937
+#include <thread>       //std::thread::hardware_concurrency
+#include <vector>       //std::vector
+
+using namespace Hatchit::Graphics;
+
+static const size_t Counts[] = { 10 * 1000, 100 * 1000, 1000 * 1000 };
+static const uint32_t Runs = 11;
+
+typedef void (*SortFunction)(std::vector<DrawKey>& keys, std::vector<DrawKey>& scratch, JobScheduler* scheduler);
+
+static void stableSort(std::vector<DrawKey>& keys, std::vector<DrawKey>&, JobScheduler*)
+{
+    std::stable_sort(keys.begin(), keys.end(), [](const DrawKey& a, const DrawKey& b) { return a.key < b.key; });
+}
+
+static void radixSort(std::vector<DrawKey>& keys, std::vector<DrawKey>& scratch, JobScheduler* scheduler)
+{
+    DrawKeySorter::Sort(keys.data(), scratch.data(), keys.size(), scheduler);
+}
+
+//Median time of sorting fresh copies of the same keys; leaves the last result in sorted
+static double timeSort(SortFunction sort, const std::vector<DrawKey>& keys, std::vector<DrawKey>& sorted, JobScheduler* scheduler)
+{
+    std::vector<DrawKey> scratch(keys.size());
+    std::vector<double> times(Runs);
+
+    for (uint32_t i = 0; i < Runs; i++)
+    {
+        sorted = keys;
+
+        auto start = std::chrono::steady_clock::now();
+        sort(sorted, scratch, scheduler);
+        times[i] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    std::sort(times.begin(), times.end());
+    return times[Runs / 2];
+}
+
+static bool sameOrder(const std::vector<DrawKey>& a, const std::vector<DrawKey>& b)
+{
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        if (a[i].key != b[i].key || a[i].index != b[i].index)
+            return false;
+    }
+    return true;
+}
+
+int main()
+{
+    uint32_t hardwareThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+    JobScheduler scheduler;
+    if (!scheduler.Start(hardwareThreads))
+    {
+        std::printf("Failed to start %u workers\n", hardwareThreads);
+        return 1;
+    }
+
+    std::printf("Median of %u sorts; parallel sorts use %u workers plus the calling thread\n\n", Runs, hardwareThreads);
+    std::printf("%10s %14s %14s %14s %10s %10s\n", "keys", "stable_sort ms", "radix ms", "parallel ms", "radix x", "parallel x");
+
+    std::mt19937 random(1234);
+    std::uniform_int_distribution<uint32_t> pipelines(0, 63);
+    std::uniform_int_distribution<uint32_t> materials(0, 1023);
+    std::uniform_int_distribution<uint32_t> meshes(0, 4095);
+    std::uniform_real_distribution<float> depths(0.0f, 1.0f);
+
+    bool matched = true;
+    for (size_t c = 0; c < sizeof(Counts) / sizeof(Counts[0]); c++)
+    {
+        const size_t count = Counts[c];
+
+        std::vector<DrawKey> keys(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            keys[i].key = DrawKeySorter::MakeKey(pipelines(random), materials(random), meshes(random), depths(random));
+            keys[i].index = static_cast<uint32_t>(i);
+        }
+
+        std::vector<DrawKey> expected, sorted;
+        double reference = timeSort(stableSort, keys, expected, nullptr);
+
+        double radix = timeSort(radixSort, keys, sorted, nullptr);
+        matched = sameOrder(expected, sorted) && matched;
+
+        double parallel = timeSort(radixSort, keys, sorted, &scheduler);
+        matched = sameOrder(expected, sorted) && matched;
+
+        std::printf("%10zu %14.3f %14.3f %14.3f %10.2f %10.2f\n", count, reference, radix, parallel, reference / radix, reference / parallel);
+    }
+
+    scheduler.Shutdown();
+
+    if (!matched)
+    {
+        std::printf("\nFAIL: the radix sort's order didn't match std::stable_sort\n");
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,174 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+/**
+* Culls 1M bounding spheres against one camera's frustum. The spheres are
+* scattered through a cube around a 90 degree perspective camera so about
+* a sixth of them are visible. Times a loop of Frustum::Intersects as the
+* scalar reference, FrustumCuller::Cull on this thread, and Cull spread
+* across a JobScheduler for every worker count from 1 to
+* std::thread::hardware_concurrency(). Every result is checked against
+* the scalar one.
+*
+* FrustumCuller picks its SIMD path when it is compiled: add -mavx to
+* build the 8-wide AVX path; x86-64 builds use SSE otherwise.
+*
+* g++ -std=c++11 -O2 -pthread -Itests/support -Iinclude/unused
+*     tests/bench_frustumculler.cpp source/unused/ht_frustum.cpp source/unused/ht_frustumculler.cpp
+*     source/unused/ht_jobscheduler.cpp
+*/
+
+#include <ht_frustumculler.h>
+#include <algorithm>    //std::sort
+#include <chrono>       //std::chrono::steady_clock
+#include <cstdio>       //printf
+#include <random>       //std::mt19937
+#include <thread>       //std::thread::hardware_concurrency
+#include <vector>       //std::vector
+
+using namespace Hatchit;
+using namespace Hatchit::Graphics;
+
+static const size_t ObjectCount = 1000 * 1000;
+static const uint32_t Runs = 11;
+
+struct Scene
+{
+    std::vector<float>  x;
+    std::vector<float>  y;
+    std::vector<float>  z;
+    std::vector<float>  radius;
+
+    BoundingSphereSoA spheres() const
+    {
+        BoundingSphereSoA soa = { x.data(), y.data(), z.data(), radius.data() };
+        return soa;
+    }
+};
+
+template <typename Function>
+static double medianTime(Function function)
+{
+    std::vector<double> times(Runs);
+    for (uint32_t i = 0; i < Runs; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        times[i] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    std::sort(times.begin(), times.end());
+    return times[Runs / 2];
+}
+
+static Frustum makeFrustum()
+{
+    //Looking down -z with a 90 degree field of view, from 0.1 to 1000 units
+    const float nearZ = 0.1f;
+    const float farZ = 1000.0f;
+
+    Math::Matrix4 view = {};
+    Math::Matrix4 proj = {};
+    for (int i = 0; i < 4; i++)
+        view.m[i * 4 + i] = 1.0f;
+
+    proj.m[0] = 1.0f;
+    proj.m[5] = 1.0f;
+    proj.m[10] = (farZ + nearZ) / (nearZ - farZ);
+    proj.m[11] = 2.0f * farZ * nearZ / (nearZ - farZ);
+    proj.m[14] = -1.0f;
+
+    return Frustum(view, proj);
+}
+
+static size_t cullScalar(const Frustum& frustum, const Scene& scene, uint8_t* visible)
+{
+    size_t visibleCount = 0;
+    for (size_t i = 0; i < ObjectCount; i++)
+    {
+        BoundingSphere sphere = { scene.x[i], scene.y[i], scene.z[i], scene.radius[i] };
+        visible[i] = frustum.Intersects(sphere) ? 1 : 0;
+        visibleCount += visible[i];
+    }
+    return visibleCount;
+}
+
+int main()
+{
+    uint32_t hardwareThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+    Scene scene;
+    scene.x.resize(ObjectCount);
+    scene.y.resize(ObjectCount);
+    scene.z.resize(ObjectCount);
+    scene.radius.resize(ObjectCount);
+
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+    std::uniform_real_distribution<float> radius(0.5f, 5.0f);
+    for (size_t i = 0; i < ObjectCount; i++)
+    {
+        scene.x[i] = position(random);
+        scene.y[i] = position(random);
+        scene.z[i] = position(random);
+        scene.radius[i] = radius(random);
+    }
+
+    const Frustum frustum = makeFrustum();
+    const BoundingSphereSoA spheres = scene.spheres();
+
+    std::vector<uint8_t> expected(ObjectCount);
+    std::vector<uint8_t> visible(ObjectCount);
+
+    size_t expectedCount = 0;
+    double scalar = medianTime([&] { expectedCount = cullScalar(frustum, scene, expected.data()); });
+
+    std::printf("%zu spheres, %zu visible; median of %u culls\n\n", ObjectCount, expectedCount, Runs);
+    std::printf("%-22s %10s %10s %12s\n", "", "ms", "speedup", "Mspheres/s");
+    std::printf("%-22s %10.3f %10.2f %12.1f\n", "Frustum::Intersects", scalar, 1.0, ObjectCount / scalar / 1000.0);
+
+    bool matched = true;
+    size_t visibleCount = 0;
+
+    double simd = medianTime([&] { visibleCount = FrustumCuller::Cull(frustum, spheres, ObjectCount, visible.data()); });
+    matched = visibleCount == expectedCount && visible == expected && matched;
+    std::printf("%-22s %10.3f %10.2f %12.1f\n", "Cull, this thread", simd, scalar / simd, ObjectCount / simd / 1000.0);
+
+    for (uint32_t workers = 1; workers <= hardwareThreads; workers++)
+    {
+        JobScheduler scheduler;
+        if (!scheduler.Start(workers))
+        {
+            std::printf("Failed to start %u workers\n", workers);
+            return 1;
+        }
+
+        double parallel = medianTime([&] { visibleCount = FrustumCuller::Cull(frustum, spheres, ObjectCount, visible.data(), &scheduler); });
+        matched = visibleCount == expectedCount && visible == expected && matched;
+
+        char label[32];
+        std::snprintf(label, sizeof(label), "Cull, %u worker%s", workers, workers == 1 ? "" : "s");
+        std::printf("%-22s %10.3f %10.2f %12.1f\n", label, parallel, scalar / parallel, ObjectCount / parallel / 1000.0);
+
+        scheduler.Shutdown();
+    }
+
+    if (!matched)
+    {
+        std::printf("\nFAIL: FrustumCuller didn't agree with Frustum::Intersects\n");
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,159 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+/**
+* Records a frame of synthetic render passes through JobScheduler the way
+* Renderer::Render does: one job per pass, scheduled against a counter
+* the main thread waits on. Large passes split their draws into chunks
+* and wait on them from inside the job, as a VKRenderPass recording into
+* secondary command buffers does, so idle workers have to steal.
+*
+* A draw is a fixed amount of arithmetic standing in for the CPU cost of
+* recording it. Prints the median frame time for every worker count from
+* 1 to std::thread::hardware_concurrency() next to the time it takes one
+* thread to record every pass itself. The thread waiting on the frame
+* records too, so N workers means N + 1 threads doing the work.
+*
+* g++ -std=c++11 -O2 -pthread -Itests/support -Iinclude/unused
+*     tests/bench_jobscheduler.cpp source/unused/ht_jobscheduler.cpp
+*/
+
+#include <ht_jobscheduler.h>
+#include <algorithm>    //std::sort
+#include <chrono>       //std::chrono::steady_clock
+#include <cstdio>       //printf
+#include <thread>       //std::thread::hardware_concurrency
+#include <vector>       //std::vector
+
+using namespace Hatchit::Graphics;
+
+static const uint32_t PassCount = 48;
+static const uint32_t DrawsPerPass = 500;
+static const uint32_t LargePassEvery = 8;       //Every 8th pass has 16 times the draws
+static const uint32_t LargePassScale = 16;
+static const uint32_t DrawsPerChunk = 1000;     //Chunk size large passes split on
+static const uint32_t WorkPerDraw = 400;
+static const uint32_t Frames = 60;
+
+//Keeps the compiler from throwing the recording work away
+static std::vector<uint32_t> _PassResults(PassCount);
+
+static uint32_t drawCount(uint32_t pass)
+{
+    return (pass % LargePassEvery == 0) ? DrawsPerPass * LargePassScale : DrawsPerPass;
+}
+
+static uint32_t recordDraws(uint32_t pass, uint32_t begin, uint32_t end)
+{
+    uint32_t state = pass * 2654435761u;
+    for (uint32_t draw = begin; draw < end; draw++)
+    {
+        state ^= draw;
+        for (uint32_t i = 0; i < WorkPerDraw; i++)
+            state = state * 1664525u + 1013904223u;
+    }
+    return state;
+}
+
+static void recordPass(JobScheduler* scheduler, uint32_t pass)
+{
+    const uint32_t draws = drawCount(pass);
+
+    if (scheduler == nullptr || draws <= DrawsPerChunk)
+    {
+        _PassResults[pass] = recordDraws(pass, 0, draws);
+        return;
+    }
+
+    const uint32_t chunks = (draws + DrawsPerChunk - 1) / DrawsPerChunk;
+    std::vector<uint32_t> results(chunks);
+
+    JobCounter counter;
+    for (uint32_t c = 0; c < chunks; c++)
+    {
+        scheduler->Schedule([pass, c, draws, &results](uint32_t)
+        {
+            results[c] = recordDraws(pass, c * DrawsPerChunk, std::min(draws, (c + 1) * DrawsPerChunk));
+        }, &counter);
+    }
+    scheduler->Wait(&counter);
+
+    uint32_t result = 0;
+    for (uint32_t c = 0; c < chunks; c++)
+        result ^= results[c];
+    _PassResults[pass] = result;
+}
+
+static double recordFrame(JobScheduler* scheduler)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    if (scheduler == nullptr)
+    {
+        for (uint32_t pass = 0; pass < PassCount; pass++)
+            recordPass(nullptr, pass);
+    }
+    else
+    {
+        JobCounter recorded;
+        for (uint32_t pass = 0; pass < PassCount; pass++)
+            scheduler->Schedule([scheduler, pass](uint32_t) { recordPass(scheduler, pass); }, &recorded);
+        scheduler->Wait(&recorded);
+    }
+
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static double medianFrame(JobScheduler* scheduler)
+{
+    //Let the workers spin up before timing
+    for (uint32_t i = 0; i < 5; i++)
+        recordFrame(scheduler);
+
+    std::vector<double> times(Frames);
+    for (uint32_t i = 0; i < Frames; i++)
+        times[i] = recordFrame(scheduler);
+
+    std::sort(times.begin(), times.end());
+    return times[Frames / 2];
+}
+
+int main()
+{
+    uint32_t hardwareThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+    std::printf("%u passes, %u of them with %u draws and the rest with %u; median of %u frames\n\n",
+        PassCount, PassCount / LargePassEvery, DrawsPerPass * LargePassScale, DrawsPerPass, Frames);
+
+    double serial = medianFrame(nullptr);
+    std::printf("%8s %8s %12s %8s\n", "workers", "threads", "frame ms", "speedup");
+    std::printf("%8s %8u %12.3f %8.2f\n", "serial", 1u, serial, 1.0);
+
+    for (uint32_t workers = 1; workers <= hardwareThreads; workers++)
+    {
+        JobScheduler scheduler;
+        if (!scheduler.Start(workers))
+        {
+            std::printf("Failed to start %u workers\n", workers);
+            return 1;
+        }
+
+        double frame = medianFrame(&scheduler);
+        std::printf("%8u %8u %12.3f %8.2f\n", workers, scheduler.GetContextCount(), frame, serial / frame);
+
+        scheduler.Shutdown();
+    }
+
+    return 0;
+}
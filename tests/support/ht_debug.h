@@ -0,0 +1,25 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+/**
+* Stands in for HatchitCore's ht_debug.h so the tests in this directory
+* build with nothing but a compiler.
+*/
+
+#pragma once
+
+#include <cstdio>   //fprintf
+
+#define HT_DEBUG_PRINTF(...) std::fprintf(stderr, __VA_ARGS__)
+#define HT_ERROR_PRINTF(...) std::fprintf(stderr, __VA_ARGS__)
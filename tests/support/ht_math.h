@@ -0,0 +1,49 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+/**
+* Stands in for HatchitMath's ht_math.h so the tests in this directory
+* build with nothing but a compiler. Only what the CPU side of the
+* renderer uses is here: a Matrix4 of 16 packed floats, stored a row at a
+* time, and its product.
+*/
+
+#pragma once
+
+namespace Hatchit
+{
+    namespace Math
+    {
+        struct Matrix4
+        {
+            float m[16];
+
+            Matrix4 operator*(const Matrix4& other) const
+            {
+                Matrix4 result;
+                for (int row = 0; row < 4; row++)
+                {
+                    for (int column = 0; column < 4; column++)
+                    {
+                        float sum = 0.0f;
+                        for (int k = 0; k < 4; k++)
+                            sum += m[row * 4 + k] * other.m[k * 4 + column];
+                        result.m[row * 4 + column] = sum;
+                    }
+                }
+                return result;
+            }
+        };
+    }
+}
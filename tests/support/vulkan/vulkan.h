@@ -0,0 +1,168 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+/**
+* Stands in for the Vulkan SDK's vulkan.h so the memory allocator tests
+* build with nothing but a compiler. Only the types and constants the
+* allocator and ht_vulkan.h name are here, with the same values as the
+* real header. The entry points never reach a driver; they fail, so a
+* test has to hand the allocator its own VKMemoryFunctions.
+*/
+
+#pragma once
+
+#include <cstddef>  //size_t
+#include <cstdint>  //uint32_t & uint64_t
+
+#define VK_DEFINE_HANDLE(object) typedef struct object##_T* object;
+
+VK_DEFINE_HANDLE(VkDevice)
+VK_DEFINE_HANDLE(VkDeviceMemory)
+VK_DEFINE_HANDLE(VkBuffer)
+VK_DEFINE_HANDLE(VkImage)
+
+#define VK_NULL_HANDLE nullptr
+#define VK_WHOLE_SIZE (~0ULL)
+#define VK_MAX_MEMORY_TYPES 32
+#define VK_MAX_MEMORY_HEAPS 16
+
+typedef uint32_t VkFlags;
+typedef uint64_t VkDeviceSize;
+typedef VkFlags VkMemoryPropertyFlags;
+typedef VkFlags VkMemoryHeapFlags;
+typedef VkFlags VkMemoryMapFlags;
+
+typedef enum VkResult
+{
+    VK_SUCCESS = 0,
+    VK_ERROR_OUT_OF_HOST_MEMORY = -1,
+    VK_ERROR_OUT_OF_DEVICE_MEMORY = -2,
+    VK_ERROR_INITIALIZATION_FAILED = -3,
+    VK_ERROR_MEMORY_MAP_FAILED = -5
+} VkResult;
+
+typedef enum VkStructureType
+{
+    VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO = 5
+} VkStructureType;
+
+typedef enum VkMemoryPropertyFlagBits
+{
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT = 0x00000001,
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT = 0x00000002,
+    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT = 0x00000004,
+    VK_MEMORY_PROPERTY_HOST_CACHED_BIT = 0x00000008,
+    VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT = 0x00000010
+} VkMemoryPropertyFlagBits;
+
+typedef enum VkMemoryHeapFlagBits
+{
+    VK_MEMORY_HEAP_DEVICE_LOCAL_BIT = 0x00000001
+} VkMemoryHeapFlagBits;
+
+typedef struct VkAllocationCallbacks VkAllocationCallbacks;
+
+typedef struct VkMemoryRequirements
+{
+    VkDeviceSize    size;
+    VkDeviceSize    alignment;
+    uint32_t        memoryTypeBits;
+} VkMemoryRequirements;
+
+typedef struct VkMemoryType
+{
+    VkMemoryPropertyFlags   propertyFlags;
+    uint32_t                heapIndex;
+} VkMemoryType;
+
+typedef struct VkMemoryHeap
+{
+    VkDeviceSize        size;
+    VkMemoryHeapFlags   flags;
+} VkMemoryHeap;
+
+typedef struct VkPhysicalDeviceMemoryProperties
+{
+    uint32_t        memoryTypeCount;
+    VkMemoryType    memoryTypes[VK_MAX_MEMORY_TYPES];
+    uint32_t        memoryHeapCount;
+    VkMemoryHeap    memoryHeaps[VK_MAX_MEMORY_HEAPS];
+} VkPhysicalDeviceMemoryProperties;
+
+typedef struct VkMemoryAllocateInfo
+{
+    VkStructureType sType;
+    const void*     pNext;
+    VkDeviceSize    allocationSize;
+    uint32_t        memoryTypeIndex;
+} VkMemoryAllocateInfo;
+
+typedef VkResult (*PFN_vkAllocateMemory)(VkDevice device, const VkMemoryAllocateInfo* pAllocateInfo,
+    const VkAllocationCallbacks* pAllocator, VkDeviceMemory* pMemory);
+typedef void (*PFN_vkFreeMemory)(VkDevice device, VkDeviceMemory memory, const VkAllocationCallbacks* pAllocator);
+typedef VkResult (*PFN_vkMapMemory)(VkDevice device, VkDeviceMemory memory, VkDeviceSize offset,
+    VkDeviceSize size, VkMemoryMapFlags flags, void** ppData);
+typedef void (*PFN_vkUnmapMemory)(VkDevice device, VkDeviceMemory memory);
+
+//Only ever declared by ht_vulkan.h; nothing here calls them
+typedef void (*PFN_vkGetPhysicalDeviceSurfaceSupportKHR)(void);
+typedef void (*PFN_vkGetPhysicalDeviceSurfaceCapabilitiesKHR)(void);
+typedef void (*PFN_vkGetPhysicalDeviceSurfaceFormatsKHR)(void);
+typedef void (*PFN_vkGetPhysicalDeviceSurfacePresentModesKHR)(void);
+typedef void (*PFN_vkCreateDebugReportCallbackEXT)(void);
+typedef void (*PFN_vkDestroyDebugReportCallbackEXT)(void);
+typedef void (*PFN_vkDebugReportMessageEXT)(void);
+typedef void (*PFN_vkCreateSwapchainKHR)(void);
+typedef void (*PFN_vkDestroySwapchainKHR)(void);
+typedef void (*PFN_vkGetSwapchainImagesKHR)(void);
+typedef void (*PFN_vkAcquireNextImageKHR)(void);
+typedef void (*PFN_vkQueuePresentKHR)(void);
+
+inline VkResult vkAllocateMemory(VkDevice, const VkMemoryAllocateInfo*, const VkAllocationCallbacks*, VkDeviceMemory*)
+{
+    return VK_ERROR_INITIALIZATION_FAILED;
+}
+
+inline void vkFreeMemory(VkDevice, VkDeviceMemory, const VkAllocationCallbacks*)
+{
+}
+
+inline VkResult vkMapMemory(VkDevice, VkDeviceMemory, VkDeviceSize, VkDeviceSize, VkMemoryMapFlags, void**)
+{
+    return VK_ERROR_MEMORY_MAP_FAILED;
+}
+
+inline void vkUnmapMemory(VkDevice, VkDeviceMemory)
+{
+}
+
+inline void vkGetBufferMemoryRequirements(VkDevice, VkBuffer, VkMemoryRequirements* pMemoryRequirements)
+{
+    *pMemoryRequirements = VkMemoryRequirements();
+}
+
+inline void vkGetImageMemoryRequirements(VkDevice, VkImage, VkMemoryRequirements* pMemoryRequirements)
+{
+    *pMemoryRequirements = VkMemoryRequirements();
+}
+
+inline VkResult vkBindBufferMemory(VkDevice, VkBuffer, VkDeviceMemory, VkDeviceSize)
+{
+    return VK_ERROR_INITIALIZATION_FAILED;
+}
+
+inline VkResult vkBindImageMemory(VkDevice, VkImage, VkDeviceMemory, VkDeviceSize)
+{
+    return VK_ERROR_INITIALIZATION_FAILED;
+}
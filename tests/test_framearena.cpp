@@ -0,0 +1,280 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+/**
+* Builds the same frame over and over the way a render pass does: requests
+* are pushed through a SubmissionQueue and gathered, culled, turned into
+* draw keys and sorted, then grouped into a pipeline list with per-draw
+* instance data, all in a FrameArena that is reset after every frame.
+*
+* Every operator new in the program is counted. Once the first frames have
+* grown the arena and the gather buffer, a frame must not touch the heap
+* at all; a stray std::vector or std::map anywhere in frame construction
+* shows up as a non-zero count. Also checks that a FrameAllocator that
+* can't get memory throws std::bad_alloc.
+*
+* g++ -std=c++11 -pthread -Itests/support -Iinclude/unused tests/test_framearena.cpp
+*     source/unused/ht_framearena.cpp source/unused/ht_submissionqueue.cpp source/unused/ht_drawkey.cpp
+*     source/unused/ht_frustum.cpp source/unused/ht_frustumculler.cpp source/unused/ht_jobscheduler.cpp
+*/
+
+#include <ht_framearena.h>
+#include <ht_submissionqueue.h>
+#include <ht_drawkey.h>
+#include <ht_frustumculler.h>
+#include <atomic>   //std::atomic
+#include <cstdio>   //printf
+#include <cstdlib>  //std::malloc & std::free
+#include <new>      //std::bad_alloc
+#include <vector>   //std::vector
+
+using namespace Hatchit;
+using namespace Hatchit::Graphics;
+
+//Every heap allocation made anywhere in the program
+static std::atomic<uint64_t> _HeapAllocations(0);
+
+void* operator new(size_t size)
+{
+    _HeapAllocations++;
+    void* memory = std::malloc(size > 0 ? size : 1);
+    if (memory == nullptr)
+        throw std::bad_alloc();
+    return memory;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+    std::free(memory);
+}
+
+static const uint32_t WarmupFrames = 4;
+static const uint32_t Frames = 1000;
+static const uint32_t RequestsPerFrame = 4096;
+
+struct Request
+{
+    uint32_t        pipeline;
+    uint32_t        material;
+    uint32_t        mesh;
+    const void*     instanceData;
+    BoundingSphere  bounds;
+    uint64_t        sortKey;
+};
+
+struct Draw
+{
+    uint32_t    material;
+    uint32_t    mesh;
+    uint32_t    count;
+    uint32_t    instanceIndex;
+};
+
+struct PipelineDraws
+{
+    uint32_t            pipeline;
+    FrameVector<Draw>   draws;
+};
+
+struct InstanceData
+{
+    FrameVector<const void*>        chunks;
+    FrameVector<BoundingSphere>     bounds;
+};
+
+//What a render pass keeps from one frame to the next
+struct Pass
+{
+    SubmissionQueue<Request>    submissions;
+    std::vector<Request>        requests;   //Cleared, never shrunk
+    FrameArena                  arena;
+};
+
+//Stands in for the requests a scene schedules; the same every frame
+static Request makeRequest(uint32_t i)
+{
+    Request request = {};
+    request.pipeline = i % 4;
+    request.material = (i / 4) % 32;
+    request.mesh = (i / 128) % 8;
+    request.instanceData = reinterpret_cast<const void*>(static_cast<uintptr_t>(i + 1) * 16);
+
+    //Spread over twice the view volume so about half are culled
+    request.bounds.x = static_cast<float>(i % 16) / 4.0f - 2.0f;
+    request.bounds.y = static_cast<float>((i / 16) % 16) / 4.0f - 2.0f;
+    request.bounds.z = static_cast<float>((i / 256) % 16) / 8.0f - 1.0f;
+    request.bounds.radius = 0.1f;
+
+    request.sortKey = DrawKeySorter::MakeKey(request.pipeline, request.material, request.mesh, static_cast<float>(i % 100) / 100.0f);
+    return request;
+}
+
+//Gather, cull, sort and group one frame; returns how many instances were drawn
+static size_t buildFrame(Pass& pass, const Frustum& frustum)
+{
+    for (uint32_t i = 0; i < RequestsPerFrame; i++)
+        pass.submissions.Push(makeRequest(i));
+
+    pass.submissions.Gather(pass.requests);
+
+    FrameArena& arena = pass.arena;
+    const size_t count = pass.requests.size();
+
+    FrameVector<float> x(count, 0.0f, FrameAllocator<float>(&arena));
+    FrameVector<float> y(count, 0.0f, FrameAllocator<float>(&arena));
+    FrameVector<float> z(count, 0.0f, FrameAllocator<float>(&arena));
+    FrameVector<float> radius(count, 0.0f, FrameAllocator<float>(&arena));
+    for (size_t i = 0; i < count; i++)
+    {
+        x[i] = pass.requests[i].bounds.x;
+        y[i] = pass.requests[i].bounds.y;
+        z[i] = pass.requests[i].bounds.z;
+        radius[i] = pass.requests[i].bounds.radius;
+    }
+
+    FrameVector<uint8_t> visible(count, 1, FrameAllocator<uint8_t>(&arena));
+    BoundingSphereSoA spheres = { x.data(), y.data(), z.data(), radius.data() };
+    size_t visibleCount = FrustumCuller::Cull(frustum, spheres, count, visible.data());
+
+    FrameVector<DrawKey> keys(visibleCount, DrawKey(), FrameAllocator<DrawKey>(&arena));
+    FrameVector<DrawKey> scratch(visibleCount, DrawKey(), FrameAllocator<DrawKey>(&arena));
+    for (size_t i = 0, k = 0; i < count; i++)
+    {
+        if (!visible[i])
+            continue;
+
+        keys[k].key = pass.requests[i].sortKey;
+        keys[k].index = static_cast<uint32_t>(i);
+        k++;
+    }
+
+    DrawKeySorter::Sort(keys.data(), scratch.data(), visibleCount);
+
+    FrameVector<PipelineDraws> pipelineList{ FrameAllocator<PipelineDraws>(&arena) };
+    FrameVector<InstanceData> instanceData{ FrameAllocator<InstanceData>(&arena) };
+    for (size_t k = 0; k < visibleCount; k++)
+    {
+        const Request& request = pass.requests[keys[k].index];
+
+        if (pipelineList.empty() || pipelineList.back().pipeline != request.pipeline)
+            pipelineList.push_back({ request.pipeline, FrameVector<Draw>(FrameAllocator<Draw>(&arena)) });
+
+        FrameVector<Draw>& draws = pipelineList.back().draws;
+        if (!draws.empty() && draws.back().material == request.material && draws.back().mesh == request.mesh)
+        {
+            draws.back().count++;
+            instanceData[draws.back().instanceIndex].chunks.push_back(request.instanceData);
+            instanceData[draws.back().instanceIndex].bounds.push_back(request.bounds);
+            continue;
+        }
+
+        draws.push_back({ request.material, request.mesh, 1, static_cast<uint32_t>(instanceData.size()) });
+        instanceData.push_back({ FrameVector<const void*>(FrameAllocator<const void*>(&arena)),
+            FrameVector<BoundingSphere>(FrameAllocator<BoundingSphere>(&arena)) });
+        instanceData.back().chunks.push_back(request.instanceData);
+        instanceData.back().bounds.push_back(request.bounds);
+    }
+
+    size_t drawn = 0;
+    for (size_t i = 0; i < instanceData.size(); i++)
+        drawn += instanceData[i].chunks.size();
+
+    pass.requests.clear();
+    return drawn;
+}
+
+int main()
+{
+    //Identity matrices leave the frustum as the clip volume, -1 to 1 on every axis
+    Math::Matrix4 identity = {};
+    for (int i = 0; i < 4; i++)
+        identity.m[i * 4 + i] = 1.0f;
+    const Frustum frustum(identity, identity);
+
+    Pass pass;
+
+    size_t drawn = 0;
+    for (uint32_t frame = 0; frame < WarmupFrames; frame++)
+    {
+        drawn = buildFrame(pass, frustum);
+        pass.arena.Reset();
+    }
+
+    if (drawn == 0 || drawn == RequestsPerFrame)
+    {
+        std::printf("FAIL: expected some but not all of %u requests to be culled, drew %zu\n", RequestsPerFrame, drawn);
+        return 1;
+    }
+
+    const uint32_t arenaAllocations = pass.arena.GetStats().heapAllocations;
+
+    for (uint32_t frame = 0; frame < Frames; frame++)
+    {
+        const uint64_t before = _HeapAllocations.load();
+        size_t frameDrawn = buildFrame(pass, frustum);
+        pass.arena.Reset();
+        const uint64_t allocations = _HeapAllocations.load() - before;
+
+        if (allocations != 0)
+        {
+            std::printf("FAIL: frame %u made %llu heap allocations after warm-up\n", frame, static_cast<unsigned long long>(allocations));
+            return 1;
+        }
+
+        if (frameDrawn != drawn)
+        {
+            std::printf("FAIL: frame %u drew %zu instances, expected %zu\n", frame, frameDrawn, drawn);
+            return 1;
+        }
+
+        FrameArenaStats stats = pass.arena.GetStats();
+        if (stats.heapAllocations != arenaAllocations || stats.blockCount != 1 || stats.bytesUsed != 0)
+        {
+            std::printf("FAIL: frame %u left the arena with %u heap allocations over %u blocks and %zu bytes in use\n",
+                frame, stats.heapAllocations, stats.blockCount, stats.bytesUsed);
+            return 1;
+        }
+    }
+
+    //More than can be addressed can never be allocated
+    bool threw = false;
+    try
+    {
+        FrameAllocator<uint64_t> allocator(&pass.arena);
+        allocator.allocate(static_cast<size_t>(-1) / 4);
+    }
+    catch (const std::bad_alloc&)
+    {
+        threw = true;
+    }
+
+    if (!threw)
+    {
+        std::printf("FAIL: an allocation too big to fit didn't throw std::bad_alloc\n");
+        return 1;
+    }
+
+    std::printf("PASS: %u frames of %u requests made no heap allocations after warm-up\n", Frames, RequestsPerFrame);
+    return 0;
+}
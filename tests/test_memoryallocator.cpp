@@ -0,0 +1,487 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+/**
+* Drives VKMemoryAllocator against a made up device: a 1 GB device local
+* heap and a 256 MB host visible one, with 1 MB blocks. The allocator's
+* VKMemoryFunctions are stubs that hand out host memory and count what is
+* live, so the test can see every block the allocator takes and returns.
+*
+* Covers buddy splitting and merging, alignment, keeping linear and
+* optimal resources apart when bufferImageGranularity needs it, dedicated
+* allocations above half a block, per-category heap usage, Defragment
+* with a move callback that succeeds and one that refuses, and the
+* fragmentation GetStats reports.
+*
+* g++ -std=c++11 -pthread -Itests/support -Iinclude/vulkan -Iinclude/unused/vulkan
+*     tests/test_memoryallocator.cpp source/unused/vulkan/ht_vkmemoryallocator.cpp
+*/
+
+#include <ht_vkmemoryallocator.h>
+#include <algorithm>  //std::fill_n & std::copy_n
+#include <cmath>      //std::fabs
+#include <cstdio>     //printf
+#include <map>        //std::map
+#include <vector>     //std::vector
+
+using namespace Hatchit::Graphics::Vulkan;
+
+static const VkDeviceSize KB = 1024;
+static const VkDeviceSize MB = 1024 * 1024;
+static const VkDeviceSize BlockSize = 1 * MB;
+
+static const uint32_t DeviceLocalType = 0;
+static const uint32_t HostVisibleType = 1;
+
+//Memory the stub driver has handed out, by handle
+static std::map<VkDeviceMemory, std::vector<uint8_t>> _DriverMemory;
+static uintptr_t _NextHandle = 1;
+static uint32_t _MappedCount = 0;
+
+static VkResult stubAllocate(VkDevice, const VkMemoryAllocateInfo* pAllocateInfo, const VkAllocationCallbacks*, VkDeviceMemory* pMemory)
+{
+    VkDeviceMemory memory = reinterpret_cast<VkDeviceMemory>(_NextHandle++);
+    _DriverMemory[memory].resize(static_cast<size_t>(pAllocateInfo->allocationSize));
+    *pMemory = memory;
+    return VK_SUCCESS;
+}
+
+static void stubFree(VkDevice, VkDeviceMemory memory, const VkAllocationCallbacks*)
+{
+    _DriverMemory.erase(memory);
+}
+
+static VkResult stubMap(VkDevice, VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize, VkMemoryMapFlags, void** ppData)
+{
+    _MappedCount++;
+    *ppData = _DriverMemory[memory].data() + offset;
+    return VK_SUCCESS;
+}
+
+static void stubUnmap(VkDevice, VkDeviceMemory)
+{
+    _MappedCount--;
+}
+
+static const VKMemoryFunctions _StubFunctions = { stubAllocate, stubFree, stubMap, stubUnmap };
+
+static VkPhysicalDeviceMemoryProperties makeMemoryProperties()
+{
+    VkPhysicalDeviceMemoryProperties properties = {};
+
+    properties.memoryHeapCount = 2;
+    properties.memoryHeaps[0].size = 1024 * MB;
+    properties.memoryHeaps[0].flags = VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+    properties.memoryHeaps[1].size = 256 * MB;
+
+    properties.memoryTypeCount = 2;
+    properties.memoryTypes[DeviceLocalType].propertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    properties.memoryTypes[DeviceLocalType].heapIndex = 0;
+    properties.memoryTypes[HostVisibleType].propertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    properties.memoryTypes[HostVisibleType].heapIndex = 1;
+
+    return properties;
+}
+
+static void initialize(VKMemoryAllocator& allocator, VkDeviceSize bufferImageGranularity)
+{
+    allocator.Initialize(VK_NULL_HANDLE, makeMemoryProperties(), bufferImageGranularity, &_StubFunctions, BlockSize);
+}
+
+static VkMemoryRequirements requirements(VkDeviceSize size, VkDeviceSize alignment = 1)
+{
+    VkMemoryRequirements memReqs = {};
+    memReqs.size = size;
+    memReqs.alignment = alignment;
+    memReqs.memoryTypeBits = ~0u;
+    return memReqs;
+}
+
+static bool allocate(VKMemoryAllocator& allocator, VkDeviceSize size, VKAllocation& allocation,
+    VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, bool linear = true,
+    VKMemoryCategory category = VKMemoryCategory::Other, void* userData = nullptr)
+{
+    allocation = {};
+    return allocator.Allocate(requirements(size), properties, linear, allocation, category, userData);
+}
+
+static bool fail(const char* message)
+{
+    std::printf("FAIL: %s\n", message);
+    return false;
+}
+
+//Ranges split down from the whole block and merge back into it
+static bool testBuddy()
+{
+    VKMemoryAllocator allocator;
+    initialize(allocator, 1);
+
+    VKAllocation a, b, c, d;
+    if (!allocate(allocator, 256, a) || !allocate(allocator, 256, b) || !allocate(allocator, 1 * KB, c) || !allocate(allocator, 300, d))
+        return fail("buddy: allocation failed");
+
+    if (a.offset != 0 || b.offset != 256 || c.offset != 1 * KB || d.offset != 512)
+        return fail("buddy: ranges weren't split from the bottom of the block");
+    if (a.memory != b.memory || b.memory != c.memory || c.memory != d.memory)
+        return fail("buddy: small ranges didn't share a block");
+    if (d.size != 512)
+        return fail("buddy: a 300 byte request wasn't rounded up to 512");
+    if (_DriverMemory.size() != 1)
+        return fail("buddy: more than one block was taken from the driver");
+
+    VKMemoryStats stats = allocator.GetStats();
+    if (stats.blockCount != 1 || stats.allocationCount != 4 || stats.bytesUsed != 2 * KB || stats.bytesFree != BlockSize - 2 * KB)
+        return fail("buddy: stats don't match the live ranges");
+    if (stats.largestFreeRange != BlockSize / 2)
+        return fail("buddy: the upper half of the block wasn't left whole");
+
+    //a's buddy is b, so freeing a alone can't merge
+    allocator.Free(a);
+    if (a.memory != VK_NULL_HANDLE)
+        return fail("buddy: Free didn't clear the allocation");
+
+    VKAllocation e;
+    if (!allocate(allocator, 256, e) || e.offset != 0)
+        return fail("buddy: a freed range wasn't reused");
+
+    allocator.Free(e);
+    allocator.Free(b);
+    allocator.Free(d);
+    allocator.Free(c);
+
+    stats = allocator.GetStats();
+    if (stats.allocationCount != 0 || stats.bytesUsed != 0 || stats.largestFreeRange != BlockSize || stats.fragmentation != 0.0f)
+        return fail("buddy: freed ranges didn't merge back into the whole block");
+
+    //The last block of a kind is kept for the next allocation
+    if (stats.blockCount != 1 || _DriverMemory.size() != 1)
+        return fail("buddy: the only block was given back to the driver");
+
+    allocator.DeInitialize();
+    if (!_DriverMemory.empty())
+        return fail("buddy: DeInitialize left memory with the driver");
+
+    return true;
+}
+
+//Alignment above the size is honoured by rounding the range up
+static bool testAlignment()
+{
+    VKMemoryAllocator allocator;
+    initialize(allocator, 1);
+
+    VKAllocation small, aligned;
+    if (!allocate(allocator, 256, small))
+        return fail("alignment: allocation failed");
+    if (!allocator.Allocate(requirements(256, 64 * KB), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true, aligned))
+        return fail("alignment: aligned allocation failed");
+
+    if (aligned.offset % (64 * KB) != 0 || aligned.offset == 0)
+        return fail("alignment: range isn't aligned past the range already in use");
+    if (aligned.size < 64 * KB)
+        return fail("alignment: range wasn't rounded up to its alignment");
+
+    allocator.Free(small);
+    allocator.Free(aligned);
+    allocator.DeInitialize();
+    return true;
+}
+
+//Linear and optimal resources only get their own blocks when the granularity is coarser than a range
+static bool testGranularity()
+{
+    VKMemoryAllocator coarse;
+    initialize(coarse, 4 * KB);
+
+    VKAllocation linear, optimal;
+    if (!allocate(coarse, 256, linear, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true) ||
+        !allocate(coarse, 256, optimal, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false))
+        return fail("granularity: allocation failed");
+
+    if (linear.memory == optimal.memory)
+        return fail("granularity: linear and optimal ranges shared a block under a 4 KB granularity");
+    if (coarse.GetStats().blockCount != 2)
+        return fail("granularity: expected one block for each tiling");
+
+    //Another linear range goes with the first one
+    VKAllocation linear2;
+    if (!allocate(coarse, 256, linear2, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true) || linear2.memory != linear.memory)
+        return fail("granularity: a second linear range didn't join the linear block");
+
+    coarse.Free(linear);
+    coarse.Free(linear2);
+    coarse.Free(optimal);
+    coarse.DeInitialize();
+
+    //Every range is 256 byte aligned, so a 256 byte granularity never needs padding
+    VKMemoryAllocator fine;
+    initialize(fine, 256);
+
+    if (!allocate(fine, 256, linear, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true) ||
+        !allocate(fine, 256, optimal, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false))
+        return fail("granularity: allocation failed");
+
+    if (linear.memory != optimal.memory)
+        return fail("granularity: linear and optimal ranges were kept apart when they didn't need to be");
+
+    fine.Free(linear);
+    fine.Free(optimal);
+    fine.DeInitialize();
+    return true;
+}
+
+//More than half a block gets memory of its own
+static bool testDedicated()
+{
+    VKMemoryAllocator allocator;
+    initialize(allocator, 1);
+
+    VKAllocation half, big;
+    if (!allocate(allocator, BlockSize / 2, half) || !allocate(allocator, BlockSize / 2 + 1, big))
+        return fail("dedicated: allocation failed");
+
+    VKMemoryStats stats = allocator.GetStats();
+    if (stats.blockCount != 1 || stats.dedicatedCount != 1 || stats.allocationCount != 2)
+        return fail("dedicated: expected half a block shared and anything larger dedicated");
+    if (big.offset != 0 || big.size != BlockSize / 2 + 1 || big.memory == half.memory)
+        return fail("dedicated: the dedicated range isn't its own memory of exactly the requested size");
+    if (_DriverMemory[big.memory].size() != BlockSize / 2 + 1)
+        return fail("dedicated: the driver wasn't asked for exactly the requested size");
+
+    allocator.Free(big);
+    stats = allocator.GetStats();
+    if (stats.dedicatedCount != 0 || _DriverMemory.size() != 1)
+        return fail("dedicated: freeing a dedicated range didn't give its memory back");
+
+    allocator.Free(half);
+    allocator.DeInitialize();
+    return true;
+}
+
+//Usage is accounted by heap and category, and host visible memory comes back mapped
+static bool testHeapUsage()
+{
+    VKMemoryAllocator allocator;
+    initialize(allocator, 1);
+
+    VKAllocation texture, mesh, staging;
+    if (!allocate(allocator, 1 * KB, texture, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false, VKMemoryCategory::Texture) ||
+        !allocate(allocator, 600 * KB, mesh, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true, VKMemoryCategory::Mesh) ||
+        !allocate(allocator, 300, staging, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, true, VKMemoryCategory::Staging))
+        return fail("heap usage: allocation failed");
+
+    if (texture.memoryType != DeviceLocalType || staging.memoryType != HostVisibleType)
+        return fail("heap usage: ranges came from the wrong memory types");
+    if (texture.mapped != nullptr)
+        return fail("heap usage: device local memory was mapped");
+    if (staging.mapped != _DriverMemory[staging.memory].data() + staging.offset || _MappedCount != 1)
+        return fail("heap usage: host visible memory isn't mapped at the range");
+
+    VKHeapUsage device = allocator.GetHeapUsage(0);
+    VKHeapUsage host = allocator.GetHeapUsage(1);
+
+    if (device.reserved != BlockSize + 600 * KB || host.reserved != BlockSize)
+        return fail("heap usage: reserved memory doesn't match the blocks taken");
+    if (device.categories[static_cast<uint32_t>(VKMemoryCategory::Texture)] != 1 * KB ||
+        device.categories[static_cast<uint32_t>(VKMemoryCategory::Mesh)] != 600 * KB ||
+        device.categories[static_cast<uint32_t>(VKMemoryCategory::Staging)] != 0)
+        return fail("heap usage: device local categories are wrong");
+    if (host.categories[static_cast<uint32_t>(VKMemoryCategory::Staging)] != 512 ||
+        host.categories[static_cast<uint32_t>(VKMemoryCategory::Texture)] != 0)
+        return fail("heap usage: host visible categories are wrong");
+
+    allocator.Free(texture);
+    allocator.Free(mesh);
+    allocator.Free(staging);
+
+    device = allocator.GetHeapUsage(0);
+    host = allocator.GetHeapUsage(1);
+    for (uint32_t i = 0; i < static_cast<uint32_t>(VKMemoryCategory::Count); i++)
+    {
+        if (device.categories[i] != 0 || host.categories[i] != 0)
+            return fail("heap usage: freed memory is still accounted");
+    }
+
+    allocator.DeInitialize();
+    if (_MappedCount != 0)
+        return fail("heap usage: DeInitialize left memory mapped");
+
+    return true;
+}
+
+//Four quarter blocks with every other one freed leave half the block free in two pieces
+static bool testFragmentation()
+{
+    VKMemoryAllocator allocator;
+    initialize(allocator, 1);
+
+    VKAllocation quarters[4];
+    for (int i = 0; i < 4; i++)
+    {
+        if (!allocate(allocator, BlockSize / 4, quarters[i]))
+            return fail("fragmentation: allocation failed");
+    }
+
+    if (allocator.GetStats().fragmentation != 0.0f || allocator.GetStats().bytesFree != 0)
+        return fail("fragmentation: a full block reported free memory");
+
+    allocator.Free(quarters[0]);
+    allocator.Free(quarters[2]);
+
+    VKMemoryStats stats = allocator.GetStats();
+    if (stats.bytesFree != BlockSize / 2 || stats.largestFreeRange != BlockSize / 4)
+        return fail("fragmentation: free memory doesn't match the freed ranges");
+    if (std::fabs(stats.fragmentation - 0.5f) > 0.0001f)
+        return fail("fragmentation: expected 0.5 with free memory split in two");
+
+    allocator.Free(quarters[1]);
+    stats = allocator.GetStats();
+    if (stats.largestFreeRange != BlockSize / 2 || std::fabs(stats.fragmentation - (1.0f / 3.0f)) > 0.0001f)
+        return fail("fragmentation: a freed range didn't merge with its buddy");
+
+    allocator.Free(quarters[3]);
+    if (allocator.GetStats().fragmentation != 0.0f)
+        return fail("fragmentation: an empty block reported fragmentation");
+
+    allocator.DeInitialize();
+    return true;
+}
+
+//Leaves two blocks of the same kind: the first half used by kept, the second holding only moved
+static bool setUpDefragment(VKMemoryAllocator& allocator, VKAllocation& kept, VKAllocation& moved)
+{
+    initialize(allocator, 1);
+
+    VKAllocation extra;
+    if (!allocate(allocator, BlockSize / 2, kept, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, true, VKMemoryCategory::Mesh) ||
+        !allocate(allocator, BlockSize / 2, extra, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, true, VKMemoryCategory::Mesh) ||
+        !allocate(allocator, BlockSize / 4, moved, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, true, VKMemoryCategory::Uniform, &moved))
+        return fail("defragment: allocation failed");
+
+    if (moved.memory == kept.memory)
+        return fail("defragment: the last range should have needed a second block");
+
+    allocator.Free(extra);
+    return true;
+}
+
+static bool testDefragment()
+{
+    VKAllocation kept, moved;
+
+    //A callback that moves the range empties the second block
+    {
+        VKMemoryAllocator allocator;
+        if (!setUpDefragment(allocator, kept, moved))
+            return false;
+
+        const VkDeviceMemory source = moved.memory;
+        std::fill_n(static_cast<uint8_t*>(moved.mapped), BlockSize / 4, 0xAB);
+
+        VKHeapUsage before = allocator.GetHeapUsage(1);
+
+        uint32_t calls = 0;
+        allocator.SetMoveCallback([&calls](const VKAllocation& from, const VKAllocation& to)
+        {
+            calls++;
+            std::copy_n(static_cast<const uint8_t*>(from.mapped), from.size, static_cast<uint8_t*>(to.mapped));
+            *static_cast<VKAllocation*>(from.userData) = to;
+            return true;
+        });
+
+        if (allocator.Defragment(16) != 1 || calls != 1)
+            return fail("defragment: expected exactly one range to move");
+        if (moved.memory != kept.memory || moved.memory == source || moved.category != VKMemoryCategory::Uniform)
+            return fail("defragment: the range wasn't moved into the fuller block");
+        if (_DriverMemory.count(source) != 0 || allocator.GetStats().blockCount != 1)
+            return fail("defragment: the emptied block wasn't released");
+        if (static_cast<uint8_t*>(moved.mapped)[BlockSize / 4 - 1] != 0xAB)
+            return fail("defragment: the callback's copy didn't land in the new range");
+
+        VKHeapUsage after = allocator.GetHeapUsage(1);
+        if (after.categories[static_cast<uint32_t>(VKMemoryCategory::Uniform)] != before.categories[static_cast<uint32_t>(VKMemoryCategory::Uniform)] ||
+            after.reserved != BlockSize)
+            return fail("defragment: a move changed category usage");
+
+        //Nothing left to compact
+        if (allocator.Defragment(16) != 0)
+            return fail("defragment: a single block was compacted");
+
+        allocator.Free(moved);
+        allocator.Free(kept);
+        allocator.DeInitialize();
+    }
+
+    //A callback that refuses leaves everything where it was
+    {
+        VKMemoryAllocator allocator;
+        if (!setUpDefragment(allocator, kept, moved))
+            return false;
+
+        const VKAllocation original = moved;
+        VKMemoryStats before = allocator.GetStats();
+        VKHeapUsage usageBefore = allocator.GetHeapUsage(1);
+
+        allocator.SetMoveCallback([](const VKAllocation&, const VKAllocation&) { return false; });
+
+        if (allocator.Defragment(16) != 0)
+            return fail("defragment: a refused move was counted");
+
+        VKMemoryStats after = allocator.GetStats();
+        VKHeapUsage usageAfter = allocator.GetHeapUsage(1);
+        if (moved.memory != original.memory || moved.offset != original.offset)
+            return fail("defragment: a refused move changed the allocation");
+        if (after.blockCount != 2 || after.allocationCount != before.allocationCount || after.bytesUsed != before.bytesUsed)
+            return fail("defragment: a refused move left the blocks changed");
+        for (uint32_t i = 0; i < static_cast<uint32_t>(VKMemoryCategory::Count); i++)
+        {
+            if (usageAfter.categories[i] != usageBefore.categories[i])
+                return fail("defragment: a refused move changed category usage");
+        }
+
+        //The range is still live where it was, and freeing it releases its now empty block
+        allocator.Free(moved);
+        if (allocator.GetStats().blockCount != 1 || _DriverMemory.count(original.memory) != 0)
+            return fail("defragment: the untouched range couldn't be freed");
+
+        allocator.Free(kept);
+        allocator.DeInitialize();
+    }
+
+    return true;
+}
+
+int main()
+{
+    bool passed = testBuddy();
+    passed = testAlignment() && passed;
+    passed = testGranularity() && passed;
+    passed = testDedicated() && passed;
+    passed = testHeapUsage() && passed;
+    passed = testFragmentation() && passed;
+    passed = testDefragment() && passed;
+
+    if (!_DriverMemory.empty())
+    {
+        std::printf("FAIL: %zu blocks were never given back to the driver\n", _DriverMemory.size());
+        return 1;
+    }
+
+    if (!passed)
+        return 1;
+
+    std::printf("PASS: buddy allocation, alignment, granularity, dedicated ranges, heap usage, fragmentation and defragmentation\n");
+    return 0;
+}
@@ -0,0 +1,113 @@
+/**
+**    Hatchit Engine
+**    Copyright(c) 2015-2016 Third-Degree
+**
+**    GNU Lesser General Public License
+**    This file may be used under the terms of the GNU Lesser
+**    General Public License version 3 as published by the Free
+**    Software Foundation and appearing in the file LICENSE.LGPLv3 included
+**    in the packaging of this file. Please review the following information
+**    to ensure the GNU Lesser General Public License requirements
+**    will be met: https://www.gnu.org/licenses/lgpl.html
+**
+**/
+
+/**
+* Pushes from 16 threads at once through SubmissionQueue, the lock free
+* path render passes take scheduled requests through, and checks every
+* item comes out once and in each thread's order. New threads are started
+* every round so far more than SubmitSlots::MaxSlots threads push over the
+* test's life; none of them should be left on the locked overflow buffer.
+*
+* g++ -std=c++11 -pthread -Itests/support -Iinclude/unused
+*     tests/test_submissionqueue.cpp source/unused/ht_submissionqueue.cpp
+*/
+
+#include <ht_submissionqueue.h>
+#include <atomic>   //std::atomic
+#include <cstdio>   //printf
+#include <thread>   //std::thread
+#include <vector>   //std::vector
+
+using namespace Hatchit::Graphics;
+
+static const uint32_t ThreadCount = 16;
+static const uint32_t PushesPerThread = 10000;
+static const uint32_t Rounds = 16;
+
+struct Item
+{
+    uint32_t thread;
+    uint32_t sequence;
+};
+
+int main()
+{
+    SubmissionQueue<Item> queue;
+    std::atomic<uint32_t> overflowed(0);
+
+    for (uint32_t round = 0; round < Rounds; round++)
+    {
+        std::atomic<bool> go(false);
+
+        std::vector<std::thread> threads;
+        for (uint32_t t = 0; t < ThreadCount; t++)
+        {
+            threads.push_back(std::thread([&queue, &overflowed, &go, t]()
+            {
+                if (SubmitSlots::ThisThread() >= SubmitSlots::MaxSlots)
+                    overflowed++;
+
+                //Start together so the pushes really overlap
+                while (!go)
+                    std::this_thread::yield();
+
+                for (uint32_t i = 0; i < PushesPerThread; i++)
+                    queue.Push({ t, i });
+            }));
+        }
+
+        go = true;
+        for (size_t t = 0; t < threads.size(); t++)
+            threads[t].join();
+
+        std::vector<Item> items;
+        queue.Gather(items);
+
+        if (items.size() != ThreadCount * PushesPerThread)
+        {
+            std::printf("FAIL: round %u gathered %zu items, expected %u\n", round, items.size(), ThreadCount * PushesPerThread);
+            return 1;
+        }
+
+        //Each thread's items come out of its own buffer in the order they were pushed
+        std::vector<uint32_t> next(ThreadCount, 0);
+        for (size_t i = 0; i < items.size(); i++)
+        {
+            const Item& item = items[i];
+            if (item.thread >= ThreadCount || item.sequence != next[item.thread])
+            {
+                std::printf("FAIL: round %u item %zu out of order\n", round, i);
+                return 1;
+            }
+            next[item.thread]++;
+        }
+    }
+
+    if (overflowed > 0)
+    {
+        std::printf("FAIL: %u threads fell back to the overflow buffer\n", overflowed.load());
+        return 1;
+    }
+
+    std::vector<Item> leftover;
+    queue.Gather(leftover);
+    if (!leftover.empty())
+    {
+        std::printf("FAIL: %zu items left after the last gather\n", leftover.size());
+        return 1;
+    }
+
+    std::printf("PASS: %u threads pushed %u items each over %u rounds\n", ThreadCount, PushesPerThread, Rounds);
+    return 0;
+}